@@ -164,6 +164,15 @@ int cfs_crypto_hash_update(struct cfs_crypto_hash_desc *desc, const void *buf,
 			   unsigned int buf_len);
 int cfs_crypto_hash_final(struct cfs_crypto_hash_desc *desc,
 			  unsigned char *hash, unsigned int *hash_len);
+
+/* Get the \a idx page fragment of \a data for cfs_crypto_hash_pages(). */
+typedef void (*cfs_crypto_page_get_t)(void *data, unsigned int idx,
+				      struct page **page,
+				      unsigned int *offset, unsigned int *len);
+int cfs_crypto_hash_pages(enum cfs_crypto_hash_alg hash_alg,
+			  cfs_crypto_page_get_t get, void *data,
+			  unsigned int npages, unsigned char *hash,
+			  unsigned int *hash_len);
 int cfs_crypto_register(void);
 void cfs_crypto_unregister(void);
 int cfs_crypto_hash_speed(enum cfs_crypto_hash_alg hash_alg);
@@ -665,6 +665,20 @@ void cfs_hash_bd_move_locked(cfs_hash_t *hs, cfs_hash_bd_t *bd_old,
 static inline int cfs_hash_bd_dec_and_lock(cfs_hash_t *hs, cfs_hash_bd_t *bd,
 					   atomic_t *condition)
 {
+	if (cfs_hash_with_rw_bktlock(hs)) {
+		/* same as atomic_dec_and_lock(), bucket is write-locked
+		 * if the counter drops to zero */
+		if (atomic_add_unless(condition, -1, 1))
+			return 0;
+
+		write_lock(&bd->bd_bucket->hsb_lock.rw);
+		if (atomic_dec_and_test(condition))
+			return 1;
+
+		write_unlock(&bd->bd_bucket->hsb_lock.rw);
+		return 0;
+	}
+
 	LASSERT(cfs_hash_with_spin_bktlock(hs));
 	return atomic_dec_and_lock(condition, &bd->bd_bucket->hsb_lock.spin);
 }
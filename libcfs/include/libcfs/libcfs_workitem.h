@@ -107,6 +107,8 @@ void cfs_wi_shutdown(void);
 #ifdef __KERNEL__
 /** # workitem scheduler loops before reschedule */
 #define CFS_WI_RESCHED    128
+
+int cfs_wi_sched_print(char *buf, int len);
 #else
 int cfs_wi_check_events(void);
 #endif
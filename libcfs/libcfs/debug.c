@@ -90,6 +90,11 @@ EXPORT_SYMBOL(libcfs_console_backoff);
 unsigned int libcfs_debug_binary = 1;
 EXPORT_SYMBOL(libcfs_debug_binary);
 
+unsigned int libcfs_debug_raw;
+CFS_MODULE_PARM(libcfs_debug_raw, "i", uint, 0644,
+		"Lustre kernel debug mask logged unformatted until dumped");
+EXPORT_SYMBOL(libcfs_debug_raw);
+
 unsigned int libcfs_stack = 3 * THREAD_SIZE / 4;
 EXPORT_SYMBOL(libcfs_stack);
 
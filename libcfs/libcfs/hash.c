@@ -1851,18 +1851,27 @@ cfs_hash_rehash(cfs_hash_t *hs, int do_rehash)
 }
 EXPORT_SYMBOL(cfs_hash_rehash);
 
+/*
+ * Move elements of @old to their buckets in the new bucket-table.
+ * Lookups and changes search both bucket-tables while rehashing, and they
+ * lock both buckets of a key, so moving an element only needs the locks
+ * of its old and new buckets, not cfs_hash_lock(hs, 1).
+ * Called with cfs_hash_lock(hs, 0) held.
+ */
 static int
 cfs_hash_rehash_bd(cfs_hash_t *hs, cfs_hash_bd_t *old)
 {
 	cfs_hash_bd_t      new;
+	cfs_hash_bd_t      cur;
 	struct hlist_head *hhead;
 	struct hlist_node *hnode;
 	struct hlist_node *pos;
 	void		  *key;
 	int		   c = 0;
 
-	/* hold cfs_hash_lock(hs, 1), so don't need any bucket lock */
 	cfs_hash_bd_for_each_hlist(hs, old, hhead) {
+ again:
+		cfs_hash_bd_lock(hs, old, 1);
 		hlist_for_each_safe(hnode, pos, hhead) {
 			key = cfs_hash_key(hs, hnode);
 			LASSERT(key != NULL);
@@ -1874,9 +1883,48 @@ cfs_hash_rehash_bd(cfs_hash_t *hs, cfs_hash_bd_t *old)
 			 */
 			cfs_hash_bd_from_key(hs, hs->hs_rehash_buckets,
 					     hs->hs_rehash_bits, key, &new);
-			cfs_hash_bd_move_locked(hs, old, &new, hnode);
-			c++;
+			if (cfs_hash_bd_compare(old, &new) == 0)
+				continue;
+
+			/* bucket locks are taken in ascending index order */
+			if (new.bd_bucket->hsb_index >=
+			    old->bd_bucket->hsb_index) {
+				if (new.bd_bucket != old->bd_bucket)
+					cfs_hash_bd_lock(hs, &new, 1);
+				cfs_hash_bd_move_locked(hs, old, &new, hnode);
+				if (new.bd_bucket != old->bd_bucket)
+					cfs_hash_bd_unlock(hs, &new, 1);
+				c++;
+				continue;
+			}
+
+			/* relock in order, @hnode can be removed meanwhile */
+			cfs_hash_bd_unlock(hs, old, 1);
+			cfs_hash_bd_lock(hs, &new, 1);
+			cfs_hash_bd_lock(hs, old, 1);
+
+			hlist_for_each(pos, hhead) {
+				if (pos != hnode)
+					continue;
+
+				cfs_hash_bd_from_key(hs, hs->hs_rehash_buckets,
+						     hs->hs_rehash_bits,
+						     cfs_hash_key(hs, hnode),
+						     &cur);
+				if (cfs_hash_bd_compare(&new, &cur) == 0) {
+					cfs_hash_bd_move_locked(hs, old, &new,
+								hnode);
+					c++;
+				}
+				break;
+			}
+
+			cfs_hash_bd_unlock(hs, old, 1);
+			cfs_hash_bd_unlock(hs, &new, 1);
+			/* elements left in @hhead don't move */
+			goto again;
 		}
+		cfs_hash_bd_unlock(hs, old, 1);
 	}
 	return c;
 }
@@ -1933,6 +1981,11 @@ cfs_hash_rehash_worker(cfs_workitem_t *wi)
         LASSERT(hs->hs_rehash_buckets == NULL);
         hs->hs_rehash_buckets = bkts;
 
+	/* from now on elements are found in either bucket-table, so they
+	 * can be moved with bucket locks while the hash is in use */
+	cfs_hash_unlock(hs, 1);
+	cfs_hash_lock(hs, 0);
+
         rc = 0;
         cfs_hash_for_each_bucket(hs, &bd, i) {
                 if (cfs_hash_is_exiting(hs)) {
@@ -1941,6 +1994,8 @@ cfs_hash_rehash_worker(cfs_workitem_t *wi)
                         if (old_size < new_size) /* OK to free old bkt-table */
                                 break;
                         /* it's shrinking, need free new bkt-table */
+			cfs_hash_unlock(hs, 0);
+			cfs_hash_lock(hs, 1);
                         hs->hs_rehash_buckets = NULL;
                         old_size = new_size;
                         new_size = CFS_HASH_NBKT(hs);
@@ -1954,11 +2009,15 @@ cfs_hash_rehash_worker(cfs_workitem_t *wi)
                 }
 
 		count = 0;
-		cfs_hash_unlock(hs, 1);
+		cfs_hash_unlock(hs, 0);
 		cond_resched();
-		cfs_hash_lock(hs, 1);
+		cfs_hash_lock(hs, 0);
 	}
 
+	/* switch bucket-tables, nothing is moved here */
+	cfs_hash_unlock(hs, 0);
+	cfs_hash_lock(hs, 1);
+
         hs->hs_rehash_count++;
 
         bkts = hs->hs_buckets;
@@ -279,6 +279,371 @@ free:
 }
 EXPORT_SYMBOL(cfs_crypto_hash_final);
 
+/* Reflected polynomials of CRC32 and CRC32C. */
+#define CFS_CRC32_POLY		0xedb88320
+#define CFS_CRC32C_POLY		0x82f63b78
+
+/* Largest prime smaller than 65536, as in zlib. */
+#define CFS_ADLER32_BASE	65521
+
+/* Split the pages among threads only if each one gets at least so many. */
+#define CFS_CRYPTO_CHUNK_PAGES	64
+
+static int cksum_threads = 4;
+CFS_MODULE_PARM(cksum_threads, "i", int, 0444,
+		"threads per CPU partition to compute the checksum of large "
+		"bulk in parallel, 0 to disable");
+
+/* per-CPT schedulers, the chunks of a bulk stay on the caller's CPT */
+static struct cfs_wi_sched **cfs_crypto_scheds;
+
+struct cfs_crypto_chunk {
+	cfs_workitem_t		 ccc_wi;
+	/* scheduler the chunk is queued on */
+	struct cfs_wi_sched	*ccc_sched;
+	/* set by whoever hashes the chunk, a thread or the caller */
+	atomic_t		 ccc_taken;
+	enum cfs_crypto_hash_alg ccc_alg;
+	cfs_crypto_page_get_t	 ccc_get;
+	void			*ccc_data;
+	unsigned int		 ccc_start;
+	unsigned int		 ccc_count;
+	/* bytes hashed in this chunk */
+	__u64			 ccc_len;
+	__u32			 ccc_hash;
+	int			 ccc_rc;
+	atomic_t		*ccc_pending;
+	struct completion	*ccc_done;
+};
+
+static __u32 cfs_gf2_matrix_times(const __u32 *mat, __u32 vec)
+{
+	__u32 sum = 0;
+
+	while (vec != 0) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+
+	return sum;
+}
+
+static void cfs_gf2_matrix_square(__u32 *square, const __u32 *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = cfs_gf2_matrix_times(mat, mat[n]);
+}
+
+/**
+ * Advance the (not inverted) CRC \a crc over \a len zero bytes.
+ *
+ * This is the operator used by zlib crc32_combine(), with the polynomial
+ * as parameter, then crc(A|B) = shift(crc(A), len(B)) ^ crc'(B) where
+ * crc'(B) is computed from zero initial value.
+ */
+static __u32 cfs_crc32_shift(__u32 poly, __u32 crc, __u64 len)
+{
+	__u32	even[32];
+	__u32	odd[32];
+	__u32	row = 1;
+	int	n;
+
+	if (len == 0)
+		return crc;
+
+	odd[0] = poly;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	/* operators for two and four zero bits */
+	cfs_gf2_matrix_square(even, odd);
+	cfs_gf2_matrix_square(odd, even);
+
+	do {
+		cfs_gf2_matrix_square(even, odd);
+		if (len & 1)
+			crc = cfs_gf2_matrix_times(even, crc);
+		len >>= 1;
+		if (len == 0)
+			break;
+
+		cfs_gf2_matrix_square(odd, even);
+		if (len & 1)
+			crc = cfs_gf2_matrix_times(odd, crc);
+		len >>= 1;
+	} while (len != 0);
+
+	return crc;
+}
+
+static __u32 cfs_adler32_combine(__u32 adler1, __u32 adler2, __u64 len2)
+{
+	__u32 sum1;
+	__u32 sum2;
+	__u32 rem;
+
+	rem = do_div(len2, CFS_ADLER32_BASE);
+	sum1 = adler1 & 0xffff;
+	sum2 = (rem * sum1) % CFS_ADLER32_BASE;
+	sum1 += (adler2 & 0xffff) + CFS_ADLER32_BASE - 1;
+	sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) +
+		CFS_ADLER32_BASE - rem;
+	if (sum1 >= CFS_ADLER32_BASE)
+		sum1 -= CFS_ADLER32_BASE;
+	if (sum1 >= CFS_ADLER32_BASE)
+		sum1 -= CFS_ADLER32_BASE;
+	if (sum2 >= (CFS_ADLER32_BASE << 1))
+		sum2 -= (CFS_ADLER32_BASE << 1);
+	if (sum2 >= CFS_ADLER32_BASE)
+		sum2 -= CFS_ADLER32_BASE;
+
+	return sum1 | (sum2 << 16);
+}
+
+/**
+ * Combine the checksums of two adjacent chunks.
+ *
+ * \a hash2 is computed from the initial value returned by
+ * cfs_crypto_chunk_key(), the result is the same as the checksum of
+ * the two chunks computed at once.
+ */
+static __u32 cfs_crypto_hash_combine(enum cfs_crypto_hash_alg hash_alg,
+				     __u32 hash1, __u32 hash2, __u64 len2)
+{
+	switch (hash_alg) {
+	case CFS_HASH_ALG_ADLER32:
+		return cfs_adler32_combine(hash1, hash2, len2);
+	case CFS_HASH_ALG_CRC32:
+		return cfs_crc32_shift(CFS_CRC32_POLY, hash1, len2) ^ hash2;
+	case CFS_HASH_ALG_CRC32C:
+		/* crc32c digest is inverted */
+		return ~(cfs_crc32_shift(CFS_CRC32C_POLY, ~hash1, len2) ^
+			 ~hash2);
+	default:
+		LBUG();
+	}
+
+	return 0;
+}
+
+static int cfs_crypto_chunk_hash(struct cfs_crypto_chunk *ccc)
+{
+	struct cfs_crypto_hash_desc	*hdesc;
+	struct page			*page;
+	unsigned int			 offset;
+	unsigned int			 len;
+	unsigned int			 bufsize = sizeof(__u32);
+	unsigned char			*key	 = NULL;
+	__le32				 crc_key = 0;
+	__le32				 hash;
+	unsigned int			 i;
+	int				 rc;
+
+	/* The chunks other than the first one start from zero CRC, then
+	 * they can be combined. Adler32 always starts from its default. */
+	if (ccc->ccc_start != 0 && ccc->ccc_alg != CFS_HASH_ALG_ADLER32)
+		key = (unsigned char *)&crc_key;
+
+	hdesc = cfs_crypto_hash_init(ccc->ccc_alg, key,
+				     key != NULL ? sizeof(crc_key) : 0);
+	if (IS_ERR(hdesc))
+		return PTR_ERR(hdesc);
+
+	ccc->ccc_len = 0;
+	for (i = ccc->ccc_start; i < ccc->ccc_start + ccc->ccc_count; i++) {
+		ccc->ccc_get(ccc->ccc_data, i, &page, &offset, &len);
+		cfs_crypto_hash_update_page(hdesc, page, offset, len);
+		ccc->ccc_len += len;
+	}
+
+	rc = cfs_crypto_hash_final(hdesc, (unsigned char *)&hash, &bufsize);
+	if (rc != 0)
+		return rc;
+
+	if (ccc->ccc_alg == CFS_HASH_ALG_ADLER32)
+		ccc->ccc_hash = (__force __u32)hash;
+	else
+		ccc->ccc_hash = le32_to_cpu(hash);
+
+	return 0;
+}
+
+static int cfs_crypto_chunk_action(cfs_workitem_t *wi)
+{
+	struct cfs_crypto_chunk *ccc	 = wi->wi_data;
+	atomic_t		*pending = ccc->ccc_pending;
+	struct completion	*done	 = ccc->ccc_done;
+
+	/* the caller may have taken it back already */
+	if (atomic_xchg(&ccc->ccc_taken, 1) == 0)
+		ccc->ccc_rc = cfs_crypto_chunk_hash(ccc);
+
+	/* Nothing schedules it again, and no cfs_wi_exit() so that the
+	 * caller can still cfs_wi_deschedule() it, which then only sees it
+	 * running. @ccc may be freed once @pending drops to zero. */
+	if (atomic_dec_and_test(pending))
+		complete(done);
+
+	return 1;
+}
+
+static int cfs_crypto_nthreads(int cpt)
+{
+	return min(cksum_threads, cfs_cpt_weight(cfs_cpt_table, cpt));
+}
+
+static int cfs_crypto_hash_pages_serial(enum cfs_crypto_hash_alg hash_alg,
+					cfs_crypto_page_get_t get, void *data,
+					unsigned int npages,
+					unsigned char *hash,
+					unsigned int *hash_len)
+{
+	struct cfs_crypto_hash_desc	*hdesc;
+	struct page			*page;
+	unsigned int			 offset;
+	unsigned int			 len;
+	unsigned int			 i;
+
+	hdesc = cfs_crypto_hash_init(hash_alg, NULL, 0);
+	if (IS_ERR(hdesc))
+		return PTR_ERR(hdesc);
+
+	for (i = 0; i < npages; i++) {
+		get(data, i, &page, &offset, &len);
+		cfs_crypto_hash_update_page(hdesc, page, offset, len);
+	}
+
+	return cfs_crypto_hash_final(hdesc, hash, hash_len);
+}
+
+/**
+ * Compute the hash of the data in the given pages.
+ *
+ * The result is the same as hashing the pages in turn with
+ * cfs_crypto_hash_update_page(). For checksums that can be combined,
+ * i.e. adler32, crc32 and crc32c, large data is split into chunks that
+ * are hashed in parallel by the "cfs_cksum" threads of the caller's CPT
+ * and the caller, then the chunk checksums are combined. The caller
+ * never waits for a chunk no thread has started, it takes it back and
+ * hashes it by itself, so busy threads cost no more than hashing serially.
+ *
+ * \param[in] hash_alg	algorithm id (CFS_HASH_ALG_*)
+ * \param[in] get	callback to get the \a idx page fragment of \a data
+ * \param[in] data	opaque data for \a get
+ * \param[in] npages	number of page fragments
+ * \param[out] hash	pointer to hash buffer to store hash digest
+ * \param[in,out] hash_len size of \a hash buffer
+ *
+ * \retval		0 for success
+ * \retval		negative errno on failure
+ */
+int cfs_crypto_hash_pages(enum cfs_crypto_hash_alg hash_alg,
+			  cfs_crypto_page_get_t get, void *data,
+			  unsigned int npages, unsigned char *hash,
+			  unsigned int *hash_len)
+{
+	struct cfs_crypto_chunk	*chunks;
+	struct cfs_wi_sched	*sched;
+	struct completion	 done;
+	atomic_t		 pending;
+	unsigned int		 nchunks;
+	unsigned int		 per;
+	unsigned int		 i;
+	__u32			 cksum;
+	int			 cpt;
+	int			 rc;
+
+	if (cfs_crypto_scheds == NULL || hash == NULL || hash_len == NULL ||
+	    *hash_len < sizeof(cksum) ||
+	    (hash_alg != CFS_HASH_ALG_ADLER32 &&
+	     hash_alg != CFS_HASH_ALG_CRC32 &&
+	     hash_alg != CFS_HASH_ALG_CRC32C))
+		goto serial;
+
+	cpt = cfs_cpt_current(cfs_cpt_table, 1);
+	sched = cfs_crypto_scheds[cpt];
+	nchunks = min_t(unsigned int, cfs_crypto_nthreads(cpt) + 1,
+			npages / CFS_CRYPTO_CHUNK_PAGES);
+	if (nchunks < 2)
+		goto serial;
+
+	LIBCFS_ALLOC(chunks, nchunks * sizeof(*chunks));
+	if (chunks == NULL)
+		goto serial;
+
+	init_completion(&done);
+	/* one for each queued chunk and one for the caller */
+	atomic_set(&pending, nchunks);
+	per = npages / nchunks;
+	for (i = 0; i < nchunks; i++) {
+		struct cfs_crypto_chunk *ccc = &chunks[i];
+
+		ccc->ccc_alg = hash_alg;
+		ccc->ccc_get = get;
+		ccc->ccc_data = data;
+		ccc->ccc_start = i * per;
+		ccc->ccc_count = i == nchunks - 1 ? npages - i * per : per;
+		ccc->ccc_pending = &pending;
+		ccc->ccc_done = &done;
+		ccc->ccc_sched = sched;
+		atomic_set(&ccc->ccc_taken, 0);
+		if (i == 0)
+			continue;
+
+		cfs_wi_init(&ccc->ccc_wi, ccc, cfs_crypto_chunk_action);
+		cfs_wi_schedule(sched, &ccc->ccc_wi);
+	}
+
+	/* The caller hashes the first chunk by itself, then takes back the
+	 * chunks no thread has started, the last ones first since threads
+	 * start them in order. */
+	rc = cfs_crypto_chunk_hash(&chunks[0]);
+	for (i = nchunks - 1; i > 0; i--) {
+		struct cfs_crypto_chunk *ccc = &chunks[i];
+
+		if (atomic_xchg(&ccc->ccc_taken, 1) != 0)
+			continue;
+
+		/* a chunk still queued won't run and count itself done */
+		if (cfs_wi_deschedule(ccc->ccc_sched, &ccc->ccc_wi))
+			atomic_dec(&pending);
+		ccc->ccc_rc = cfs_crypto_chunk_hash(ccc);
+	}
+
+	if (!atomic_dec_and_test(&pending))
+		wait_for_completion(&done);
+
+	cksum = chunks[0].ccc_hash;
+	for (i = 1; i < nchunks && rc == 0; i++) {
+		rc = chunks[i].ccc_rc;
+		cksum = cfs_crypto_hash_combine(hash_alg, cksum,
+						chunks[i].ccc_hash,
+						chunks[i].ccc_len);
+	}
+	LIBCFS_FREE(chunks, nchunks * sizeof(*chunks));
+	if (rc != 0)
+		return rc;
+
+	if (hash_alg == CFS_HASH_ALG_ADLER32)
+		*(__u32 *)hash = cksum;
+	else
+		*(__le32 *)hash = cpu_to_le32(cksum);
+	*hash_len = sizeof(cksum);
+
+	return 0;
+
+serial:
+	return cfs_crypto_hash_pages_serial(hash_alg, get, data, npages,
+					    hash, hash_len);
+}
+EXPORT_SYMBOL(cfs_crypto_hash_pages);
+
 /**
  * Compute the speed of specified hash function
  *
@@ -415,6 +780,48 @@ static int crc32c_pclmul;
 #endif
 #endif /* HAVE_PCLMULQDQ */
 
+static void cfs_crypto_scheds_destroy(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int i;
+
+	if (cfs_crypto_scheds == NULL)
+		return;
+
+	for (i = 0; i < ncpts; i++) {
+		if (cfs_crypto_scheds[i] != NULL)
+			cfs_wi_sched_destroy(cfs_crypto_scheds[i]);
+	}
+
+	LIBCFS_FREE(cfs_crypto_scheds, ncpts * sizeof(cfs_crypto_scheds[0]));
+	cfs_crypto_scheds = NULL;
+}
+
+static void cfs_crypto_scheds_create(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int rc = -ENOMEM;
+	int i;
+
+	LIBCFS_ALLOC(cfs_crypto_scheds, ncpts * sizeof(cfs_crypto_scheds[0]));
+	if (cfs_crypto_scheds == NULL)
+		goto failed;
+
+	for (i = 0; i < ncpts; i++) {
+		rc = cfs_wi_sched_create("cfs_cksum", cfs_cpt_table, i,
+					 cfs_crypto_nthreads(i),
+					 &cfs_crypto_scheds[i]);
+		if (rc != 0)
+			goto failed;
+	}
+
+	return;
+failed:
+	CWARN("Failed to start checksum threads, bulk checksum will not be "
+	      "parallel: rc = %d\n", rc);
+	cfs_crypto_scheds_destroy();
+}
+
 /**
  * Register available hash functions
  *
@@ -441,6 +848,9 @@ int cfs_crypto_register(void)
 	/* check all algorithms and do performance test */
 	cfs_crypto_test_hashes();
 
+	if (cksum_threads > 0)
+		cfs_crypto_scheds_create();
+
 	return 0;
 }
 
@@ -449,6 +859,8 @@ int cfs_crypto_register(void)
  */
 void cfs_crypto_unregister(void)
 {
+	cfs_crypto_scheds_destroy();
+
 	if (adler32 == 0)
 		cfs_crypto_adler32_unregister();
 
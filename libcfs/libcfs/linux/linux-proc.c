@@ -376,6 +376,53 @@ proc_cpt_table(struct ctl_table *table, int write, void __user *buffer,
 				     __proc_cpt_table);
 }
 
+static int __proc_workitems(void *data, int write,
+			    loff_t pos, void __user *buffer, int nob)
+{
+	char *buf = NULL;
+	int   len = 4096;
+	int   rc  = 0;
+
+	if (write)
+		return -EPERM;
+
+	while (1) {
+		LIBCFS_ALLOC(buf, len);
+		if (buf == NULL)
+			return -ENOMEM;
+
+		rc = cfs_wi_sched_print(buf, len);
+		if (rc >= 0)
+			break;
+
+		LIBCFS_FREE(buf, len);
+		if (rc == -EFBIG) {
+			len <<= 1;
+			continue;
+		}
+		goto out;
+	}
+
+	if (pos >= rc) {
+		rc = 0;
+		goto out;
+	}
+
+	rc = cfs_trace_copyout_string(buffer, nob, buf + pos, NULL);
+ out:
+	if (buf != NULL)
+		LIBCFS_FREE(buf, len);
+	return rc;
+}
+
+static int
+proc_workitems(struct ctl_table *table, int write, void __user *buffer,
+	       size_t *lenp, loff_t *ppos)
+{
+	return lprocfs_call_handler(table->data, write, ppos, buffer, lenp,
+				     __proc_workitems);
+}
+
 static struct ctl_table lnet_table[] = {
 	/*
 	 * NB No .strategy entries have been provided since sysctl(8) prefers
@@ -397,6 +444,14 @@ static struct ctl_table lnet_table[] = {
 		.mode		= 0644,
 		.proc_handler	= &proc_dobitmasks,
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "debug_raw",
+		.data		= &libcfs_debug_raw,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= &proc_dobitmasks,
+	},
 	{
 		INIT_CTL_NAME
 		.procname	= "printk",
@@ -449,6 +504,13 @@ static struct ctl_table lnet_table[] = {
 		.mode		= 0444,
 		.proc_handler	= &proc_cpt_table,
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "workitems",
+		.maxlen		= 128,
+		.mode		= 0444,
+		.proc_handler	= &proc_workitems,
+	},
 	{
 		INIT_CTL_NAME
 		.procname	= "upcall",
@@ -166,6 +166,7 @@ cfs_trace_get_tage_try(struct cfs_trace_cpu_data *tcd, unsigned long len)
 		}
 
 		tage->used = 0;
+		tage->raw = 0;
 		tage->cpu = smp_processor_id();
 		tage->type = tcd->tcd_type;
 		list_add_tail(&tage->linkage, &tcd->tcd_pages);
@@ -237,11 +238,96 @@ static struct cfs_trace_page *cfs_trace_get_tage(struct cfs_trace_cpu_data *tcd,
         if (tcd->tcd_cur_pages > 0) {
                 tage = cfs_tage_from_list(tcd->tcd_pages.next);
                 tage->used = 0;
+		tage->raw = 0;
                 cfs_tage_to_tail(tage, &tcd->tcd_pages);
         }
         return tage;
 }
 
+#ifdef CONFIG_BINARY_PRINTF
+/*
+ * %p extensions dereference their argument when the record is formatted,
+ * the object may be gone by then, so such messages are logged as text.
+ */
+static bool cfs_trace_raw_fmt_ok(const char *fmt)
+{
+	while ((fmt = strstr(fmt, "%p")) != NULL) {
+		fmt += 2;
+		if (isalnum(*fmt))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Log a message as a raw record: the format and the arguments packed by
+ * vbin_printf(), which is much cheaper than vsnprintf(). The record is
+ * formatted only when its page is dumped, see cfs_trace_decode_pages().
+ *
+ * Returns 0 on success, or an error if the message should be logged as text.
+ */
+static int cfs_trace_raw_msg(struct cfs_trace_cpu_data *tcd,
+			     struct ptldebug_header *header,
+			     const char *file, const char *fn,
+			     const char *format, va_list args)
+{
+	struct cfs_trace_raw_rec  rec;
+	struct cfs_trace_page	 *tage;
+	char			 *debug_buf;
+	u32			 *bin_buf;
+	va_list			  ap;
+	int			  known_size = sizeof(*header) + sizeof(rec);
+	int			  words = 8; /* average number of arguments */
+	int			  max_words;
+	int			  i;
+
+	if (!cfs_trace_raw_fmt_ok(format))
+		return -EINVAL;
+
+	for (i = 0; i < 2; i++) {
+		/* sizeof(u32) - 1 for the alignment of the arguments */
+		if (known_size + (words + 1) * sizeof(u32) > PAGE_CACHE_SIZE)
+			return -E2BIG;
+
+		tage = cfs_trace_get_tage(tcd, known_size +
+					       (words + 1) * sizeof(u32));
+		if (tage == NULL)
+			return -ENOMEM;
+
+		debug_buf = (char *)page_address(tage->page) + tage->used;
+		bin_buf = (u32 *)PTR_ALIGN(debug_buf + known_size,
+					   sizeof(u32));
+		max_words = ((char *)page_address(tage->page) +
+			     PAGE_CACHE_SIZE - (char *)bin_buf) / sizeof(u32);
+
+		va_copy(ap, args);
+		words = vbin_printf(bin_buf, max_words, format, ap);
+		va_end(ap);
+
+		if (words <= max_words)
+			break;
+	}
+
+	if (i == 2)
+		return -E2BIG;
+
+	rec.trr_file = file;
+	rec.trr_fn = fn;
+	rec.trr_fmt = format;
+
+	header->ph_flags |= PH_FLAG_RAW;
+	header->ph_len = (char *)(bin_buf + words) - debug_buf;
+	memcpy(debug_buf, header, sizeof(*header));
+	memcpy(debug_buf + sizeof(*header), &rec, sizeof(rec));
+
+	tage->used += header->ph_len;
+	tage->raw = 1;
+	__LASSERT(tage->used <= PAGE_CACHE_SIZE);
+
+	return 0;
+}
+#endif
+
 int libcfs_debug_msg(struct libcfs_debug_msg_data *msgdata,
                      const char *format, ...)
 {
@@ -298,6 +384,17 @@ int libcfs_debug_vmsg2(struct libcfs_debug_msg_data *msgdata,
                 goto console;
         }
 
+#ifdef CONFIG_BINARY_PRINTF
+	/* messages which go to the console are formatted anyway */
+	if ((mask & libcfs_debug_raw) != 0 && (mask & libcfs_printk) == 0 &&
+	    libcfs_debug_binary && format1 != NULL && format2 == NULL &&
+	    cfs_trace_raw_msg(tcd, &header, file, msgdata->msg_fn,
+			      format1, args) == 0) {
+		cfs_trace_put_tcd(tcd);
+		return 1;
+	}
+#endif
+
 	known_size = strlen(file) + 1;
         if (msgdata->msg_fn)
                 known_size += strlen(msgdata->msg_fn) + 1;
@@ -620,6 +717,233 @@ static void put_pages_on_daemon_list(struct page_collection *pc)
         }
 }
 
+#ifdef CONFIG_BINARY_PRINTF
+/*
+ * Raw records are formatted on the dump path too, which LBUG and memory
+ * pressure can get to, so decoding never sleeps for memory: the scratch
+ * buffer is allocated at init and serialised by cfs_trace_decode_mutex,
+ * pages are taken from the raw pages already decoded before GFP_ATOMIC.
+ */
+static DEFINE_MUTEX(cfs_trace_decode_mutex);
+static char *cfs_trace_decode_buf;
+/* # records lost because no page was left to format them into */
+static atomic_t cfs_trace_decode_dropped = ATOMIC_INIT(0);
+
+/*
+ * Get a page with \a len bytes left for the records formatted from \a src,
+ * \a tage is the last one returned for \a src. Pages on \a spare are used
+ * before new ones are allocated.
+ */
+static struct cfs_trace_page *
+cfs_trace_decode_get_tage(struct cfs_trace_page *src,
+			  struct cfs_trace_page *tage, int len,
+			  struct list_head *pages, struct list_head *spare)
+{
+	if (tage != NULL && tage->used + len <= PAGE_CACHE_SIZE)
+		return tage;
+
+	if (!list_empty(spare)) {
+		tage = cfs_tage_from_list(spare->next);
+		list_del(&tage->linkage);
+	} else {
+		tage = cfs_tage_alloc(GFP_ATOMIC);
+		if (tage == NULL)
+			return NULL;
+	}
+
+	tage->used = 0;
+	tage->raw = 0;
+	tage->cpu = src->cpu;
+	tage->type = src->type;
+	list_add_tail(&tage->linkage, pages);
+	return tage;
+}
+
+/*
+ * Copy the records of \a src to pages appended to \a pages, formatting
+ * the raw ones into text records. \a buf has PAGE_CACHE_SIZE bytes.
+ *
+ * Returns the number of records dropped because no page was available.
+ */
+static int cfs_trace_decode_page(struct cfs_trace_page *src,
+				 struct list_head *pages,
+				 struct list_head *spare, char *buf)
+{
+	struct cfs_trace_page	 *tage = NULL;
+	struct ptldebug_header	  hdr;
+	struct cfs_trace_raw_rec  rec;
+	char			 *p = page_address(src->page);
+	char			 *end = p + src->used;
+	char			 *debug_buf;
+	int			  known_size;
+	int			  needed;
+	int			  dropped = 0;
+	int			  len;
+
+	for (; p < end; p += len) {
+		memcpy(&hdr, p, sizeof(hdr));
+		len = hdr.ph_len;
+
+		if (!(hdr.ph_flags & PH_FLAG_RAW)) {
+			tage = cfs_trace_decode_get_tage(src, tage, len, pages,
+							 spare);
+			if (tage == NULL) {
+				dropped++;
+				continue;
+			}
+			memcpy((char *)page_address(tage->page) + tage->used,
+			       p, len);
+			tage->used += len;
+			continue;
+		}
+
+		memcpy(&rec, p + sizeof(hdr), sizeof(rec));
+		known_size = sizeof(hdr) + strlen(rec.trr_file) + 1;
+		if (rec.trr_fn != NULL)
+			known_size += strlen(rec.trr_fn) + 1;
+
+		needed = bstr_printf(buf, PAGE_CACHE_SIZE - known_size,
+				     rec.trr_fmt,
+				     (u32 *)PTR_ALIGN(p + sizeof(hdr) +
+						      sizeof(rec),
+						      sizeof(u32)));
+		needed = min_t(int, needed, PAGE_CACHE_SIZE - known_size - 1);
+
+		hdr.ph_flags &= ~PH_FLAG_RAW;
+		hdr.ph_len = known_size + needed;
+		tage = cfs_trace_decode_get_tage(src, tage, hdr.ph_len, pages,
+						 spare);
+		if (tage == NULL) {
+			dropped++;
+			continue;
+		}
+
+		debug_buf = (char *)page_address(tage->page) + tage->used;
+		memcpy(debug_buf, &hdr, sizeof(hdr));
+		debug_buf += sizeof(hdr);
+
+		strcpy(debug_buf, rec.trr_file);
+		debug_buf += strlen(rec.trr_file) + 1;
+
+		if (rec.trr_fn != NULL) {
+			strcpy(debug_buf, rec.trr_fn);
+			debug_buf += strlen(rec.trr_fn) + 1;
+		}
+
+		memcpy(debug_buf, buf, needed);
+		tage->used += hdr.ph_len;
+	}
+
+	return dropped;
+}
+
+/* format the raw records of \a pc, keeping the order of the pages */
+static void cfs_trace_decode_pages(struct page_collection *pc)
+{
+	struct cfs_trace_page	*tage;
+	struct cfs_trace_page	*tmp;
+	struct list_head	 pages;
+	struct list_head	 spare;
+	int			 dropped = 0;
+
+	INIT_LIST_HEAD(&pages);
+	INIT_LIST_HEAD(&spare);
+
+	mutex_lock(&cfs_trace_decode_mutex);
+	list_for_each_entry_safe(tage, tmp, &pc->pc_pages, linkage) {
+		__LASSERT_TAGE_INVARIANT(tage);
+
+		if (!tage->raw) {
+			list_move_tail(&tage->linkage, &pages);
+			continue;
+		}
+
+		dropped += cfs_trace_decode_page(tage, &pages, &spare,
+						 cfs_trace_decode_buf);
+		/* its records are copied, reuse it for the next ones */
+		list_move_tail(&tage->linkage, &spare);
+	}
+	mutex_unlock(&cfs_trace_decode_mutex);
+
+	list_splice(&pages, &pc->pc_pages);
+	list_for_each_entry_safe(tage, tmp, &spare, linkage) {
+		list_del(&tage->linkage);
+		cfs_tage_free(tage);
+	}
+
+	if (dropped > 0) {
+		atomic_add(dropped, &cfs_trace_decode_dropped);
+		printk(KERN_ERR "LustreError: dropped %d debug records "
+		       "(%d total), out of memory formatting them\n",
+		       dropped, atomic_read(&cfs_trace_decode_dropped));
+	}
+}
+
+static void cfs_trace_print_raw(struct ptldebug_header *hdr)
+{
+	struct cfs_trace_raw_rec  rec;
+	char			 *buf;
+	int			  len;
+
+	memcpy(&rec, hdr + 1, sizeof(rec));
+
+	buf = cfs_trace_get_console_buffer();
+	len = bstr_printf(buf, CFS_TRACE_CONSOLE_BUFFER_SIZE, rec.trr_fmt,
+			  (u32 *)PTR_ALIGN((char *)(hdr + 1) + sizeof(rec),
+					   sizeof(u32)));
+	len = min_t(int, len, CFS_TRACE_CONSOLE_BUFFER_SIZE - 1);
+	cfs_print_to_console(hdr, D_EMERG, buf, len, rec.trr_file,
+			     rec.trr_fn);
+	cfs_trace_put_console_buffer(buf);
+}
+
+/*
+ * Raw records reference the strings of the module which logged them,
+ * format all of them before a module goes away.
+ */
+static int cfs_trace_module_notify(struct notifier_block *nb,
+				   unsigned long action, void *data)
+{
+	struct page_collection	   pc;
+	struct cfs_trace_cpu_data *tcd;
+	int			   i;
+	int			   cpu;
+
+	if (action != MODULE_STATE_GOING)
+		return NOTIFY_DONE;
+
+	cfs_tracefile_write_lock();
+
+	pc.pc_want_daemon_pages = 0;
+	collect_pages(&pc);
+	cfs_trace_decode_pages(&pc);
+	put_pages_back(&pc);
+
+	/* cfs_tcd_shrink() moves pages to the daemon list unformatted */
+	INIT_LIST_HEAD(&pc.pc_pages);
+	for_each_possible_cpu(cpu) {
+		cfs_tcd_for_each_type_lock(tcd, i, cpu) {
+			list_splice_init(&tcd->tcd_daemon_pages,
+					 &pc.pc_pages);
+			tcd->tcd_cur_daemon_pages = 0;
+		}
+	}
+	cfs_trace_decode_pages(&pc);
+	put_pages_on_daemon_list(&pc);
+
+	cfs_tracefile_write_unlock();
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cfs_trace_module_nb = {
+	.notifier_call	= cfs_trace_module_notify,
+};
+#else
+static inline void cfs_trace_decode_pages(struct page_collection *pc)
+{
+}
+#endif
+
 void cfs_trace_debug_print(void)
 {
 	struct page_collection pc;
@@ -640,6 +964,13 @@ void cfs_trace_debug_print(void)
                         struct ptldebug_header *hdr;
                         int len;
                         hdr = (void *)p;
+#ifdef CONFIG_BINARY_PRINTF
+			if (hdr->ph_flags & PH_FLAG_RAW) {
+				cfs_trace_print_raw(hdr);
+				p += hdr->ph_len;
+				continue;
+			}
+#endif
                         p += sizeof(*hdr);
                         file = p;
                         p += strlen(file) + 1;
@@ -680,6 +1011,7 @@ int cfs_tracefile_dump_all_pages(char *filename)
 
         pc.pc_want_daemon_pages = 1;
         collect_pages(&pc);
+	cfs_trace_decode_pages(&pc);
 	if (list_empty(&pc.pc_pages)) {
                 rc = 0;
                 goto close;
@@ -967,6 +1299,7 @@ static int tracefiled(void *arg)
 
                 pc.pc_want_daemon_pages = 0;
                 collect_pages(&pc);
+		cfs_trace_decode_pages(&pc);
 		if (list_empty(&pc.pc_pages))
                         goto end_loop;
 
@@ -1125,6 +1458,20 @@ int cfs_tracefile_init(int max_pages)
 		LASSERT(tcd->tcd_max_pages > 0);
 		tcd->tcd_shutting_down = 0;
 	}
+#ifdef CONFIG_BINARY_PRINTF
+	cfs_trace_decode_buf = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
+	if (cfs_trace_decode_buf == NULL) {
+		cfs_tracefile_fini_arch();
+		return -ENOMEM;
+	}
+
+	rc = register_module_notifier(&cfs_trace_module_nb);
+	if (rc != 0) {
+		kfree(cfs_trace_decode_buf);
+		cfs_tracefile_fini_arch();
+		return rc;
+	}
+#endif
 	return 0;
 }
 
@@ -1163,6 +1510,13 @@ static void cfs_trace_cleanup(void)
 
 void cfs_tracefile_exit(void)
 {
+#ifdef CONFIG_BINARY_PRINTF
+	unregister_module_notifier(&cfs_trace_module_nb);
+#endif
         cfs_trace_stop_thread();
         cfs_trace_cleanup();
+#ifdef CONFIG_BINARY_PRINTF
+	kfree(cfs_trace_decode_buf);
+	cfs_trace_decode_buf = NULL;
+#endif
 }
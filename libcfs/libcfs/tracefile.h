@@ -257,6 +257,28 @@ struct cfs_trace_page {
 	 * type(context) of this page
 	 */
 	unsigned short		type;
+	/*
+	 * page holds raw records which are not formatted yet
+	 */
+	unsigned short		raw;
+};
+
+/*
+ * Raw record flag, records carrying it are formatted into text before the
+ * page leaves the kernel, so it never shows up in a dumped log.
+ */
+#define PH_FLAG_RAW		0x80000000
+
+/*
+ * Body of a raw record, it follows struct ptldebug_header and is followed
+ * by the arguments of tbr_fmt as packed by vbin_printf(), aligned to u32.
+ * All strings are referenced rather than copied, so pending raw records
+ * are formatted before any module is unloaded.
+ */
+struct cfs_trace_raw_rec {
+	const char		*trr_file;
+	const char		*trr_fn;
+	const char		*trr_fmt;
 };
 
 extern void cfs_set_ptldebug_header(struct ptldebug_header *header,
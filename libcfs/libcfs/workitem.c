@@ -45,6 +45,16 @@
 
 #define CFS_WS_NAME_LEN         16
 
+#ifdef __KERNEL__
+/** # workitems stolen at a time */
+#define CFS_WI_STEAL_BATCH	16
+
+static int wi_steal = 1;
+CFS_MODULE_PARM(wi_steal, "i", int, 0644,
+		"idle threads run workitems of busy schedulers "
+		"(0: never, 1: of the same CPT or of no CPT, 2: of any CPT)");
+#endif
+
 typedef struct cfs_wi_sched {
 	struct list_head		ws_list;	/* chain on global list */
 #ifdef __KERNEL__
@@ -73,6 +83,19 @@ typedef struct cfs_wi_sched {
 	unsigned int		ws_stopping:1;
 	/** serialize starting thread, protected by cfs_wi_data::wi_glock */
 	unsigned int		ws_starting:1;
+#ifdef __KERNEL__
+	/** # idle threads, protected by ws_lock */
+	int			ws_nidle;
+	/** asked to steal workitems of a busy scheduler, under ws_lock */
+	int			ws_steal;
+	/** threads of other schedulers running my workitems, protected by
+	 * cfs_wi_data::wi_glock */
+	int			ws_nthieves;
+	/** # workitems my threads stole from others, protected by ws_lock */
+	unsigned long		ws_nsteals;
+	/** # my workitems stolen by others, protected by ws_lock */
+	unsigned long		ws_nstolen;
+#endif
 	/** scheduler name */
 	char			ws_name[CFS_WS_NAME_LEN];
 } cfs_wi_sched_t;
@@ -86,6 +109,10 @@ static struct cfs_workitem_data {
 	int			wi_init;
 	/** shutting down the whole WI module */
 	int			wi_stopping;
+#ifdef __KERNEL__
+	/** # idle scheduler threads */
+	atomic_t		wi_nidle;
+#endif
 } cfs_wi_data;
 
 #ifdef __KERNEL__
@@ -110,7 +137,7 @@ cfs_wi_sched_cansleep(cfs_wi_sched_t *sched)
 		return 0;
 	}
 
-	if (!list_empty(&sched->ws_runq)) {
+	if (!list_empty(&sched->ws_runq) || sched->ws_steal) {
 		cfs_wi_sched_unlock(sched);
 		return 0;
 	}
@@ -118,6 +145,58 @@ cfs_wi_sched_cansleep(cfs_wi_sched_t *sched)
 	return 1;
 }
 
+/**
+ * Can threads of \a thief run workitems of \a victim?
+ * Called with cfs_wi_data::wi_glock held.
+ *
+ * By default (wi_steal == 1) workitems only move where they keep their
+ * memory locality: between schedulers of different users bound to the
+ * same CPT, or off a scheduler not bound to any CPT. Per-CPT schedulers
+ * of one user, e.g. the "lst_t" ones of LNet selftest, are only balanced
+ * against each other with wi_steal == 2.
+ */
+static int
+cfs_wi_sched_can_steal(struct cfs_wi_sched *thief, struct cfs_wi_sched *victim)
+{
+	if (thief == victim || thief->ws_stopping || victim->ws_stopping ||
+	    cfs_wi_data.wi_stopping)
+		return 0;
+
+	/* workitems of a single thread scheduler are serialised */
+	if (thief->ws_nthreads < 2 || victim->ws_nthreads < 2)
+		return 0;
+
+	if (thief->ws_cptab != victim->ws_cptab)
+		return 0;
+
+	return thief->ws_cpt == victim->ws_cpt ||
+	       victim->ws_cpt == CFS_CPT_ANY || wi_steal > 1;
+}
+
+/**
+ * \a sched has no idle thread to run a new workitem, wake up an idle
+ * thread of another scheduler to steal it.
+ */
+static void
+cfs_wi_sched_wake_thief(struct cfs_wi_sched *sched)
+{
+	struct cfs_wi_sched	*tmp;
+
+	spin_lock(&cfs_wi_data.wi_glock);
+	list_for_each_entry(tmp, &cfs_wi_data.wi_scheds, ws_list) {
+		/* ws_nidle is only a hint here */
+		if (tmp->ws_nidle == 0 || !cfs_wi_sched_can_steal(tmp, sched))
+			continue;
+
+		cfs_wi_sched_lock(tmp);
+		tmp->ws_steal = 1;
+		cfs_wi_sched_unlock(tmp);
+		wake_up(&tmp->ws_waitq);
+		break;
+	}
+	spin_unlock(&cfs_wi_data.wi_glock);
+}
+
 #else /* !__KERNEL__ */
 
 static inline void
@@ -213,6 +292,10 @@ EXPORT_SYMBOL(cfs_wi_deschedule);
 void
 cfs_wi_schedule(struct cfs_wi_sched *sched, cfs_workitem_t *wi)
 {
+#ifdef __KERNEL__
+	int	steal = 0;
+#endif
+
 	LASSERT(!in_interrupt()); /* because we use plain spinlock */
 	LASSERT(!sched->ws_stopping);
 
@@ -227,6 +310,7 @@ cfs_wi_schedule(struct cfs_wi_sched *sched, cfs_workitem_t *wi)
 			list_add_tail(&wi->wi_list, &sched->ws_runq);
 #ifdef __KERNEL__
 			wake_up(&sched->ws_waitq);
+			steal = sched->ws_nidle == 0;
 #endif
 		} else {
 			list_add(&wi->wi_list, &sched->ws_rerunq);
@@ -235,12 +319,107 @@ cfs_wi_schedule(struct cfs_wi_sched *sched, cfs_workitem_t *wi)
 
 	LASSERT (!list_empty(&wi->wi_list));
 	cfs_wi_sched_unlock(sched);
+
+#ifdef __KERNEL__
+	if (steal && wi_steal != 0 && atomic_read(&cfs_wi_data.wi_nidle) > 0)
+		cfs_wi_sched_wake_thief(sched);
+#endif
 	return;
 }
 EXPORT_SYMBOL(cfs_wi_schedule);
 
 #ifdef __KERNEL__
 
+/**
+ * Run at most \a max workitems of \a sched, it can be called by threads of
+ * another scheduler as well. Called and returns with \a sched locked.
+ */
+static int
+cfs_wi_sched_run_locked(struct cfs_wi_sched *sched, int max)
+{
+	int		nloops = 0;
+	int		rc;
+	cfs_workitem_t *wi;
+
+	while (!list_empty(&sched->ws_runq) && nloops < max) {
+		wi = list_entry(sched->ws_runq.next, cfs_workitem_t, wi_list);
+		LASSERT(wi->wi_scheduled && !wi->wi_running);
+
+		list_del_init(&wi->wi_list);
+
+		LASSERT(sched->ws_nscheduled > 0);
+		sched->ws_nscheduled--;
+
+		wi->wi_running   = 1;
+		wi->wi_scheduled = 0;
+
+		cfs_wi_sched_unlock(sched);
+		nloops++;
+
+		rc = (*wi->wi_action) (wi);
+
+		cfs_wi_sched_lock(sched);
+		if (rc != 0) /* WI should be dead, even be freed! */
+			continue;
+
+		wi->wi_running = 0;
+		if (list_empty(&wi->wi_list))
+			continue;
+
+		LASSERT(wi->wi_scheduled);
+		/* wi is rescheduled, should be on rerunq now, we
+		 * move it to runq so it can run action now */
+		list_move_tail(&wi->wi_list, &sched->ws_runq);
+	}
+
+	return nloops;
+}
+
+/**
+ * Run some workitems of the busiest scheduler \a sched can steal from,
+ * returns the number of workitems run.
+ */
+static int
+cfs_wi_sched_steal(struct cfs_wi_sched *sched)
+{
+	struct cfs_wi_sched	*victim = NULL;
+	struct cfs_wi_sched	*tmp;
+	int			 n;
+
+	spin_lock(&cfs_wi_data.wi_glock);
+	list_for_each_entry(tmp, &cfs_wi_data.wi_scheds, ws_list) {
+		/* unlocked check of the queue depth, it's only a hint */
+		if (tmp->ws_nidle > 0 || list_empty(&tmp->ws_runq) ||
+		    !cfs_wi_sched_can_steal(sched, tmp))
+			continue;
+
+		if (victim == NULL || tmp->ws_nscheduled > victim->ws_nscheduled)
+			victim = tmp;
+	}
+
+	if (victim != NULL)
+		victim->ws_nthieves++;
+	spin_unlock(&cfs_wi_data.wi_glock);
+
+	if (victim == NULL)
+		return 0;
+
+	cfs_wi_sched_lock(victim);
+	n = cfs_wi_sched_run_locked(victim, CFS_WI_STEAL_BATCH);
+	victim->ws_nstolen += n;
+	cfs_wi_sched_unlock(victim);
+
+	spin_lock(&cfs_wi_data.wi_glock);
+	victim->ws_nthieves--;
+	spin_unlock(&cfs_wi_data.wi_glock);
+
+	cfs_wi_sched_lock(sched);
+	sched->ws_nsteals += n;
+	cfs_wi_sched_unlock(sched);
+
+	return n;
+}
+
 static int
 cfs_wi_scheduler (void *arg)
 {
@@ -265,43 +444,9 @@ cfs_wi_scheduler (void *arg)
 	cfs_wi_sched_lock(sched);
 
 	while (!sched->ws_stopping) {
-		int		nloops = 0;
 		int		rc;
-		cfs_workitem_t *wi;
-
-		while (!list_empty(&sched->ws_runq) &&
-		       nloops < CFS_WI_RESCHED) {
-			wi = list_entry(sched->ws_runq.next,
-					    cfs_workitem_t, wi_list);
-			LASSERT(wi->wi_scheduled && !wi->wi_running);
-
-			list_del_init(&wi->wi_list);
-
-			LASSERT(sched->ws_nscheduled > 0);
-			sched->ws_nscheduled--;
-
-                        wi->wi_running   = 1;
-                        wi->wi_scheduled = 0;
 
-
-                        cfs_wi_sched_unlock(sched);
-                        nloops++;
-
-                        rc = (*wi->wi_action) (wi);
-
-                        cfs_wi_sched_lock(sched);
-                        if (rc != 0) /* WI should be dead, even be freed! */
-                                continue;
-
-			wi->wi_running = 0;
-			if (list_empty(&wi->wi_list))
-                                continue;
-
-			LASSERT(wi->wi_scheduled);
-			/* wi is rescheduled, should be on rerunq now, we
-			 * move it to runq so it can run action now */
-			list_move_tail(&wi->wi_list, &sched->ws_runq);
-                }
+		cfs_wi_sched_run_locked(sched, CFS_WI_RESCHED);
 
 		if (!list_empty(&sched->ws_runq)) {
 			cfs_wi_sched_unlock(sched);
@@ -312,10 +457,21 @@ cfs_wi_scheduler (void *arg)
 			continue;
 		}
 
+		sched->ws_steal = 0;
+		sched->ws_nidle++;
 		cfs_wi_sched_unlock(sched);
-		rc = wait_event_interruptible_exclusive(sched->ws_waitq,
-				!cfs_wi_sched_cansleep(sched));
+		atomic_inc(&cfs_wi_data.wi_nidle);
+
+		if (wi_steal == 0 || cfs_wi_sched_steal(sched) == 0) {
+			rc = wait_event_interruptible_exclusive(sched->ws_waitq,
+					!cfs_wi_sched_cansleep(sched));
+		} else {
+			cond_resched();
+		}
+
+		atomic_dec(&cfs_wi_data.wi_nidle);
 		cfs_wi_sched_lock(sched);
+		sched->ws_nidle--;
         }
 
         cfs_wi_sched_unlock(sched);
@@ -401,7 +557,7 @@ cfs_wi_sched_destroy(struct cfs_wi_sched *sched)
 	{
 		int i = 2;
 
-		while (sched->ws_nthreads > 0) {
+		while (sched->ws_nthreads > 0 || sched->ws_nthieves > 0) {
 			CDEBUG(IS_PO2(++i) ? D_WARNING : D_NET,
 			       "waiting for %d threads of WI sched[%s] to "
 			       "terminate\n", sched->ws_nthreads,
@@ -508,6 +664,44 @@ cfs_wi_sched_create(char *name, struct cfs_cpt_table *cptab,
 }
 EXPORT_SYMBOL(cfs_wi_sched_create);
 
+#ifdef __KERNEL__
+/**
+ * Print queue depth and steal counters of all schedulers to \a buf,
+ * returns -EFBIG if \a buf is too small.
+ */
+int
+cfs_wi_sched_print(char *buf, int len)
+{
+	struct cfs_wi_sched	*sched;
+	char			*tmp = buf;
+	int			 rc;
+
+	rc = snprintf(tmp, len, "%-16s %4s %8s %8s %12s %12s\n",
+		      "name", "cpt", "threads", "queued", "steals", "stolen");
+	if (rc >= len)
+		return -EFBIG;
+	tmp += rc;
+	len -= rc;
+
+	spin_lock(&cfs_wi_data.wi_glock);
+	list_for_each_entry(sched, &cfs_wi_data.wi_scheds, ws_list) {
+		rc = snprintf(tmp, len, "%-16s %4d %8d %8d %12lu %12lu\n",
+			      sched->ws_name, sched->ws_cpt,
+			      sched->ws_nthreads, sched->ws_nscheduled,
+			      sched->ws_nsteals, sched->ws_nstolen);
+		if (rc >= len) {
+			rc = -EFBIG;
+			break;
+		}
+		tmp += rc;
+		len -= rc;
+	}
+	spin_unlock(&cfs_wi_data.wi_glock);
+
+	return rc < 0 ? rc : tmp - buf;
+}
+#endif
+
 int
 cfs_wi_startup(void)
 {
@@ -515,6 +709,9 @@ cfs_wi_startup(void)
 
 	spin_lock_init(&cfs_wi_data.wi_glock);
 	INIT_LIST_HEAD(&cfs_wi_data.wi_scheds);
+#ifdef __KERNEL__
+	atomic_set(&cfs_wi_data.wi_nidle, 0);
+#endif
 	cfs_wi_data.wi_init = 1;
 
 	return 0;
@@ -539,7 +736,7 @@ cfs_wi_shutdown (void)
 	list_for_each_entry(sched, &cfs_wi_data.wi_scheds, ws_list) {
 		spin_lock(&cfs_wi_data.wi_glock);
 
-		while (sched->ws_nthreads != 0) {
+		while (sched->ws_nthreads != 0 || sched->ws_nthieves != 0) {
 			spin_unlock(&cfs_wi_data.wi_glock);
 			cfs_pause(cfs_time_seconds(1) / 20);
 			spin_lock(&cfs_wi_data.wi_glock);
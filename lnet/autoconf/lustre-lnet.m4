@@ -569,6 +569,55 @@ sk_data_ready, [
 EXTRA_KCFLAGS="$tmp_flags"
 ]) # LN_CONFIG_SK_DATA_READY
 
+#
+# LN_CONFIG_SOCK_ZEROCOPY
+#
+# 4.14 sockets can transmit with MSG_ZEROCOPY and report completion
+# through the socket error queue. socklnd sends the pages through a
+# bio_vec iterator, so check for everything that path uses; without it
+# the zc_sendmsg tunable is refused.
+#
+AC_DEFUN([LN_CONFIG_SOCK_ZEROCOPY], [
+LB_CHECK_COMPILE([if sockets support MSG_ZEROCOPY],
+sock_zerocopy, [
+	#include <linux/bvec.h>
+	#include <linux/errqueue.h>
+	#include <linux/uio.h>
+	#include <net/sock.h>
+],[
+	struct sock_exterr_skb *serr = NULL;
+	struct msghdr msg = { .msg_flags = MSG_DONTWAIT | MSG_ZEROCOPY };
+	struct bio_vec bvec;
+
+	sock_set_flag((struct sock *)NULL, SOCK_ZEROCOPY);
+	sock_dequeue_err_skb((struct sock *)NULL);
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_code = SO_EE_CODE_ZEROCOPY_COPIED;
+	iov_iter_bvec(&msg.msg_iter, WRITE, &bvec, 1, 0);
+	sock_sendmsg((struct socket *)NULL, &msg);
+],[
+	AC_DEFINE(HAVE_SOCK_ZEROCOPY, 1,
+		[sockets support MSG_ZEROCOPY])
+])
+]) # LN_CONFIG_SOCK_ZEROCOPY
+
+#
+# LN_CONFIG_IOV_ITER_TYPE
+#
+# 4.20 iov_iter_bvec() no longer takes ITER_BVEC in its direction
+#
+AC_DEFUN([LN_CONFIG_IOV_ITER_TYPE], [
+LB_CHECK_COMPILE([if 'iov_iter_type' exists],
+iov_iter_type, [
+	#include <linux/uio.h>
+],[
+	iov_iter_type((struct iov_iter *)NULL);
+],[
+	AC_DEFINE(HAVE_IOV_ITER_TYPE, 1,
+		[iov_iter_type exists])
+])
+]) # LN_CONFIG_IOV_ITER_TYPE
+
 #
 # LN_PROG_LINUX
 #
@@ -590,6 +639,10 @@ LN_CONFIG_MX
 LN_CONFIG_TCP_SENDPAGE
 # 3.15
 LN_CONFIG_SK_DATA_READY
+# 4.14
+LN_CONFIG_SOCK_ZEROCOPY
+# 4.20
+LN_CONFIG_IOV_ITER_TYPE
 ]) # LN_PROG_LINUX
 
 #
@@ -372,8 +372,8 @@ lnet_handle2me(lnet_handle_me_t *handle)
 static inline void
 lnet_peer_addref_locked(lnet_peer_t *lp)
 {
-        LASSERT (lp->lp_refcount > 0);
-        lp->lp_refcount++;
+	LASSERT(atomic_read(&lp->lp_refcount) > 0);
+	atomic_inc(&lp->lp_refcount);
 }
 
 extern void lnet_destroy_peer_locked(lnet_peer_t *lp);
@@ -381,10 +381,23 @@ extern void lnet_destroy_peer_locked(lnet_peer_t *lp);
 static inline void
 lnet_peer_decref_locked(lnet_peer_t *lp)
 {
-        LASSERT (lp->lp_refcount > 0);
-        lp->lp_refcount--;
-        if (lp->lp_refcount == 0)
-                lnet_destroy_peer_locked(lp);
+	LASSERT(atomic_read(&lp->lp_refcount) > 0);
+	if (atomic_dec_and_test(&lp->lp_refcount))
+		lnet_destroy_peer_locked(lp);
+}
+
+/* drop a ref taken without lnet_net_lock, e.g. by lnet_find_peer_rcu() */
+static inline void
+lnet_peer_decref(lnet_peer_t *lp)
+{
+	int cpt = lp->lp_cpt;
+
+	LASSERT(atomic_read(&lp->lp_refcount) > 0);
+	if (atomic_dec_and_test(&lp->lp_refcount)) {
+		lnet_net_lock(cpt);
+		lnet_destroy_peer_locked(lp);
+		lnet_net_unlock(cpt);
+	}
 }
 
 static inline int
@@ -716,11 +729,18 @@ int lnet_parse_ip2nets(char **networksp, char *ip2nets);
 int lnet_parse_routes(char *route_str, int *im_a_router);
 int lnet_parse_networks(struct list_head *nilist, char *networks);
 int lnet_net_unique(__u32 net, struct list_head *nilist);
+int lnet_parse_mr_peers(char *mr_peers);
 
 int lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt);
 lnet_peer_t *lnet_find_peer_locked(struct lnet_peer_table *ptable,
 				   lnet_nid_t nid);
+lnet_peer_t *lnet_find_peer_rcu(lnet_nid_t nid, int cpt);
 void lnet_peer_tables_cleanup(lnet_ni_t *ni);
+int lnet_add_mr_peer(lnet_nid_t *nids, int nnids);
+void lnet_del_mr_peers(lnet_ni_t *ni);
+lnet_mr_peer_t *lnet_mr_peer_find_locked(lnet_nid_t nid);
+lnet_nid_t lnet_mr_primary_nid(lnet_nid_t nid);
+lnet_nid_t lnet_mr_select_nid_locked(lnet_nid_t nid, lnet_ni_t *src_ni);
 void lnet_peer_tables_destroy(void);
 int lnet_peer_tables_create(void);
 void lnet_debug_peer(lnet_nid_t nid);
@@ -438,8 +438,12 @@ typedef struct {
 } lnet_rc_data_t;
 
 typedef struct lnet_peer {
-	/* chain on peer hash */
+	/* chain on peer hash (RCU) */
 	struct list_head	lp_hashlist;
+#ifdef __KERNEL__
+	/* freeing after lockless lookups are done with it */
+	struct rcu_head		lp_rcu;
+#endif
 	/* messages blocking for tx credits */
 	struct list_head	lp_txq;
 	/* messages blocking for router credits */
@@ -462,6 +466,8 @@ typedef struct lnet_peer {
 	unsigned int		lp_notifylnd:1;
 	/* some thread is handling notification */
 	unsigned int		lp_notifying:1;
+	/* off the peer hash, lnet_find_peer_rcu() mustn't return it */
+	unsigned int		lp_unhashed:1;
 	/* SEND event outstanding from ping */
 	unsigned int		lp_ping_notsent;
 	/* # times router went dead<->alive */
@@ -481,7 +487,7 @@ typedef struct lnet_peer {
 	/* interface peer is on */
 	lnet_ni_t		*lp_ni;
 	lnet_nid_t		lp_nid;		/* peer's NID */
-	int			lp_refcount;	/* # refs */
+	atomic_t		lp_refcount;	/* # refs */
 	int			lp_cpt;		/* CPT this peer attached on */
 	/* # refs from lnet_route_t::lr_gateway */
 	int			lp_rtr_refcount;
@@ -491,6 +497,36 @@ typedef struct lnet_peer {
 	lnet_rc_data_t		*lp_rcd;	/* router checker state */
 } lnet_peer_t;
 
+/* max # NIDs (one per local network) of a multi-rail peer */
+#define LNET_MR_NIDS_MAX	4
+
+struct lnet_mr_peer;
+
+/* one NID of a multi-rail peer on the_lnet.ln_mr_hash */
+typedef struct lnet_mr_nid {
+	/* chain on the_lnet.ln_mr_hash */
+	struct list_head	mrn_hashlist;
+	/* peer this NID is a rail of */
+	struct lnet_mr_peer	*mrn_mrp;
+	lnet_nid_t		mrn_nid;
+} lnet_mr_nid_t;
+
+/* peer reachable over several local networks */
+typedef struct lnet_mr_peer {
+	/* chain on the_lnet.ln_mr_peers */
+	struct list_head	mrp_list;
+	/* NID lookup, walked under RCU by lnet_parse() */
+	lnet_mr_nid_t		mrp_hash[LNET_MR_NIDS_MAX];
+	/* # NIDs in mrp_nids */
+	int			mrp_nnids;
+	/* round-robin cursor for rails of equal weight */
+	atomic_t		mrp_seq;
+	/* mrp_nids[0] is the primary NID seen by upper layers */
+	lnet_nid_t		mrp_nids[LNET_MR_NIDS_MAX];
+	/* peer of each NID (ref held), NULL once its NI has gone */
+	lnet_peer_t		*mrp_peers[LNET_MR_NIDS_MAX];
+} lnet_mr_peer_t;
+
 /* peer hash size */
 #define LNET_PEER_HASH_BITS     9
 #define LNET_PEER_HASH_SIZE     (1 << LNET_PEER_HASH_BITS)
@@ -499,9 +535,8 @@ typedef struct lnet_peer {
 struct lnet_peer_table {
 	int			pt_version;	/* /proc validity stamp */
 	int			pt_number;	/* # peers extant */
-	int			pt_zombies;	/* # zombies to go to deathrow
-						 * (and not there yet) */
-	struct list_head	pt_deathrow;	/* zombie peers */
+	int			pt_zombies;	/* # zombies not destroyed
+						 * yet */
 	struct list_head	*pt_hash;	/* NID->peer hash */
 };
 
@@ -552,6 +587,12 @@ typedef struct {
 	int			rbp_credits;
 	/* low water mark */
 	int			rbp_mincredits;
+	/* configured # buffers, a dynamic pool never shrinks below it */
+	int			rbp_req_nbuffers;
+	/* low water mark since the last resize check */
+	int			rbp_lowcredits;
+	/* # consecutive resize checks the pool stayed idle */
+	int			rbp_nidle;
 } lnet_rtrbufpool_t;
 
 typedef struct {
@@ -686,6 +727,9 @@ struct lnet_msg_container {
 	int			msc_nfinalizers;
 	/* msgs waiting to complete finalizing */
 	struct list_head	msc_finalizing;
+	/* protects msc_active and msgs_alloc of this CPT's counters, so
+	 * lnet_parse() can commit without lnet_net_lock */
+	spinlock_t		msc_lock;
 	struct list_head	msc_active;	/* active message list */
 	/* threads doing finalization */
 	void			**msc_finalizers;
@@ -748,6 +792,10 @@ typedef struct
 	struct list_head		ln_routers;
 	/* validity stamp */
 	__u64				ln_routers_version;
+	/* peers with NIDs on several local networks */
+	struct list_head		ln_mr_peers;
+	/* NID->multi-rail peer hash, LNET_PEER_HASH_SIZE chains */
+	struct list_head		*ln_mr_hash;
 	/* percpt router buffer pools */
 	lnet_rtrbufpool_t		**ln_rtrpools;
 
@@ -46,9 +46,14 @@
 
 #define LST_FEAT_NONE		(0)
 #define LST_FEAT_BULK_LEN	(1 << 0)	/* enable variable page size */
+#define LST_FEAT_LATENCY	(1 << 1)	/* RPC latency histogram */
 
 #define LST_FEATS_EMPTY		(LST_FEAT_NONE)
-#define LST_FEATS_MASK		(LST_FEAT_NONE | LST_FEAT_BULK_LEN)
+#define LST_FEATS_MASK		(LST_FEAT_NONE | LST_FEAT_BULK_LEN | \
+				 LST_FEAT_LATENCY)
+/* features of a new session, nodes without LST_FEAT_LATENCY reject any
+ * session asking for it, so it has to be requested explicitly */
+#define LST_FEATS_DEFAULT	(LST_FEAT_NONE | LST_FEAT_BULK_LEN)
 
 #define LST_NAME_SIZE           32              /* max name buffer length */
 
@@ -71,6 +76,7 @@
 #define LSTIO_TEST_ADD          0xC26           /* add test (to batch) */
 #define LSTIO_BATCH_QUERY       0xC27           /* query batch status */
 #define LSTIO_STAT_QUERY        0xC30           /* get stats */
+#define LSTIO_LAT_QUERY         0xC31           /* get RPC latency */
 
 typedef struct {
         lnet_nid_t              ses_nid;                /* nid of console node */
@@ -517,4 +523,15 @@ typedef struct {
         __u32 ping_errors;
 } WIRE_ATTR sfw_counters_t;
 
+/* # buckets of the test RPC latency histogram */
+#define SFW_LAT_BUCKETS		28
+
+/* log2 histogram of test RPC round-trip time since the session started,
+ * bucket i counts RPCs done in [2^i, 2^(i+1)) usecs, the last bucket
+ * also counts anything slower */
+typedef struct {
+	__u32 lat_max_usec;			/* slowest RPC */
+	__u32 lat_buckets[SFW_LAT_BUCKETS];
+} WIRE_ATTR sfw_latency_t;
+
 #endif
@@ -82,7 +82,9 @@ ksocknal_create_route (__u32 ipaddr, int port)
         route->ksnr_connecting = 0;
         route->ksnr_connected = 0;
         route->ksnr_deleted = 0;
+        route->ksnr_no_stripe = 0;
         route->ksnr_conn_count = 0;
+        memset(route->ksnr_nconns, 0, sizeof(route->ksnr_nconns));
         route->ksnr_share_count = 0;
 
         return (route);
@@ -358,6 +360,7 @@ ksocknal_associate_route_conn_locked(ksock_route_t *route, ksock_conn_t *conn)
         }
 
         route->ksnr_connected |= (1<<type);
+        route->ksnr_nconns[type]++;
         route->ksnr_conn_count++;
 
         /* Successful connection => further attempts can
@@ -687,6 +690,37 @@ ksocknal_choose_scheduler_locked(unsigned int cpt)
 	return sched;
 }
 
+/* Parallel connections of the same type to a peer are spread over the
+ * CPTs, so that striped bulk is driven by schedulers on different CPUs */
+static unsigned int
+ksocknal_stripe_cpt_locked(ksock_peer_t *peer, ksock_conn_t *conn,
+			   unsigned int cpt)
+{
+	struct list_head *tmp;
+	ksock_conn_t	 *conn2;
+	int		 ncpts = cfs_cpt_number(lnet_cpt_table());
+	int		 nconns = 0;
+	int		 i;
+
+	list_for_each(tmp, &peer->ksnp_conns) {
+		conn2 = list_entry(tmp, ksock_conn_t, ksnc_list);
+		if (conn2->ksnc_type == conn->ksnc_type)
+			nconns++;
+	}
+
+	if (nconns == 0)
+		return cpt;
+
+	for (i = 0; i < ncpts; i++) {
+		unsigned int cpt2 = (cpt + nconns + i) % ncpts;
+
+		if (ksocknal_data.ksnd_sched_info[cpt2]->ksi_nthreads > 0)
+			return cpt2;
+	}
+
+	return cpt;
+}
+
 static int
 ksocknal_local_ipvec (lnet_ni_t *ni, __u32 *ipaddrs)
 {
@@ -1035,6 +1069,7 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
         ksock_tx_t        *txtmp;
         int                rc;
         int                active;
+	int		   zc_sendmsg;
         char              *warn = NULL;
 
         active = (route != NULL);
@@ -1063,6 +1098,7 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
 	conn->ksnc_rx_scheduled = 0;
 
 	INIT_LIST_HEAD(&conn->ksnc_tx_queue);
+	INIT_LIST_HEAD(&conn->ksnc_zc_txs);
 	conn->ksnc_tx_ready = 0;
 	conn->ksnc_tx_scheduled = 0;
 	conn->ksnc_tx_carrier = NULL;
@@ -1204,6 +1240,12 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
         case 0:
                 break;
         case EALREADY:
+                /* An older peer refuses anything but a single connection
+                 * of each type; stop striping this route rather than
+                 * retrying forever.  Losing a genuine race here only
+                 * costs the extra connections. */
+                if (active && route->ksnr_nconns[type] > 0)
+                        route->ksnr_no_stripe = 1;
                 warn = "lost conn race";
                 goto failed_2;
         case EPROTO:
@@ -1211,9 +1253,12 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
                 goto failed_2;
         }
 
-	/* Refuse to duplicate an existing connection, unless this is a
-	 * loopback connection */
+	/* Refuse to duplicate an existing connection beyond the number of
+	 * parallel connections allowed, unless this is a loopback
+	 * connection */
 	if (conn->ksnc_ipaddr != conn->ksnc_myipaddr) {
+		int ndup = 0;
+
 		list_for_each(tmp, &peer->ksnp_conns) {
 			conn2 = list_entry(tmp, ksock_conn_t, ksnc_list);
 
@@ -1222,6 +1267,11 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
                             conn2->ksnc_type != conn->ksnc_type)
                                 continue;
 
+			if (++ndup < ksocknal_route_type_conns(active ? route :
+							       NULL,
+							       conn->ksnc_type))
+				continue;
+
                         /* Reply on a passive connection attempt so the peer
                          * realises we're connected. */
                         LASSERT (rc == 0);
@@ -1263,7 +1313,8 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
         peer->ksnp_send_keepalive = 0;
         peer->ksnp_error = 0;
 
-	sched = ksocknal_choose_scheduler_locked(cpt);
+	sched = ksocknal_choose_scheduler_locked(
+			ksocknal_stripe_cpt_locked(peer, conn, cpt));
         sched->kss_nconns++;
         conn->ksnc_scheduler = sched;
 
@@ -1328,8 +1379,12 @@ ksocknal_create_conn (lnet_ni_t *ni, ksock_route_t *route,
         if (rc == 0)
                 rc = ksocknal_lib_setup_sock(sock);
 
+	zc_sendmsg = (rc == 0) ? ksocknal_lib_zc_sendmsg(conn) : 0;
+
 	write_lock_bh(global_lock);
 
+	conn->ksnc_zc_sendmsg = zc_sendmsg;
+
         /* NB my callbacks block while I hold ksnd_global_lock */
         ksocknal_lib_set_callback(sock, conn);
 
@@ -1413,8 +1468,6 @@ ksocknal_close_conn_locked (ksock_conn_t *conn, int error)
          * Caller holds ksnd_global_lock exclusively in irq context */
         ksock_peer_t      *peer = conn->ksnc_peer;
         ksock_route_t     *route;
-        ksock_conn_t      *conn2;
-	struct list_head  *tmp;
 
 	LASSERT(peer->ksnp_error == 0);
 	LASSERT(!conn->ksnc_closing);
@@ -1428,18 +1481,9 @@ ksocknal_close_conn_locked (ksock_conn_t *conn, int error)
 		/* dissociate conn from route... */
 		LASSERT(!route->ksnr_deleted);
 		LASSERT((route->ksnr_connected & (1 << conn->ksnc_type)) != 0);
+		LASSERT(route->ksnr_nconns[conn->ksnc_type] > 0);
 
-		conn2 = NULL;
-		list_for_each(tmp, &peer->ksnp_conns) {
-			conn2 = list_entry(tmp, ksock_conn_t, ksnc_list);
-
-			if (conn2->ksnc_route == route &&
-			    conn2->ksnc_type == conn->ksnc_type)
-				break;
-
-			conn2 = NULL;
-		}
-		if (conn2 == NULL)
+		if (--route->ksnr_nconns[conn->ksnc_type] == 0)
 			route->ksnr_connected &= ~(1 << conn->ksnc_type);
 
 		conn->ksnc_route = NULL;
@@ -1520,6 +1564,28 @@ ksocknal_peer_failed (ksock_peer_t *peer)
 			    last_alive);
 }
 
+void
+ksocknal_queue_zc_drain(ksock_conn_t *conn)
+{
+	/* The last socket ref of a conn doing MSG_ZEROCOPY has gone.  The
+	 * socket may still hold skbs pointing at the pages of TXs it hasn't
+	 * reported complete, so the reaper keeps it open and reaps its
+	 * completions until they have all arrived or the conn times out,
+	 * and only then releases it (see ksocknal_drain_zc_sendmsg()).
+	 * ksnc_list is free: the conn is off the peer and deathrow lists
+	 * and can't become a zombie while the reaper holds this ref. */
+	ksocknal_conn_addref(conn);
+	conn->ksnc_zc_deadline =
+		cfs_time_shift(*ksocknal_tunables.ksnd_timeout);
+
+	spin_lock_bh(&ksocknal_data.ksnd_reaper_lock);
+
+	list_add_tail(&conn->ksnc_list, &ksocknal_data.ksnd_zc_drain_conns);
+	wake_up(&ksocknal_data.ksnd_reaper_waitq);
+
+	spin_unlock_bh(&ksocknal_data.ksnd_reaper_lock);
+}
+
 void
 ksocknal_finalize_zcreq(ksock_conn_t *conn)
 {
@@ -1527,6 +1593,7 @@ ksocknal_finalize_zcreq(ksock_conn_t *conn)
 	ksock_tx_t	 *tx;
 	ksock_tx_t	 *tmp;
 	struct list_head  zlist = LIST_HEAD_INIT(zlist);
+	int		  nzc = 0;
 
 	/* NB safe to finalize TXs because closing of socket will
 	 * abort all buffered data */
@@ -1546,8 +1613,27 @@ ksocknal_finalize_zcreq(ksock_conn_t *conn)
 		list_add(&tx->tx_zc_list, &zlist);
 	}
 
+	/* MSG_ZEROCOPY sends the socket didn't report complete before the
+	 * conn timed out, see ksocknal_queue_zc_drain() */
+	list_for_each_entry_safe(tx, tmp, &conn->ksnc_zc_txs, tx_zc_list) {
+		LASSERT(tx->tx_zc_sendmsg);
+
+		tx->tx_zc_sendmsg = 0;
+		tx->tx_zc_aborted = 1;
+		list_del(&tx->tx_zc_list);
+		list_add(&tx->tx_zc_list, &zlist);
+		nzc++;
+	}
+
 	spin_unlock(&peer->ksnp_lock);
 
+	if (nzc != 0)
+		CNETERR("Aborting %d MSG_ZEROCOPY TXs to %s ip "
+			"%u.%u.%u.%u:%d, not completed in %d seconds\n", nzc,
+			libcfs_id2str(peer->ksnp_id),
+			HIPQUAD(conn->ksnc_ipaddr), conn->ksnc_port,
+			*ksocknal_tunables.ksnd_timeout);
+
 	while (!list_empty(&zlist)) {
 		tx = list_entry(zlist.next, ksock_tx_t, tx_zc_list);
 
@@ -2290,6 +2376,7 @@ ksocknal_base_shutdown(void)
 
 		LASSERT(list_empty(&ksocknal_data.ksnd_nets));
 		LASSERT(list_empty(&ksocknal_data.ksnd_enomem_conns));
+		LASSERT(list_empty(&ksocknal_data.ksnd_zc_drain_conns));
 		LASSERT(list_empty(&ksocknal_data.ksnd_zombie_conns));
 		LASSERT(list_empty(&ksocknal_data.ksnd_connd_connreqs));
 		LASSERT(list_empty(&ksocknal_data.ksnd_connd_routes));
@@ -2398,6 +2485,7 @@ ksocknal_base_startup(void)
 
 	spin_lock_init(&ksocknal_data.ksnd_reaper_lock);
 	INIT_LIST_HEAD(&ksocknal_data.ksnd_enomem_conns);
+	INIT_LIST_HEAD(&ksocknal_data.ksnd_zc_drain_conns);
 	INIT_LIST_HEAD(&ksocknal_data.ksnd_zombie_conns);
 	INIT_LIST_HEAD(&ksocknal_data.ksnd_deathrow_conns);
 	init_waitqueue_head(&ksocknal_data.ksnd_reaper_waitq);
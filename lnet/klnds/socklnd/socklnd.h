@@ -45,6 +45,9 @@
 #include <linux/syscalls.h>
 #include <linux/sysctl.h>
 #include <linux/uio.h>
+#ifdef HAVE_SOCK_ZEROCOPY
+#include <linux/bvec.h>
+#endif
 #include <linux/unistd.h>
 #include <net/sock.h>
 #include <net/tcp.h>
@@ -69,6 +72,7 @@
 #define SOCKNAL_PEER_HASH_SIZE  101             /* # peer lists */
 #define SOCKNAL_RESCHED         100             /* # scheduler loops before reschedule */
 #define SOCKNAL_INSANITY_RECONN 5000            /* connd is trying on reconn infinitely */
+#define SOCKNAL_CONNS_PER_PEER_MAX 16           /* max parallel conns of one type per route */
 #define SOCKNAL_ENOMEM_RETRY    CFS_TICK        /* jiffies between retries */
 
 #define SOCKNAL_SINGLE_FRAG_TX      0           /* disable multi-fragment sends */
@@ -104,6 +108,9 @@ typedef struct                                  /* per scheduler state */
 #if !SOCKNAL_SINGLE_FRAG_TX || !SOCKNAL_SINGLE_FRAG_RX
 	struct iovec		kss_scratch_iov[LNET_MAX_IOV];
 #endif
+#ifdef HAVE_SOCK_ZEROCOPY
+	struct bio_vec		kss_scratch_bvec[LNET_MAX_IOV];
+#endif
 } ksock_sched_t;
 
 struct ksock_sched_info {
@@ -133,12 +140,17 @@ typedef struct
 	int              *ksnd_timeout;
 	/* # scheduler threads in each pool while starting */
 	int		 *ksnd_nscheds;
+	/* usecs a scheduler spins for new work before sleeping */
+	int		 *ksnd_busy_poll;
+	/* max # complete messages received from one conn per scheduling */
+	int		 *ksnd_rx_budget;
         int              *ksnd_nconnds;         /* # connection daemons */
         int              *ksnd_nconnds_max;     /* max # connection daemons */
         int              *ksnd_min_reconnectms; /* first connection retry after (ms)... */
         int              *ksnd_max_reconnectms; /* ...exponentially increasing to this */
         int              *ksnd_eager_ack;       /* make TCP ack eagerly? */
         int              *ksnd_typed_conns;     /* drive sockets by type? */
+        int              *ksnd_conns_per_peer;  /* # parallel bulk conns per route */
         int              *ksnd_min_bulk;        /* smallest "large" message */
         int              *ksnd_tx_buffer_size;  /* socket tx buffer size */
         int              *ksnd_rx_buffer_size;  /* socket rx buffer size */
@@ -156,6 +168,7 @@ typedef struct
         int              *ksnd_inject_csum_error; /* set non-zero to inject checksum error */
         int              *ksnd_nonblk_zcack;    /* always send zc-ack on non-blocking connection */
         unsigned int     *ksnd_zc_min_payload;  /* minimum zero copy payload size */
+        int              *ksnd_zc_sendmsg;      /* ZC send by MSG_ZEROCOPY */
         int              *ksnd_zc_recv;         /* enable ZC receive (for Chelsio TOE) */
         int              *ksnd_zc_recv_min_nfrags; /* minimum # of fragments to enable ZC receive */
 #ifdef CPU_AFFINITY
@@ -213,6 +226,8 @@ typedef struct
 	struct list_head	ksnd_zombie_conns;
 	/* conns to retry: reaper_lock*/
 	struct list_head	ksnd_enomem_conns;
+	/* closed conns waiting for MSG_ZEROCOPY completion: reaper_lock */
+	struct list_head	ksnd_zc_drain_conns;
 	/* reaper sleeps here */
 	wait_queue_head_t       ksnd_reaper_waitq;
 	/* when reaper will wake */
@@ -271,7 +286,8 @@ struct ksock_proto;                             /* forward ref */
 typedef struct                                  /* transmit packet */
 {
 	struct list_head   tx_list;	/* queue on conn for transmission etc */
-	struct list_head   tx_zc_list;	/* queue on peer for ZC request */
+	struct list_head   tx_zc_list;	/* queue on peer for ZC request,
+					 * or on conn for ZC completion */
 	atomic_t       tx_refcount;    /* tx reference count */
 	int            tx_nob;         /* # packet bytes */
 	int            tx_resid;       /* residual bytes */
@@ -282,6 +298,13 @@ typedef struct                                  /* transmit packet */
         unsigned short tx_zc_capable:1; /* payload is large enough for ZC */
         unsigned short tx_zc_checked:1; /* Have I checked if I should ZC? */
         unsigned short tx_nonblk:1;    /* it's a non-blocking ACK */
+	/* MSG_ZEROCOPY state, all under ksnp_lock once the tx is checked */
+	__u8		tx_zc_sendmsg;	/* on ksnc_zc_txs */
+	__u8		tx_zc_queued;	/* some send took a completion # */
+	__u8		tx_zc_sent;	/* no more sends will be made */
+	__u32		tx_zc_first;	/* first completion # of tx */
+	__u32		tx_zc_last;	/* last completion # of tx */
+	__u32		tx_zc_ndone;	/* # of its sends completed */
         lnet_kiov_t   *tx_kiov;        /* packet page frags */
 	struct ksock_conn *tx_conn;        /* owning conn */
         lnet_msg_t    *tx_lnetmsg;     /* lnet message for lnet_finalize() */
@@ -325,6 +348,7 @@ typedef struct ksock_conn
 	cfs_socket_t       *ksnc_sock;		/* actual socket */
 	void                *ksnc_saved_data_ready; /* socket's original data_ready() callback */
 	void                *ksnc_saved_write_space; /* socket's original write_space() callback */
+	void                *ksnc_saved_error_report; /* socket's original error_report() callback */
 	atomic_t            ksnc_conn_refcount; /* conn refcount */
 	atomic_t            ksnc_sock_refcount; /* sock refcount */
 	ksock_sched_t       *ksnc_scheduler;  /* who schedules this connection */
@@ -336,6 +360,7 @@ typedef struct ksock_conn
 	unsigned int	    ksnc_closing:1;  /* being shut down */
 	unsigned int	    ksnc_flip:1;     /* flip or not, only for V2.x */
 	unsigned int	    ksnc_zc_capable:1; /* enable to ZC */
+	unsigned int	    ksnc_zc_sendmsg:1; /* ZC by MSG_ZEROCOPY */
         struct ksock_proto *ksnc_proto;      /* protocol for the connection */
 
 	/* READER */
@@ -382,6 +407,12 @@ typedef struct ksock_conn
 	int			ksnc_tx_scheduled;
 	/* time stamp of the last posted TX */
 	cfs_time_t		ksnc_tx_last_post;
+	/* MSG_ZEROCOPY TXs waiting for completion, in send order */
+	struct list_head	ksnc_zc_txs;
+	/* sequence # of the next MSG_ZEROCOPY send */
+	__u32			ksnc_zc_seq;
+	/* when a closed conn stops waiting for MSG_ZEROCOPY completion */
+	cfs_time_t		ksnc_zc_deadline;
 } ksock_conn_t;
 
 typedef struct ksock_route
@@ -399,8 +430,10 @@ typedef struct ksock_route
         unsigned int          ksnr_connecting:1;/* connection establishment in progress */
         unsigned int          ksnr_connected:4; /* connections established by type */
         unsigned int          ksnr_deleted:1;   /* been removed from peer? */
+        unsigned int          ksnr_no_stripe:1; /* peer refused parallel conns */
         unsigned int          ksnr_share_count; /* created explicitly? */
         int                   ksnr_conn_count;  /* # conns established by this route */
+        int                   ksnr_nconns[SOCKLND_CONN_NTYPES]; /* # live conns by type */
 } ksock_route_t;
 
 #define SOCKNAL_KEEPALIVE_PING          1       /* cookie for keepalive ping */
@@ -500,6 +533,39 @@ ksocknal_route_mask(void)
                 (1 << SOCKLND_CONN_BULK_OUT));
 }
 
+/* Max # connections of \a type to keep on \a route; a NULL route means a
+ * passive connection, which is limited by the local conns_per_peer too, so
+ * a peer striping wider than we do gets EALREADY and stops striping. */
+static inline int
+ksocknal_route_type_conns(ksock_route_t *route, int type)
+{
+        int nconns = *ksocknal_tunables.ksnd_conns_per_peer;
+
+        if (type == SOCKLND_CONN_CONTROL)
+                return 1;
+
+        if (route != NULL && route->ksnr_no_stripe)
+                return 1;
+
+        return MAX(1, MIN(nconns, SOCKNAL_CONNS_PER_PEER_MAX));
+}
+
+/* mask of connection types \a route still has to establish */
+static inline int
+ksocknal_route_wanted(ksock_route_t *route)
+{
+        int mask = ksocknal_route_mask();
+        int type;
+
+        for (type = 0; type < SOCKLND_CONN_NTYPES; type++) {
+                if (route->ksnr_nconns[type] >=
+                    ksocknal_route_type_conns(route, type))
+                        mask &= ~(1 << type);
+        }
+
+        return mask;
+}
+
 static inline struct list_head *
 ksocknal_nid2peerlist (lnet_nid_t nid)
 {
@@ -516,6 +582,7 @@ ksocknal_conn_addref (ksock_conn_t *conn)
 }
 
 extern void ksocknal_queue_zombie_conn (ksock_conn_t *conn);
+extern void ksocknal_queue_zc_drain(ksock_conn_t *conn);
 extern void ksocknal_finalize_zcreq(ksock_conn_t *conn);
 
 static inline void
@@ -548,6 +615,13 @@ ksocknal_connsock_decref (ksock_conn_t *conn)
 	LASSERT (atomic_read(&conn->ksnc_sock_refcount) > 0);
 	if (atomic_dec_and_test(&conn->ksnc_sock_refcount)) {
 		LASSERT (conn->ksnc_closing);
+		if (conn->ksnc_zc_sendmsg) {
+			/* skbs may still point at the pages of TXs sent
+			 * with MSG_ZEROCOPY, keep the socket until they are
+			 * released */
+			ksocknal_queue_zc_drain(conn);
+			return;
+		}
 		libcfs_sock_release(conn->ksnc_sock);
 		conn->ksnc_sock = NULL;
 		ksocknal_finalize_zcreq(conn);
@@ -661,6 +735,9 @@ extern void ksocknal_read_callback(ksock_conn_t *conn);
 extern void ksocknal_write_callback(ksock_conn_t *conn);
 
 extern int ksocknal_lib_zc_capable(ksock_conn_t *conn);
+extern int ksocknal_lib_zc_sendmsg(ksock_conn_t *conn);
+extern int ksocknal_lib_zc_reap(ksock_conn_t *conn, __u32 *lo, __u32 *hi);
+extern int ksocknal_drain_zc_sendmsg(ksock_conn_t *conn);
 extern void ksocknal_lib_save_callback(cfs_socket_t *sock, ksock_conn_t *conn);
 extern void ksocknal_lib_set_callback(cfs_socket_t *sock,  ksock_conn_t *conn);
 extern void ksocknal_lib_reset_callback(cfs_socket_t *sock, ksock_conn_t *conn);
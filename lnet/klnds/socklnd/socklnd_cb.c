@@ -57,6 +57,10 @@ ksocknal_alloc_tx(int type, int size)
 	tx->tx_zc_aborted = 0;
 	tx->tx_zc_capable = 0;
 	tx->tx_zc_checked = 0;
+	tx->tx_zc_sendmsg = 0;
+	tx->tx_zc_queued = 0;
+	tx->tx_zc_sent = 0;
+	tx->tx_zc_ndone = 0;
 	tx->tx_desc_size  = size;
 
 	atomic_inc(&ksocknal_data.ksnd_nactive_txs);
@@ -448,6 +452,18 @@ ksocknal_check_zc_req(ksock_tx_t *tx)
 
         tx->tx_zc_checked = 1;
 
+        if (conn->ksnc_zc_sendmsg) {
+                /* The socket tells me when it has finished with the pages
+                 * (see ksocknal_reap_zc_sendmsg()), so no ZC-ACK needed */
+                ksocknal_tx_addref(tx);
+
+		spin_lock(&peer->ksnp_lock);
+		tx->tx_zc_sendmsg = 1;
+		list_add_tail(&tx->tx_zc_list, &conn->ksnc_zc_txs);
+		spin_unlock(&peer->ksnp_lock);
+                return;
+        }
+
         if (conn->ksnc_proto == &ksocknal_protocol_v1x ||
             !conn->ksnc_zc_capable)
                 return;
@@ -475,6 +491,47 @@ ksocknal_check_zc_req(ksock_tx_t *tx)
 	spin_unlock(&peer->ksnp_lock);
 }
 
+/* A TX sent with MSG_ZEROCOPY is done once no more sends will be made and
+ * the socket has reported all its sends complete.  Called with ksnp_lock */
+static int
+ksocknal_zc_tx_done(ksock_tx_t *tx)
+{
+	if (!tx->tx_zc_sent)
+		return 0;
+
+	return !tx->tx_zc_queued ||
+	       tx->tx_zc_ndone == tx->tx_zc_last - tx->tx_zc_first + 1;
+}
+
+/* No more sends will be made for a TX sent with MSG_ZEROCOPY, either
+ * because it's all sent or because sending failed.  Its pages are released
+ * once the socket reports its sends complete, see ksocknal_zc_reap_sock() */
+static void
+ksocknal_zc_tx_sent(ksock_tx_t *tx)
+{
+	ksock_peer_t   *peer = tx->tx_conn->ksnc_peer;
+
+	spin_lock(&peer->ksnp_lock);
+
+	if (!tx->tx_zc_sendmsg) {
+		spin_unlock(&peer->ksnp_lock);
+		return;
+	}
+
+	tx->tx_zc_sent = 1;
+	if (!ksocknal_zc_tx_done(tx)) {
+		spin_unlock(&peer->ksnp_lock);
+		return;
+	}
+
+	tx->tx_zc_sendmsg = 0;
+	list_del(&tx->tx_zc_list);
+
+	spin_unlock(&peer->ksnp_lock);
+
+	ksocknal_tx_decref(tx);
+}
+
 static void
 ksocknal_uncheck_zc_req(ksock_tx_t *tx)
 {
@@ -485,6 +542,13 @@ ksocknal_uncheck_zc_req(ksock_tx_t *tx)
 
 	tx->tx_zc_checked = 0;
 
+	if (tx->tx_conn->ksnc_zc_sendmsg) {
+		/* whatever has been sent must still complete before the
+		 * pages can go */
+		ksocknal_zc_tx_sent(tx);
+		return;
+	}
+
 	spin_lock(&peer->ksnp_lock);
 
 	if (tx->tx_msg.ksm_zc_cookies[0] == 0) {
@@ -501,11 +565,96 @@ ksocknal_uncheck_zc_req(ksock_tx_t *tx)
 	ksocknal_tx_decref(tx);
 }
 
+/* Account the MSG_ZEROCOPY completions queued on the socket to their TXs
+ * and release the TXs that are done.  The caller keeps the socket open */
+static void
+ksocknal_zc_reap_sock(ksock_conn_t *conn)
+{
+	ksock_peer_t	 *peer = conn->ksnc_peer;
+	ksock_tx_t	 *tx;
+	ksock_tx_t	 *tmp;
+	struct list_head  zlist = LIST_HEAD_INIT(zlist);
+	__u32		  lo;
+	__u32		  hi;
+	__u32		  first;
+	__u32		  last;
+
+	while (ksocknal_lib_zc_reap(conn, &lo, &hi)) {
+		spin_lock(&peer->ksnp_lock);
+
+		/* the sends of a TX have consecutive #s; completions can
+		 * arrive in any order, so count the ones of each TX */
+		list_for_each_entry_safe(tx, tmp, &conn->ksnc_zc_txs,
+					 tx_zc_list) {
+			if (!tx->tx_zc_queued)
+				continue;
+
+			first = (__s32)(lo - tx->tx_zc_first) > 0 ?
+				lo : tx->tx_zc_first;
+			last = (__s32)(hi - tx->tx_zc_last) < 0 ?
+			       hi : tx->tx_zc_last;
+			if ((__s32)(last - first) >= 0)
+				tx->tx_zc_ndone += last - first + 1;
+
+			if (!ksocknal_zc_tx_done(tx))
+				continue;
+
+			tx->tx_zc_sendmsg = 0;
+			list_del(&tx->tx_zc_list);
+			list_add_tail(&tx->tx_zc_list, &zlist);
+		}
+
+		spin_unlock(&peer->ksnp_lock);
+	}
+
+	while (!list_empty(&zlist)) {
+		tx = list_entry(zlist.next, ksock_tx_t, tx_zc_list);
+
+		list_del(&tx->tx_zc_list);
+		ksocknal_tx_decref(tx);
+	}
+}
+
+/* Release the TXs whose MSG_ZEROCOPY sends the socket has completed */
+static void
+ksocknal_reap_zc_sendmsg(ksock_conn_t *conn)
+{
+	if (!conn->ksnc_zc_sendmsg)
+		return;
+
+	if (ksocknal_connsock_addref(conn) != 0)	/* being shut down */
+		return;
+
+	ksocknal_zc_reap_sock(conn);
+	ksocknal_connsock_decref(conn);
+}
+
+/* Called by the reaper for a closed conn whose socket is kept open for
+ * MSG_ZEROCOPY completions, see ksocknal_queue_zc_drain().  Returns
+ * non-zero once no TX waits for completion any more */
+int
+ksocknal_drain_zc_sendmsg(ksock_conn_t *conn)
+{
+	int	rc;
+
+	LASSERT(atomic_read(&conn->ksnc_sock_refcount) == 0);
+
+	ksocknal_zc_reap_sock(conn);
+
+	spin_lock(&conn->ksnc_peer->ksnp_lock);
+	rc = list_empty(&conn->ksnc_zc_txs);
+	spin_unlock(&conn->ksnc_peer->ksnp_lock);
+
+	return rc;
+}
+
 static int
 ksocknal_process_transmit (ksock_conn_t *conn, ksock_tx_t *tx)
 {
         int            rc;
 
+        ksocknal_reap_zc_sendmsg(conn);
+
         if (tx->tx_zc_capable && !tx->tx_zc_checked)
                 ksocknal_check_zc_req(tx);
 
@@ -513,6 +662,9 @@ ksocknal_process_transmit (ksock_conn_t *conn, ksock_tx_t *tx)
 
         CDEBUG (D_NET, "send(%d) %d\n", tx->tx_resid, rc);
 
+	if (tx->tx_resid == 0 && tx->tx_zc_checked && conn->ksnc_zc_sendmsg)
+		ksocknal_zc_tx_sent(tx);
+
         if (tx->tx_resid == 0) {
                 /* Sent everything OK */
                 LASSERT (rc == 0);
@@ -589,7 +741,7 @@ ksocknal_launch_connection_locked (ksock_route_t *route)
 
         LASSERT (!route->ksnr_scheduled);
         LASSERT (!route->ksnr_connecting);
-        LASSERT ((ksocknal_route_mask() & ~route->ksnr_connected) != 0);
+        LASSERT (ksocknal_route_wanted(route) != 0);
 
         route->ksnr_scheduled = 1;              /* scheduling conn for connd */
         ksocknal_route_addref(route);           /* extra ref for connd */
@@ -791,7 +943,7 @@ ksocknal_find_connectable_route_locked (ksock_peer_t *peer)
                         continue;
 
                 /* all route types connected ? */
-                if ((ksocknal_route_mask() & ~route->ksnr_connected) == 0)
+                if (ksocknal_route_wanted(route) == 0)
                         continue;
 
                 if (!(route->ksnr_retry_interval == 0 || /* first attempt */
@@ -1385,6 +1537,33 @@ ksocknal_sched_cansleep(ksock_sched_t *sched)
 	return rc;
 }
 
+/* Spin for up to busy_poll usecs waiting for new work, so messages
+ * arriving back to back are picked up without a sleep/wakeup cycle.
+ * Returns non-zero if there is work to do. */
+static int
+ksocknal_sched_busy_poll(ksock_sched_t *sched)
+{
+	int	usecs = *ksocknal_tunables.ksnd_busy_poll;
+	ktime_t	start;
+
+	if (usecs <= 0)
+		return 0;
+
+	start = ktime_get();
+	do {
+		/* unlocked peek; ksocknal_sched_cansleep() rechecks */
+		if (!list_empty(&sched->kss_rx_conns) ||
+		    !list_empty(&sched->kss_tx_conns) ||
+		    ksocknal_data.ksnd_shuttingdown)
+			return 1;
+
+		cpu_relax();
+	} while (!need_resched() &&
+		 ktime_us_delta(ktime_get(), start) < usecs);
+
+	return 0;
+}
+
 int ksocknal_scheduler(void *arg)
 {
 	struct ksock_sched_info	*info;
@@ -1392,6 +1571,7 @@ int ksocknal_scheduler(void *arg)
 	ksock_conn_t		*conn;
 	ksock_tx_t		*tx;
 	int			rc;
+	int			nrx;
 	int			nloops = 0;
 	long			id = (long)arg;
 
@@ -1428,7 +1608,25 @@ int ksocknal_scheduler(void *arg)
                         conn->ksnc_rx_ready = 0;
 			spin_unlock_bh(&sched->kss_lock);
 
-			rc = ksocknal_process_receive(conn);
+			/* error_report schedules me for rx too */
+			ksocknal_reap_zc_sendmsg(conn);
+
+			/* Receive up to rx_budget complete messages in one
+			 * go, unless the conn blocks waiting for
+			 * ksocknal_recv().  Each pass of process_receive only
+			 * completes one stage (header, payload, slop); a
+			 * message is done once ksocknal_new_packet() has
+			 * cleared ksnc_rx_started.  rx_budget <= 1 keeps the
+			 * old single pass per scheduling. */
+			nrx = 0;
+			do {
+				rc = ksocknal_process_receive(conn);
+				if (rc == 0 && !conn->ksnc_rx_started)
+					nrx++;
+			} while (rc == 0 &&
+				 *ksocknal_tunables.ksnd_rx_budget > 1 &&
+				 nrx < *ksocknal_tunables.ksnd_rx_budget &&
+				 conn->ksnc_rx_state != SOCKNAL_RX_PARSE);
 
 			spin_lock_bh(&sched->kss_lock);
 
@@ -1535,10 +1733,12 @@ int ksocknal_scheduler(void *arg)
                         nloops = 0;
 
                         if (!did_something) {   /* wait for something to do */
-				rc = wait_event_interruptible_exclusive(
-					sched->kss_waitq,
-					!ksocknal_sched_cansleep(sched));
-				LASSERT (rc == 0);
+				if (!ksocknal_sched_busy_poll(sched)) {
+					rc = wait_event_interruptible_exclusive(
+						sched->kss_waitq,
+						!ksocknal_sched_cansleep(sched));
+					LASSERT(rc == 0);
+				}
 			} else {
 				cond_resched();
 			}
@@ -1863,7 +2063,7 @@ ksocknal_connect (ksock_route_t *route)
         route->ksnr_connecting = 1;
 
         for (;;) {
-                wanted = ksocknal_route_mask() & ~route->ksnr_connected;
+                wanted = ksocknal_route_wanted(route);
 
                 /* stop connecting if peer/route got closed under me, or
                  * route got connected while queued */
@@ -2521,6 +2721,40 @@ ksocknal_check_peer_timeouts (int idx)
 	read_unlock(&ksocknal_data.ksnd_global_lock);
 }
 
+/* Release the sockets of closed conns once their MSG_ZEROCOPY sends have
+ * completed or the conns have timed out */
+static void
+ksocknal_reap_zc_drain_conns(void)
+{
+	struct list_head  drain = LIST_HEAD_INIT(drain);
+	ksock_conn_t	 *conn;
+
+	spin_lock_bh(&ksocknal_data.ksnd_reaper_lock);
+	list_splice_init(&ksocknal_data.ksnd_zc_drain_conns, &drain);
+	spin_unlock_bh(&ksocknal_data.ksnd_reaper_lock);
+
+	while (!list_empty(&drain)) {
+		conn = list_entry(drain.next, ksock_conn_t, ksnc_list);
+		list_del(&conn->ksnc_list);
+
+		if (!ksocknal_drain_zc_sendmsg(conn) &&
+		    cfs_time_before(cfs_time_current(),
+				    conn->ksnc_zc_deadline)) {
+			/* check again on my next pass */
+			spin_lock_bh(&ksocknal_data.ksnd_reaper_lock);
+			list_add_tail(&conn->ksnc_list,
+				      &ksocknal_data.ksnd_zc_drain_conns);
+			spin_unlock_bh(&ksocknal_data.ksnd_reaper_lock);
+			continue;
+		}
+
+		libcfs_sock_release(conn->ksnc_sock);
+		conn->ksnc_sock = NULL;
+		ksocknal_finalize_zcreq(conn);
+		ksocknal_conn_decref(conn);
+	}
+}
+
 int ksocknal_reaper(void *arg)
 {
 	wait_queue_t     wait;
@@ -2599,6 +2833,8 @@ int ksocknal_reaper(void *arg)
                         nenomem_conns++;
                 }
 
+		ksocknal_reap_zc_drain_conns();
+
                 /* careful with the jiffy wrap... */
                 while ((timeout = cfs_time_sub(deadline,
                                                cfs_time_current())) <= 0) {
@@ -35,6 +35,9 @@
  */
 
 #include "socklnd.h"
+#ifdef HAVE_SOCK_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 
 # if defined(CONFIG_SYSCTL) && !CFS_SYSFS_MODULE_PARM
 
@@ -48,6 +51,24 @@ static struct ctl_table ksocknal_ctl_table[] = {
 		.proc_handler	= &proc_dointvec,
 		INIT_STRATEGY
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "busy_poll",
+		.data		= &ksocknal_tunables.ksnd_busy_poll,
+		.maxlen		= sizeof (int),
+		.mode		= 0644,
+		.proc_handler	= &proc_dointvec,
+		INIT_STRATEGY
+	},
+	{
+		INIT_CTL_NAME
+		.procname	= "rx_budget",
+		.data		= &ksocknal_tunables.ksnd_rx_budget,
+		.maxlen		= sizeof (int),
+		.mode		= 0644,
+		.proc_handler	= &proc_dointvec,
+		INIT_STRATEGY
+	},
 	{
 		INIT_CTL_NAME
 		.procname	= "credits",
@@ -129,6 +150,17 @@ static struct ctl_table ksocknal_ctl_table[] = {
 		.proc_handler	= &proc_dointvec,
 		INIT_STRATEGY
 	},
+#ifdef HAVE_SOCK_ZEROCOPY
+	{
+		INIT_CTL_NAME
+		.procname	= "zero_copy_sendmsg",
+		.data		= &ksocknal_tunables.ksnd_zc_sendmsg,
+		.maxlen		= sizeof (int),
+		.mode		= 0644,
+		.proc_handler	= &proc_dointvec,
+		INIT_STRATEGY
+	},
+#endif
 	{
 		INIT_CTL_NAME
 		.procname	= "zero_copy_recv",
@@ -156,6 +188,15 @@ static struct ctl_table ksocknal_ctl_table[] = {
 		.proc_handler	= &proc_dointvec,
 		INIT_STRATEGY
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "conns_per_peer",
+		.data		= &ksocknal_tunables.ksnd_conns_per_peer,
+		.maxlen		= sizeof (int),
+		.mode		= 0644,
+		.proc_handler	= &proc_dointvec,
+		INIT_STRATEGY
+	},
 	{
 		INIT_CTL_NAME
 		.procname	= "min_bulk",
@@ -380,6 +421,66 @@ ksocknal_lib_zc_capable(ksock_conn_t *conn)
 	return ((caps & NETIF_F_SG) != 0 && (caps & NETIF_F_ALL_CSUM) != 0);
 }
 
+/* Ask the socket to transmit zero-copy with MSG_ZEROCOPY, so bulk pages
+ * are released on the socket's completion notifications instead of by
+ * my peer's ZC-ACK */
+int
+ksocknal_lib_zc_sendmsg(ksock_conn_t *conn)
+{
+#ifdef HAVE_SOCK_ZEROCOPY
+	struct sock	*sk = conn->ksnc_sock->sk;
+
+	if (!*ksocknal_tunables.ksnd_zc_sendmsg || !conn->ksnc_zc_capable)
+		return 0;
+
+	/* This is what SO_ZEROCOPY does for a TCP socket; setting the flag
+	 * directly saves the set_fs() dance around sock_setsockopt() */
+	lock_sock(sk);
+	sock_set_flag(sk, SOCK_ZEROCOPY);
+	release_sock(sk);
+
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* Take the next MSG_ZEROCOPY completion from the socket's error queue.
+ * Returns non-zero and the range of completed sends in [\a lo, \a hi] if
+ * there was one.  Ranges may complete out of order. */
+int
+ksocknal_lib_zc_reap(ksock_conn_t *conn, __u32 *lo, __u32 *hi)
+{
+#ifdef HAVE_SOCK_ZEROCOPY
+	struct sock		*sk = conn->ksnc_sock->sk;
+	struct sk_buff		*skb;
+	struct sock_exterr_skb	*serr;
+	int			 found = 0;
+
+	while (!found && (skb = sock_dequeue_err_skb(sk)) != NULL) {
+		serr = SKB_EXT_ERR(skb);
+
+		if (serr->ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY &&
+		    serr->ee.ee_errno == 0) {
+			*lo = serr->ee.ee_info;
+			*hi = serr->ee.ee_data;
+			found = 1;
+
+			if ((serr->ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0)
+				CDEBUG(D_NET, "MSG_ZEROCOPY to %u.%u.%u.%u "
+				       "was copied\n",
+				       HIPQUAD(conn->ksnc_ipaddr));
+		}
+
+		kfree_skb(skb);
+	}
+
+	return found;
+#else
+	return 0;
+#endif
+}
+
 int
 ksocknal_lib_send_iov(ksock_conn_t *conn, ksock_tx_t *tx)
 {
@@ -458,6 +559,46 @@ ksocknal_lib_send_kiov(ksock_conn_t *conn, ksock_tx_t *tx)
                         rc = cfs_tcp_sendpage(sk, page, offset, fragsize,
                                               msgflg);
                 }
+#ifdef HAVE_SOCK_ZEROCOPY
+	} else if (tx->tx_zc_sendmsg) {
+		/* Zero copy by MSG_ZEROCOPY; the pages are released when
+		 * the socket reports this send complete */
+		struct bio_vec *bvec = conn->ksnc_scheduler->kss_scratch_bvec;
+		struct msghdr	msg = { .msg_flags = MSG_DONTWAIT |
+						     MSG_ZEROCOPY };
+		unsigned int	niov = tx->tx_nkiov;
+		int		i;
+
+		for (nob = i = 0; i < niov; i++) {
+			bvec[i].bv_page = kiov[i].kiov_page;
+			bvec[i].bv_offset = kiov[i].kiov_offset;
+			nob += bvec[i].bv_len = kiov[i].kiov_len;
+		}
+
+		if (!list_empty(&conn->ksnc_tx_queue) ||
+		    nob < tx->tx_resid)
+			msg.msg_flags |= MSG_MORE;
+
+#ifdef HAVE_IOV_ITER_TYPE
+		iov_iter_bvec(&msg.msg_iter, WRITE, bvec, niov, nob);
+#else
+		iov_iter_bvec(&msg.msg_iter, WRITE | ITER_BVEC, bvec, niov,
+			      nob);
+#endif
+		rc = sock_sendmsg(sock, &msg);
+
+		/* Every send that queues data takes the socket's next
+		 * completion sequence #, one that fails gives it back */
+		if (rc > 0) {
+			spin_lock(&conn->ksnc_peer->ksnp_lock);
+			if (!tx->tx_zc_queued) {
+				tx->tx_zc_first = conn->ksnc_zc_seq;
+				tx->tx_zc_queued = 1;
+			}
+			tx->tx_zc_last = conn->ksnc_zc_seq++;
+			spin_unlock(&conn->ksnc_peer->ksnp_lock);
+		}
+#endif
         } else {
 #if SOCKNAL_SINGLE_FRAG_TX || !SOCKNAL_RISK_KMAP_DEADLOCK
 		struct iovec	scratch;
@@ -1033,11 +1174,38 @@ ksocknal_write_space (struct sock *sk)
 	read_unlock(&ksocknal_data.ksnd_global_lock);
 }
 
+#ifdef HAVE_SOCK_ZEROCOPY
+static void
+ksocknal_error_report(struct sock *sk)
+{
+	ksock_conn_t  *conn;
+
+	/* interleave correctly with closing sockets... */
+	LASSERT(!in_irq());
+	read_lock(&ksocknal_data.ksnd_global_lock);
+
+	conn = sk->sk_user_data;
+	if (conn == NULL) {	/* raced with ksocknal_terminate_conn */
+		LASSERT(sk->sk_error_report != &ksocknal_error_report);
+		sk->sk_error_report(sk);
+	} else {
+		/* MSG_ZEROCOPY completions are reaped by the scheduler; the
+		 * socket's own callback still wakes anyone waiting on a real
+		 * socket error */
+		((void (*)(struct sock *))conn->ksnc_saved_error_report)(sk);
+		ksocknal_read_callback(conn);
+	}
+
+	read_unlock(&ksocknal_data.ksnd_global_lock);
+}
+#endif
+
 void
 ksocknal_lib_save_callback(struct socket *sock, ksock_conn_t *conn)
 {
         conn->ksnc_saved_data_ready = sock->sk->sk_data_ready;
         conn->ksnc_saved_write_space = sock->sk->sk_write_space;
+        conn->ksnc_saved_error_report = sock->sk->sk_error_report;
 }
 
 void
@@ -1046,6 +1214,10 @@ ksocknal_lib_set_callback(struct socket *sock,  ksock_conn_t *conn)
         sock->sk->sk_user_data = conn;
         sock->sk->sk_data_ready = ksocknal_data_ready;
         sock->sk->sk_write_space = ksocknal_write_space;
+#ifdef HAVE_SOCK_ZEROCOPY
+	if (conn->ksnc_zc_sendmsg)
+		sock->sk->sk_error_report = ksocknal_error_report;
+#endif
         return;
 }
 
@@ -1057,6 +1229,7 @@ ksocknal_lib_reset_callback(struct socket *sock, ksock_conn_t *conn)
          * since the socket could survive past this module being unloaded!! */
         sock->sk->sk_data_ready = conn->ksnc_saved_data_ready;
         sock->sk->sk_write_space = conn->ksnc_saved_write_space;
+        sock->sk->sk_error_report = conn->ksnc_saved_error_report;
 
         /* A callback could be in progress already; they hold a read lock
          * on ksnd_global_lock (to serialise with me) and NOOP if
@@ -47,6 +47,15 @@ static unsigned int nscheds;
 CFS_MODULE_PARM(nscheds, "i", int, 0444,
 		"# scheduler daemons in each pool while starting");
 
+static int busy_poll;
+CFS_MODULE_PARM(busy_poll, "i", int, 0644,
+                "usecs schedulers busy-poll for new work before sleeping");
+
+static int rx_budget = 1;
+CFS_MODULE_PARM(rx_budget, "i", int, 0644,
+                "max # complete messages received from one connection "
+                "in a batch (<= 1: one receive pass)");
+
 static int nconnds = 4;
 CFS_MODULE_PARM(nconnds, "i", int, 0444,
                 "# connection daemons while starting");
@@ -71,6 +80,10 @@ static int typed_conns = 1;
 CFS_MODULE_PARM(typed_conns, "i", int, 0444,
                 "use different sockets for bulk");
 
+static int conns_per_peer = 1;
+CFS_MODULE_PARM(conns_per_peer, "i", int, 0644,
+                "# parallel bulk sockets per peer route");
+
 static int min_bulk = (1<<10);
 CFS_MODULE_PARM(min_bulk, "i", int, 0644,
                 "smallest 'large' message");
@@ -130,6 +143,15 @@ static unsigned int zc_min_payload = (16 << 10);
 CFS_MODULE_PARM(zc_min_payload, "i", int, 0644,
                 "minimum payload size to zero copy");
 
+static int zc_sendmsg = 0;
+#ifdef HAVE_SOCK_ZEROCOPY
+CFS_MODULE_PARM(zc_sendmsg, "i", int, 0644,
+                "zero copy send by MSG_ZEROCOPY instead of ZC-ACK");
+#else
+CFS_MODULE_PARM(zc_sendmsg, "i", int, 0444,
+		"zero copy send by MSG_ZEROCOPY (unsupported by this kernel)");
+#endif
+
 static unsigned int zc_recv = 0;
 CFS_MODULE_PARM(zc_recv, "i", int, 0644,
                 "enable ZC recv for Chelsio driver");
@@ -162,12 +184,15 @@ int ksocknal_tunables_init(void)
         /* initialize ksocknal_tunables structure */
         ksocknal_tunables.ksnd_timeout            = &sock_timeout;
 	ksocknal_tunables.ksnd_nscheds		  = &nscheds;
+        ksocknal_tunables.ksnd_busy_poll          = &busy_poll;
+        ksocknal_tunables.ksnd_rx_budget          = &rx_budget;
         ksocknal_tunables.ksnd_nconnds            = &nconnds;
         ksocknal_tunables.ksnd_nconnds_max        = &nconnds_max;
         ksocknal_tunables.ksnd_min_reconnectms    = &min_reconnectms;
         ksocknal_tunables.ksnd_max_reconnectms    = &max_reconnectms;
         ksocknal_tunables.ksnd_eager_ack          = &eager_ack;
         ksocknal_tunables.ksnd_typed_conns        = &typed_conns;
+        ksocknal_tunables.ksnd_conns_per_peer     = &conns_per_peer;
         ksocknal_tunables.ksnd_min_bulk           = &min_bulk;
         ksocknal_tunables.ksnd_tx_buffer_size     = &tx_buffer_size;
         ksocknal_tunables.ksnd_rx_buffer_size     = &rx_buffer_size;
@@ -185,6 +210,7 @@ int ksocknal_tunables_init(void)
         ksocknal_tunables.ksnd_inject_csum_error  = &inject_csum_error;
         ksocknal_tunables.ksnd_nonblk_zcack       = &nonblk_zcack;
         ksocknal_tunables.ksnd_zc_min_payload     = &zc_min_payload;
+        ksocknal_tunables.ksnd_zc_sendmsg         = &zc_sendmsg;
         ksocknal_tunables.ksnd_zc_recv            = &zc_recv;
         ksocknal_tunables.ksnd_zc_recv_min_nfrags = &zc_recv_min_nfrags;
 
@@ -214,6 +240,14 @@ int ksocknal_tunables_init(void)
         if (*ksocknal_tunables.ksnd_zc_min_payload < (2 << 10))
                 *ksocknal_tunables.ksnd_zc_min_payload = (2 << 10);
 
+#ifndef HAVE_SOCK_ZEROCOPY
+	if (*ksocknal_tunables.ksnd_zc_sendmsg != 0) {
+		CWARN("zc_sendmsg is ignored, this kernel does not support "
+		      "MSG_ZEROCOPY\n");
+		*ksocknal_tunables.ksnd_zc_sendmsg = 0;
+	}
+#endif
+
         /* initialize platform-sepcific tunables */
         return ksocknal_lib_tunables_init();
 };
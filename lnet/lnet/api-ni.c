@@ -56,6 +56,10 @@ static char *routes = "";
 CFS_MODULE_PARM(routes, "s", charp, 0444,
                 "routes to non-local networks");
 
+static char *mr_peers = "";
+CFS_MODULE_PARM(mr_peers, "s", charp, 0444,
+		"peers with NIDs on several local networks");
+
 static int rnet_htable_size = LNET_REMOTE_NETS_HASH_DEFAULT;
 CFS_MODULE_PARM(rnet_htable_size, "i", int, 0444,
 		"size of remote network hash table");
@@ -569,6 +573,7 @@ lnet_prepare(lnet_pid_t requested_pid)
 	INIT_LIST_HEAD(&the_lnet.ln_nis_cpt);
 	INIT_LIST_HEAD(&the_lnet.ln_nis_zombie);
 	INIT_LIST_HEAD(&the_lnet.ln_routers);
+	INIT_LIST_HEAD(&the_lnet.ln_mr_peers);
 	INIT_LIST_HEAD(&the_lnet.ln_drop_rules);
 	INIT_LIST_HEAD(&the_lnet.ln_delay_rules);
 
@@ -643,6 +648,7 @@ lnet_unprepare (void)
 	LASSERT(list_empty(&the_lnet.ln_nis));
 	LASSERT(list_empty(&the_lnet.ln_nis_cpt));
 	LASSERT(list_empty(&the_lnet.ln_nis_zombie));
+	LASSERT(list_empty(&the_lnet.ln_mr_peers));
 
 	lnet_portals_destroy();
 
@@ -1190,6 +1196,9 @@ lnet_shutdown_lndnis(void)
 	for (i = 0; i < the_lnet.ln_nportals; i++)
 		LNetClearLazyPortal(i);
 
+	/* Multi-rail peers hold peer refs, drop them before waiting */
+	lnet_del_mr_peers(NULL);
+
 	/* Clear the peer table and wait for all peers to go (they hold refs on
 	 * their NIs) */
 	lnet_peer_tables_cleanup(NULL);
@@ -1210,6 +1219,7 @@ lnet_shutdown_lndni(struct lnet_ni *ni)
 	lnet_net_unlock(LNET_LOCK_EX);
 
 	/* Do peer table cleanup for this ni */
+	lnet_del_mr_peers(ni);
 	lnet_peer_tables_cleanup(ni);
 
 	lnet_net_lock(LNET_LOCK_EX);
@@ -1549,6 +1559,10 @@ LNetNIInit(lnet_pid_t requested_pid)
 		rc = lnet_rtrpools_alloc(im_a_router);
 		if (rc != 0)
 			goto failed2;
+
+		rc = lnet_parse_mr_peers(mr_peers);
+		if (rc != 0)
+			goto failed2;
 	}
 
 	rc = lnet_acceptor_start();
@@ -843,6 +843,103 @@ lnet_parse_routes (char *routes, int *im_a_router)
 	return rc;
 }
 
+static int
+lnet_parse_mr_peer(char *str)
+{
+	/* static scratch buffer OK (single threaded) */
+	static char	cmd[LNET_SINGLE_TEXTBUF_NOB];
+
+	lnet_nid_t	nids[LNET_MR_NIDS_MAX];
+	int		nnids = 0;
+	char		*sep = str;
+	char		*token = str;
+	int		rc;
+	int		i;
+
+	/* save a copy of the string for error messages */
+	strncpy(cmd, str, sizeof(cmd));
+	cmd[sizeof(cmd) - 1] = '\0';
+
+	for (;;) {
+		/* scan for token start */
+		while (cfs_iswhite(*sep) || *sep == ',')
+			sep++;
+		if (*sep == 0)
+			break;
+
+		token = sep++;
+
+		/* scan for token end */
+		while (*sep != 0 && !cfs_iswhite(*sep) && *sep != ',')
+			sep++;
+		if (*sep != 0)
+			*sep++ = 0;
+
+		if (nnids == LNET_MR_NIDS_MAX)
+			goto token_error;
+
+		nids[nnids] = libcfs_str2nid(token);
+		if (nids[nnids] == LNET_NID_ANY ||
+		    LNET_NETTYP(LNET_NIDNET(nids[nnids])) == LOLND)
+			goto token_error;
+
+		/* one NID per network */
+		for (i = 0; i < nnids; i++) {
+			if (LNET_NIDNET(nids[i]) == LNET_NIDNET(nids[nnids]))
+				goto token_error;
+		}
+		nnids++;
+	}
+
+	if (nnids < 2) {
+		lnet_syntax("mr_peers", cmd, 0, strlen(cmd));
+		return -1;
+	}
+
+	rc = lnet_add_mr_peer(nids, nnids);
+	if (rc != 0 && rc != -EEXIST) {
+		CERROR("Can't add multi-rail peer %s: %d\n",
+		       libcfs_nid2str(nids[0]), rc);
+		return -1;
+	}
+
+	return 0;
+
+token_error:
+	lnet_syntax("mr_peers", cmd, (int)(token - str), strlen(token));
+	return -1;
+}
+
+/* mr_peers="nid,nid[,...][; nid,nid...]", the first NID of each peer is
+ * its primary NID, each NID must be on a different local network */
+int
+lnet_parse_mr_peers(char *mr_peers)
+{
+	struct list_head	tbs;
+	struct lnet_text_buf	*ltb;
+	int			rc = 0;
+
+	INIT_LIST_HEAD(&tbs);
+
+	if (lnet_str2tbs_sep(&tbs, mr_peers) < 0) {
+		CERROR("Error parsing multi-rail peers\n");
+		return -EINVAL;
+	}
+
+	while (!list_empty(&tbs)) {
+		ltb = list_entry(tbs.next, struct lnet_text_buf, ltb_list);
+
+		if (rc == 0 && lnet_parse_mr_peer(ltb->ltb_text) < 0)
+			rc = -EINVAL;
+
+		list_del(&ltb->ltb_list);
+		lnet_free_text_buf(ltb);
+	}
+
+	LASSERT(lnet_tbnob == 0);
+	return rc;
+}
+
 static int
 lnet_match_network_token(char *token, int len, __u32 *ipaddrs, int nip)
 {
@@ -88,6 +88,9 @@ LNetMEAttach(unsigned int portal,
 	if ((int)portal >= the_lnet.ln_nportals)
 		return -EINVAL;
 
+	/* lnet_parse() reports a multi-rail peer by its primary NID */
+	match_id.nid = lnet_mr_primary_nid(match_id.nid);
+
 	mtable = lnet_mt_of_attach(portal, match_id,
 				   match_bits, ignore_bits, pos);
 	if (mtable == NULL) /* can't match portal type */
@@ -160,6 +163,8 @@ LNetMEInsert(lnet_handle_me_t current_meh,
 	if (pos == LNET_INS_LOCAL)
 		return -EPERM;
 
+	match_id.nid = lnet_mr_primary_nid(match_id.nid);
+
 	new_me = lnet_me_alloc();
 	if (new_me == NULL)
 		return -ENOMEM;
@@ -935,6 +935,8 @@ lnet_post_routed_recv_locked (lnet_msg_t *msg, int do_recv)
 		rbp->rbp_credits--;
 		if (rbp->rbp_credits < rbp->rbp_mincredits)
 			rbp->rbp_mincredits = rbp->rbp_credits;
+		if (rbp->rbp_credits < rbp->rbp_lowcredits)
+			rbp->rbp_lowcredits = rbp->rbp_credits;
 
 		if (rbp->rbp_credits < 0) {
 			/* must have checked eager_recv before here */
@@ -1239,6 +1241,7 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg, lnet_nid_t rtr_nid)
 	int			cpt;
 	int			cpt2;
 	int			rc;
+	int			mr_checked = 0;
 
 	/* NB: rtr_nid is set to LNET_NID_ANY for all current use-cases,
 	 * but we might want to use pre-determined router for ACK/REPLY
@@ -1275,6 +1278,33 @@ lnet_send(lnet_nid_t src_nid, lnet_msg_t *msg, lnet_nid_t rtr_nid)
                 LASSERT (!msg->msg_routing);
         }
 
+	/* pick the rail to a multi-rail peer, once */
+	if (!mr_checked && !msg->msg_routing && rtr_nid == LNET_NID_ANY &&
+	    !list_empty(&the_lnet.ln_mr_peers)) {
+		lnet_nid_t	mr_nid;
+
+		mr_checked = 1;
+		mr_nid = lnet_mr_select_nid_locked(dst_nid, src_ni);
+		if (mr_nid != dst_nid) {
+			CDEBUG(D_NET, "Multi-rail %s via %s for %s %d\n",
+			       libcfs_nid2str(dst_nid), libcfs_nid2str(mr_nid),
+			       lnet_msgtyp2str(msg->msg_type), msg->msg_len);
+
+			dst_nid = mr_nid;
+			msg->msg_target.nid = dst_nid;
+			msg->msg_hdr.dest_nid = cpu_to_le64(dst_nid);
+
+			cpt2 = lnet_cpt_of_nid_locked(dst_nid);
+			if (cpt2 != cpt) {
+				if (src_ni != NULL)
+					lnet_ni_decref_locked(src_ni, cpt);
+				lnet_net_unlock(cpt);
+				cpt = cpt2;
+				goto again;
+			}
+		}
+	}
+
         /* Is this for someone on a local network? */
 	local_ni = lnet_net2ni_locked(LNET_NIDNET(dst_nid), cpt);
 
@@ -1809,7 +1839,9 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
 	int		rc = 0;
 	int		cpt;
 	int		for_me;
+	int		mr_rail = 0;
 	struct lnet_msg	*msg;
+	lnet_peer_t	*lp;
 	lnet_pid_t     dest_pid;
 	lnet_nid_t     dest_nid;
 	lnet_nid_t     src_nid;
@@ -1973,28 +2005,68 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
 		msg->msg_hdr.payload_length = payload_length;
 	}
 
-	lnet_net_lock(cpt);
-	rc = lnet_nid2peer_locked(&msg->msg_rxpeer, from_nid, cpt);
-	if (rc != 0) {
+	/* known senders are looked up without holding the lock */
+	lp = lnet_find_peer_rcu(from_nid, cpt);
+	if (lp == NULL) {
+		lnet_net_lock(cpt);
+		rc = lnet_nid2peer_locked(&lp, from_nid, cpt);
 		lnet_net_unlock(cpt);
-		CERROR("%s, src %s: Dropping %s "
-		       "(error %d looking up sender)\n",
-		       libcfs_nid2str(from_nid), libcfs_nid2str(src_nid),
-		       lnet_msgtyp2str(type), rc);
-		lnet_msg_free(msg);
-		goto drop;
+		if (rc != 0) {
+			CERROR("%s, src %s: Dropping %s "
+			       "(error %d looking up sender)\n",
+			       libcfs_nid2str(from_nid),
+			       libcfs_nid2str(src_nid),
+			       lnet_msgtyp2str(type), rc);
+			lnet_msg_free(msg);
+			goto drop;
+		}
+	}
+	msg->msg_rxpeer = lp;
+
+	if (for_me && !list_empty(&the_lnet.ln_mr_peers)) {
+		lnet_mr_peer_t *mrp;
+
+		rcu_read_lock();
+		mrp = lnet_mr_peer_find_locked(src_nid);
+		if (mrp != NULL) {
+			/* upper layers only see the primary NID of a
+			 * multi-rail peer, whichever rail it arrived on */
+			msg->msg_hdr.src_nid = mrp->mrp_nids[0];
+			/* and a rail we hear from is usable again */
+			mr_rail = src_nid == from_nid;
+		}
+		rcu_read_unlock();
+	}
+
+	/* Messages for me from a live peer that isn't a router are the hot
+	 * path, they don't need lnet_net_lock: the peer ref is atomic and
+	 * lnet_msg_commit() has its own lock.  Just refresh the aliveness
+	 * stamps of a rail, lnet_notify_locked() is only needed when it was
+	 * down. */
+	if (for_me && !lnet_isrouter(lp) && (!mr_rail || lp->lp_alive) &&
+	    likely(list_empty(&the_lnet.ln_delay_rules))) {
+		if (mr_rail)
+			lp->lp_last_alive = lp->lp_last_query =
+				cfs_time_current();
+
+		lnet_msg_commit(msg, cpt);
+		goto parse_local;
 	}
 
-	if (lnet_isrouter(msg->msg_rxpeer)) {
-		lnet_peer_set_alive(msg->msg_rxpeer);
+	lnet_net_lock(cpt);
+
+	if (mr_rail)
+		lnet_peer_set_alive(lp);
+
+	if (lnet_isrouter(lp)) {
+		lnet_peer_set_alive(lp);
 		if (avoid_asym_router_failure &&
 		    LNET_NIDNET(src_nid) != LNET_NIDNET(from_nid)) {
 			/* received a remote message from router, update
 			 * remote NI status on this router.
 			 * NB: multi-hop routed message will be ignored.
 			 */
-			lnet_router_ni_update_locked(msg->msg_rxpeer,
-						     LNET_NIDNET(src_nid));
+			lnet_router_ni_update_locked(lp, LNET_NIDNET(src_nid));
 		}
 	}
 
@@ -2023,6 +2095,7 @@ lnet_parse(lnet_ni_t *ni, lnet_hdr_t *hdr, lnet_nid_t from_nid,
 
 	lnet_net_unlock(cpt);
 
+ parse_local:
 	rc = lnet_parse_local(ni, msg);
 	if (rc != 0)
 		goto free_drop;
@@ -162,11 +162,14 @@ lnet_msg_commit(lnet_msg_t *msg, int cpt)
 
 	LASSERT(!msg->msg_onactivelist);
 	msg->msg_onactivelist = 1;
+
+	spin_lock(&container->msc_lock);
 	list_add(&msg->msg_activelist, &container->msc_active);
 
 	counters->msgs_alloc++;
 	if (counters->msgs_alloc > counters->msgs_max)
 		counters->msgs_max = counters->msgs_alloc;
+	spin_unlock(&container->msc_lock);
 }
 
 static void
@@ -276,6 +279,7 @@ lnet_msg_decommit_rx(lnet_msg_t *msg, int status)
 void
 lnet_msg_decommit(lnet_msg_t *msg, int cpt, int status)
 {
+	struct lnet_msg_container *container;
 	int	cpt2 = cpt;
 
 	LASSERT(msg->msg_tx_committed || msg->msg_rx_committed);
@@ -296,10 +300,13 @@ lnet_msg_decommit(lnet_msg_t *msg, int cpt, int status)
 		lnet_msg_decommit_rx(msg, status);
 	}
 
+	container = the_lnet.ln_msg_containers[cpt2];
+	spin_lock(&container->msc_lock);
 	list_del(&msg->msg_activelist);
 	msg->msg_onactivelist = 0;
 
 	the_lnet.ln_counters[cpt2]->msgs_alloc--;
+	spin_unlock(&container->msc_lock);
 
 	if (cpt2 != cpt) {
 		lnet_net_unlock(cpt2);
@@ -578,6 +585,7 @@ lnet_msg_container_setup(struct lnet_msg_container *container, int cpt)
 
 	container->msc_init = 1;
 
+	spin_lock_init(&container->msc_lock);
 	INIT_LIST_HEAD(&container->msc_active);
 	INIT_LIST_HEAD(&container->msc_finalizing);
 
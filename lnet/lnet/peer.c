@@ -57,8 +57,6 @@ lnet_peer_tables_create(void)
 	}
 
 	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
-		INIT_LIST_HEAD(&ptable->pt_deathrow);
-
 		LIBCFS_CPT_ALLOC(hash, lnet_cpt_table(), i,
 				 LNET_PEER_HASH_SIZE * sizeof(*hash));
 		if (hash == NULL) {
@@ -72,6 +70,17 @@ lnet_peer_tables_create(void)
 		ptable->pt_hash = hash; /* sign of initialization */
 	}
 
+	LIBCFS_ALLOC(hash, LNET_PEER_HASH_SIZE * sizeof(*hash));
+	if (hash == NULL) {
+		CERROR("Failed to create multi-rail peer hash table\n");
+		lnet_peer_tables_destroy();
+		return -ENOMEM;
+	}
+
+	for (j = 0; j < LNET_PEER_HASH_SIZE; j++)
+		INIT_LIST_HEAD(&hash[j]);
+	the_lnet.ln_mr_hash = hash;
+
 	return 0;
 }
 
@@ -83,16 +92,26 @@ lnet_peer_tables_destroy(void)
 	int			i;
 	int			j;
 
+	hash = the_lnet.ln_mr_hash;
+	if (hash != NULL) {
+		the_lnet.ln_mr_hash = NULL;
+		for (j = 0; j < LNET_PEER_HASH_SIZE; j++)
+			LASSERT(list_empty(&hash[j]));
+
+		LIBCFS_FREE(hash, LNET_PEER_HASH_SIZE * sizeof(*hash));
+	}
+
 	if (the_lnet.ln_peer_tables == NULL)
 		return;
 
+	/* wait for peers freed by lnet_destroy_peer_locked() */
+	rcu_barrier();
+
 	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
 		hash = ptable->pt_hash;
 		if (hash == NULL) /* not intialized */
 			break;
 
-		LASSERT(list_empty(&ptable->pt_deathrow));
-
 		ptable->pt_hash = NULL;
 		for (j = 0; j < LNET_PEER_HASH_SIZE; j++)
 			LASSERT(list_empty(&hash[j]));
@@ -116,7 +135,9 @@ lnet_peer_table_cleanup_locked(lnet_ni_t *ni, struct lnet_peer_table *ptable)
 					 lp_hashlist) {
 			if (ni != NULL && ni != lp->lp_ni)
 				continue;
-			list_del_init(&lp->lp_hashlist);
+			/* lockless lookups may still be walking past it */
+			list_del_rcu(&lp->lp_hashlist);
+			lp->lp_unhashed = 1;
 			/* Lose hash table's ref */
 			ptable->pt_zombies++;
 			lnet_peer_decref_locked(lp);
@@ -125,7 +146,7 @@ lnet_peer_table_cleanup_locked(lnet_ni_t *ni, struct lnet_peer_table *ptable)
 }
 
 static void
-lnet_peer_table_deathrow_wait_locked(struct lnet_peer_table *ptable,
+lnet_peer_table_zombies_wait_locked(struct lnet_peer_table *ptable,
 				     int cpt_locked)
 {
 	int	i;
@@ -175,10 +196,6 @@ lnet_peer_tables_cleanup(lnet_ni_t *ni)
 {
 	int			i;
 	struct lnet_peer_table	*ptable;
-	lnet_peer_t		*lp;
-	struct list_head	deathrow;
-
-	INIT_LIST_HEAD(&deathrow);
 
 	LASSERT(the_lnet.ln_shutdown || ni != NULL);
 	/* If just deleting the peers for a NI, get rid of any routes these
@@ -189,27 +206,28 @@ lnet_peer_tables_cleanup(lnet_ni_t *ni)
 		lnet_net_unlock(i);
 	}
 
-	/* Start the process of moving the applicable peers to
-	 * deathrow. */
+	/* Unhash the applicable peers, they are destroyed once their last
+	 * ref has gone. */
 	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
 		lnet_net_lock(i);
 		lnet_peer_table_cleanup_locked(ni, ptable);
 		lnet_net_unlock(i);
 	}
 
-	/* Cleanup all entries on deathrow. */
+	/* Wait for all of them to be destroyed. */
 	cfs_percpt_for_each(ptable, i, the_lnet.ln_peer_tables) {
 		lnet_net_lock(i);
-		lnet_peer_table_deathrow_wait_locked(ptable, i);
-		list_splice_init(&ptable->pt_deathrow, &deathrow);
+		lnet_peer_table_zombies_wait_locked(ptable, i);
 		lnet_net_unlock(i);
 	}
+}
 
-	while (!list_empty(&deathrow)) {
-		lp = list_entry(deathrow.next, lnet_peer_t, lp_hashlist);
-		list_del(&lp->lp_hashlist);
-		LIBCFS_FREE(lp, sizeof(*lp));
-	}
+static void
+lnet_peer_free_rcu(struct rcu_head *head)
+{
+	lnet_peer_t *lp = container_of(head, lnet_peer_t, lp_rcu);
+
+	LIBCFS_FREE(lp, sizeof(*lp));
 }
 
 void
@@ -217,10 +235,9 @@ lnet_destroy_peer_locked(lnet_peer_t *lp)
 {
 	struct lnet_peer_table *ptable;
 
-	LASSERT(lp->lp_refcount == 0);
+	LASSERT(atomic_read(&lp->lp_refcount) == 0);
 	LASSERT(lp->lp_rtr_refcount == 0);
 	LASSERT(list_empty(&lp->lp_txq));
-	LASSERT(list_empty(&lp->lp_hashlist));
 	LASSERT(lp->lp_txqnob == 0);
 
 	ptable = the_lnet.ln_peer_tables[lp->lp_cpt];
@@ -230,9 +247,11 @@ lnet_destroy_peer_locked(lnet_peer_t *lp)
 	lnet_ni_decref_locked(lp->lp_ni, lp->lp_cpt);
 	lp->lp_ni = NULL;
 
-	list_add(&lp->lp_hashlist, &ptable->pt_deathrow);
 	LASSERT(ptable->pt_zombies > 0);
 	ptable->pt_zombies--;
+
+	/* it's unhashed, but lnet_find_peer_rcu() may still be looking */
+	call_rcu(&lp->lp_rcu, lnet_peer_free_rcu);
 }
 
 lnet_peer_t *
@@ -254,6 +273,48 @@ lnet_find_peer_locked(struct lnet_peer_table *ptable, lnet_nid_t nid)
 	return NULL;
 }
 
+/**
+ * Find the peer of \a nid without taking lnet_net_lock, \a cpt is the
+ * CPT of \a nid. Peers are unhashed before their last ref goes and freed
+ * after a grace period, so a lookup can still walk past one that is being
+ * torn down; those are skipped. A peer can be unhashed between the check
+ * and taking the ref, so lp_unhashed is checked again once the ref is
+ * held; unhashing after that is no different from unhashing right after
+ * a locked lookup, the ref keeps the peer until the caller drops it.
+ *
+ * \retval the peer with a ref held for the caller, NULL if not found
+ */
+lnet_peer_t *
+lnet_find_peer_rcu(lnet_nid_t nid, int cpt)
+{
+	struct lnet_peer_table	*ptable;
+	lnet_peer_t		*lp;
+
+	ptable = the_lnet.ln_peer_tables[cpt];
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(lp, &ptable->pt_hash[lnet_nid2peerhash(nid)],
+				lp_hashlist) {
+		if (lp->lp_nid != nid || lp->lp_unhashed ||
+		    !atomic_inc_not_zero(&lp->lp_refcount))
+			continue;
+
+		/* a successful atomic_inc_not_zero() is a full barrier, so
+		 * this sees lp_unhashed if the hash's ref was already gone */
+		if (lp->lp_unhashed || the_lnet.ln_shutdown) {
+			rcu_read_unlock();
+			lnet_peer_decref(lp);
+			return NULL;
+		}
+
+		rcu_read_unlock();
+		return lp;
+	}
+	rcu_read_unlock();
+
+	return NULL;
+}
+
 int
 lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt)
 {
@@ -277,12 +338,6 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt)
 		return 0;
 	}
 
-	if (!list_empty(&ptable->pt_deathrow)) {
-		lp = list_entry(ptable->pt_deathrow.next,
-				lnet_peer_t, lp_hashlist);
-		list_del(&lp->lp_hashlist);
-	}
-
 	/*
 	 * take extra refcount in case another thread has shutdown LNet
 	 * and destroyed locks and peer-table before I finish the allocation
@@ -290,11 +345,7 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt)
 	ptable->pt_number++;
 	lnet_net_unlock(cpt);
 
-	if (lp != NULL)
-		memset(lp, 0, sizeof(*lp));
-	else
-		LIBCFS_CPT_ALLOC(lp, lnet_cpt_table(), cpt2, sizeof(*lp));
-
+	LIBCFS_CPT_ALLOC(lp, lnet_cpt_table(), cpt2, sizeof(*lp));
 	if (lp == NULL) {
 		rc = -ENOMEM;
 		lnet_net_lock(cpt);
@@ -317,7 +368,7 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt)
 	lp->lp_ping_feats = LNET_PING_FEAT_INVAL;
 	lp->lp_nid = nid;
 	lp->lp_cpt = cpt2;
-	lp->lp_refcount = 2;	/* 1 for caller; 1 for hash */
+	atomic_set(&lp->lp_refcount, 2);	/* 1 for caller; 1 for hash */
 	lp->lp_rtr_refcount = 0;
 
 	lnet_net_lock(cpt);
@@ -344,19 +395,264 @@ lnet_nid2peer_locked(lnet_peer_t **lpp, lnet_nid_t nid, int cpt)
 	lp->lp_rtrcredits    =
 	lp->lp_minrtrcredits = lnet_peer_buffer_credits(lp->lp_ni);
 
-	list_add_tail(&lp->lp_hashlist,
-		      &ptable->pt_hash[lnet_nid2peerhash(nid)]);
+	/* publish it to lnet_find_peer_rcu() fully initialized */
+	list_add_tail_rcu(&lp->lp_hashlist,
+			  &ptable->pt_hash[lnet_nid2peerhash(nid)]);
 	ptable->pt_version++;
 	*lpp = lp;
 
 	return 0;
 out:
+	/* never hashed, nobody else has seen it */
 	if (lp != NULL)
-		list_add(&lp->lp_hashlist, &ptable->pt_deathrow);
+		LIBCFS_FREE(lp, sizeof(*lp));
 	ptable->pt_number--;
 	return rc;
 }
 
+/**
+ * Find the multi-rail peer \a nid is a rail of. The caller holds
+ * lnet_net_lock() or rcu_read_lock(), peers are only added and removed
+ * under LNET_LOCK_EX and freed after a grace period.
+ */
+lnet_mr_peer_t *
+lnet_mr_peer_find_locked(lnet_nid_t nid)
+{
+	lnet_mr_nid_t	*mrn;
+
+	list_for_each_entry_rcu(mrn,
+				&the_lnet.ln_mr_hash[lnet_nid2peerhash(nid)],
+				mrn_hashlist) {
+		if (mrn->mrn_nid == nid)
+			return mrn->mrn_mrp;
+	}
+
+	return NULL;
+}
+
+/**
+ * Map \a nid to the primary NID of its multi-rail peer, so a message that
+ * arrives on any rail matches an ME bound to any other rail of that peer.
+ *
+ * \retval the primary NID, \a nid itself if it isn't a multi-rail peer
+ */
+lnet_nid_t
+lnet_mr_primary_nid(lnet_nid_t nid)
+{
+	lnet_mr_peer_t *mrp;
+
+	if (nid == LNET_NID_ANY || list_empty(&the_lnet.ln_mr_peers))
+		return nid;
+
+	rcu_read_lock();
+	mrp = lnet_mr_peer_find_locked(nid);
+	if (mrp != NULL)
+		nid = mrp->mrp_nids[0];
+	rcu_read_unlock();
+
+	return nid;
+}
+
+/**
+ * Tell whether \a nid is a NID of a peer listed in the mr_peers module
+ * parameter. Only sends to such peers should leave the choice of the
+ * source NI to LNet, everything else keeps its source NID.
+ *
+ * \retval 1 if \a nid is a multi-rail peer, 0 otherwise
+ */
+int
+LNetIsMultiRail(lnet_nid_t nid)
+{
+	int rc;
+
+	if (list_empty(&the_lnet.ln_mr_peers))
+		return 0;
+
+	rcu_read_lock();
+	rc = lnet_mr_peer_find_locked(nid) != NULL;
+	rcu_read_unlock();
+
+	return rc;
+}
+EXPORT_SYMBOL(LNetIsMultiRail);
+
+/**
+ * Choose the NID to reach \a nid on if it belongs to a multi-rail peer.
+ *
+ * With \a src_ni set the rail on that NI is used. lnet_send() only passes
+ * it for ACK/REPLY and for PUT/GET whose caller named the NI, i.e. replies
+ * and bulk of a request that arrived on that NI, so a conversation stays on
+ * the rail it started on. New sends leave it NULL and get the rail whose
+ * peer and NI have the most spare send credits; rails marked down are only
+ * used if no other rail is left and ties are broken round-robin. Credits
+ * of other CPTs are read without their lock, a stale value only costs
+ * balance, lnet_post_send_locked() checks again.
+ *
+ * \retval the NID to send to, \a nid itself if there's no better choice
+ */
+lnet_nid_t
+lnet_mr_select_nid_locked(lnet_nid_t nid, lnet_ni_t *src_ni)
+{
+	lnet_mr_peer_t	*mrp;
+	lnet_peer_t	*lp;
+	lnet_nid_t	best_nid = nid;
+	int		best_credits = 0;
+	int		best_alive = -1;
+	unsigned int	seq = 0;
+	int		credits;
+	int		i;
+	int		j;
+
+	mrp = lnet_mr_peer_find_locked(nid);
+	if (mrp == NULL)
+		return nid;
+
+	/* senders on other CPTs hold other locks, so the cursor is atomic */
+	if (src_ni == NULL)
+		seq = (unsigned int)atomic_inc_return(&mrp->mrp_seq);
+
+	for (j = 0; j < mrp->mrp_nnids; j++) {
+		i = (seq + j) % mrp->mrp_nnids;
+		lp = mrp->mrp_peers[i];
+		if (lp == NULL)
+			continue;
+
+		if (src_ni != NULL) {
+			if (lp->lp_ni == src_ni)
+				return mrp->mrp_nids[i];
+			continue;
+		}
+
+		credits = lp->lp_txcredits +
+			  lp->lp_ni->ni_tx_queues[lp->lp_cpt]->tq_credits;
+
+		if (lp->lp_alive < best_alive ||
+		    (lp->lp_alive == best_alive && credits <= best_credits))
+			continue;
+
+		best_alive = lp->lp_alive;
+		best_credits = credits;
+		best_nid = mrp->mrp_nids[i];
+	}
+
+	return best_nid;
+}
+
+int
+lnet_add_mr_peer(lnet_nid_t *nids, int nnids)
+{
+	lnet_mr_peer_t	*mrp;
+	lnet_mr_nid_t	*mrn;
+	int		rc = 0;
+	int		i;
+
+	LASSERT(nnids > 1 && nnids <= LNET_MR_NIDS_MAX);
+
+	for (i = 0; i < nnids; i++) {
+		if (lnet_islocalnid(nids[i]))	/* it's me */
+			return -EEXIST;
+		if (!lnet_islocalnet(LNET_NIDNET(nids[i])))
+			return -EHOSTUNREACH;
+	}
+
+	LIBCFS_ALLOC(mrp, sizeof(*mrp));
+	if (mrp == NULL)
+		return -ENOMEM;
+
+	mrp->mrp_nnids = nnids;
+	atomic_set(&mrp->mrp_seq, 0);
+
+	lnet_net_lock(LNET_LOCK_EX);
+
+	for (i = 0; i < nnids; i++) {
+		if (lnet_mr_peer_find_locked(nids[i]) != NULL) {
+			rc = -EEXIST;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < nnids; i++) {
+		mrp->mrp_nids[i] = nids[i];
+		/* NB: may drop and retake the lock */
+		rc = lnet_nid2peer_locked(&mrp->mrp_peers[i], nids[i],
+					  LNET_LOCK_EX);
+		if (rc != 0)
+			goto out;
+	}
+
+	/* the lock may have been dropped, check again before publishing */
+	for (i = 0; i < nnids; i++) {
+		if (lnet_mr_peer_find_locked(nids[i]) != NULL) {
+			rc = -EEXIST;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < nnids; i++) {
+		mrn = &mrp->mrp_hash[i];
+		mrn->mrn_mrp = mrp;
+		mrn->mrn_nid = nids[i];
+		list_add_tail_rcu(&mrn->mrn_hashlist,
+			&the_lnet.ln_mr_hash[lnet_nid2peerhash(nids[i])]);
+	}
+	list_add_tail(&mrp->mrp_list, &the_lnet.ln_mr_peers);
+	lnet_net_unlock(LNET_LOCK_EX);
+	return 0;
+out:
+	for (i = 0; i < nnids; i++) {
+		if (mrp->mrp_peers[i] != NULL)
+			lnet_peer_decref_locked(mrp->mrp_peers[i]);
+	}
+	lnet_net_unlock(LNET_LOCK_EX);
+
+	LIBCFS_FREE(mrp, sizeof(*mrp));
+	return rc;
+}
+
+/* Drop the rails on \a ni, or all multi-rail peers if \a ni is NULL */
+void
+lnet_del_mr_peers(lnet_ni_t *ni)
+{
+	lnet_mr_peer_t	*mrp;
+	lnet_mr_peer_t	*tmp;
+	struct list_head zombies;
+	int		i;
+
+	INIT_LIST_HEAD(&zombies);
+
+	lnet_net_lock(LNET_LOCK_EX);
+	list_for_each_entry_safe(mrp, tmp, &the_lnet.ln_mr_peers, mrp_list) {
+		for (i = 0; i < mrp->mrp_nnids; i++) {
+			if (mrp->mrp_peers[i] == NULL ||
+			    (ni != NULL && mrp->mrp_peers[i]->lp_ni != ni))
+				continue;
+
+			lnet_peer_decref_locked(mrp->mrp_peers[i]);
+			mrp->mrp_peers[i] = NULL;
+		}
+
+		if (ni != NULL)
+			continue;
+
+		for (i = 0; i < mrp->mrp_nnids; i++)
+			list_del_rcu(&mrp->mrp_hash[i].mrn_hashlist);
+		list_move(&mrp->mrp_list, &zombies);
+	}
+	lnet_net_unlock(LNET_LOCK_EX);
+
+	if (list_empty(&zombies))
+		return;
+
+	/* lnet_mr_peer_find_locked() may still walk them under RCU */
+	synchronize_rcu();
+
+	while (!list_empty(&zombies)) {
+		mrp = list_entry(zombies.next, lnet_mr_peer_t, mrp_list);
+		list_del(&mrp->mrp_list);
+		LIBCFS_FREE(mrp, sizeof(*mrp));
+	}
+}
+
 void
 lnet_debug_peer(lnet_nid_t nid)
 {
@@ -379,7 +675,7 @@ lnet_debug_peer(lnet_nid_t nid)
                 aliveness = lp->lp_alive ? "up" : "down";
 
         CDEBUG(D_WARNING, "%-24s %4d %5s %5d %5d %5d %5d %5d %ld\n",
-               libcfs_nid2str(lp->lp_nid), lp->lp_refcount,
+               libcfs_nid2str(lp->lp_nid), atomic_read(&lp->lp_refcount),
                aliveness, lp->lp_ni->ni_peertxcredits,
                lp->lp_rtrcredits, lp->lp_minrtrcredits,
                lp->lp_txcredits, lp->lp_mintxcredits, lp->lp_txqnob);
@@ -433,7 +729,7 @@ int lnet_get_peer_info(__u32 peer_index, __u64 *nid,
 					 lp->lp_alive ? "up" : "down");
 
 			*nid = lp->lp_nid;
-			*refcount = lp->lp_refcount;
+			*refcount = atomic_read(&lp->lp_refcount);
 			*ni_peer_tx_credits = lp->lp_ni->ni_peertxcredits;
 			*peer_tx_credits = lp->lp_txcredits;
 			*peer_rtr_credits = lp->lp_rtrcredits;
@@ -33,6 +33,8 @@
 #define LNET_NRB_LARGE		(LNET_NRB_LARGE_MIN * 4)
 #define LNET_NRB_LARGE_PAGES	((LNET_MTU + PAGE_CACHE_SIZE - 1) >> \
 				  PAGE_CACHE_SHIFT)
+/* # idle resize checks (seconds) before a dynamic pool shrinks */
+#define LNET_NRB_IDLE_CHECKS	30
 
 static char *forwarding = "";
 CFS_MODULE_PARM(forwarding, "s", charp, 0444,
@@ -47,6 +49,10 @@ CFS_MODULE_PARM(small_router_buffers, "i", int, 0444,
 static int large_router_buffers;
 CFS_MODULE_PARM(large_router_buffers, "i", int, 0444,
 		"# of large messages to buffer in the router");
+static int dynamic_router_buffers;
+CFS_MODULE_PARM(dynamic_router_buffers, "i", int, 0644,
+		"max multiple of the configured router buffers a pool grows "
+		"to on demand (0 to disable)");
 static int peer_buffer_credits = 0;
 CFS_MODULE_PARM(peer_buffer_credits, "i", int, 0444,
                 "# router buffer credits per peer");
@@ -71,6 +77,7 @@ lnet_peer_buffer_credits(lnet_ni_t *ni)
 
 /* forward ref's */
 static int lnet_router_checker(void *);
+static void lnet_rtrpools_resize(void);
 
 static int check_routers_before_use = 0;
 CFS_MODULE_PARM(check_routers_before_use, "i", int, 0444,
@@ -168,7 +175,7 @@ lnet_ni_notify_locked(lnet_ni_t *ni, lnet_peer_t *lp)
 static void
 lnet_rtr_addref_locked(lnet_peer_t *lp)
 {
-	LASSERT(lp->lp_refcount > 0);
+	LASSERT(atomic_read(&lp->lp_refcount) > 0);
 	LASSERT(lp->lp_rtr_refcount >= 0);
 
 	/* lnet_net_lock must be exclusively locked */
@@ -195,7 +202,7 @@ lnet_rtr_addref_locked(lnet_peer_t *lp)
 static void
 lnet_rtr_decref_locked(lnet_peer_t *lp)
 {
-	LASSERT(lp->lp_refcount > 0);
+	LASSERT(atomic_read(&lp->lp_refcount) > 0);
 	LASSERT(lp->lp_rtr_refcount > 0);
 
 	/* lnet_net_lock must be exclusively locked */
@@ -1272,6 +1279,8 @@ rescan:
 
 		lnet_net_unlock(cpt);
 
+		lnet_rtrpools_resize();
+
 		lnet_prune_rc_data(0); /* don't wait for UNLINK */
 
 		/* Call cfs_pause() here always adds 1 to load average
@@ -1372,7 +1381,7 @@ lnet_rtrpool_free_bufs(lnet_rtrbufpool_t *rbp, int cpt)
 }
 
 static int
-lnet_rtrpool_adjust_bufs(lnet_rtrbufpool_t *rbp, int nbufs, int cpt)
+lnet_rtrpool_resize_bufs(lnet_rtrbufpool_t *rbp, int nbufs, int cpt)
 {
 	struct list_head rb_list;
 	lnet_rtrbuf_t	*rb;
@@ -1380,19 +1389,34 @@ lnet_rtrpool_adjust_bufs(lnet_rtrbufpool_t *rbp, int nbufs, int cpt)
 	int		num_buffers = 0;
 	int		npages = rbp->rbp_npages;
 
-	/* If we are called for less buffers than already in the pool, we
-	 * just lower the nbuffers number and excess buffers will be
-	 * thrown away as they are returned to the free list.  Credits
-	 * then get adjusted as well. */
+	INIT_LIST_HEAD(&rb_list);
+
+	/* If we are called for less buffers than already in the pool, idle
+	 * buffers beyond the new size are freed now.  We then lower the
+	 * nbuffers number and the remaining excess buffers will be thrown
+	 * away as they are returned to the free list.  Credits then get
+	 * adjusted as well. */
 	if (nbufs <= rbp->rbp_nbuffers) {
 		lnet_net_lock(cpt);
+		while (rbp->rbp_credits > 0 && rbp->rbp_nbuffers > nbufs) {
+			rb = list_entry(rbp->rbp_bufs.next,
+					lnet_rtrbuf_t, rb_list);
+			list_move(&rb->rb_list, &rb_list);
+			rbp->rbp_credits--;
+			rbp->rbp_nbuffers--;
+		}
 		rbp->rbp_nbuffers = nbufs;
+		rbp->rbp_lowcredits = rbp->rbp_credits;
 		lnet_net_unlock(cpt);
+
+		while (!list_empty(&rb_list)) {
+			rb = list_entry(rb_list.next, lnet_rtrbuf_t, rb_list);
+			list_del(&rb->rb_list);
+			lnet_destroy_rtrbuf(rb, npages);
+		}
 		return 0;
 	}
 
-	INIT_LIST_HEAD(&rb_list);
-
 	/* allocate the buffers on a local list first.  If all buffers are
 	 * allocated successfully then join this list to the rbp buffer
 	 * list.  If not then free all allocated buffers. */
@@ -1417,6 +1441,7 @@ lnet_rtrpool_adjust_bufs(lnet_rtrbufpool_t *rbp, int nbufs, int cpt)
 	rbp->rbp_nbuffers += num_buffers;
 	rbp->rbp_credits += num_buffers;
 	rbp->rbp_mincredits = rbp->rbp_credits;
+	rbp->rbp_lowcredits = rbp->rbp_credits;
 	/* We need to schedule blocked msg using the newly
 	 * added buffers. */
 	while (!list_empty(&rbp->rbp_bufs) &&
@@ -1437,6 +1462,91 @@ failed:
 	return -ENOMEM;
 }
 
+static int
+lnet_rtrpool_adjust_bufs(lnet_rtrbufpool_t *rbp, int nbufs, int cpt)
+{
+	rbp->rbp_req_nbuffers = nbufs;
+	rbp->rbp_nidle = 0;
+
+	return lnet_rtrpool_resize_bufs(rbp, nbufs, cpt);
+}
+
+/* Grow a pool when messages blocked for its buffers during the last
+ * check interval, and shrink it back towards its configured size once it
+ * has kept a good part of its buffers idle for a while.  New buffers come
+ * from the pool's CPT, i.e. the NUMA node the messages are received on. */
+static void
+lnet_rtrpool_resize(lnet_rtrbufpool_t *rbp, int cpt)
+{
+	int	nmax = rbp->rbp_req_nbuffers * dynamic_router_buffers;
+	int	nbuffers;
+	int	low;
+	int	nbufs;
+
+	if (rbp->rbp_req_nbuffers == 0)
+		return;
+
+	lnet_net_lock(cpt);
+	nbuffers = rbp->rbp_nbuffers;
+	low = rbp->rbp_lowcredits;
+	rbp->rbp_lowcredits = rbp->rbp_credits;
+	lnet_net_unlock(cpt);
+
+	if (low < 0) {
+		/* cover the peak # blocked messages, with some headroom */
+		rbp->rbp_nidle = 0;
+		nbufs = min(nmax, nbuffers - low + nbuffers / 8);
+		if (nbufs <= nbuffers)
+			return;
+
+		CDEBUG(D_NET, "CPT %d: grow %d page router buffers %d->%d\n",
+		       cpt, rbp->rbp_npages, nbuffers, nbufs);
+		lnet_rtrpool_resize_bufs(rbp, nbufs, cpt);
+		return;
+	}
+
+	if (nbuffers <= rbp->rbp_req_nbuffers || low <= nbuffers / 4) {
+		rbp->rbp_nidle = 0;
+		return;
+	}
+
+	if (++rbp->rbp_nidle < LNET_NRB_IDLE_CHECKS)
+		return;
+
+	/* give back half of the buffers that stayed idle */
+	rbp->rbp_nidle = 0;
+	nbufs = max(rbp->rbp_req_nbuffers, nbuffers - low / 2);
+
+	CDEBUG(D_NET, "CPT %d: shrink %d page router buffers %d->%d\n",
+	       cpt, rbp->rbp_npages, nbuffers, nbufs);
+	lnet_rtrpool_resize_bufs(rbp, nbufs, cpt);
+}
+
+static void
+lnet_rtrpools_resize(void)
+{
+	lnet_rtrbufpool_t *rtrp;
+	int		  i;
+	int		  j;
+
+	if (dynamic_router_buffers <= 0 || !the_lnet.ln_routing)
+		return;
+
+	/* Serialise with buffer configuration.  The mutex is held while the
+	 * router checker is stopped, so just skip this round if it's busy */
+	if (!mutex_trylock(&the_lnet.ln_api_mutex))
+		return;
+
+	if (the_lnet.ln_routing && the_lnet.ln_rtrpools != NULL) {
+		cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
+			for (j = 0; j < LNET_NRBPOOLS; j++)
+				lnet_rtrpool_resize(&rtrp[j], i);
+		}
+	}
+
+	LNET_MUTEX_UNLOCK(&the_lnet.ln_api_mutex);
+}
+
 static void
 lnet_rtrpool_init(lnet_rtrbufpool_t *rbp, int npages)
 {
@@ -1446,6 +1556,9 @@ lnet_rtrpool_init(lnet_rtrbufpool_t *rbp, int npages)
         rbp->rbp_npages = npages;
         rbp->rbp_credits = 0;
         rbp->rbp_mincredits = 0;
+        rbp->rbp_req_nbuffers = 0;
+        rbp->rbp_lowcredits = 0;
+        rbp->rbp_nidle = 0;
 }
 
 void
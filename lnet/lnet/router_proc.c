@@ -332,7 +332,7 @@ proc_lnet_routers(struct ctl_table *table, int write, void __user *buffer,
                         lnet_nid_t nid = peer->lp_nid;
                         cfs_time_t now = cfs_time_current();
                         cfs_time_t deadline = peer->lp_ping_deadline;
-                        int nrefs     = peer->lp_refcount;
+                        int nrefs     = atomic_read(&peer->lp_refcount);
                         int nrtrrefs  = peer->lp_rtr_refcount;
                         int alive_cnt = peer->lp_alive_count;
                         int alive     = peer->lp_alive;
@@ -495,7 +495,7 @@ proc_lnet_peers(struct ctl_table *table, int write, void __user *buffer,
 
                 if (peer != NULL) {
                         lnet_nid_t nid       = peer->lp_nid;
-                        int        nrefs     = peer->lp_refcount;
+                        int        nrefs     = atomic_read(&peer->lp_refcount);
                         int        lastalive = -1;
                         char      *aliveness = "NA";
                         int        maxcr     = peer->lp_ni->ni_peertxcredits;
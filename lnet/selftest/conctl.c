@@ -667,7 +667,7 @@ lst_batch_info_ioctl(lstio_batch_info_args_t *args)
 }
 
 static int
-lst_stat_query_ioctl(lstio_stat_args_t *args)
+lst_stat_query_ioctl(lstio_stat_args_t *args, int transop)
 {
         int             rc;
 	char           *name = NULL;
@@ -684,9 +684,9 @@ lst_stat_query_ioctl(lstio_stat_args_t *args)
 			return -EINVAL;
 
 		rc = lstcon_nodes_stat(args->lstio_sta_count,
-                                       args->lstio_sta_idsp,
-                                       args->lstio_sta_timeout,
-                                       args->lstio_sta_resultp);
+				       args->lstio_sta_idsp, transop,
+				       args->lstio_sta_timeout,
+				       args->lstio_sta_resultp);
 	} else if (args->lstio_sta_namep != NULL) {
 		if (args->lstio_sta_nmlen <= 0 ||
 		    args->lstio_sta_nmlen > LST_NAME_SIZE)
@@ -699,7 +699,8 @@ lst_stat_query_ioctl(lstio_stat_args_t *args)
 		rc = copy_from_user(name, args->lstio_sta_namep,
 				    args->lstio_sta_nmlen);
 		if (rc == 0)
-			rc = lstcon_group_stat(name, args->lstio_sta_timeout,
+			rc = lstcon_group_stat(name, transop,
+					       args->lstio_sta_timeout,
 					       args->lstio_sta_resultp);
 		else
 			rc = -EFAULT;
@@ -910,7 +911,12 @@ lstcon_ioctl_entry(unsigned int cmd, struct libcfs_ioctl_hdr *hdr)
 		rc = lst_test_add_ioctl((lstio_test_args_t *)buf);
 		break;
 	case LSTIO_STAT_QUERY:
-		rc = lst_stat_query_ioctl((lstio_stat_args_t *)buf);
+		rc = lst_stat_query_ioctl((lstio_stat_args_t *)buf,
+					  LST_TRANS_STATQRY);
+		break;
+	case LSTIO_LAT_QUERY:
+		rc = lst_stat_query_ioctl((lstio_stat_args_t *)buf,
+					  LST_TRANS_LATQRY);
 		break;
 	default:
 		rc = -EINVAL;
@@ -1506,17 +1506,42 @@ lstcon_statrpc_readent(int transop, srpc_msg_t *msg,
 }
 
 static int
-lstcon_ndlist_stat(struct list_head *ndlist,
+lstcon_latrpc_readent(int transop, srpc_msg_t *msg,
+		      lstcon_rpc_ent_t __user *ent_up)
+{
+	srpc_lat_reply_t *rep = &msg->msg_body.lat_reply;
+
+	if (rep->lat_status != 0)
+		return 0;
+
+	if (copy_to_user(&ent_up->rpe_payload[0], &rep->lat_hist,
+			 sizeof(rep->lat_hist)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/* \a transop is LST_TRANS_STATQRY for counters or LST_TRANS_LATQRY for
+ * the RPC latency histogram */
+static int
+lstcon_ndlist_stat(struct list_head *ndlist, int transop,
 		   int timeout, struct list_head __user *result_up)
 {
 	struct list_head    head;
 	lstcon_rpc_trans_t *trans;
 	int		    rc;
 
+	LASSERT(transop == LST_TRANS_STATQRY || transop == LST_TRANS_LATQRY);
+
+	/* nodes without the feature don't provide the latency service */
+	if (transop == LST_TRANS_LATQRY &&
+	    (console_session.ses_features & LST_FEAT_LATENCY) == 0)
+		return -EOPNOTSUPP;
+
 	INIT_LIST_HEAD(&head);
 
         rc = lstcon_rpc_trans_ndlist(ndlist, &head,
-                                     LST_TRANS_STATQRY, NULL, NULL, &trans);
+                                     transop, NULL, NULL, &trans);
         if (rc != 0) {
                 CERROR("Can't create transaction: %d\n", rc);
                 return rc;
@@ -1524,15 +1549,17 @@ lstcon_ndlist_stat(struct list_head *ndlist,
 
         lstcon_rpc_trans_postwait(trans, LST_VALIDATE_TIMEOUT(timeout));
 
-        rc = lstcon_rpc_trans_interpreter(trans, result_up,
-                                          lstcon_statrpc_readent);
+	rc = lstcon_rpc_trans_interpreter(trans, result_up,
+					  transop == LST_TRANS_STATQRY ?
+					  lstcon_statrpc_readent :
+					  lstcon_latrpc_readent);
         lstcon_rpc_trans_destroy(trans);
 
         return rc;
 }
 
 int
-lstcon_group_stat(char *grp_name, int timeout,
+lstcon_group_stat(char *grp_name, int transop, int timeout,
 		  struct list_head __user *result_up)
 {
         lstcon_group_t     *grp;
@@ -1544,7 +1571,8 @@ lstcon_group_stat(char *grp_name, int timeout,
                 return rc;
         }
 
-        rc = lstcon_ndlist_stat(&grp->grp_ndl_list, timeout, result_up);
+	rc = lstcon_ndlist_stat(&grp->grp_ndl_list, transop, timeout,
+				result_up);
 
         lstcon_group_put(grp);
 
@@ -1553,7 +1581,7 @@ lstcon_group_stat(char *grp_name, int timeout,
 
 int
 lstcon_nodes_stat(int count, lnet_process_id_t __user *ids_up,
-		  int timeout, struct list_head __user *result_up)
+		  int transop, int timeout, struct list_head __user *result_up)
 {
         lstcon_ndlink_t         *ndl;
         lstcon_group_t          *tmp;
@@ -1588,7 +1616,8 @@ lstcon_nodes_stat(int count, lnet_process_id_t __user *ids_up,
                 return rc;
         }
 
-        rc = lstcon_ndlist_stat(&tmp->grp_ndl_list, timeout, result_up);
+	rc = lstcon_ndlist_stat(&tmp->grp_ndl_list, transop, timeout,
+				result_up);
 
         lstcon_group_put(tmp);
 
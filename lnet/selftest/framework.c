@@ -419,6 +419,63 @@ sfw_get_stats (srpc_stat_reqst_t *request, srpc_stat_reply_t *reply)
 	return 0;
 }
 
+static int
+sfw_get_latency(srpc_lat_reqst_t *request, srpc_lat_reply_t *reply)
+{
+	sfw_session_t	*sn = sfw_data.fw_session;
+	sfw_latency_t	*lat = &reply->lat_hist;
+	int		 i;
+
+	reply->lat_sid = (sn == NULL) ? LST_INVALID_SID : sn->sn_id;
+
+	if (request->lat_sid.ses_nid == LNET_NID_ANY) {
+		reply->lat_status = EINVAL;
+		return 0;
+	}
+
+	if (sn == NULL || !sfw_sid_equal(request->lat_sid, sn->sn_id)) {
+		reply->lat_status = ESRCH;
+		return 0;
+	}
+
+	lat->lat_max_usec = atomic_read(&sn->sn_lat_max);
+	for (i = 0; i < SFW_LAT_BUCKETS; i++)
+		lat->lat_buckets[i] = atomic_read(&sn->sn_lat_buckets[i]);
+
+	reply->lat_status = 0;
+	return 0;
+}
+
+/* add round-trip time of a completed test RPC to the session histogram */
+static void
+sfw_account_latency(sfw_session_t *sn, srpc_client_rpc_t *rpc)
+{
+	s64		usec;
+	int		max;
+	int		old;
+	int		i;
+
+	/* monotonic, so NTP or settimeofday() can't skew the histogram */
+	usec = ktime_us_delta(ktime_get(), rpc->crpc_started);
+	if (usec < 0)
+		usec = 0;
+	else if (usec > INT_MAX)
+		usec = INT_MAX;
+
+	i = usec == 0 ? 0 : fls(usec) - 1;
+	if (i >= SFW_LAT_BUCKETS)
+		i = SFW_LAT_BUCKETS - 1;
+	atomic_inc(&sn->sn_lat_buckets[i]);
+
+	max = atomic_read(&sn->sn_lat_max);
+	while (usec > max) {
+		old = atomic_cmpxchg(&sn->sn_lat_max, max, usec);
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
 int
 sfw_make_session(srpc_mksn_reqst_t *request, srpc_mksn_reply_t *reply)
 {
@@ -892,6 +949,9 @@ sfw_test_rpc_done (srpc_client_rpc_t *rpc)
 
         tsi->tsi_ops->tso_done_rpc(tsu, rpc);
 
+	if (rpc->crpc_status == 0)
+		sfw_account_latency(tsi->tsi_batch->bat_session, rpc);
+
 	spin_lock(&tsi->tsi_lock);
 
 	LASSERT(sfw_test_active(tsi));
@@ -994,6 +1054,7 @@ sfw_run_test (swi_workitem_t *wi)
 
 	spin_lock(&rpc->crpc_lock);
 	rpc->crpc_timeout = rpc_timeout;
+	rpc->crpc_started = ktime_get();
 	srpc_post_rpc(rpc);
 	spin_unlock(&rpc->crpc_lock);
 	return 0;
@@ -1320,6 +1381,11 @@ sfw_handle_server_rpc(struct srpc_server_rpc *rpc)
                                    &reply->msg_body.stat_reply);
                 break;
 
+	case SRPC_SERVICE_QUERY_LAT:
+		rc = sfw_get_latency(&request->msg_body.lat_reqst,
+				     &reply->msg_body.lat_reply);
+		break;
+
         case SRPC_SERVICE_DEBUG:
                 rc = sfw_debug_session(&request->msg_body.dbg_reqst,
                                        &reply->msg_body.dbg_reply);
@@ -1576,6 +1642,26 @@ sfw_unpack_message (srpc_msg_t *msg)
                 return;
         }
 
+	if (msg->msg_type == SRPC_MSG_LAT_REQST) {
+		srpc_lat_reqst_t *req = &msg->msg_body.lat_reqst;
+
+		__swab64s(&req->lat_rpyid);
+		sfw_unpack_sid(req->lat_sid);
+		return;
+	}
+
+	if (msg->msg_type == SRPC_MSG_LAT_REPLY) {
+		srpc_lat_reply_t *rep = &msg->msg_body.lat_reply;
+		int		  i;
+
+		__swab32s(&rep->lat_status);
+		sfw_unpack_sid(rep->lat_sid);
+		__swab32s(&rep->lat_hist.lat_max_usec);
+		for (i = 0; i < SFW_LAT_BUCKETS; i++)
+			__swab32s(&rep->lat_hist.lat_buckets[i]);
+		return;
+	}
+
         LBUG ();
         return;
 }
@@ -1621,6 +1707,11 @@ static srpc_service_t sfw_services[] =
                 /* sv_name */  "query stats",
                 0
         },
+	{
+		/* sv_id */    SRPC_SERVICE_QUERY_LAT,
+		/* sv_name */  "query latency",
+		0
+	},
         {
                 /* sv_id */    SRPC_SERVICE_MAKE_SESSION,
                 /* sv_name */  "make session",
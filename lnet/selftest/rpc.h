@@ -63,6 +63,8 @@ typedef enum {
         SRPC_MSG_PING_REPLY     = 15,
         SRPC_MSG_JOIN_REQST     = 16,
         SRPC_MSG_JOIN_REPLY     = 17,
+	SRPC_MSG_LAT_REQST	= 18,
+	SRPC_MSG_LAT_REPLY	= 19,
 } srpc_msg_type_t;
 
 /* CAVEAT EMPTOR:
@@ -168,6 +170,17 @@ typedef struct {
         lnet_counters_t         str_lnet;
 } WIRE_ATTR srpc_stat_reply_t;
 
+typedef struct {
+	__u64			lat_rpyid;	/* reply buffer matchbits */
+	lst_sid_t		lat_sid;	/* session id */
+} WIRE_ATTR srpc_lat_reqst_t;
+
+typedef struct {
+	__u32			lat_status;
+	lst_sid_t		lat_sid;
+	sfw_latency_t		lat_hist;
+} WIRE_ATTR srpc_lat_reply_t;
+
 typedef struct {
         __u32                   blk_opc;        /* bulk operation code */
         __u32                   blk_npg;        /* # of pages */
@@ -270,6 +283,8 @@ typedef struct srpc_msg {
                 srpc_batch_reply_t   bat_reply;
                 srpc_stat_reqst_t    stat_reqst;
                 srpc_stat_reply_t    stat_reply;
+		srpc_lat_reqst_t     lat_reqst;
+		srpc_lat_reply_t     lat_reply;
                 srpc_test_reqst_t    tes_reqst;
                 srpc_test_reply_t    tes_reply;
                 srpc_join_reqst_t    join_reqst;
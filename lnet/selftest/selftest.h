@@ -82,6 +82,7 @@ struct sfw_test_instance;
 #define SRPC_SERVICE_TEST               4
 #define SRPC_SERVICE_QUERY_STAT         5
 #define SRPC_SERVICE_JOIN               6
+#define SRPC_SERVICE_QUERY_LAT		7
 #define SRPC_FRAMEWORK_SERVICE_MAX_ID   10
 /* other services start from SRPC_FRAMEWORK_SERVICE_MAX_ID+1 */
 #define SRPC_SERVICE_BRW                11
@@ -126,6 +127,9 @@ srpc_service2request (int service)
 
         case SRPC_SERVICE_JOIN:
                 return SRPC_MSG_JOIN_REQST;
+
+	case SRPC_SERVICE_QUERY_LAT:
+		return SRPC_MSG_LAT_REQST;
         }
 }
 
@@ -220,6 +224,8 @@ typedef struct srpc_client_rpc {
         /* state flags */
         unsigned int         crpc_aborted:1; /* being given up */
         unsigned int         crpc_closed:1;  /* completed */
+	/* when a test RPC was posted, monotonic */
+	ktime_t			crpc_started;
 
         /* RPC events */
         srpc_event_t         crpc_bulkev;    /* bulk event */
@@ -338,6 +344,9 @@ typedef struct {
 	atomic_t		sn_brw_errors;
 	atomic_t		sn_ping_errors;
 	cfs_time_t		sn_started;
+	/* test RPC latency, see sfw_latency_t */
+	atomic_t		sn_lat_max;
+	atomic_t		sn_lat_buckets[SFW_LAT_BUCKETS];
 } sfw_session_t;
 
 #define sfw_sid_equal(sid0, sid1)     ((sid0).ses_nid == (sid1).ses_nid && \
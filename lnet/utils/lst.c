@@ -52,8 +52,10 @@ lst_sid_t LST_INVALID_SID = {LNET_NID_ANY, -1};
 static lst_sid_t           session_id;
 static int                 session_key;
 
-/* All nodes running 2.6.50 or later understand feature LST_FEAT_BULK_LEN */
-static unsigned		session_features = LST_FEATS_MASK;
+/* All nodes running 2.6.50 or later understand feature LST_FEAT_BULK_LEN,
+ * LST_FEAT_LATENCY needs nodes providing the latency query service and is
+ * only asked for by "new_session --latency" */
+static unsigned		session_features = LST_FEATS_DEFAULT;
 static lstcon_trans_stat_t	trans_stat;
 
 typedef struct list_string {
@@ -541,6 +543,7 @@ jt_lst_new_session(int argc,  char **argv)
         {
                 {"timeout", required_argument,  0, 't' },
                 {"force",   no_argument,        0, 'f' },
+		{"latency", no_argument,	0, 'l' },
                 {0,         0,                  0,  0  }
         };
 
@@ -552,8 +555,8 @@ jt_lst_new_session(int argc,  char **argv)
 
         while (1) {
 
-                c = getopt_long(argc, argv, "ft:",
-                                session_opts, &optidx);
+		c = getopt_long(argc, argv, "flt:",
+				session_opts, &optidx);
 
                 if (c == -1)
                         break;
@@ -565,6 +568,9 @@ jt_lst_new_session(int argc,  char **argv)
                 case 't':
                         timeout = atoi(optarg);
                         break;
+		case 'l':
+			session_features |= LST_FEAT_LATENCY;
+			break;
                 default:
                         lst_print_usage(argv[0]);
                         return -1;
@@ -1486,8 +1492,8 @@ jt_lst_list_group(int argc, char **argv)
 }
 
 int
-lst_stat_ioctl (char *name, int count, lnet_process_id_t *idsp,
-		int timeout, struct list_head *resultp)
+lst_stat_ioctl(unsigned int opc, char *name, int count,
+	       lnet_process_id_t *idsp, int timeout, struct list_head *resultp)
 {
         lstio_stat_args_t args = {0};
 
@@ -1499,7 +1505,7 @@ lst_stat_ioctl (char *name, int count, lnet_process_id_t *idsp,
         args.lstio_sta_idsp    = idsp;
         args.lstio_sta_resultp = resultp;
 
-        return lst_ioctl (LSTIO_STAT_QUERY, &args, sizeof(args));
+	return lst_ioctl(opc, &args, sizeof(args));
 }
 
 typedef struct {
@@ -1525,7 +1531,8 @@ lst_stat_req_param_free(lst_stat_req_param_t *srp)
 }
 
 static int
-lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
+lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp,
+			 int nob, int save_old)
 {
         lst_stat_req_param_t *srp = NULL;
         int                   count = save_old ? 2 : 1;
@@ -1559,10 +1566,8 @@ lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
         srp->srp_name = name;
 
         for (i = 0; i < count; i++) {
-                rc = lst_alloc_rpcent(&srp->srp_result[i], srp->srp_count,
-                                      sizeof(sfw_counters_t)  +
-                                      sizeof(srpc_counters_t) +
-                                      sizeof(lnet_counters_t));
+		rc = lst_alloc_rpcent(&srp->srp_result[i], srp->srp_count,
+				      nob);
                 if (rc != 0) {
                         fprintf(stderr, "Out of memory\n");
                         break;
@@ -1866,6 +1871,122 @@ lst_print_stat(char *name, struct list_head *resultp,
         lst_print_lnet_stat(name, bwrt, rdwr, type);
 }
 
+#define LST_STAT_COUNTERS_NOB	(sizeof(sfw_counters_t)  + \
+				 sizeof(srpc_counters_t) + \
+				 sizeof(lnet_counters_t))
+
+#define LST_FMT_TEXT	0
+#define LST_FMT_CSV	1
+#define LST_FMT_JSON	2
+
+/* usecs at \a pct percent of \a lat, interpolated within the bucket */
+static double
+lst_latency_percentile(sfw_latency_t *lat, __u64 total, double pct)
+{
+	double	target = total * pct / 100;
+	double	lo;
+	double	hi;
+	__u64	sum = 0;
+	int	i;
+
+	for (i = 0; i < SFW_LAT_BUCKETS; i++) {
+		if (lat->lat_buckets[i] == 0 ||
+		    sum + lat->lat_buckets[i] < target) {
+			sum += lat->lat_buckets[i];
+			continue;
+		}
+
+		lo = i == 0 ? 0 : (double)(1ULL << i);
+		hi = (double)(1ULL << (i + 1));
+		lo += (hi - lo) * (target - sum) / lat->lat_buckets[i];
+		return lo < lat->lat_max_usec ? lo : lat->lat_max_usec;
+	}
+
+	return lat->lat_max_usec;
+}
+
+static void
+lst_print_latency(char *name, struct list_head *result, int format)
+{
+	static int	   csv_header;
+	lstcon_rpc_ent_t  *ent;
+	sfw_latency_t	  *lat;
+	sfw_latency_t	   sum;
+	__u64		   total = 0;
+	int		   errcount = 0;
+	int		   i;
+
+	memset(&sum, 0, sizeof(sum));
+
+	list_for_each_entry(ent, result, rpe_link) {
+		if (ent->rpe_peer.nid == LNET_NID_ANY)
+			continue;
+
+		if (ent->rpe_rpc_errno != 0 || ent->rpe_fwk_errno != 0) {
+			errcount++;
+			continue;
+		}
+
+		lat = (sfw_latency_t *)&ent->rpe_payload[0];
+		if (lat->lat_max_usec > sum.lat_max_usec)
+			sum.lat_max_usec = lat->lat_max_usec;
+		for (i = 0; i < SFW_LAT_BUCKETS; i++) {
+			sum.lat_buckets[i] += lat->lat_buckets[i];
+			total += lat->lat_buckets[i];
+		}
+	}
+
+	if (errcount > 0)
+		fprintf(stderr, "Failed to stat on %d nodes\n", errcount);
+
+	switch (format) {
+	default:
+		fprintf(stdout, "[RPC Latency of %s]\n", name);
+		if (total == 0) {
+			fprintf(stdout, "No RPCs completed\n");
+			break;
+		}
+		fprintf(stdout, "RPCs: "LPU64" p50: %.0f us p99: %.0f us "
+			"p99.9: %.0f us max: %u us\n", total,
+			lst_latency_percentile(&sum, total, 50),
+			lst_latency_percentile(&sum, total, 99),
+			lst_latency_percentile(&sum, total, 99.9),
+			sum.lat_max_usec);
+		break;
+
+	case LST_FMT_CSV:
+		if (!csv_header) {
+			csv_header = 1;
+			fprintf(stdout,
+				"group,rpcs,p50_us,p99_us,p99.9_us,max_us\n");
+		}
+		fprintf(stdout, "%s,"LPU64",%.0f,%.0f,%.0f,%u\n", name, total,
+			lst_latency_percentile(&sum, total, 50),
+			lst_latency_percentile(&sum, total, 99),
+			lst_latency_percentile(&sum, total, 99.9),
+			sum.lat_max_usec);
+		break;
+
+	case LST_FMT_JSON:
+		/* one object per line */
+		fprintf(stdout, "{\"group\": \"%s\", \"rpcs\": "LPU64", "
+			"\"p50_us\": %.0f, \"p99_us\": %.0f, "
+			"\"p99.9_us\": %.0f, \"max_us\": %u, \"buckets\": [",
+			name, total,
+			lst_latency_percentile(&sum, total, 50),
+			lst_latency_percentile(&sum, total, 99),
+			lst_latency_percentile(&sum, total, 99.9),
+			sum.lat_max_usec);
+		for (i = 0; i < SFW_LAT_BUCKETS; i++)
+			fprintf(stdout, i == 0 ? "%u" : ", %u",
+				sum.lat_buckets[i]);
+		fprintf(stdout, "]}\n");
+		break;
+	}
+
+	fflush(stdout);
+}
+
 int
 jt_lst_stat(int argc, char **argv)
 {
@@ -1881,6 +2002,8 @@ jt_lst_stat(int argc, char **argv)
         int                   rdwr    = 0;
         int                   type    = -1;
         int                   idx     = 0;
+	int		      latency = 0;
+	int		      format  = LST_FMT_TEXT;
         int                   rc;
         int                   c;
 
@@ -1898,6 +2021,8 @@ jt_lst_stat(int argc, char **argv)
 		{"avg"	     , no_argument,	 0, 'g' },
 		{"min"	     , no_argument,	 0, 'n' },
 		{"max"	     , no_argument,	 0, 'x' },
+		{"latency"   , no_argument,	 0, 'L' },
+		{"format"    , required_argument, 0, 'f' },
 		{0,	       0,		 0,  0  }
         };
 
@@ -1908,7 +2033,8 @@ jt_lst_stat(int argc, char **argv)
         }
 
         while (1) {
-		c = getopt_long(argc, argv, "t:d:lcbarwgnx", stat_opts, &optidx);
+		c = getopt_long(argc, argv, "t:d:lcbarwgnxLf:", stat_opts,
+				&optidx);
 
                 if (c == -1)
                         break;
@@ -1962,6 +2088,21 @@ jt_lst_stat(int argc, char **argv)
                         }
                         type |= 4;
                         break;
+		case 'L':
+			latency = 1;
+			break;
+		case 'f':
+			if (strcmp(optarg, "text") == 0) {
+				format = LST_FMT_TEXT;
+			} else if (strcmp(optarg, "csv") == 0) {
+				format = LST_FMT_CSV;
+			} else if (strcmp(optarg, "json") == 0) {
+				format = LST_FMT_JSON;
+			} else {
+				fprintf(stderr, "Unknown format %s\n", optarg);
+				return -1;
+			}
+			break;
 
                 default:
                         lst_print_usage(argv[0]);
@@ -1984,14 +2125,16 @@ jt_lst_stat(int argc, char **argv)
             return -1;
         }
 
-        /* extra count to get first data point */
-        if (count != -1)
-            count++;
+	/* extra count to get first data point, latency is cumulative */
+	if (count != -1 && !latency)
+		count++;
 
 	INIT_LIST_HEAD(&head);
 
         while (optind < argc) {
-                rc = lst_stat_req_param_alloc(argv[optind++], &srp, 1);
+		rc = lst_stat_req_param_alloc(argv[optind++], &srp,
+					      latency ? sizeof(sfw_latency_t) :
+					      LST_STAT_COUNTERS_NOB, !latency);
                 if (rc != 0)
                         goto out;
 
@@ -2008,22 +2151,38 @@ jt_lst_stat(int argc, char **argv)
 		last = now;
 
 		list_for_each_entry(srp, &head, srp_link) {
-                        rc = lst_stat_ioctl(srp->srp_name,
-                                            srp->srp_count, srp->srp_ids,
-                                            timeout, &srp->srp_result[idx]);
+			rc = lst_stat_ioctl(latency ? LSTIO_LAT_QUERY :
+						      LSTIO_STAT_QUERY,
+					    srp->srp_name,
+					    srp->srp_count, srp->srp_ids,
+					    timeout, &srp->srp_result[idx]);
                         if (rc == -1) {
+				int err = errno;
+
                                 lst_print_error("stat", "Failed to stat %s: %s\n",
-                                                srp->srp_name, strerror(errno));
+                                                srp->srp_name, strerror(err));
+				if (latency && err == EOPNOTSUPP)
+					fprintf(stderr, "Latency needs a "
+						"session created with "
+						"\"new_session --latency\"\n");
                                 goto out;
                         }
 
+			if (latency) {
+				lst_print_latency(srp->srp_name,
+						  &srp->srp_result[0], format);
+				lst_reset_rpcent(&srp->srp_result[0]);
+				continue;
+			}
+
 			lst_print_stat(srp->srp_name, srp->srp_result,
 				       idx, lnet, bwrt, rdwr, type);
 
                         lst_reset_rpcent(&srp->srp_result[1 - idx]);
                 }
 
-                idx = 1 - idx;
+		if (!latency)
+			idx = 1 - idx;
 
                 if (count > 0)
                         count--;
@@ -2091,7 +2250,8 @@ jt_lst_show_error(int argc, char **argv)
 	INIT_LIST_HEAD(&head);
 
         while (optind < argc) {
-                rc = lst_stat_req_param_alloc(argv[optind++], &srp, 0);
+		rc = lst_stat_req_param_alloc(argv[optind++], &srp,
+					      LST_STAT_COUNTERS_NOB, 0);
                 if (rc != 0)
                         goto out;
 
@@ -2099,8 +2259,9 @@ jt_lst_show_error(int argc, char **argv)
         }
 
 	list_for_each_entry(srp, &head, srp_link) {
-                rc = lst_stat_ioctl(srp->srp_name, srp->srp_count,
-                                    srp->srp_ids, 10, &srp->srp_result[0]);
+		rc = lst_stat_ioctl(LSTIO_STAT_QUERY, srp->srp_name,
+				    srp->srp_count, srp->srp_ids, 10,
+				    &srp->srp_result[0]);
 
                 if (rc == -1) {
                         lst_print_error(srp->srp_name, "Failed to show errors of %s: %s\n",
@@ -3224,7 +3385,7 @@ out:
 
 static command_t lst_cmdlist[] = {
 	{"new_session",		jt_lst_new_session,	NULL,
-         "Usage: lst new_session [--timeout TIME] [--force] [NAME]"	                },
+	 "Usage: lst new_session [--timeout TIME] [--force] [--latency] [NAME]"},
 	{"end_session",		jt_lst_end_session,	NULL,
          "Usage: lst end_session"	                                                },
         {"show_session",        jt_lst_show_session,    NULL,
@@ -3241,6 +3402,7 @@ static command_t lst_cmdlist[] = {
           "Usage: lst list_group [--active] [--busy] [--down] [--unknown] GROUP ..."    },
 	{"stat",                jt_lst_stat,            NULL,
 	 "Usage: lst stat [--bw] [--rate] [--read] [--write] [--max] [--min] [--avg] "
+	 " [--latency [--format text|csv|json]]"
 	 " [--timeout #] [--delay #] [--count #] GROUP [GROUP]"                         },
         {"show_error",          jt_lst_show_error,      NULL,
          "Usage: lst show_error NAME | IDS ..."                                         },
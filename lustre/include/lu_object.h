@@ -564,8 +564,21 @@ struct lu_site_bkt_data {
 	 */
 	long			lsb_lru_len;
 	/**
-	 * LRU list, updated on each access to object. Protected by
-	 * bucket lock of lu_site::ls_obj_hash.
+	 * number of unreferenced objects cached in this bucket. The LRU
+	 * list may also hold referenced objects, so this, not lsb_lru_len,
+	 * is what the busy statistics and the shrinker count rely on.
+	 * Incremented by lu_object_put() under the bucket write lock and
+	 * decremented by the lookup taking the first reference, which may
+	 * only hold the bucket lock shared.
+	 */
+	atomic_t		lsb_idle;
+	/**
+	 * LRU list, updated when the last reference to an object is
+	 * released. Protected by bucket lock of lu_site::ls_obj_hash.
+	 *
+	 * Lookup holds the bucket lock shared and leaves a found object on
+	 * the list, so the list may contain referenced objects, these are
+	 * removed lazily by lu_site_purge().
 	 *
 	 * "Cold" end of LRU is lu_site::ls_lru.next. Accessed object are
 	 * moved to the lu_site::ls_lru.prev (this is due to the non-existence
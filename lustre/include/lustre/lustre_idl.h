@@ -1347,6 +1347,8 @@ extern void lustre_swab_ptlrpc_body(struct ptlrpc_body *pb);
 #define OBD_CONNECT_OPEN_BY_FID	0x20000000000000ULL /* open by fid won't pack
 						       name in request */
 #define OBD_CONNECT_LFSCK      0x40000000000000ULL/* support online LFSCK */
+#define OBD_CONNECT_DQACQ_BATCH 0x80000000000000ULL /* many quota_body per
+						     * QUOTA_DQACQ RPC */
 #define OBD_CONNECT_UNLINK_CLOSE 0x100000000000000ULL/* close file in unlink */
 #define OBD_CONNECT_DIR_STRIPE	 0x400000000000000ULL /* striped DNE dir */
 
@@ -1395,7 +1397,8 @@ extern void lustre_swab_ptlrpc_body(struct ptlrpc_body *pb);
 				OBD_CONNECT_FLOCK_DEAD | \
 				OBD_CONNECT_DISP_STRIPE | OBD_CONNECT_LFSCK | \
 				OBD_CONNECT_OPEN_BY_FID | \
-				OBD_CONNECT_DIR_STRIPE)
+				OBD_CONNECT_DIR_STRIPE | \
+				OBD_CONNECT_DQACQ_BATCH)
 
 #define OST_CONNECT_SUPPORTED  (OBD_CONNECT_SRVLOCK | OBD_CONNECT_GRANT | \
                                 OBD_CONNECT_REQPORTAL | OBD_CONNECT_VERSION | \
@@ -1504,6 +1507,7 @@ typedef enum {
         OBD_CKSUM_CRC32 = 0x00000001,
         OBD_CKSUM_ADLER = 0x00000002,
         OBD_CKSUM_CRC32C= 0x00000004,
+        OBD_CKSUM_T10CRC= 0x00000008, /* T10-DIF CRC per 512-byte sector */
 } cksum_type_t;
 
 /*
@@ -1550,7 +1554,7 @@ enum obdo_flags {
         OBD_FL_CKSUM_CRC32  = 0x00001000, /* CRC32 checksum type */
         OBD_FL_CKSUM_ADLER  = 0x00002000, /* ADLER checksum type */
         OBD_FL_CKSUM_CRC32C = 0x00004000, /* CRC32C checksum type */
-        OBD_FL_CKSUM_RSVD2  = 0x00008000, /* for future cksum types */
+        OBD_FL_CKSUM_T10CRC = 0x00008000, /* T10-DIF sector CRC cksum type */
         OBD_FL_CKSUM_RSVD3  = 0x00010000, /* for future cksum types */
         OBD_FL_SHRINK_GRANT = 0x00020000, /* object shrink the grant */
         OBD_FL_MMAP         = 0x00040000, /* object is mmapped on the client.
@@ -1564,7 +1568,7 @@ enum obdo_flags {
         /* Note that while these checksum values are currently separate bits,
          * in 2.x we can actually allow all values from 1-31 if we wanted. */
         OBD_FL_CKSUM_ALL    = OBD_FL_CKSUM_CRC32 | OBD_FL_CKSUM_ADLER |
-                              OBD_FL_CKSUM_CRC32C,
+                              OBD_FL_CKSUM_CRC32C | OBD_FL_CKSUM_T10CRC,
 
         /* mask for local-only flag, which won't be sent over network */
         OBD_FL_LOCAL_MASK   = 0xF0000000,
@@ -2028,6 +2032,9 @@ struct quota_body {
 /* qb_usage is the current qunit (in kbytes/inodes) when quota_body is used in
  * quota reply */
 #define qb_qunit	qb_usage
+/* qb_padding is the status of each quota_body in the reply of a QUOTA_DQACQ
+ * carrying several quota_body (OBD_CONNECT_DQACQ_BATCH) */
+#define qb_rc		qb_padding
 
 #define QUOTA_DQACQ_FL_ACQ	0x1  /* acquire quota */
 #define QUOTA_DQACQ_FL_PREACQ	0x2  /* pre-acquire */
@@ -187,10 +187,14 @@ unsigned int ll_crypto_tfm_alg_min_keysize(struct crypto_blkcipher *tfm)
 
 #ifdef HAVE_BVEC_ITER
 #define bio_idx(bio)			(bio->bi_iter.bi_idx)
+#define bio_start_sector(bio)		(bio->bi_iter.bi_sector)
 #define bio_set_sector(bio, sector)	(bio->bi_iter.bi_sector = sector)
+#define bip_set_sector(bip, sector)	(bip->bip_iter.bi_sector = sector)
 #else
 #define bio_idx(bio)			(bio->bi_idx)
+#define bio_start_sector(bio)		(bio->bi_sector)
 #define bio_set_sector(bio, sector)	(bio->bi_sector = sector)
+#define bip_set_sector(bip, sector)	(bip->bip_sector = sector)
 #define bio_sectors(bio)		((bio)->bi_size >> 9)
 #ifndef HAVE_BIO_END_SECTOR
 #define bio_end_sector(bio)		(bio->bi_sector + bio_sectors(bio))
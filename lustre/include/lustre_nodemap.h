@@ -47,6 +47,8 @@ enum nodemap_tree_type {
 	NODEMAP_CLIENT_TO_FS,
 };
 
+struct nm_idmap_array;
+
 /** The nodemap id 0 will be the default nodemap. It will have a configuration
  * set by the MGS, but no ranges will be allowed as all NIDs that do not map
  * will be added to the default nodemap
@@ -81,6 +83,9 @@ struct lu_nodemap {
 	struct rb_root		nm_fs_to_client_gidmap;
 	/* GID map keyed by remote UID */
 	struct rb_root		nm_client_to_fs_gidmap;
+	/* sorted snapshots of the idmap trees for lockless lookups,
+	 * indexed by nodemap_id_type and nodemap_tree_type */
+	struct nm_idmap_array	*nm_idmaps[2][2];
 	/* proc directory entry */
 	struct proc_dir_entry	*nm_proc_entry;
 	/* attached client members of this nodemap */
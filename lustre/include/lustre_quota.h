@@ -202,6 +202,10 @@ struct lquota_id_info {
 	 * be negative when releasing space.  */
 	long long		 lqi_space;
 
+	/* part of lqi_space consumed from the per-CPU partition
+	 * reservation of the quota slave entry */
+	long long		 lqi_pcpt_space;
+
 	/* quota slave entry structure associated with this ID */
 	struct lquota_entry	*lqi_qentry;
 
@@ -480,6 +480,8 @@ struct niobuf_local {
 	__u32		lnb_flags;
 	struct page	*lnb_page;
 	void		*lnb_data;
+	/* T10-DIF guard tags of the page verified by the target, if any */
+	__be16		*lnb_guards;
 	int		lnb_rc;
 };
 
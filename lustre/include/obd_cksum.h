@@ -39,6 +39,12 @@
 #include <libcfs/libcfs.h>
 #include <libcfs/libcfs_crypto.h>
 #include <lustre/lustre_idl.h>
+#include <linux/crc-t10dif.h>
+
+/* T10-DIF guard tags are computed over 512-byte sectors, independently of
+ * the block size of the device the data is finally written to. */
+#define OBD_T10_SECTOR_SHIFT	9
+#define OBD_T10_SECTOR_SIZE	(1 << OBD_T10_SECTOR_SHIFT)
 
 static inline unsigned char cksum_obd2cfs(cksum_type_t cksum_type)
 {
@@ -46,6 +52,8 @@ static inline unsigned char cksum_obd2cfs(cksum_type_t cksum_type)
 	case OBD_CKSUM_CRC32:
 		return CFS_HASH_ALG_CRC32;
 	case OBD_CKSUM_ADLER:
+	/* the RPC checksum for T10CRC is the adler32 of the guard tags */
+	case OBD_CKSUM_T10CRC:
 		return CFS_HASH_ALG_ADLER32;
 	case OBD_CKSUM_CRC32C:
 		return CFS_HASH_ALG_CRC32C;
@@ -66,12 +74,19 @@ static inline unsigned char cksum_obd2cfs(cksum_type_t cksum_type)
  * In case of an unsupported types/flags we fall back to ADLER
  * because that is supported by all clients since 1.8
  *
- * In case multiple algorithms are supported the best one is used. */
+ * In case multiple algorithms are supported the best one is used.
+ *
+ * OBD_CKSUM_T10CRC is never picked from a mask, since it is only worthwhile
+ * when the OST can pass the guard tags down to integrity capable storage.
+ * It has to be selected explicitly via the osc "checksum_type" tunable. */
 static inline u32 cksum_type_pack(cksum_type_t cksum_type)
 {
 	unsigned int    performance = 0, tmp;
 	u32		flag = OBD_FL_CKSUM_ADLER;
 
+	if (cksum_type == OBD_CKSUM_T10CRC)
+		return OBD_FL_CKSUM_T10CRC;
+
 	if (cksum_type & OBD_CKSUM_CRC32) {
 		tmp = cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32));
 		if (tmp > performance) {
@@ -95,7 +110,8 @@ static inline u32 cksum_type_pack(cksum_type_t cksum_type)
 	}
 	if (unlikely(cksum_type && !(cksum_type & (OBD_CKSUM_CRC32C |
 						   OBD_CKSUM_CRC32 |
-						   OBD_CKSUM_ADLER))))
+						   OBD_CKSUM_ADLER |
+						   OBD_CKSUM_T10CRC))))
 		CWARN("unknown cksum type %x\n", cksum_type);
 
 	return flag;
@@ -108,6 +124,8 @@ static inline cksum_type_t cksum_type_unpack(u32 o_flags)
 		return OBD_CKSUM_CRC32C;
 	case OBD_FL_CKSUM_CRC32:
 		return OBD_CKSUM_CRC32;
+	case OBD_FL_CKSUM_T10CRC:
+		return OBD_CKSUM_T10CRC;
 	default:
 		break;
 	}
@@ -132,6 +150,7 @@ static inline cksum_type_t cksum_types_supported_client(void)
 		ret |= OBD_CKSUM_CRC32C;
 	if (cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32)) > 0)
 		ret |= OBD_CKSUM_CRC32;
+	ret |= OBD_CKSUM_T10CRC;
 
 	return ret;
 }
@@ -155,6 +174,9 @@ static inline cksum_type_t cksum_types_supported_server(void)
 	if (cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32)) >=
 	    base_speed)
 		ret |= OBD_CKSUM_CRC32;
+	/* guard tags are checked on the OST even without integrity capable
+	 * storage, so advertise T10CRC unconditionally */
+	ret |= OBD_CKSUM_T10CRC;
 
 	return ret;
 }
@@ -174,6 +196,59 @@ static inline cksum_type_t cksum_type_select(cksum_type_t cksum_types)
 
 /* Checksum algorithm names. Must be defined in the same order as the
  * OBD_CKSUM_* flags. */
-#define DECLARE_CKSUM_NAME char *cksum_name[] = {"crc32", "adler", "crc32c"}
+#define DECLARE_CKSUM_NAME char *cksum_name[] = {"crc32", "adler", "crc32c", \
+						"t10crc"}
+
+/* Number of T10-DIF guard tags covering \a len bytes of a page. */
+static inline unsigned int obd_t10_guard_count(unsigned int len)
+{
+	return (len + OBD_T10_SECTOR_SIZE - 1) >> OBD_T10_SECTOR_SHIFT;
+}
+
+/* Compute the big-endian T10-DIF guard tag of each 512-byte sector in the
+ * page fragment [\a off, \a off + \a len), return the number of tags. */
+static inline unsigned int obd_t10_page_guards(struct page *page,
+					       unsigned int off,
+					       unsigned int len,
+					       __be16 *guards)
+{
+	unsigned char	*addr = kmap(page) + off;
+	unsigned int	 i;
+	unsigned int	 n = 0;
+
+	for (i = 0; i < len; i += OBD_T10_SECTOR_SIZE)
+		guards[n++] = cpu_to_be16(crc_t10dif(addr + i,
+					min_t(unsigned int, len - i,
+					      OBD_T10_SECTOR_SIZE)));
+	kunmap(page);
+
+	return n;
+}
+
+/* Compute the guard tags of all the pages returned by \a get into
+ * \a guards and return the RPC checksum, the adler32 of the tags. */
+static inline int obd_t10_guards_cksum(cfs_crypto_page_get_t get, void *data,
+				       unsigned int npages, __be16 *guards,
+				       unsigned int nguards, __u32 *cksum)
+{
+	unsigned int	bufsize = sizeof(*cksum);
+	unsigned int	n = 0;
+	unsigned int	i;
+
+	for (i = 0; i < npages; i++) {
+		struct page	*page;
+		unsigned int	 off;
+		unsigned int	 len;
+
+		get(data, i, &page, &off, &len);
+		if (n + obd_t10_guard_count(len) > nguards)
+			return -EOVERFLOW;
+		n += obd_t10_page_guards(page, off, len, guards + n);
+	}
+
+	return cfs_crypto_hash_digest(CFS_HASH_ALG_ADLER32, guards,
+				      n * sizeof(*guards), NULL, 0,
+				      (unsigned char *)cksum, &bufsize);
+}
 
 #endif /* __OBD_H */
@@ -39,6 +39,11 @@
 
 #include "lfsck_internal.h"
 
+static int lfsck_oit_threads;
+CFS_MODULE_PARM(lfsck_oit_threads, "i", int, 0644,
+		"threads to handle the objects found by the otable-based "
+		"iteration, 0 means the master engine handles them by itself");
+
 int lfsck_unpack_ent(struct lu_dirent *ent, __u64 *cookie, __u16 *type)
 {
 	struct luda_type	*lt;
@@ -581,6 +586,8 @@ static int lfsck_exec_oit(const struct lu_env *env,
 
 	LASSERT(lfsck->li_obj_dir == NULL);
 
+	lfsck_env_info(env)->lti_oit_cookie =
+				lfsck->li_pos_current.lp_oit_cookie;
 	list_for_each_entry(com, &lfsck->li_list_scan, lc_link) {
 		rc = com->lc_ops->lfsck_exec_oit(env, com, obj);
 		if (rc != 0)
@@ -821,6 +828,457 @@ checkpoint:
 	RETURN(rc);
 }
 
+/**
+ * Handle the object found by the otable-based iteration in the OIT worker.
+ *
+ * It does the same as the master engine does for the object when there is
+ * no OIT worker, except that the directory to be traversed is not opened
+ * here but recorded in @lor for the master engine.
+ *
+ * \param[in] env	pointer to the thread context
+ * \param[in] lfsck	pointer to the lfsck instance
+ * \param[in] lor	pointer to the lfsck_oit_req to be handled
+ *
+ * \retval		0 for success
+ * \retval		negative error number on failure
+ */
+static int lfsck_oit_worker_exec(const struct lu_env *env,
+				 struct lfsck_instance *lfsck,
+				 struct lfsck_oit_req *lor)
+{
+	struct lfsck_component	*com;
+	struct dt_object	*target;
+	int			 rc	= 0;
+	ENTRY;
+
+	lfsck_env_info(env)->lti_oit_cookie = lor->lor_cookie;
+	target = lfsck_object_find_bottom(env, lfsck, &lor->lor_fid);
+	if (IS_ERR(target)) {
+		rc = PTR_ERR(target);
+		CDEBUG(D_LFSCK, "%s: OIT worker failed at find target "DFID
+		       ", cookie "LPU64": rc = %d\n", lfsck_lfsck2name(lfsck),
+		       PFID(&lor->lor_fid), lor->lor_cookie, rc);
+		lfsck_fail(env, lfsck, true);
+
+		RETURN(rc);
+	}
+
+	if (!dt_object_exists(target))
+		GOTO(out, rc = 0);
+
+	if (lor->lor_update_lma) {
+		rc = lfsck_update_lma(env, lfsck, target);
+		if (rc != 0) {
+			CDEBUG(D_LFSCK, "%s: fail to update LMA for "DFID
+			       ": rc = %d\n", lfsck_lfsck2name(lfsck),
+			       PFID(lfsck_dto2fid(target)), rc);
+
+			GOTO(out, rc);
+		}
+	}
+
+	list_for_each_entry(com, &lfsck->li_list_scan, lc_link) {
+		rc = com->lc_ops->lfsck_exec_oit(env, com, target);
+		if (rc != 0)
+			GOTO(out, rc);
+	}
+
+	rc = lfsck_needs_scan_dir(env, lfsck, target);
+	if (rc > 0) {
+		lor->lor_dir = lfsck_object_get(target);
+		rc = 0;
+	} else if (rc < 0) {
+		lfsck_fail(env, lfsck, false);
+	}
+
+	GOTO(out, rc);
+
+out:
+	lfsck_object_put(env, target);
+
+	return rc;
+}
+
+static int lfsck_oit_worker(void *args)
+{
+	struct lfsck_thread_args *lta	= args;
+	struct lu_env		 *env	= &lta->lta_env;
+	struct lfsck_instance	 *lfsck	= lta->lta_lfsck;
+	struct lfsck_bookmark	 *bk	= &lfsck->li_bookmark_ram;
+	struct lfsck_oit_req	 *lor;
+	struct l_wait_info	  lwi	= { 0 };
+	int			  rc;
+
+	CDEBUG(D_LFSCK, "%s: OIT worker start, pid = %d\n",
+	       lfsck_lfsck2name(lfsck), current_pid());
+	lfsck_env_info(env)->lti_oit_worker = 1;
+
+	while (1) {
+		l_wait_event(lfsck->li_oit_waitq,
+			     !list_empty(&lfsck->li_oit_req_list) ||
+			     lfsck->li_oit_workers_exit,
+			     &lwi);
+
+		spin_lock(&lfsck->li_oit_lock);
+		if (list_empty(&lfsck->li_oit_req_list)) {
+			spin_unlock(&lfsck->li_oit_lock);
+			if (lfsck->li_oit_workers_exit)
+				break;
+
+			continue;
+		}
+
+		lor = list_entry(lfsck->li_oit_req_list.next,
+				 struct lfsck_oit_req, lor_link);
+		list_del_init(&lor->lor_link);
+		spin_unlock(&lfsck->li_oit_lock);
+
+		rc = lfsck_oit_worker_exec(env, lfsck, lor);
+
+		spin_lock(&lfsck->li_oit_lock);
+		if (rc != 0 && bk->lb_param & LPF_FAILOUT &&
+		    lfsck->li_oit_result == 0)
+			lfsck->li_oit_result = rc;
+
+		/* The directory will be traversed by the master engine,
+		 * it is done after that. */
+		if (lor->lor_dir != NULL)
+			list_add_tail(&lor->lor_link,
+				      &lfsck->li_oit_dir_list);
+		else
+			lor->lor_done = 1;
+		spin_unlock(&lfsck->li_oit_lock);
+		wake_up_all(&lfsck->li_thread.t_ctl_waitq);
+	}
+
+	CDEBUG(D_LFSCK, "%s: OIT worker exit, pid = %d\n",
+	       lfsck_lfsck2name(lfsck), current_pid());
+
+	lfsck_thread_args_fini(lta);
+	if (atomic_dec_and_test(&lfsck->li_oit_workers))
+		wake_up_all(&lfsck->li_thread.t_ctl_waitq);
+
+	return 0;
+}
+
+/**
+ * Start the OIT worker threads.
+ *
+ * The master engine goes on with the otable-based iteration and filters
+ * out the objects that need not to be checked, the others are handed to
+ * the OIT worker threads that call the components' lfsck_exec_oit() in
+ * parallel. The count of worker threads is controlled by the module
+ * parameter "lfsck_oit_threads". If none of them can be started, then the
+ * master engine handles the objects by itself as before.
+ *
+ * \param[in] lfsck	pointer to the lfsck instance
+ */
+static void lfsck_oit_workers_start(struct lfsck_instance *lfsck)
+{
+	struct lfsck_thread_args	*lta;
+	struct task_struct		*task;
+	int				 count = lfsck_oit_threads;
+	int				 i;
+
+	if (count <= 0)
+		return;
+
+	if (count > LFSCK_OIT_THREADS_MAX)
+		count = LFSCK_OIT_THREADS_MAX;
+
+	lfsck->li_oit_workers_exit = 0;
+	lfsck->li_oit_result = 0;
+	lfsck->li_oit_inflight_count = 0;
+	for (i = 0; i < count; i++) {
+		lta = lfsck_thread_args_init(lfsck, NULL, NULL);
+		if (IS_ERR(lta)) {
+			CDEBUG(D_LFSCK, "%s: fail to init args for the OIT "
+			       "worker: rc = %ld\n",
+			       lfsck_lfsck2name(lfsck), PTR_ERR(lta));
+			break;
+		}
+
+		atomic_inc(&lfsck->li_oit_workers);
+		task = kthread_run(lfsck_oit_worker, lta, "lfsck_oit_%02d", i);
+		if (IS_ERR(task)) {
+			CDEBUG(D_LFSCK, "%s: cannot start the OIT worker: "
+			       "rc = %ld\n", lfsck_lfsck2name(lfsck),
+			       PTR_ERR(task));
+			atomic_dec(&lfsck->li_oit_workers);
+			lfsck_thread_args_fini(lta);
+			break;
+		}
+	}
+
+	lfsck->li_oit_inflight_max = i * LFSCK_OIT_REQS_PER_THREAD;
+}
+
+/**
+ * Stop the OIT worker threads.
+ *
+ * The objects that have not been taken by the OIT worker threads are
+ * dropped, they are still in the lfsck_instance::li_oit_inflight list
+ * as not done, so the checkpoint will not skip them.
+ *
+ * \param[in] lfsck	pointer to the lfsck instance
+ */
+static void lfsck_oit_workers_stop(struct lfsck_instance *lfsck)
+{
+	struct lfsck_oit_req	*lor;
+	struct lfsck_oit_req	*next;
+	struct l_wait_info	 lwi	= { 0 };
+
+	if (lfsck->li_oit_inflight_max == 0)
+		return;
+
+	spin_lock(&lfsck->li_oit_lock);
+	list_for_each_entry_safe(lor, next, &lfsck->li_oit_req_list,
+				 lor_link)
+		list_del_init(&lor->lor_link);
+	lfsck->li_oit_workers_exit = 1;
+	spin_unlock(&lfsck->li_oit_lock);
+
+	wake_up_all(&lfsck->li_oit_waitq);
+	l_wait_event(lfsck->li_thread.t_ctl_waitq,
+		     atomic_read(&lfsck->li_oit_workers) == 0,
+		     &lwi);
+}
+
+/* Release all the lfsck_oit_req after the OIT worker threads stopped. */
+static void lfsck_oit_reqs_fini(const struct lu_env *env,
+				struct lfsck_instance *lfsck)
+{
+	struct lfsck_oit_req	*lor;
+	struct lfsck_oit_req	*next;
+
+	LASSERT(atomic_read(&lfsck->li_oit_workers) == 0);
+
+	list_for_each_entry_safe(lor, next, &lfsck->li_oit_inflight,
+				 lor_inflight) {
+		list_del(&lor->lor_inflight);
+		if (lor->lor_dir != NULL)
+			lfsck_object_put(env, lor->lor_dir);
+		OBD_FREE_PTR(lor);
+	}
+
+	INIT_LIST_HEAD(&lfsck->li_oit_req_list);
+	INIT_LIST_HEAD(&lfsck->li_oit_dir_list);
+	lfsck->li_oit_inflight_count = 0;
+	lfsck->li_oit_inflight_max = 0;
+}
+
+static int lfsck_oit_dispatch(struct lfsck_instance *lfsck,
+			      const struct lu_fid *fid, __u64 cookie,
+			      bool update_lma)
+{
+	struct lfsck_oit_req *lor;
+
+	OBD_ALLOC_PTR(lor);
+	if (lor == NULL)
+		return -ENOMEM;
+
+	lor->lor_fid = *fid;
+	lor->lor_cookie = cookie;
+	if (update_lma)
+		lor->lor_update_lma = 1;
+
+	spin_lock(&lfsck->li_oit_lock);
+	list_add_tail(&lor->lor_link, &lfsck->li_oit_req_list);
+	list_add_tail(&lor->lor_inflight, &lfsck->li_oit_inflight);
+	lfsck->li_oit_inflight_count++;
+	spin_unlock(&lfsck->li_oit_lock);
+	wake_up(&lfsck->li_oit_waitq);
+
+	return 0;
+}
+
+/* Release the done lfsck_oit_req at the head of the in-flight list. */
+static void lfsck_oit_retire(struct lfsck_instance *lfsck)
+{
+	struct lfsck_oit_req	*lor;
+	struct lfsck_oit_req	*next;
+	struct list_head	 done;
+
+	INIT_LIST_HEAD(&done);
+	spin_lock(&lfsck->li_oit_lock);
+	list_for_each_entry_safe(lor, next, &lfsck->li_oit_inflight,
+				 lor_inflight) {
+		if (!lor->lor_done)
+			break;
+
+		list_move_tail(&lor->lor_inflight, &done);
+		lfsck->li_oit_inflight_count--;
+	}
+	spin_unlock(&lfsck->li_oit_lock);
+
+	list_for_each_entry_safe(lor, next, &done, lor_inflight) {
+		list_del(&lor->lor_inflight);
+		OBD_FREE_PTR(lor);
+	}
+}
+
+static bool lfsck_oit_head_done(struct lfsck_instance *lfsck)
+{
+	struct lfsck_oit_req	*lor;
+	bool			 done	= false;
+
+	spin_lock(&lfsck->li_oit_lock);
+	if (!list_empty(&lfsck->li_oit_inflight)) {
+		lor = list_entry(lfsck->li_oit_inflight.next,
+				 struct lfsck_oit_req, lor_inflight);
+		done = lor->lor_done;
+	}
+	spin_unlock(&lfsck->li_oit_lock);
+
+	return done;
+}
+
+/**
+ * Traverse the directories found by the OIT worker threads.
+ *
+ * \param[in] env	pointer to the thread context
+ * \param[in] lfsck	pointer to the lfsck instance
+ *
+ * \retval		positive number if all the directories are done
+ * \retval		0 if the traversal is stopped or paused
+ * \retval		negative error number on failure
+ */
+static int lfsck_oit_scan_dirs(const struct lu_env *env,
+			       struct lfsck_instance *lfsck)
+{
+	struct lfsck_bookmark	*bk	= &lfsck->li_bookmark_ram;
+	struct lfsck_oit_req	*lor;
+	int			 rc;
+
+	while (!list_empty(&lfsck->li_oit_dir_list)) {
+		spin_lock(&lfsck->li_oit_lock);
+		lor = list_entry(lfsck->li_oit_dir_list.next,
+				 struct lfsck_oit_req, lor_link);
+		list_del_init(&lor->lor_link);
+		spin_unlock(&lfsck->li_oit_lock);
+
+		lfsck->li_pos_current.lp_oit_cookie = lor->lor_cookie;
+		rc = lfsck_load_stripe_lmv(env, lfsck, lor->lor_dir);
+		if (rc == 0)
+			rc = lfsck_open_dir(env, lfsck, 0);
+
+		if (rc == 0) {
+			rc = lfsck_master_dir_engine(env, lfsck);
+			/* Keep the directory opened, then its position
+			 * will be recorded by the checkpoint. */
+			if (rc <= 0)
+				return rc;
+		} else if (rc < 0) {
+			lfsck_fail(env, lfsck, false);
+		}
+
+		if (lfsck->li_obj_dir != NULL)
+			lfsck_close_dir(env, lfsck, rc);
+
+		lfsck_object_put(env, lor->lor_dir);
+		spin_lock(&lfsck->li_oit_lock);
+		lor->lor_dir = NULL;
+		lor->lor_done = 1;
+		spin_unlock(&lfsck->li_oit_lock);
+
+		if (rc < 0 && bk->lb_param & LPF_FAILOUT)
+			return rc;
+	}
+
+	return 1;
+}
+
+/**
+ * Wait for the OIT worker threads.
+ *
+ * Wait until there is room for more objects to be handled by the OIT
+ * worker threads, or until all the objects have been handled if @drain.
+ * The directories found by the OIT worker threads are traversed by the
+ * master engine during the waiting.
+ *
+ * \param[in] env	pointer to the thread context
+ * \param[in] lfsck	pointer to the lfsck instance
+ * \param[in] drain	wait for all the objects to be handled or not
+ *
+ * \retval		positive number if go ahead
+ * \retval		0 if the LFSCK is stopped or paused
+ * \retval		negative error number on failure
+ */
+static int lfsck_oit_wait(const struct lu_env *env,
+			  struct lfsck_instance *lfsck, bool drain)
+{
+	struct ptlrpc_thread	*thread = &lfsck->li_thread;
+	struct l_wait_info	 lwi	= { 0 };
+	__u32			 limit	= 0;
+	int			 rc;
+
+	if (!drain)
+		limit = lfsck->li_oit_inflight_max - 1;
+
+	while (1) {
+		lfsck_oit_retire(lfsck);
+		rc = lfsck_oit_scan_dirs(env, lfsck);
+		if (rc <= 0)
+			return rc;
+
+		if (lfsck->li_oit_result != 0)
+			return lfsck->li_oit_result;
+
+		if (lfsck->li_oit_inflight_count <= limit)
+			return 1;
+
+		l_wait_event(thread->t_ctl_waitq,
+			     !thread_is_running(thread) ||
+			     lfsck->li_oit_result != 0 ||
+			     !list_empty(&lfsck->li_oit_dir_list) ||
+			     lfsck_oit_head_done(lfsck),
+			     &lwi);
+		if (unlikely(!thread_is_running(thread)))
+			return 0;
+	}
+}
+
+/**
+ * Adjust the OIT position for the objects in processing.
+ *
+ * The OIT worker threads may be still processing some objects before the
+ * current OIT position, then the OIT position cannot go beyond the oldest
+ * one of them. If the oldest one is not the directory in traversal, then
+ * the directory traversal position is dropped, and the directory will be
+ * traversed again when resume from such position.
+ *
+ * \param[in] lfsck	pointer to the lfsck instance
+ * \param[in] pos	pointer to the position to be adjusted
+ *
+ * \retval		true if the directory traversal position is dropped
+ * \retval		false if the caller should fill it as normal
+ */
+bool lfsck_oit_pos_adjust(struct lfsck_instance *lfsck,
+			  struct lfsck_position *pos)
+{
+	struct lfsck_oit_req	*lor;
+	bool			 dropped = false;
+
+	spin_lock(&lfsck->li_oit_lock);
+	list_for_each_entry(lor, &lfsck->li_oit_inflight, lor_inflight) {
+		if (lor->lor_done)
+			continue;
+
+		if (lor->lor_dir != NULL && lor->lor_dir == lfsck->li_obj_dir) {
+			pos->lp_oit_cookie = lor->lor_cookie;
+		} else {
+			pos->lp_oit_cookie = lor->lor_cookie - 1;
+			fid_zero(&pos->lp_dir_parent);
+			pos->lp_dir_cookie = 0;
+			dropped = true;
+		}
+		break;
+	}
+	spin_unlock(&lfsck->li_oit_lock);
+
+	return dropped;
+}
+
 /**
  * Object-table based iteration engine.
  *
@@ -871,8 +1329,12 @@ static int lfsck_master_oit_engine(const struct lu_env *env,
 				RETURN(rc);
 		}
 
-		if (unlikely(lfsck->li_oit_over))
+		if (unlikely(lfsck->li_oit_over)) {
+			if (lfsck->li_oit_inflight_max != 0)
+				RETURN(lfsck_oit_wait(env, lfsck, true));
+
 			RETURN(1);
+		}
 
 		if (CFS_FAIL_TIMEOUT(OBD_FAIL_LFSCK_DELAY1, cfs_fail_val) &&
 		    unlikely(!thread_is_running(thread))) {
@@ -907,6 +1369,12 @@ static int lfsck_master_oit_engine(const struct lu_env *env,
 				RETURN(rc);
 		}
 
+		if (lfsck->li_oit_inflight_max != 0) {
+			rc = lfsck_oit_wait(env, lfsck, false);
+			if (rc <= 0)
+				RETURN(rc);
+		}
+
 		lfsck->li_new_scanned++;
 		lfsck->li_pos_current.lp_oit_cookie = iops->store(env, di);
 		rc = iops->rec(env, di, (struct dt_rec *)fid, 0);
@@ -967,6 +1435,19 @@ static int lfsck_master_oit_engine(const struct lu_env *env,
 			}
 		}
 
+		if (lfsck->li_oit_inflight_max != 0) {
+			rc = lfsck_oit_dispatch(lfsck, fid,
+					lfsck->li_pos_current.lp_oit_cookie,
+					update_lma);
+			if (rc != 0) {
+				lfsck_fail(env, lfsck, true);
+				if (bk->lb_param & LPF_FAILOUT)
+					RETURN(rc);
+			}
+
+			goto checkpoint;
+		}
+
 		target = lfsck_object_find_bottom(env, lfsck, fid);
 		if (IS_ERR(target)) {
 			CDEBUG(D_LFSCK, "%s: OIT scan failed at find target "
@@ -1025,6 +1506,9 @@ checkpoint:
 		}
 	} while (rc == 0 || lfsck->li_di_dir != NULL);
 
+	if (rc > 0 && lfsck->li_oit_inflight_max != 0)
+		rc = lfsck_oit_wait(env, lfsck, true);
+
 	RETURN(rc);
 }
 
@@ -1093,10 +1577,13 @@ int lfsck_master_engine(void *args)
 		GOTO(fini_oit, rc = 0);
 
 	if (!list_empty(&lfsck->li_list_scan) ||
-	    list_empty(&lfsck->li_list_double_scan))
+	    list_empty(&lfsck->li_list_double_scan)) {
+		lfsck_oit_workers_start(lfsck);
 		rc = lfsck_master_oit_engine(env, lfsck);
-	else
+		lfsck_oit_workers_stop(lfsck);
+	} else {
 		rc = 1;
+	}
 
 	lfsck_pos_fill(env, lfsck, &lfsck->li_pos_checkpoint, false);
 	CDEBUG(D_LFSCK, "LFSCK exit: oit_flags = %#x, dir_flags = %#x, "
@@ -1111,6 +1598,7 @@ int lfsck_master_engine(void *args)
 		rc = lfsck_post(env, lfsck, rc);
 	else
 		lfsck_close_dir(env, lfsck, rc);
+	lfsck_oit_reqs_fini(env, lfsck);
 
 fini_oit:
 	lfsck_di_oit_put(env, lfsck);
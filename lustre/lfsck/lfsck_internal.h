@@ -595,6 +595,31 @@ struct lfsck_rec_lmv_save {
 /* Allow lfsck_record_lmv() to be called recursively at most three times. */
 #define LFSCK_REC_LMV_MAX_DEPTH 3
 
+/* The max count of OIT worker threads for each LFSCK instance. */
+#define LFSCK_OIT_THREADS_MAX	32
+
+/* How many objects can be in processing for each OIT worker thread. */
+#define LFSCK_OIT_REQS_PER_THREAD	64
+
+/* The object found by the otable-based iteration to be handled by the
+ * OIT worker threads. */
+struct lfsck_oit_req {
+	/* Link into lfsck_instance::li_oit_req_list, or into the
+	 * lfsck_instance::li_oit_dir_list if it is a directory that
+	 * needs to be traversed by the master engine. */
+	struct list_head	 lor_link;
+
+	/* Link into lfsck_instance::li_oit_inflight, in OIT order. */
+	struct list_head	 lor_inflight;
+
+	/* The directory to be traversed, hold reference. */
+	struct dt_object	*lor_dir;
+	struct lu_fid		 lor_fid;
+	__u64			 lor_cookie;
+	unsigned int		 lor_update_lma:1,
+				 lor_done:1;
+};
+
 struct lfsck_instance {
 	struct mutex		  li_mutex;
 	spinlock_t		  li_lock;
@@ -619,6 +644,29 @@ struct lfsck_instance {
 	/* For the lfsck_lmv_unit to be handled. */
 	struct list_head	  li_list_lmv;
 
+	/* For the lfsck_oit_req to be handled by the OIT worker threads,
+	 * all the li_oit_* lists and counters are protected by li_oit_lock. */
+	struct list_head	  li_oit_req_list;
+
+	/* For the lfsck_oit_req in processing, in OIT order. The oldest one
+	 * that is not done decides the OIT position for the checkpoint. */
+	struct list_head	  li_oit_inflight;
+
+	/* For the directories to be traversed by the master engine. */
+	struct list_head	  li_oit_dir_list;
+	spinlock_t		  li_oit_lock;
+
+	/* The OIT worker threads wait on it for new lfsck_oit_req. */
+	wait_queue_head_t	  li_oit_waitq;
+	atomic_t		  li_oit_workers;
+	__u32			  li_oit_inflight_count;
+
+	/* Zero if the master engine handles the objects by itself. */
+	__u32			  li_oit_inflight_max;
+
+	/* The first failure that the OIT worker threads hit. */
+	int			  li_oit_result;
+
 	atomic_t		  li_ref;
 	atomic_t		  li_double_scan_count;
 	struct ptlrpc_thread	  li_thread;
@@ -696,7 +744,8 @@ struct lfsck_instance {
 				  li_drop_dryrun:1, /* Ever dryrun, not now. */
 				  li_master:1, /* Master instance or not. */
 				  li_current_oit_processed:1,
-				  li_start_unplug:1;
+				  li_start_unplug:1,
+				  li_oit_workers_exit:1;
 	struct lfsck_rec_lmv_save li_rec_lmv_save[LFSCK_REC_LMV_MAX_DEPTH];
 };
 
@@ -816,6 +865,11 @@ struct lfsck_thread_info {
 	struct lu_attr		lti_la2;
 	struct lu_attr		lti_la3;
 	struct ost_id		lti_oi;
+	/* The OIT position of the object in processing by this thread. */
+	__u64			lti_oit_cookie;
+	/* This thread is an OIT worker, it must not touch the iterators
+	 * of the master engine. */
+	unsigned int		lti_oit_worker:1;
 	union {
 		struct lustre_mdt_attrs lti_lma;
 		/* old LMA for compatibility */
@@ -877,6 +931,11 @@ int lfsck_pos_dump(struct seq_file *m, struct lfsck_position *pos,
 		   const char *prefix);
 void lfsck_pos_fill(const struct lu_env *env, struct lfsck_instance *lfsck,
 		    struct lfsck_position *pos, bool init);
+__u64 lfsck_oit_cookie_failed(const struct lu_env *env,
+			      struct lfsck_instance *lfsck);
+void lfsck_pos_fill_failed(const struct lu_env *env,
+			   struct lfsck_instance *lfsck,
+			   struct lfsck_position *pos);
 bool __lfsck_set_speed(struct lfsck_instance *lfsck, __u32 limit);
 void lfsck_control_speed(struct lfsck_instance *lfsck);
 void lfsck_control_speed_by_self(struct lfsck_component *com);
@@ -909,6 +968,8 @@ void lfsck_close_dir(const struct lu_env *env,
 		     struct lfsck_instance *lfsck, int result);
 int lfsck_open_dir(const struct lu_env *env,
 		   struct lfsck_instance *lfsck, __u64 cookie);
+bool lfsck_oit_pos_adjust(struct lfsck_instance *lfsck,
+			  struct lfsck_position *pos);
 int lfsck_master_engine(void *args);
 int lfsck_assistant_engine(void *args);
 
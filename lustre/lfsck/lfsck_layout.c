@@ -1364,8 +1364,7 @@ static void lfsck_layout_record_failure(const struct lu_env *env,
 	__u64 cookie;
 
 	lo->ll_objs_failed_phase1++;
-	cookie = lfsck->li_obj_oit->do_index_ops->dio_it.store(env,
-							lfsck->li_di_oit);
+	cookie = lfsck_oit_cookie_failed(env, lfsck);
 	if (lo->ll_pos_first_inconsistent == 0 ||
 	    lo->ll_pos_first_inconsistent < cookie) {
 		lo->ll_pos_first_inconsistent = cookie;
@@ -4311,7 +4310,7 @@ static int lfsck_layout_scan_stripes(const struct lu_env *env,
 
 		if (llo == NULL) {
 			llo = lfsck_layout_object_init(env, parent,
-				lfsck->li_pos_current.lp_oit_cookie);
+						       info->lti_oit_cookie);
 			if (IS_ERR(llo)) {
 				rc = PTR_ERR(llo);
 				goto next;
@@ -4437,7 +4436,9 @@ again:
 	lmm->lmm_oi = *oi;
 
 	if (bk->lb_param & LPF_DRYRUN) {
+		down_write(&com->lc_sem);
 		lo->ll_objs_repaired[LLIT_OTHERS - 1]++;
+		up_write(&com->lc_sem);
 
 		GOTO(out, stripe = true);
 	}
@@ -4476,7 +4477,9 @@ again:
 	if (rc != 0)
 		GOTO(out, rc);
 
+	down_write(&com->lc_sem);
 	lo->ll_objs_repaired[LLIT_OTHERS - 1]++;
+	up_write(&com->lc_sem);
 
 	GOTO(out, stripe = true);
 
@@ -5485,16 +5488,20 @@ static void lfsck_layout_assistant_fill_pos(const struct lu_env *env,
 					    struct lfsck_component *com,
 					    struct lfsck_position *pos)
 {
-	struct lfsck_assistant_data	*lad = com->lc_data;
+	struct lfsck_assistant_data	*lad	= com->lc_data;
 	struct lfsck_layout_req		*llr;
+	__u64				 cookie = 0;
 
-	if (list_empty(&lad->lad_req_list))
-		return;
+	/* The OIT worker threads queue the requests out of OIT order,
+	 * so the checkpoint cannot pass the oldest of them. */
+	list_for_each_entry(llr, &lad->lad_req_list, llr_lar.lar_list) {
+		if (cookie == 0 || llr->llr_parent->llo_cookie < cookie)
+			cookie = llr->llr_parent->llo_cookie;
+	}
 
-	llr = list_entry(lad->lad_req_list.next,
-			 struct lfsck_layout_req,
-			 llr_lar.lar_list);
-	pos->lp_oit_cookie = llr->llr_parent->llo_cookie - 1;
+	if (cookie != 0 &&
+	    (pos->lp_oit_cookie == 0 || cookie - 1 < pos->lp_oit_cookie))
+		pos->lp_oit_cookie = cookie - 1;
 }
 
 struct lfsck_assistant_operations lfsck_layout_assistant_ops = {
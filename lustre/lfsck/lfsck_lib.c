@@ -1691,6 +1691,12 @@ void lfsck_pos_fill(const struct lu_env *env, struct lfsck_instance *lfsck,
 
 	LASSERT(pos->lp_oit_cookie > 0);
 
+	/* The OIT worker threads may be still processing some objects
+	 * before the current OIT position, then the checkpoint cannot
+	 * go beyond the oldest one of them. */
+	if (lfsck_oit_pos_adjust(lfsck, pos))
+		return;
+
 	if (lfsck->li_di_dir != NULL) {
 		struct dt_object *dto = lfsck->li_obj_dir;
 
@@ -1709,6 +1715,56 @@ void lfsck_pos_fill(const struct lu_env *env, struct lfsck_instance *lfsck,
 	}
 }
 
+/**
+ * The OIT position of the object that failed in this thread.
+ *
+ * The OIT worker threads handle the objects out of order while the master
+ * engine moves the otable-based iterator on, so a worker uses the position
+ * of its own object.
+ *
+ * \param[in] env	pointer to the thread context
+ * \param[in] lfsck	pointer to the lfsck instance
+ *
+ * \retval		the OIT cookie of the failed object
+ */
+__u64 lfsck_oit_cookie_failed(const struct lu_env *env,
+			      struct lfsck_instance *lfsck)
+{
+	struct lfsck_thread_info *info = lfsck_env_info(env);
+
+	if (info->lti_oit_worker)
+		return info->lti_oit_cookie;
+
+	return lfsck->li_obj_oit->do_index_ops->dio_it.store(env,
+							lfsck->li_di_oit);
+}
+
+/**
+ * Fill \a pos with the position of the object that failed in this thread.
+ *
+ * Same as lfsck_pos_fill() except for the OIT worker threads, which only
+ * know the OIT position of their own object and must not read the master
+ * engine's iterators; there is no directory position for them.
+ *
+ * \param[in] env	pointer to the thread context
+ * \param[in] lfsck	pointer to the lfsck instance
+ * \param[out] pos	pointer to the position to be filled
+ */
+void lfsck_pos_fill_failed(const struct lu_env *env,
+			   struct lfsck_instance *lfsck,
+			   struct lfsck_position *pos)
+{
+	struct lfsck_thread_info *info = lfsck_env_info(env);
+
+	if (!info->lti_oit_worker) {
+		lfsck_pos_fill(env, lfsck, pos, false);
+		return;
+	}
+
+	memset(pos, 0, sizeof(*pos));
+	pos->lp_oit_cookie = info->lti_oit_cookie;
+}
+
 bool __lfsck_set_speed(struct lfsck_instance *lfsck, __u32 limit)
 {
 	bool dirty = false;
@@ -3107,6 +3163,12 @@ int lfsck_register(const struct lu_env *env, struct dt_device *key,
 	INIT_LIST_HEAD(&lfsck->li_list_double_scan);
 	INIT_LIST_HEAD(&lfsck->li_list_idle);
 	INIT_LIST_HEAD(&lfsck->li_list_lmv);
+	INIT_LIST_HEAD(&lfsck->li_oit_req_list);
+	INIT_LIST_HEAD(&lfsck->li_oit_inflight);
+	INIT_LIST_HEAD(&lfsck->li_oit_dir_list);
+	spin_lock_init(&lfsck->li_oit_lock);
+	init_waitqueue_head(&lfsck->li_oit_waitq);
+	atomic_set(&lfsck->li_oit_workers, 0);
 	atomic_set(&lfsck->li_ref, 1);
 	atomic_set(&lfsck->li_double_scan_count, 0);
 	init_waitqueue_head(&lfsck->li_thread.t_ctl_waitq);
@@ -241,7 +241,7 @@ static void lfsck_namespace_record_failure(const struct lu_env *env,
 	struct lfsck_position pos;
 
 	ns->ln_items_failed++;
-	lfsck_pos_fill(env, lfsck, &pos, false);
+	lfsck_pos_fill_failed(env, lfsck, &pos);
 	if (lfsck_pos_is_zero(&ns->ln_pos_first_inconsistent) ||
 	    lfsck_pos_is_eq(&pos, &ns->ln_pos_first_inconsistent) < 0) {
 		ns->ln_pos_first_inconsistent = pos;
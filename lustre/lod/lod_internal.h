@@ -79,6 +79,26 @@ struct pool_desc {
 #define pool_tgt_array(p)  ((p)->pool_obds.op_array)
 #define pool_tgt_rw_sem(p) ((p)->pool_obds.op_rw_sem)
 
+/* weighted random selection of OSTs for the QoS allocator: the candidate
+ * OSTs of one pool with their weights, summed up in a Fenwick (binary
+ * indexed) tree so a weighted pick and a weight update are O(log n). It is
+ * kept across allocations and rebuilt only when the QoS data is dirty or
+ * another pool is used. Protected by lq_rw_sem, see lod_alloc_qos() */
+struct lod_qos_wt {
+	__u32			 lqw_size;	/* allocated entries */
+	__u32			 lqw_count;	/* candidates in use */
+	__u32			 lqw_good;	/* usable candidates */
+	__u32			 lqw_ntaken;	/* entries in lqw_taken */
+	struct ost_pool		*lqw_osts;	/* pool of the candidates */
+	__u64			 lqw_total;	/* sum of all weights */
+	__u32			*lqw_idx;	/* OST index of the candidate */
+	int			*lqw_next;	/* next candidate on the OSS */
+	__u32			*lqw_taken;	/* taken by this allocation */
+	__u64			*lqw_weight;	/* weight of the candidate */
+	__u64			*lqw_tree;	/* Fenwick tree, 1-based */
+	bool			 lqw_valid;	/* candidates are up to date */
+};
+
 struct lod_qos {
 	struct list_head	 lq_oss_list;
 	struct rw_semaphore	 lq_rw_sem;
@@ -86,6 +106,11 @@ struct lod_qos {
 	unsigned int		 lq_prio_free;   /* priority for free space */
 	unsigned int		 lq_threshold_rr;/* priority for rr */
 	struct lod_qos_rr	 lq_rr;          /* round robin qos data */
+	struct lod_qos_wt	 lq_wt;		 /* weighted qos selection */
+	__u64			 lq_objs;	 /* objects placed by qos, the
+						  * penalties decay with it */
+	struct list_head	 lq_pen_osts;	 /* OSTs and OSSs with a */
+	struct list_head	 lq_pen_oss;	 /* penalty left to decay */
 	bool			 lq_dirty:1,     /* recalc qos data */
 				 lq_same_space:1,/* the ost's all have approx.
 						    the same space avail */
@@ -100,7 +125,11 @@ struct lod_qos_oss {
 	__u64			 lqo_penalty_per_obj; /* penalty decrease
 							 every obj*/
 	time_t			 lqo_used;	/* last used time, seconds */
+	__u64			 lqo_objs;	/* lq_objs at last decay */
+	struct list_head	 lqo_pen_list;	/* link to lq_pen_oss */
 	__u32			 lqo_ost_count;	/* number of osts on this oss */
+	int			 lqo_cand;	/* first lq_wt candidate on
+						 * this oss, or -1 */
 };
 
 struct ltd_qos {
@@ -110,6 +139,10 @@ struct ltd_qos {
 							 every obj*/
 	__u64			 ltq_weight;	/* net weighting */
 	time_t			 ltq_used;	/* last used time, seconds */
+	__u64			 ltq_objs;	/* lq_objs at last decay */
+	struct list_head	 ltq_pen_list;	/* link to lq_pen_osts */
+	int			 ltq_cand;	/* lq_wt candidate, valid only
+						 * if lqw_idx[] points back */
 	bool			 ltq_usable:1;	/* usable for striping */
 };
 
@@ -463,6 +496,7 @@ int lod_qos_prep_create(const struct lu_env *env, struct lod_object *lo,
 			struct thandle *th);
 int qos_add_tgt(struct lod_device*, struct lod_tgt_desc *);
 int qos_del_tgt(struct lod_device *, struct lod_tgt_desc *);
+void lod_qos_wt_fini(struct lod_qos_wt *w);
 
 /* lproc_lod.c */
 int lod_procfs_init(struct lod_device *lod);
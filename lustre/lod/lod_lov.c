@@ -1270,6 +1270,8 @@ int lod_pools_init(struct lod_device *lod, struct lustre_cfg *lcfg)
 
 	/* Set up allocation policy (QoS and RR) */
 	INIT_LIST_HEAD(&lod->lod_qos.lq_oss_list);
+	INIT_LIST_HEAD(&lod->lod_qos.lq_pen_osts);
+	INIT_LIST_HEAD(&lod->lod_qos.lq_pen_oss);
 	init_rwsem(&lod->lod_qos.lq_rw_sem);
 	lod->lod_qos.lq_dirty = 1;
 	lod->lod_qos.lq_rr.lqr_dirty = 1;
@@ -1333,6 +1335,7 @@ int lod_pools_fini(struct lod_device *lod)
 
 	cfs_hash_putref(lod->lod_pools_hash_body);
 	lod_ost_pool_free(&(lod->lod_qos.lq_rr.lqr_pool));
+	lod_qos_wt_fini(&lod->lod_qos.lq_wt);
 	lod_ost_pool_free(&lod->lod_pool_info);
 
 	RETURN(0);
@@ -794,6 +794,7 @@ int lod_pool_add(struct obd_device *obd, char *poolname, char *ostname)
 		GOTO(out, rc);
 
 	pool->pool_rr.lqr_dirty = 1;
+	lod->lod_qos.lq_dirty = 1;
 
 	CDEBUG(D_CONFIG, "Added %s to "LOV_POOLNAMEF" as member %d\n",
 			ostname, poolname,  pool_tgt_count(pool));
@@ -849,6 +850,7 @@ int lod_pool_remove(struct obd_device *obd, char *poolname, char *ostname)
 	lod_ost_pool_remove(&pool->pool_obds, idx);
 
 	pool->pool_rr.lqr_dirty = 1;
+	lod->lod_qos.lq_dirty = 1;
 
 	CDEBUG(D_CONFIG, "%s removed from "LOV_POOLNAMEF"\n", ostname,
 	       poolname);
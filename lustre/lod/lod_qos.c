@@ -97,6 +97,8 @@ int qos_add_tgt(struct lod_device *lod, struct lod_tgt_desc *ost_desc)
 			GOTO(out, rc = -ENOMEM);
 		memcpy(&oss->lqo_uuid, &exp->exp_connection->c_remote_uuid,
 		       sizeof(oss->lqo_uuid));
+		INIT_LIST_HEAD(&oss->lqo_pen_list);
+		oss->lqo_objs = lod->lod_qos.lq_objs;
 	} else {
 		/* Assume we have to move this one */
 		list_del(&oss->lqo_oss_list);
@@ -104,6 +106,8 @@ int qos_add_tgt(struct lod_device *lod, struct lod_tgt_desc *ost_desc)
 
 	oss->lqo_ost_count++;
 	ost_desc->ltd_qos.ltq_oss = oss;
+	INIT_LIST_HEAD(&ost_desc->ltd_qos.ltq_pen_list);
+	ost_desc->ltd_qos.ltq_objs = lod->lod_qos.lq_objs;
 
 	CDEBUG(D_QOS, "add tgt %s to OSS %s (%d OSTs)\n",
 	       obd_uuid2str(&ost_desc->ltd_uuid), obd_uuid2str(&oss->lqo_uuid),
@@ -151,11 +155,13 @@ int qos_del_tgt(struct lod_device *lod, struct lod_tgt_desc *ost_desc)
 	if (!oss)
 		GOTO(out, rc = -ENOENT);
 
+	list_del_init(&ost_desc->ltd_qos.ltq_pen_list);
 	oss->lqo_ost_count--;
 	if (oss->lqo_ost_count == 0) {
 		CDEBUG(D_QOS, "removing OSS %s\n",
 		       obd_uuid2str(&oss->lqo_uuid));
 		list_del(&oss->lqo_oss_list);
+		list_del(&oss->lqo_pen_list);
 		ost_desc->ltd_qos.ltq_oss = NULL;
 		OBD_FREE_PTR(oss);
 	}
@@ -285,6 +291,45 @@ out:
 	EXIT;
 }
 
+/**
+ * Apply the penalty decay of a given number of objects.
+ *
+ * Every object placed by QoS decreases the penalties of all OSTs and OSSs
+ * by their per-object penalty. Rather than walking all of them for every
+ * object, lq_objs counts the objects and each OST and OSS remembers the
+ * count at its last decay, so the decay is applied when the penalty is
+ * needed. This is the same as decreasing the penalty once per object.
+ *
+ * \param[in] penalty	current penalty
+ * \param[in] ppo	penalty per object
+ * \param[in] objs	objects placed since the last decay
+ *
+ * \retval		the decayed penalty
+ */
+static __u64 lod_qos_decay(__u64 penalty, __u64 ppo, __u64 objs)
+{
+	/* ppo * objs may overflow, compare through a division */
+	if (objs != 0 && ppo > penalty / objs)
+		return 0;
+
+	return penalty - ppo * objs;
+}
+
+static void lod_qos_decay_tgt(struct lod_device *lod, struct ltd_qos *q)
+{
+	q->ltq_penalty = lod_qos_decay(q->ltq_penalty, q->ltq_penalty_per_obj,
+				       lod->lod_qos.lq_objs - q->ltq_objs);
+	q->ltq_objs = lod->lod_qos.lq_objs;
+}
+
+static void lod_qos_decay_oss(struct lod_device *lod, struct lod_qos_oss *oss)
+{
+	oss->lqo_penalty = lod_qos_decay(oss->lqo_penalty,
+					 oss->lqo_penalty_per_obj,
+					 lod->lod_qos.lq_objs - oss->lqo_objs);
+	oss->lqo_objs = lod->lod_qos.lq_objs;
+}
+
 /**
  * Calculate per-OST and per-OSS penalties
  *
@@ -337,6 +382,9 @@ static int lod_qos_calc_ppo(struct lod_device *lod)
 	 * (lod ref taken in lod_qos_prep_create()) */
 	cfs_foreach_bit(lod->lod_ost_bitmap, i) {
 		LASSERT(OST_TGT(lod,i));
+		/* bring the penalty up to date with the old per-object
+		 * penalty before it changes */
+		lod_qos_decay_tgt(lod, &OST_TGT(lod, i)->ltd_qos);
 		temp = TGT_BAVAIL(i);
 		if (!temp)
 			continue;
@@ -375,6 +423,7 @@ static int lod_qos_calc_ppo(struct lod_device *lod)
 
 	/* Per-OSS penalty is prio * oss_avail / oss_osts / (num_oss - 1) / 2 */
 	list_for_each_entry(oss, &lod->lod_qos.lq_oss_list, lqo_oss_list) {
+		lod_qos_decay_oss(lod, oss);
 		temp = oss->lqo_bavail >> 1;
 		do_div(temp, oss->lqo_ost_count * num_active);
 		oss->lqo_penalty_per_obj = (temp * prio_wide) >> 8;
@@ -413,7 +462,8 @@ out:
  * Calculate weight for a given OST target.
  *
  * The final OST weight is the number of bytes available minus the OST and
- * OSS penalties.  See lod_qos_calc_ppo() for how penalties are calculated.
+ * OSS penalties, after their pending decay is applied.  See
+ * lod_qos_calc_ppo() for how penalties are calculated.
  *
  * \param[in] lod	LOD device, where OST targets are listed
  * \param[in] i		OST target index
@@ -424,6 +474,9 @@ static int lod_qos_calc_weight(struct lod_device *lod, int i)
 {
 	__u64 temp, temp2;
 
+	lod_qos_decay_tgt(lod, &OST_TGT(lod, i)->ltd_qos);
+	lod_qos_decay_oss(lod, OST_TGT(lod, i)->ltd_qos.ltq_oss);
+
 	temp = TGT_BAVAIL(i);
 	temp2 = OST_TGT(lod,i)->ltd_qos.ltq_penalty +
 		OST_TGT(lod,i)->ltd_qos.ltq_oss->lqo_penalty;
@@ -435,35 +488,213 @@ static int lod_qos_calc_weight(struct lod_device *lod, int i)
 }
 
 /**
- * Re-calculate weights.
+ * Release the weighted selection arrays.
+ *
+ * \param[in] w		weighted selection data
+ */
+void lod_qos_wt_fini(struct lod_qos_wt *w)
+{
+	if (w->lqw_size == 0)
+		return;
+
+	OBD_FREE_LARGE(w->lqw_idx, w->lqw_size * sizeof(w->lqw_idx[0]));
+	OBD_FREE_LARGE(w->lqw_next, w->lqw_size * sizeof(w->lqw_next[0]));
+	OBD_FREE_LARGE(w->lqw_taken, w->lqw_size * sizeof(w->lqw_taken[0]));
+	OBD_FREE_LARGE(w->lqw_weight, w->lqw_size * sizeof(w->lqw_weight[0]));
+	OBD_FREE_LARGE(w->lqw_tree,
+		       (w->lqw_size + 1) * sizeof(w->lqw_tree[0]));
+	w->lqw_idx = NULL;
+	w->lqw_next = NULL;
+	w->lqw_taken = NULL;
+	w->lqw_weight = NULL;
+	w->lqw_tree = NULL;
+	w->lqw_size = 0;
+	w->lqw_count = 0;
+	w->lqw_valid = false;
+}
+
+/**
+ * Prepare the weighted selection arrays for a number of candidates.
+ *
+ * The arrays are kept between allocations and only grow when the number
+ * of OSTs in the pool grows.
+ *
+ * \param[in] w		weighted selection data
+ * \param[in] count	maximum number of candidates
+ *
+ * \retval 0		on success
+ * \retval -ENOMEM	on error
+ */
+static int lod_qos_wt_prep(struct lod_qos_wt *w, __u32 count)
+{
+	w->lqw_count = 0;
+	w->lqw_good = 0;
+	w->lqw_total = 0;
+	if (w->lqw_size >= count)
+		return 0;
+
+	lod_qos_wt_fini(w);
+
+	OBD_ALLOC_LARGE(w->lqw_idx, count * sizeof(w->lqw_idx[0]));
+	OBD_ALLOC_LARGE(w->lqw_next, count * sizeof(w->lqw_next[0]));
+	OBD_ALLOC_LARGE(w->lqw_taken, count * sizeof(w->lqw_taken[0]));
+	OBD_ALLOC_LARGE(w->lqw_weight, count * sizeof(w->lqw_weight[0]));
+	OBD_ALLOC_LARGE(w->lqw_tree, (count + 1) * sizeof(w->lqw_tree[0]));
+	w->lqw_size = count;
+	if (w->lqw_idx == NULL || w->lqw_next == NULL ||
+	    w->lqw_taken == NULL || w->lqw_weight == NULL || w->lqw_tree == NULL) {
+		lod_qos_wt_fini(w);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * Build the Fenwick tree from the candidate weights in O(n).
+ *
+ * \param[in] w		weighted selection data
+ */
+static void lod_qos_wt_build(struct lod_qos_wt *w)
+{
+	__u32 i, j;
+
+	w->lqw_tree[0] = 0;
+	for (i = 1; i <= w->lqw_count; i++)
+		w->lqw_tree[i] = w->lqw_weight[i - 1];
+
+	for (i = 1; i <= w->lqw_count; i++) {
+		j = i + (i & -i);
+		if (j <= w->lqw_count)
+			w->lqw_tree[j] += w->lqw_tree[i];
+	}
+}
+
+/**
+ * Change the weight of a candidate.
+ *
+ * \param[in] w		weighted selection data
+ * \param[in] j		candidate
+ * \param[in] weight	new weight of the candidate
+ */
+static void lod_qos_wt_set(struct lod_qos_wt *w, __u32 j, __u64 weight)
+{
+	/* unsigned arithmetic wraps, so a negative delta works too */
+	__u64 delta = weight - w->lqw_weight[j];
+	__u32 i;
+
+	w->lqw_weight[j] = weight;
+	w->lqw_total += delta;
+	for (i = j + 1; i <= w->lqw_count; i += i & -i)
+		w->lqw_tree[i] += delta;
+}
+
+/**
+ * Find the candidate covering a point in the cumulative weights.
+ *
+ * Returns the first candidate for which the sum of the weights up to and
+ * including it is larger than \a rand, so a candidate is hit with the
+ * probability proportional to its weight. Zero-weight candidates are never
+ * returned.
+ *
+ * \param[in] w		weighted selection data
+ * \param[in] rand	random number less than the total weight
+ *
+ * \retval		candidate index
+ */
+static __u32 lod_qos_wt_find(struct lod_qos_wt *w, __u64 rand)
+{
+	__u32 pos = 0;
+	__u32 step;
+
+	LASSERT(w->lqw_count > 0);
+	for (step = 1U << (fls(w->lqw_count) - 1); step > 0; step >>= 1) {
+		if (pos + step <= w->lqw_count &&
+		    w->lqw_tree[pos + step] <= rand) {
+			pos += step;
+			rand -= w->lqw_tree[pos];
+		}
+	}
+
+	return min(pos, w->lqw_count - 1);
+}
+
+/**
+ * Look up the candidate of an OST in the weighted selection data.
+ *
+ * \param[in] w		weighted selection data
+ * \param[in] i		OST target index
+ * \param[in] q		QoS data of the OST
  *
- * The function is called when some OST target was used for a new object. In
- * this case we should re-calculate all the weights to keep new allocations
- * balanced well.
+ * \retval		candidate index, or -1 if the OST is no candidate
+ */
+static int lod_qos_wt_cand(struct lod_qos_wt *w, __u32 i, struct ltd_qos *q)
+{
+	int j = q->ltq_cand;
+
+	if (!w->lqw_valid || j < 0 || (__u32)j >= w->lqw_count ||
+	    w->lqw_idx[j] != i)
+		return -1;
+
+	return j;
+}
+
+/**
+ * Re-calculate the weight of a candidate OST and update the tree.
  *
  * \param[in] lod	LOD device
- * \param[in] osts	OST pool where a new object was placed
- * \param[in] index	OST target where a new object was placed
- * \param[out] total_wt	new total weight for the pool
+ * \param[in] w		weighted selection data
+ * \param[in] j		candidate
+ */
+static void lod_qos_wt_update(struct lod_device *lod, struct lod_qos_wt *w,
+			      __u32 j)
+{
+	struct lod_tgt_desc *ost = OST_TGT(lod, w->lqw_idx[j]);
+
+	if (!ost->ltd_qos.ltq_usable)
+		return;
+
+	lod_qos_calc_weight(lod, w->lqw_idx[j]);
+	lod_qos_wt_set(w, j, ost->ltd_qos.ltq_weight);
+
+	QOS_DEBUG("recalc tgt %d avail="LPU64" ostppo="LPU64" ostp="LPU64
+		  " ossppo="LPU64" ossp="LPU64" wt="LPU64"\n",
+		  w->lqw_idx[j], TGT_BAVAIL(w->lqw_idx[j]) >> 10,
+		  ost->ltd_qos.ltq_penalty_per_obj >> 10,
+		  ost->ltd_qos.ltq_penalty >> 10,
+		  ost->ltd_qos.ltq_oss->lqo_penalty_per_obj >> 10,
+		  ost->ltd_qos.ltq_oss->lqo_penalty >> 10,
+		  ost->ltd_qos.ltq_weight >> 10);
+}
+
+/**
+ * Account a new object in the penalties.
  *
- * \retval		0
+ * The function is called when some OST target was used for a new object.
+ * The penalties of the target and its OSS are raised and the weights of
+ * the remaining candidates on the same OSS are updated, so the rest of the
+ * striping is spread over other OSSs. The target and its OSS are queued
+ * for the decay of their penalties, see lod_qos_used_fini().
+ *
+ * \param[in] lod	LOD device
+ * \param[in] w		weighted selection data
+ * \param[in] j		candidate where a new object was placed
  */
-static int lod_qos_used(struct lod_device *lod, struct ost_pool *osts,
-			__u32 index, __u64 *total_wt)
+static void lod_qos_used(struct lod_device *lod, struct lod_qos_wt *w,
+			 __u32 j)
 {
 	struct lod_tgt_desc *ost;
 	struct lod_qos_oss  *oss;
-	unsigned int j;
+	int		     k;
 	ENTRY;
 
-	ost = OST_TGT(lod,index);
+	ost = OST_TGT(lod, w->lqw_idx[j]);
 	LASSERT(ost);
-
-	/* Don't allocate on this devuce anymore, until the next alloc_qos */
-	ost->ltd_qos.ltq_usable = 0;
-
 	oss = ost->ltd_qos.ltq_oss;
 
+	lod_qos_decay_tgt(lod, &ost->ltd_qos);
+	lod_qos_decay_oss(lod, oss);
+
 	/* Decay old penalty by half (we're adding max penalty, and don't
 	   want it to run away.) */
 	ost->ltd_qos.ltq_penalty >>= 1;
@@ -478,51 +709,82 @@ static int lod_qos_used(struct lod_device *lod, struct ost_pool *osts,
 	oss->lqo_penalty += oss->lqo_penalty_per_obj *
 		lod->lod_qos.lq_active_oss_count;
 
-	/* Decrease all OSS penalties */
-	list_for_each_entry(oss, &lod->lod_qos.lq_oss_list, lqo_oss_list) {
-		if (oss->lqo_penalty < oss->lqo_penalty_per_obj)
-			oss->lqo_penalty = 0;
-		else
-			oss->lqo_penalty -= oss->lqo_penalty_per_obj;
-	}
+	list_move_tail(&ost->ltd_qos.ltq_pen_list, &lod->lod_qos.lq_pen_osts);
+	list_move_tail(&oss->lqo_pen_list, &lod->lod_qos.lq_pen_oss);
 
-	*total_wt = 0;
-	/* Decrease all OST penalties */
-	for (j = 0; j < osts->op_count; j++) {
-		int i;
+	/* the OSS penalty has changed, reweight its other candidates */
+	for (k = oss->lqo_cand; k >= 0; k = w->lqw_next[k])
+		lod_qos_wt_update(lod, w, k);
 
-		i = osts->op_array[j];
-		if (!cfs_bitmap_check(lod->lod_ost_bitmap, i))
-			continue;
+	EXIT;
+}
+
+/**
+ * Re-calculate weights after a striping was allocated.
+ *
+ * The OSTs taken by the allocation are made candidates again with their
+ * new weights. The penalties of all OSSs and OSTs decrease by the
+ * per-object penalty for every object of the new striping; that is
+ * accounted in lq_objs and applied lazily, and the weights in the tree
+ * are refreshed for a few of the penalised OSTs and OSSs, oldest first.
+ * Two of each per object placed keep the queues moving faster than they
+ * grow. A weight which is not refreshed yet still carries some of the
+ * decayed penalty, so the OST is just picked a bit less often until then.
+ * All of this is O(log n) per object in the number of OSTs.
+ *
+ * \param[in] lod	LOD device
+ * \param[in] w		weighted selection data
+ * \param[in] count	number of objects placed
+ */
+static void lod_qos_used_fini(struct lod_device *lod, struct lod_qos_wt *w,
+			      __u32 count)
+{
+	struct lod_qos	    *qos = &lod->lod_qos;
+	struct lod_tgt_desc *ost;
+	struct lod_qos_oss  *oss;
+	unsigned int	     n;
+	int		     j;
+	ENTRY;
 
-		ost = OST_TGT(lod,i);
-		LASSERT(ost);
+	qos->lq_objs += count;
 
-		if (ost->ltd_qos.ltq_penalty <
-				ost->ltd_qos.ltq_penalty_per_obj)
-			ost->ltd_qos.ltq_penalty = 0;
+	for (n = 0; n < w->lqw_ntaken; n++) {
+		j = w->lqw_taken[n];
+		OST_TGT(lod, w->lqw_idx[j])->ltd_qos.ltq_usable = 1;
+		lod_qos_wt_update(lod, w, j);
+	}
+	w->lqw_ntaken = 0;
+
+	for (n = 0; n < 2 * count && !list_empty(&qos->lq_pen_oss); n++) {
+		oss = list_entry(qos->lq_pen_oss.next, struct lod_qos_oss,
+				 lqo_pen_list);
+		lod_qos_decay_oss(lod, oss);
+		if (oss->lqo_penalty == 0)
+			list_del_init(&oss->lqo_pen_list);
 		else
-			ost->ltd_qos.ltq_penalty -=
-				ost->ltd_qos.ltq_penalty_per_obj;
-
-		lod_qos_calc_weight(lod, i);
-
-		/* Recalc the total weight of usable osts */
-		if (ost->ltd_qos.ltq_usable)
-			*total_wt += ost->ltd_qos.ltq_weight;
-
-		QOS_DEBUG("recalc tgt %d usable=%d avail="LPU64
-			  " ostppo="LPU64" ostp="LPU64" ossppo="LPU64
-			  " ossp="LPU64" wt="LPU64"\n",
-			  i, ost->ltd_qos.ltq_usable, TGT_BAVAIL(i) >> 10,
-			  ost->ltd_qos.ltq_penalty_per_obj >> 10,
-			  ost->ltd_qos.ltq_penalty >> 10,
-			  ost->ltd_qos.ltq_oss->lqo_penalty_per_obj >> 10,
-			  ost->ltd_qos.ltq_oss->lqo_penalty >> 10,
-			  ost->ltd_qos.ltq_weight >> 10);
+			list_move_tail(&oss->lqo_pen_list, &qos->lq_pen_oss);
+
+		if (w->lqw_valid)
+			for (j = oss->lqo_cand; j >= 0; j = w->lqw_next[j])
+				lod_qos_wt_update(lod, w, j);
 	}
 
-	RETURN(0);
+	for (n = 0; n < 2 * count && !list_empty(&qos->lq_pen_osts); n++) {
+		ost = container_of0(qos->lq_pen_osts.next,
+				    struct lod_tgt_desc, ltd_qos.ltq_pen_list);
+		lod_qos_decay_tgt(lod, &ost->ltd_qos);
+		if (ost->ltd_qos.ltq_penalty == 0)
+			list_del_init(&ost->ltd_qos.ltq_pen_list);
+		else
+			list_move_tail(&ost->ltd_qos.ltq_pen_list,
+				       &qos->lq_pen_osts);
+
+		j = lod_qos_wt_cand(w, ost->ltd_index, &ost->ltd_qos);
+		if (j >= 0)
+			lod_qos_wt_update(lod, w, j);
+	}
+
+	EXIT;
 }
 
 #define LOV_QOS_EMPTY ((__u32)-1)
@@ -1299,6 +1561,120 @@ static inline int lod_qos_is_usable(struct lod_device *lod)
 	return 1;
 }
 
+/**
+ * Collect the candidate OSTs of a pool and build the tree.
+ *
+ * Check statfs of every OST in the pool and add the usable ones to the
+ * candidates, chained with the others on the same OSS. This is O(n) in the
+ * number of OSTs, so it is done only when the QoS data has changed (after
+ * statfs refresh, configuration or pool changes, see lq_dirty), or when
+ * another pool is used than for the previous allocation.
+ *
+ * \param[in] env	execution environment for this thread
+ * \param[in] lod	LOD device
+ * \param[in] w		weighted selection data
+ * \param[in] osts	OST pool to collect the candidates from
+ *
+ * \retval 0		on success
+ * \retval -ENOMEM	on error
+ */
+static int lod_qos_wt_rebuild(const struct lu_env *env, struct lod_device *lod,
+			      struct lod_qos_wt *w, struct ost_pool *osts)
+{
+	struct obd_statfs   *sfs = &lod_env_info(env)->lti_osfs;
+	struct lod_tgt_desc *ost;
+	struct lod_qos_oss  *oss;
+	unsigned int	     i;
+	__u32		     j;
+	int		     rc;
+
+	w->lqw_valid = false;
+	rc = lod_qos_wt_prep(w, osts->op_count);
+	if (rc)
+		return rc;
+
+	list_for_each_entry(oss, &lod->lod_qos.lq_oss_list, lqo_oss_list)
+		oss->lqo_cand = -1;
+
+	for (i = 0; i < osts->op_count; i++) {
+		if (!cfs_bitmap_check(lod->lod_ost_bitmap, osts->op_array[i]))
+			continue;
+
+		ost = OST_TGT(lod, osts->op_array[i]);
+		ost->ltd_qos.ltq_usable = 0;
+
+		rc = lod_statfs_and_check(env, lod, osts->op_array[i], sfs);
+		if (rc) {
+			/* this OSP doesn't feel well */
+			continue;
+		}
+
+		/*
+		 * skip full devices
+		 */
+		if (lod_qos_dev_is_full(sfs))
+			continue;
+
+		ost->ltd_qos.ltq_usable = 1;
+		lod_qos_calc_weight(lod, osts->op_array[i]);
+
+		/* add to the candidates, chained with others on the OSS */
+		oss = ost->ltd_qos.ltq_oss;
+		j = w->lqw_count++;
+		w->lqw_idx[j] = osts->op_array[i];
+		w->lqw_weight[j] = ost->ltd_qos.ltq_weight;
+		w->lqw_total += ost->ltd_qos.ltq_weight;
+		w->lqw_next[j] = oss->lqo_cand;
+		oss->lqo_cand = j;
+		ost->ltd_qos.ltq_cand = j;
+		w->lqw_good++;
+	}
+
+	lod_qos_wt_build(w);
+	w->lqw_osts = osts;
+	w->lqw_valid = true;
+
+	QOS_DEBUG("found %d good osts\n", w->lqw_good);
+
+	return 0;
+}
+
+/**
+ * Check a picked candidate is still usable.
+ *
+ * The candidates were checked when the tree was built; an OST may have
+ * become inactive, read-only or full since then. Its cached statfs data
+ * is cheap to get, so check the OST again before declaring an object on
+ * it, and drop it from the candidates until the next rebuild if it fails.
+ *
+ * \param[in] env	execution environment for this thread
+ * \param[in] lod	LOD device
+ * \param[in] i		OST target index
+ *
+ * \retval 0		if the OST is good
+ * \retval negative	negated errno if not
+ */
+static int lod_qos_wt_check(const struct lu_env *env, struct lod_device *lod,
+			    __u32 i)
+{
+	struct obd_statfs *sfs = &lod_env_info(env)->lti_osfs;
+	int		   rc;
+
+	rc = lod_statfs_and_check(env, lod, i, sfs);
+	if (rc)
+		return rc;
+
+	if (lod_qos_dev_is_full(sfs))
+		return -ENOSPC;
+
+	/* Fail Check before osc_precreate() is called
+	   so we can only 'fail' single OSC. */
+	if (OBD_FAIL_CHECK(OBD_FAIL_MDS_OSC_PRECREATE) && i == 0)
+		return -ENOSPC;
+
+	return 0;
+}
+
 /**
  * Allocate a striping using an algorithm with weights.
  *
@@ -1317,7 +1693,10 @@ static inline int lod_qos_is_usable(struct lod_device *lod)
  * The algorithm has two steps: find available OSTs and calucate their weights,
  * then select the OSTs the weights used as the probability. An OST with a
  * higher weight is proportionately more likely to be selected than one with
- * a lower weight.
+ * a lower weight. The weights are kept in a Fenwick tree (see struct
+ * lod_qos_wt) across allocations and only the penalised OSTs are
+ * reweighted, so an allocation costs O(log n) per stripe in the number of
+ * OSTs. The tree is rebuilt in O(n) only when the QoS data is dirty.
  *
  * \param[in] env	execution environment for this thread
  * \param[in] lo	LOD object
@@ -1335,17 +1714,16 @@ static int lod_alloc_qos(const struct lu_env *env, struct lod_object *lo,
 			 struct thandle *th)
 {
 	struct lod_device   *m = lu2lod_dev(lo->ldo_obj.do_lu.lo_dev);
-	struct obd_statfs   *sfs = &lod_env_info(env)->lti_osfs;
-	struct lod_tgt_desc *ost;
+	struct lod_qos_wt   *w = &m->lod_qos.lq_wt;
 	struct dt_object    *o;
-	__u64		     total_weight = 0;
 	unsigned int	     i;
 	int		     rc = 0;
-	__u32		     nfound, good_osts;
+	__u32		     nfound, j;
 	__u32		     stripe_cnt = lo->ldo_stripenr;
 	__u32		     stripe_cnt_min;
 	struct pool_desc    *pool = NULL;
 	struct ost_pool    *osts;
+	bool		     rebuild;
 	ENTRY;
 
 	stripe_cnt_min = min_stripe_count(stripe_cnt, flags);
@@ -1376,61 +1754,33 @@ static int lod_alloc_qos(const struct lu_env *env, struct lod_object *lo,
 	if (!lod_qos_is_usable(m))
 		GOTO(out, rc = -EAGAIN);
 
-	rc = lod_qos_calc_ppo(m);
-	if (rc)
-		GOTO(out, rc);
+	rebuild = m->lod_qos.lq_dirty || !w->lqw_valid || w->lqw_osts != osts;
 
-	rc = lod_qos_ost_in_use_clear(env, lo->ldo_stripenr);
-	if (rc)
+	rc = lod_qos_calc_ppo(m);
+	if (rc) {
+		w->lqw_valid = false;
 		GOTO(out, rc);
-
-	good_osts = 0;
-	/* Find all the OSTs that are valid stripe candidates */
-	for (i = 0; i < osts->op_count; i++) {
-		if (!cfs_bitmap_check(m->lod_ost_bitmap, osts->op_array[i]))
-			continue;
-
-		rc = lod_statfs_and_check(env, m, osts->op_array[i], sfs);
-		if (rc) {
-			/* this OSP doesn't feel well */
-			continue;
-		}
-
-		/*
-		 * skip full devices
-		 */
-		if (lod_qos_dev_is_full(sfs))
-			continue;
-
-		/* Fail Check before osc_precreate() is called
-		   so we can only 'fail' single OSC. */
-		if (OBD_FAIL_CHECK(OBD_FAIL_MDS_OSC_PRECREATE) &&
-				   osts->op_array[i] == 0)
-			continue;
-
-		ost = OST_TGT(m,osts->op_array[i]);
-		ost->ltd_qos.ltq_usable = 1;
-		lod_qos_calc_weight(m, osts->op_array[i]);
-		total_weight += ost->ltd_qos.ltq_weight;
-
-		good_osts++;
 	}
 
-	QOS_DEBUG("found %d good osts\n", good_osts);
+	if (rebuild) {
+		rc = lod_qos_wt_rebuild(env, m, w, osts);
+		if (rc)
+			GOTO(out, rc);
+	}
 
-	if (good_osts < stripe_cnt_min)
+	if (w->lqw_good < stripe_cnt_min)
 		GOTO(out, rc = -EAGAIN);
 
 	/* We have enough osts */
-	if (good_osts < stripe_cnt)
-		stripe_cnt = good_osts;
+	if (w->lqw_good < stripe_cnt)
+		stripe_cnt = w->lqw_good;
 
 	/* Find enough OSTs with weighted random allocation. */
 	nfound = 0;
+	w->lqw_ntaken = 0;
 	while (nfound < stripe_cnt) {
-		__u64 rand, cur_weight;
+		__u64 rand, total_weight = w->lqw_total;
 
-		cur_weight = 0;
 		rc = -ENOSPC;
 
 		if (total_weight) {
@@ -1454,59 +1804,51 @@ static int lod_alloc_qos(const struct lu_env *env, struct lod_object *lo,
 			rand = ((__u64)cfs_rand() << 32 | cfs_rand()) %
 				total_weight;
 #endif
+			/* On average, this will hit larger-weighted osts
+			 * more often */
+			j = lod_qos_wt_find(w, rand);
 		} else {
+			/* 0-weight osts will always get used last */
 			rand = 0;
+			for (j = 0; j < w->lqw_count; j++)
+				if (OST_TGT(m, w->lqw_idx[j])->ltd_qos.ltq_usable)
+					break;
+			if (j == w->lqw_count) {
+				/* no OST left to try, give up */
+				break;
+			}
 		}
 
-		/* On average, this will hit larger-weighted osts more often.
-		   0-weight osts will always get used last (only when rand=0) */
-		for (i = 0; i < osts->op_count; i++) {
-			__u32 idx = osts->op_array[i];
-
-			if (!cfs_bitmap_check(m->lod_ost_bitmap, idx))
-				continue;
-
-			ost = OST_TGT(m,idx);
-
-			if (!ost->ltd_qos.ltq_usable)
-				continue;
-
-			cur_weight += ost->ltd_qos.ltq_weight;
-			QOS_DEBUG("stripe_cnt=%d nfound=%d cur_weight="LPU64
-				  " rand="LPU64" total_weight="LPU64"\n",
-				  stripe_cnt, nfound, cur_weight, rand,
-				  total_weight);
+		i = w->lqw_idx[j];
+		QOS_DEBUG("stripe_cnt=%d nfound=%d rand="LPU64
+			  " total_weight="LPU64" stripe=%d to idx=%d\n",
+			  stripe_cnt, nfound, rand, total_weight, nfound, i);
 
-			if (cur_weight < rand)
-				continue;
-
-			QOS_DEBUG("stripe=%d to idx=%d\n", nfound, idx);
-
-			/*
-			 * do not put >1 objects on a single OST
-			 */
-			if (lod_qos_is_ost_used(env, idx, nfound))
-				continue;
-			lod_qos_ost_in_use(env, nfound, idx);
+		/* do not put >1 objects on a single OST and don't retry
+		 * an OST which failed to give us an object */
+		OST_TGT(m, i)->ltd_qos.ltq_usable = 0;
+		lod_qos_wt_set(w, j, 0);
 
-			o = lod_qos_declare_object_on(env, m, idx, th);
-			if (IS_ERR(o)) {
-				QOS_DEBUG("can't declare object on #%u: %d\n",
-					  idx, (int) PTR_ERR(o));
-				continue;
-			}
-			stripe[nfound++] = o;
-			lod_qos_used(m, osts, idx, &total_weight);
-			rc = 0;
-			break;
+		if (lod_qos_wt_check(env, m, i)) {
+			/* out of the candidates until the next rebuild */
+			w->lqw_good--;
+			continue;
 		}
+		w->lqw_taken[w->lqw_ntaken++] = j;
 
-		if (rc) {
-			/* no OST found on this iteration, give up */
-			break;
+		o = lod_qos_declare_object_on(env, m, i, th);
+		if (IS_ERR(o)) {
+			QOS_DEBUG("can't declare object on #%u: %d\n",
+				  i, (int) PTR_ERR(o));
+			continue;
 		}
+		stripe[nfound++] = o;
+		lod_qos_used(m, w, j);
+		rc = 0;
 	}
 
+	lod_qos_used_fini(m, w, nfound);
+
 	if (unlikely(nfound != stripe_cnt)) {
 		/*
 		 * when the decision to use weighted algorithm was made
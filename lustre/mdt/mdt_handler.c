@@ -4353,7 +4353,7 @@ TGT_SEC_HDL_VAR(0,			SEC_CTX_FINI,	  mdt_sec_ctx_handle)
 };
 
 static struct tgt_handler mdt_quota_ops[] = {
-TGT_QUOTA_HDL(HABEO_REFERO,		QUOTA_DQACQ,	  mdt_quota_dqacq),
+TGT_QUOTA_HDL(0,			QUOTA_DQACQ,	  mdt_quota_dqacq),
 };
 
 static struct tgt_opc_slice mdt_common_slice[] = {
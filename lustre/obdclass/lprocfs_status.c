@@ -648,11 +648,10 @@ static const char *obd_connect_names[] = {
 	"disp_stripe",
 	"open_by_fid",
 	"lfsck",
-	"unknown",
+	"dqacq_batch",
 	"unlink_close",
 	"unknown",
 	"dir_stripe",
-	"unknown",
 	NULL
 };
 
@@ -151,13 +151,24 @@ void lu_object_put(const struct lu_env *env, struct lu_object *o)
 
 	if (!lu_object_is_dying(top) &&
 	    (lu_object_exists(orig) || lu_object_is_cl(orig))) {
-		LASSERT(list_empty(&top->loh_lru));
-		list_add_tail(&top->loh_lru, &bkt->lsb_lru);
-		bkt->lsb_lru_len++;
+		/* lookup leaves the object on the LRU list, see
+		 * htable_lookup(), just move it to the hot end */
+		if (list_empty(&top->loh_lru)) {
+			list_add_tail(&top->loh_lru, &bkt->lsb_lru);
+			bkt->lsb_lru_len++;
+		} else {
+			list_move_tail(&top->loh_lru, &bkt->lsb_lru);
+		}
+		atomic_inc(&bkt->lsb_idle);
                 cfs_hash_bd_unlock(site->ls_obj_hash, &bd, 1);
                 return;
         }
 
+	if (!list_empty(&top->loh_lru)) {
+		list_del_init(&top->loh_lru);
+		bkt->lsb_lru_len--;
+	}
+
         /*
          * If object is dying (will not be cached), removed it
          * from hash table and LRU.
@@ -380,7 +391,13 @@ int lu_site_purge(const struct lu_env *env, struct lu_site *s, int nr)
                 bkt = cfs_hash_bd_extra_get(s->ls_obj_hash, &bd);
 
 		list_for_each_entry_safe(h, temp, &bkt->lsb_lru, loh_lru) {
-			LASSERT(atomic_read(&h->loh_ref) == 0);
+			/* the object was found by lookup after it had been
+			 * put to the LRU, drop it from the list now */
+			if (atomic_read(&h->loh_ref) > 0) {
+				list_del_init(&h->loh_lru);
+				bkt->lsb_lru_len--;
+				continue;
+			}
 
                         cfs_hash_bd_get(s->ls_obj_hash, &h->loh_fid, &bd2);
                         LASSERT(bd.bd_bucket == bd2.bd_bucket);
@@ -389,6 +406,7 @@ int lu_site_purge(const struct lu_env *env, struct lu_site *s, int nr)
                                                &bd2, &h->loh_hash);
 			list_move(&h->loh_lru, &dispose);
 			bkt->lsb_lru_len--;
+			atomic_dec(&bkt->lsb_idle);
                         if (did_sth == 0)
                                 did_sth = 1;
 
@@ -599,12 +617,12 @@ static struct lu_object *htable_lookup(struct lu_site *s,
 
         h = container_of0(hnode, struct lu_object_header, loh_hash);
         if (likely(!lu_object_is_dying(h))) {
+		/* the bucket may be only read-locked here, so the object
+		 * is left on the LRU list: lu_object_put() moves it to the
+		 * hot end once released and lu_site_purge() drops it from
+		 * the list if it is still referenced */
 		cfs_hash_get(s->ls_obj_hash, hnode);
                 lprocfs_counter_incr(s->ls_stats, LU_SS_CACHE_HIT);
-		if (!list_empty(&h->loh_lru)) {
-			list_del_init(&h->loh_lru);
-			bkt->lsb_lru_len--;
-		}
                 return lu_object_top(h);
         }
 
@@ -725,9 +743,11 @@ static struct lu_object *lu_object_find_try(const struct lu_env *env,
 
         s  = dev->ld_site;
         hs = s->ls_obj_hash;
-        cfs_hash_bd_get_and_lock(hs, (void *)f, &bd, 1);
-        o = htable_lookup(s, &bd, f, waiter, &version);
-        cfs_hash_bd_unlock(hs, &bd, 1);
+	/* lookup of a cached object modifies neither the hash nor the LRU,
+	 * so the bucket is shared by concurrent lookups */
+	cfs_hash_bd_get_and_lock(hs, (void *)f, &bd, 0);
+	o = htable_lookup(s, &bd, f, waiter, &version);
+	cfs_hash_bd_unlock(hs, &bd, 0);
 	if (!IS_ERR(o) || PTR_ERR(o) != -ENOENT)
                 return o;
 
@@ -1002,7 +1022,15 @@ static void lu_obj_hop_get(cfs_hash_t *hs, struct hlist_node *hnode)
 	struct lu_object_header *h;
 
 	h = hlist_entry(hnode, struct lu_object_header, loh_hash);
-	atomic_inc(&h->loh_ref);
+	if (atomic_inc_return(&h->loh_ref) == 1) {
+		struct lu_site_bkt_data *bkt;
+		cfs_hash_bd_t		 bd;
+
+		/* an idle object is taken from the cache */
+		cfs_hash_bd_get(hs, &h->loh_fid, &bd);
+		bkt = cfs_hash_bd_extra_get(hs, &bd);
+		atomic_dec(&bkt->lsb_idle);
+	}
 }
 
 static void lu_obj_hop_put_locked(cfs_hash_t *hs, struct hlist_node *hnode)
@@ -1059,7 +1087,7 @@ int lu_site_init(struct lu_site *s, struct lu_device *top)
 						 bits - LU_SITE_BKT_BITS,
 						 sizeof(*bkt), 0, 0,
 						 &lu_site_hash_ops,
-						 CFS_HASH_SPIN_BKTLOCK |
+						 CFS_HASH_RW_BKTLOCK |
 						 CFS_HASH_NO_ITEMREF |
 						 CFS_HASH_DEPTH |
 						 CFS_HASH_ASSERT_EMPTY |
@@ -1076,6 +1104,7 @@ int lu_site_init(struct lu_site *s, struct lu_device *top)
 	cfs_hash_for_each_bucket(s->ls_obj_hash, &bd, i) {
 		bkt = cfs_hash_bd_extra_get(s->ls_obj_hash, &bd);
 		INIT_LIST_HEAD(&bkt->lsb_lru);
+		atomic_set(&bkt->lsb_idle, 0);
 		init_waitqueue_head(&bkt->lsb_marche_funebre);
 	}
 
@@ -1870,8 +1899,8 @@ static void lu_site_stats_get(cfs_hash_t *hs,
 		struct hlist_head	*hhead;
 
                 cfs_hash_bd_lock(hs, &bd, 1);
-		stats->lss_busy  +=
-			cfs_hash_bd_count_get(&bd) - bkt->lsb_lru_len;
+		stats->lss_busy  += cfs_hash_bd_count_get(&bd) -
+				    atomic_read(&bkt->lsb_idle);
                 stats->lss_total += cfs_hash_bd_count_get(&bd);
                 stats->lss_max_search = max((int)stats->lss_max_search,
                                             cfs_hash_bd_depmax_get(&bd));
@@ -1057,52 +1057,106 @@ static inline int can_merge_pages(struct brw_page *p1, struct brw_page *p2)
         return (p1->off + p1->count == p2->off);
 }
 
+struct osc_cksum_args {
+	struct brw_page	**oca_pga;
+	unsigned int	  oca_npages;
+	/* bytes of the last page to be checksummed */
+	unsigned int	  oca_last_count;
+};
+
+static void osc_checksum_page_get(void *data, unsigned int idx,
+				  struct page **page, unsigned int *offset,
+				  unsigned int *len)
+{
+	struct osc_cksum_args	*oca = data;
+	struct brw_page		*pg  = oca->oca_pga[idx];
+
+	*page = pg->pg;
+	*offset = pg->off & ~CFS_PAGE_MASK;
+	*len = idx == oca->oca_npages - 1 ? oca->oca_last_count : pg->count;
+	LL_CDEBUG_PAGE(D_PAGE, pg->pg, "off %d\n", (int)*offset);
+}
+
+/* Number of T10-DIF guard tags needed to cover the first \a pg_count pages
+ * of \a pga. */
+static unsigned int osc_t10_guard_count(obd_count pg_count,
+					struct brw_page **pga)
+{
+	unsigned int	count = 0;
+	obd_count	i;
+
+	for (i = 0; i < pg_count; i++)
+		count += obd_t10_guard_count(pga[i]->count);
+
+	return count;
+}
+
+/* Compute the T10CRC checksum of the pages in \a oca, storing the guard
+ * tags into \a guards if it is given. */
+static int osc_checksum_t10(struct osc_cksum_args *oca, __be16 *guards,
+			    __u32 *cksum)
+{
+	unsigned int	nguards = osc_t10_guard_count(oca->oca_npages,
+						      oca->oca_pga);
+	__be16		*buf = guards;
+	int		rc;
+
+	if (guards == NULL) {
+		OBD_ALLOC_LARGE(buf, nguards * sizeof(*buf));
+		if (buf == NULL)
+			return -ENOMEM;
+	}
+
+	rc = obd_t10_guards_cksum(osc_checksum_page_get, oca, oca->oca_npages,
+				  buf, nguards, cksum);
+
+	if (guards == NULL)
+		OBD_FREE_LARGE(buf, nguards * sizeof(*buf));
+
+	return rc;
+}
+
 static obd_count osc_checksum_bulk(int nob, obd_count pg_count,
 				   struct brw_page **pga, int opc,
-				   cksum_type_t cksum_type)
+				   cksum_type_t cksum_type, __be16 *guards)
 {
-	__u32				cksum;
-	int				i = 0;
-	struct cfs_crypto_hash_desc	*hdesc;
-	unsigned int			bufsize;
-	int				err;
-	unsigned char			cfs_alg = cksum_obd2cfs(cksum_type);
+	struct osc_cksum_args	oca = { .oca_pga = pga };
+	__u32			cksum;
+	unsigned int		bufsize;
+	int			err;
+	unsigned char		cfs_alg = cksum_obd2cfs(cksum_type);
 
 	LASSERT(pg_count > 0);
 
-	hdesc = cfs_crypto_hash_init(cfs_alg, NULL, 0);
-	if (IS_ERR(hdesc)) {
-		CERROR("Unable to initialize checksum hash %s\n",
-		       cfs_crypto_hash_name(cfs_alg));
-		return PTR_ERR(hdesc);
-	}
+	/* corrupt the data before we compute the checksum, to
+	 * simulate an OST->client data error */
+	if (opc == OST_READ && OBD_FAIL_CHECK(OBD_FAIL_OSC_CHECKSUM_RECEIVE)) {
+		unsigned char *ptr = kmap(pga[0]->pg);
+		int off = pga[0]->off & ~CFS_PAGE_MASK;
 
-	while (nob > 0 && pg_count > 0) {
-		unsigned int count = pga[i]->count > nob ? nob : pga[i]->count;
+		memcpy(ptr + off, "bad1", min_t(typeof(nob), 4, nob));
+		kunmap(pga[0]->pg);
+	}
 
-		/* corrupt the data before we compute the checksum, to
-		 * simulate an OST->client data error */
-		if (i == 0 && opc == OST_READ &&
-		    OBD_FAIL_CHECK(OBD_FAIL_OSC_CHECKSUM_RECEIVE)) {
-			unsigned char *ptr = kmap(pga[i]->pg);
-			int off = pga[i]->off & ~CFS_PAGE_MASK;
+	while (nob > 0 && oca.oca_npages < pg_count) {
+		struct brw_page *pg = pga[oca.oca_npages++];
 
-			memcpy(ptr + off, "bad1", min_t(typeof(nob), 4, nob));
-			kunmap(pga[i]->pg);
-		}
-		cfs_crypto_hash_update_page(hdesc, pga[i]->pg,
-					    pga[i]->off & ~CFS_PAGE_MASK,
-					    count);
-		LL_CDEBUG_PAGE(D_PAGE, pga[i]->pg, "off %d\n",
-			       (int)(pga[i]->off & ~CFS_PAGE_MASK));
-
-		nob -= pga[i]->count;
-		pg_count--;
-		i++;
+		oca.oca_last_count = pg->count > nob ? nob : pg->count;
+		nob -= pg->count;
 	}
 
 	bufsize = sizeof(cksum);
-	err = cfs_crypto_hash_final(hdesc, (unsigned char *)&cksum, &bufsize);
+	if (cksum_type == OBD_CKSUM_T10CRC)
+		err = osc_checksum_t10(&oca, guards, &cksum);
+	else
+		err = cfs_crypto_hash_pages(cfs_alg, osc_checksum_page_get,
+					    &oca, oca.oca_npages,
+					    (unsigned char *)&cksum, &bufsize);
+	if (err != 0) {
+		CERROR("Unable to compute checksum hash %s: rc = %d\n",
+		       cfs_crypto_hash_name(cfs_alg), err);
+		return err;
+	}
 
 	/* For sending we only compute the wrong checksum instead
 	 * of corrupting the data so it is still correct on a redo */
@@ -1128,6 +1182,8 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
         struct osc_brw_async_args *aa;
         struct req_capsule      *pill;
         struct brw_page *pg_prev;
+	cksum_type_t		 cksum_type = cli->cl_cksum_type;
+	unsigned int		 nguards = 0;
 
         ENTRY;
         if (OBD_FAIL_CHECK(OBD_FAIL_OSC_BRW_PREP_REQ))
@@ -1158,6 +1214,13 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
         req_capsule_set_size(pill, &RMF_NIOBUF_REMOTE, RCL_CLIENT,
                              niocount * sizeof(*niobuf));
         osc_set_capa_size(req, &RMF_CAPA1, ocapa);
+	/* cl_cksum_type can be changed via lprocfs, so the type sampled here
+	 * is the one used for the whole RPC. */
+	if (opc == OST_WRITE && cli->cl_checksum &&
+	    cksum_type == OBD_CKSUM_T10CRC)
+		nguards = osc_t10_guard_count(page_count, pga);
+	req_capsule_set_size(pill, &RMF_T10_GUARDS, RCL_CLIENT,
+			     nguards * sizeof(__be16));
 
         rc = ptlrpc_request_pack(req, LUSTRE_OST_VERSION, opc);
         if (rc) {
@@ -1255,20 +1318,24 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
         if (opc == OST_WRITE) {
                 if (cli->cl_checksum &&
                     !sptlrpc_flavor_has_bulk(&req->rq_flvr)) {
-                        /* store cl_cksum_type in a local variable since
-                         * it can be changed via lprocfs */
-                        cksum_type_t cksum_type = cli->cl_cksum_type;
+			__be16 *guards = NULL;
 
+			/* cl_checksum may have been set after the request
+			 * was packed, without room for the tags */
+			if (cksum_type == OBD_CKSUM_T10CRC && nguards > 0)
+				guards = req_capsule_client_get(pill,
+							&RMF_T10_GUARDS);
                         if ((body->oa.o_valid & OBD_MD_FLFLAGS) == 0) {
                                 oa->o_flags &= OBD_FL_LOCAL_MASK;
                                 body->oa.o_flags = 0;
                         }
                         body->oa.o_flags |= cksum_type_pack(cksum_type);
                         body->oa.o_valid |= OBD_MD_FLCKSUM | OBD_MD_FLFLAGS;
-                        body->oa.o_cksum = osc_checksum_bulk(requested_nob,
-                                                             page_count, pga,
-                                                             OST_WRITE,
-                                                             cksum_type);
+			body->oa.o_cksum = osc_checksum_bulk(requested_nob,
+							     page_count, pga,
+							     OST_WRITE,
+							     cksum_type,
+							     guards);
                         CDEBUG(D_PAGE, "checksum at write origin: %x\n",
                                body->oa.o_cksum);
                         /* save this in 'oa', too, for later checking */
@@ -1288,7 +1355,7 @@ static int osc_brw_prep_request(int cmd, struct client_obd *cli,struct obdo *oa,
                     !sptlrpc_flavor_has_bulk(&req->rq_flvr)) {
                         if ((body->oa.o_valid & OBD_MD_FLFLAGS) == 0)
                                 body->oa.o_flags = 0;
-                        body->oa.o_flags |= cksum_type_pack(cli->cl_cksum_type);
+			body->oa.o_flags |= cksum_type_pack(cksum_type);
                         body->oa.o_valid |= OBD_MD_FLCKSUM | OBD_MD_FLFLAGS;
                 }
         }
@@ -1335,8 +1402,8 @@ static int check_write_checksum(struct obdo *oa, const lnet_process_id_t *peer,
 
         cksum_type = cksum_type_unpack(oa->o_valid & OBD_MD_FLFLAGS ?
                                        oa->o_flags : 0);
-        new_cksum = osc_checksum_bulk(nob, page_count, pga, OST_WRITE,
-                                      cksum_type);
+	new_cksum = osc_checksum_bulk(nob, page_count, pga, OST_WRITE,
+				      cksum_type, NULL);
 
         if (cksum_type != client_cksum_type)
                 msg = "the server did not use the checksum type specified in "
@@ -1459,9 +1526,9 @@ static int osc_brw_fini_request(struct ptlrpc_request *req, int rc)
 
                 cksum_type = cksum_type_unpack(body->oa.o_valid &OBD_MD_FLFLAGS?
                                                body->oa.o_flags : 0);
-                client_cksum = osc_checksum_bulk(rc, aa->aa_page_count,
-                                                 aa->aa_ppga, OST_READ,
-                                                 cksum_type);
+		client_cksum = osc_checksum_bulk(rc, aa->aa_page_count,
+						 aa->aa_ppga, OST_READ,
+						 cksum_type, NULL);
 
                 if (peer->nid == req->rq_bulk->bd_sender) {
                         via = router = "";
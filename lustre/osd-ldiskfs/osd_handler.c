@@ -5869,6 +5869,7 @@ static void osd_key_fini(const struct lu_context *ctx,
 	OBD_FREE(info->oti_it_ea_buf, OSD_IT_EA_BUFSIZE);
 	lu_buf_free(&info->oti_iobuf.dr_pg_buf);
 	lu_buf_free(&info->oti_iobuf.dr_bl_buf);
+	lu_buf_free(&info->oti_iobuf.dr_gd_buf);
 	lu_buf_free(&info->oti_big_buf);
 	OBD_FREE_PTR(info);
 }
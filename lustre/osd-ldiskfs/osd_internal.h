@@ -198,6 +198,10 @@ struct osd_otable_cache {
 
 	/* Position for up layer LFSCK iteration pre-loading. */
 	__u32		       ooc_pos_preload;
+
+	/* First block group not read ahead yet for pre-loading, kept across
+	 * the cache refills, 0 when the iteration restarts. */
+	__u32		       ooc_ra_bg;
 };
 
 struct osd_otable_it {
@@ -474,6 +478,18 @@ struct osd_it_quota {
 
 #define MAX_BLOCKS_PER_PAGE (PAGE_CACHE_SIZE / 512)
 
+/* protection information tuple of the T10-DIF Type 1 format */
+struct osd_pi_tuple {
+	__be16	opt_guard_tag;
+	__be16	opt_app_tag;
+	__be32	opt_ref_tag;
+};
+
+/* pages needed to hold the PI tuples of a full iobuf with 512-byte sectors */
+#define OSD_PI_MAX_PAGES \
+	DIV_ROUND_UP(PTLRPC_MAX_BRW_PAGES * MAX_BLOCKS_PER_PAGE * \
+		     sizeof(struct osd_pi_tuple), PAGE_CACHE_SIZE)
+
 struct osd_iobuf {
 	wait_queue_head_t  dr_wait;
 	atomic_t       dr_numreqs;  /* number of reqs being processed */
@@ -488,6 +504,13 @@ struct osd_iobuf {
 	struct page      **dr_pages;
 	struct lu_buf	   dr_bl_buf;
 	unsigned long     *dr_blocks;
+	/* T10-DIF guard tags of each page, verified by the target */
+	struct lu_buf	   dr_gd_buf;
+	__be16		 **dr_guards;
+	int		   dr_nguarded; /* pages having guard tags */
+	/* pages holding the PI tuples passed down with the bios */
+	struct page	  *dr_pi_pages[OSD_PI_MAX_PAGES];
+	int		   dr_pi_npages;
 	unsigned long      dr_start_time;
 	unsigned long      dr_elapsed;  /* how long io took */
 	struct osd_device *dr_dev;
@@ -54,12 +54,20 @@
  * OBD_FAIL_CHECK
  */
 #include <obd_support.h>
+/* obd_t10_guard_count() */
+#include <obd_cksum.h>
 
 #include "osd_internal.h"
 
 /* ext_depth() */
 #include <ldiskfs/ldiskfs_extents.h>
 
+static void osd_iobuf_pi_free(struct osd_iobuf *iobuf)
+{
+	while (iobuf->dr_pi_npages > 0)
+		__free_page(iobuf->dr_pi_pages[--iobuf->dr_pi_npages]);
+}
+
 static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 			    int rw, int line, int pages)
 {
@@ -78,6 +86,8 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 	iobuf->dr_dev = d;
 	iobuf->dr_frags = 0;
 	iobuf->dr_elapsed = 0;
+	iobuf->dr_nguarded = 0;
+	osd_iobuf_pi_free(iobuf);
 	/* must be counted before, so assert */
 	iobuf->dr_rw = rw;
 	iobuf->dr_init_at = line;
@@ -86,6 +96,8 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 	if (iobuf->dr_bl_buf.lb_len >= blocks * sizeof(iobuf->dr_blocks[0])) {
 		LASSERT(iobuf->dr_pg_buf.lb_len >=
 			pages * sizeof(iobuf->dr_pages[0]));
+		LASSERT(iobuf->dr_gd_buf.lb_len >=
+			pages * sizeof(iobuf->dr_guards[0]));
 		return 0;
 	}
 
@@ -112,6 +124,11 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 	if (unlikely(iobuf->dr_pages == NULL))
 		return -ENOMEM;
 
+	lu_buf_realloc(&iobuf->dr_gd_buf, pages * sizeof(iobuf->dr_guards[0]));
+	iobuf->dr_guards = iobuf->dr_gd_buf.lb_buf;
+	if (unlikely(iobuf->dr_guards == NULL))
+		return -ENOMEM;
+
 	iobuf->dr_max_pages = pages;
 
 	return 0;
@@ -119,16 +136,26 @@ static int __osd_init_iobuf(struct osd_device *d, struct osd_iobuf *iobuf,
 #define osd_init_iobuf(dev, iobuf, rw, pages) \
 	__osd_init_iobuf(dev, iobuf, rw, __LINE__, pages)
 
-static void osd_iobuf_add_page(struct osd_iobuf *iobuf, struct page *page)
+/*
+ * \a guards are the T10-DIF guard tags of the full page, computed and
+ * verified by the target, or NULL if the page has none.
+ */
+static void osd_iobuf_add_page(struct osd_iobuf *iobuf, struct page *page,
+			       __be16 *guards)
 {
-        LASSERT(iobuf->dr_npages < iobuf->dr_max_pages);
-        iobuf->dr_pages[iobuf->dr_npages++] = page;
+	LASSERT(iobuf->dr_npages < iobuf->dr_max_pages);
+	if (guards != NULL)
+		iobuf->dr_nguarded++;
+	iobuf->dr_guards[iobuf->dr_npages] = guards;
+	iobuf->dr_pages[iobuf->dr_npages++] = page;
 }
 
 void osd_fini_iobuf(struct osd_device *d, struct osd_iobuf *iobuf)
 {
         int rw = iobuf->dr_rw;
 
+	osd_iobuf_pi_free(iobuf);
+
         if (iobuf->dr_elapsed_valid) {
                 iobuf->dr_elapsed_valid = 0;
                 LASSERT(iobuf->dr_dev == d);
@@ -255,6 +282,135 @@ static int can_be_merged(struct bio *bio, sector_t sector)
 	return bio_end_sector(bio) == sector ? 1 : 0;
 }
 
+#ifdef CONFIG_BLK_DEV_INTEGRITY
+#define OSD_PI_TUPLES_PER_PAGE	(PAGE_CACHE_SIZE / sizeof(struct osd_pi_tuple))
+
+/*
+ * Check whether the guard tags of \a iobuf can be passed down to \a bdev
+ * as T10-DIF Type 1 protection information, and allocate the pages for the
+ * PI tuples if so. This is only done for writes where every page has guard
+ * tags, otherwise the block layer generates the PI itself.
+ */
+static bool osd_iobuf_pi_prep(struct osd_iobuf *iobuf,
+			      struct block_device *bdev)
+{
+	struct blk_integrity	*bi;
+	int			 npages;
+
+	if (iobuf->dr_rw != 1 || iobuf->dr_npages == 0 ||
+	    iobuf->dr_nguarded != iobuf->dr_npages)
+		return false;
+
+	bi = bdev_get_integrity(bdev);
+	if (bi == NULL || bi->name == NULL ||
+	    strcmp(bi->name, "T10-DIF-TYPE1-CRC") != 0 ||
+	    bi->tuple_size != sizeof(struct osd_pi_tuple) ||
+	    bdev_logical_block_size(bdev) != OBD_T10_SECTOR_SIZE)
+		return false;
+
+	npages = DIV_ROUND_UP(iobuf->dr_npages * MAX_BLOCKS_PER_PAGE,
+			      OSD_PI_TUPLES_PER_PAGE);
+	LASSERT(npages <= OSD_PI_MAX_PAGES);
+	while (iobuf->dr_pi_npages < npages) {
+		struct page *page = alloc_page(GFP_NOIO);
+
+		if (page == NULL) {
+			osd_iobuf_pi_free(iobuf);
+			return false;
+		}
+		iobuf->dr_pi_pages[iobuf->dr_pi_npages++] = page;
+	}
+
+	return true;
+}
+
+static struct osd_pi_tuple *osd_iobuf_pi_tuple(struct osd_iobuf *iobuf,
+					       unsigned int idx)
+{
+	struct page *page = iobuf->dr_pi_pages[idx / OSD_PI_TUPLES_PER_PAGE];
+
+	return (struct osd_pi_tuple *)page_address(page) +
+	       idx % OSD_PI_TUPLES_PER_PAGE;
+}
+
+/*
+ * Store the guard tags of \a len bytes at \a offset of page \a page_idx
+ * into the PI tuples starting at \a idx, return the next tuple index.
+ */
+static unsigned int osd_iobuf_pi_fill(struct osd_iobuf *iobuf,
+				      unsigned int idx, int page_idx,
+				      unsigned int offset, unsigned int len)
+{
+	__be16		*guards = iobuf->dr_guards[page_idx];
+	unsigned int	 i;
+
+	guards += offset >> OBD_T10_SECTOR_SHIFT;
+	for (i = 0; i < obd_t10_guard_count(len); i++, idx++)
+		osd_iobuf_pi_tuple(iobuf, idx)->opt_guard_tag = guards[i];
+
+	return idx;
+}
+
+/*
+ * Attach the PI tuples starting at \a idx to \a bio, setting the reference
+ * tags from the bio sectors. If the payload cannot be attached the bio is
+ * submitted without it and the block layer generates the PI.
+ */
+static void osd_bio_pi_attach(struct osd_iobuf *iobuf, struct bio *bio,
+			      unsigned int idx)
+{
+	struct bio_integrity_payload	*bip;
+	sector_t			 sector = bio_start_sector(bio);
+	unsigned int			 count = bio_sectors(bio);
+	unsigned int			 first = idx / OSD_PI_TUPLES_PER_PAGE;
+	unsigned int			 last;
+	unsigned int			 i;
+
+	for (i = 0; i < count; i++) {
+		struct osd_pi_tuple *pt = osd_iobuf_pi_tuple(iobuf, idx + i);
+
+		pt->opt_app_tag = 0;
+		pt->opt_ref_tag = cpu_to_be32((__u32)(sector + i));
+	}
+
+	last = (idx + count - 1) / OSD_PI_TUPLES_PER_PAGE;
+	bip = bio_integrity_alloc(bio, GFP_NOIO, last - first + 1);
+	if (IS_ERR_OR_NULL(bip))
+		return;
+	bip_set_sector(bip, sector);
+
+	for (i = first; i <= last; i++) {
+		unsigned int start = max(idx, i * OSD_PI_TUPLES_PER_PAGE);
+		unsigned int end = min(idx + count,
+				       (i + 1) * OSD_PI_TUPLES_PER_PAGE);
+
+		bio_integrity_add_page(bio, iobuf->dr_pi_pages[i],
+			(end - start) * sizeof(struct osd_pi_tuple),
+			(start % OSD_PI_TUPLES_PER_PAGE) *
+			sizeof(struct osd_pi_tuple));
+	}
+}
+#else /* !CONFIG_BLK_DEV_INTEGRITY */
+static inline bool osd_iobuf_pi_prep(struct osd_iobuf *iobuf,
+				     struct block_device *bdev)
+{
+	return false;
+}
+
+static inline unsigned int osd_iobuf_pi_fill(struct osd_iobuf *iobuf,
+					     unsigned int idx, int page_idx,
+					     unsigned int offset,
+					     unsigned int len)
+{
+	return idx;
+}
+
+static inline void osd_bio_pi_attach(struct osd_iobuf *iobuf,
+				     struct bio *bio, unsigned int idx)
+{
+}
+#endif /* CONFIG_BLK_DEV_INTEGRITY */
+
 static int osd_do_bio(struct osd_device *osd, struct inode *inode,
                       struct osd_iobuf *iobuf)
 {
@@ -274,10 +430,20 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
         int            page_idx;
         int            i;
         int            rc = 0;
+	/* PI tuple indices: next free, first of the current fragment/bio */
+	unsigned int   pi_next = 0;
+	unsigned int   pi_frag = 0;
+	unsigned int   pi_start = 0;
+	bool	       pi;
         ENTRY;
 
         LASSERT(iobuf->dr_npages == npages);
 
+	pi = osd_iobuf_pi_prep(iobuf, inode->i_sb->s_bdev);
+	if (pi)
+		CDEBUG(D_INODE, "%s: passing T10 guards of %d pages to the "
+		       "device\n", osd_name(osd), npages);
+
         osd_brw_stats_update(osd, iobuf);
         iobuf->dr_start_time = cfs_time_current();
 
@@ -312,6 +478,13 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
                                 sector_bits))
                                 nblocks++;
 
+			pi_frag = pi_next;
+			if (pi)
+				pi_next = osd_iobuf_pi_fill(iobuf, pi_next,
+							    page_idx,
+							    page_offset,
+							    blocksize * nblocks);
+
                         if (bio != NULL &&
                             can_be_merged(bio, sector) &&
                             bio_add_page(bio, page,
@@ -332,6 +505,8 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
                                        bio_phys_segments(q, bio),
                                        queue_max_phys_segments(q),
 				       0, queue_max_hw_segments(q));
+				if (pi)
+					osd_bio_pi_attach(iobuf, bio, pi_start);
 				record_start_io(iobuf, bi_size);
 				osd_submit_bio(iobuf->dr_rw, bio);
 			}
@@ -353,6 +528,7 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
 			bio->bi_rw = (iobuf->dr_rw == 0) ? READ : WRITE;
 			bio->bi_end_io = dio_complete_routine;
 			bio->bi_private = iobuf;
+			pi_start = pi_frag;
 
 			rc = bio_add_page(bio, page,
 					  blocksize * nblocks, page_offset);
@@ -361,6 +537,8 @@ static int osd_do_bio(struct osd_device *osd, struct inode *inode,
 	}
 
 	if (bio != NULL) {
+		if (pi)
+			osd_bio_pi_attach(iobuf, bio, pi_start);
 		record_start_io(iobuf, bio_sectors(bio) << 9);
 		osd_submit_bio(iobuf->dr_rw, bio);
 		rc = 0;
@@ -401,6 +579,7 @@ static int osd_map_remote_to_local(loff_t offset, ssize_t len, int *nrpages,
 		/* lnb->lnb_flags = rnb->rnb_flags; */
 		lnb->lnb_flags = 0;
 		lnb->lnb_page = NULL;
+		lnb->lnb_guards = NULL;
 		lnb->lnb_rc = 0;
 
                 LASSERTF(plen <= len, "plen %u, len %lld\n", plen,
@@ -1016,7 +1195,7 @@ static int osd_write_prep(const struct lu_env *env, struct dt_object *dt,
 			continue;
 
 		if (maxidx >= lnb[i].lnb_page->index) {
-			osd_iobuf_add_page(iobuf, lnb[i].lnb_page);
+			osd_iobuf_add_page(iobuf, lnb[i].lnb_page, NULL);
 		} else {
 			long off;
 			char *p = kmap(lnb[i].lnb_page);
@@ -1234,7 +1413,12 @@ static int osd_write_commit(const struct lu_env *env, struct dt_object *dt,
 
 		SetPageUptodate(lnb[i].lnb_page);
 
-		osd_iobuf_add_page(iobuf, lnb[i].lnb_page);
+		/* the block layer takes PI for whole sectors only, pass the
+		 * guard tags down for full pages */
+		osd_iobuf_add_page(iobuf, lnb[i].lnb_page,
+				   lnb[i].lnb_page_offset == 0 &&
+				   lnb[i].lnb_len == PAGE_CACHE_SIZE ?
+				   lnb[i].lnb_guards : NULL);
         }
 
         if (OBD_FAIL_CHECK(OBD_FAIL_OST_MAPBLK_ENOSPC)) {
@@ -1318,7 +1502,7 @@ static int osd_read_prep(const struct lu_env *env, struct dt_object *dt,
 			cache_hits++;
 		} else {
 			cache_misses++;
-			osd_iobuf_add_page(iobuf, lnb[i].lnb_page);
+			osd_iobuf_add_page(iobuf, lnb[i].lnb_page, NULL);
 		}
 
 		if (cache == 0)
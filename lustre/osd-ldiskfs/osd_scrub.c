@@ -62,6 +62,11 @@
 #define SCRUB_NEXT_OSTOBJ_OLD	10 /* old OST-object, no LMA or no FID-on-OST
 				    * flags in LMA */
 
+static int osd_scrub_ra_groups = 8;
+CFS_MODULE_PARM(osd_scrub_ra_groups, "i", int, 0644,
+		"Number of block groups to read ahead the inode bitmap and "
+		"inode table for inode iteration, 0 to disable readahead.");
+
 /* misc functions */
 
 static inline struct osd_device *osd_scrub2dev(struct osd_scrub *scrub)
@@ -700,6 +705,7 @@ static int osd_scrub_prep(struct osd_device *dev)
 		sf->sf_pos_latest_start = LDISKFS_FIRST_INO(osd_sb(dev)) + 1;
 
 	scrub->os_pos_current = sf->sf_pos_latest_start;
+	scrub->os_ra_bg = 0;
 	sf->sf_status = SS_SCANNING;
 	sf->sf_time_latest_start = cfs_time_current_sec();
 	sf->sf_time_last_checkpoint = sf->sf_time_latest_start;
@@ -1211,6 +1217,7 @@ static void osd_scrub_join(struct osd_device *dev, __u32 flags,
 		sf->sf_pos_latest_start = LDISKFS_FIRST_INO(osd_sb(dev)) + 1;
 
 	scrub->os_pos_current = sf->sf_pos_latest_start;
+	scrub->os_ra_bg = 0;
 	sf->sf_time_latest_start = cfs_time_current_sec();
 	sf->sf_time_last_checkpoint = sf->sf_time_latest_start;
 	sf->sf_pos_last_checkpoint = sf->sf_pos_latest_start - 1;
@@ -1232,6 +1239,96 @@ static void osd_scrub_join(struct osd_device *dev, __u32 flags,
 	EXIT;
 }
 
+/* The group descriptor accessors of ldiskfs are not exported, read the
+ * fields the same way they do. */
+static inline bool osd_bg_desc_64bit(struct super_block *sb)
+{
+	return LDISKFS_DESC_SIZE(sb) >= LDISKFS_MIN_DESC_SIZE_64BIT;
+}
+
+static inline __u32 osd_bg_free_inodes(struct super_block *sb,
+				       struct ldiskfs_group_desc *desc)
+{
+	return le16_to_cpu(desc->bg_free_inodes_count_lo) |
+	       (osd_bg_desc_64bit(sb) ?
+		(__u32)le16_to_cpu(desc->bg_free_inodes_count_hi) << 16 : 0);
+}
+
+static inline ldiskfs_fsblk_t
+osd_bg_inode_bitmap(struct super_block *sb, struct ldiskfs_group_desc *desc)
+{
+	return le32_to_cpu(desc->bg_inode_bitmap_lo) |
+	       (osd_bg_desc_64bit(sb) ?
+		(ldiskfs_fsblk_t)le32_to_cpu(desc->bg_inode_bitmap_hi) << 32 :
+		0);
+}
+
+static inline ldiskfs_fsblk_t
+osd_bg_inode_table(struct super_block *sb, struct ldiskfs_group_desc *desc)
+{
+	return le32_to_cpu(desc->bg_inode_table_lo) |
+	       (osd_bg_desc_64bit(sb) ?
+		(ldiskfs_fsblk_t)le32_to_cpu(desc->bg_inode_table_hi) << 32 :
+		0);
+}
+
+/**
+ * Read ahead the inode bitmaps and the inode table blocks in use for the
+ * block groups from the current one up to osd_scrub_ra_groups ahead, then
+ * the inode iteration will not wait for the synchronous reading of them
+ * group by group. The block groups without any inode in use are skipped
+ * according to the group descriptors.
+ *
+ * The cursor \a ra_bg lives in the scrub or in the otable cache, so the
+ * window is not read ahead again each time the iteration is re-entered,
+ * e.g. once per otable cache refill. A cursor behind the current group or
+ * beyond the window (iteration moved back, window shrunk) is restarted.
+ *
+ * \param[in] sb	pointer to the super block
+ * \param[in] bg	the block group in iteration
+ * \param[in,out] ra_bg	the first block group that has not been read ahead
+ */
+static void osd_iit_readahead(struct super_block *sb, ldiskfs_group_t bg,
+			      __u32 *ra_bg)
+{
+	__u32		ipg = LDISKFS_INODES_PER_GROUP(sb);
+	__u32		ipb = LDISKFS_INODES_PER_BLOCK(sb);
+	ldiskfs_group_t	end;
+
+	if (osd_scrub_ra_groups <= 0)
+		return;
+
+	end = bg + osd_scrub_ra_groups;
+	if (end > LDISKFS_SB(sb)->s_groups_count)
+		end = LDISKFS_SB(sb)->s_groups_count;
+
+	if (*ra_bg < bg || *ra_bg > end)
+		*ra_bg = bg;
+
+	for (; *ra_bg < end; (*ra_bg)++) {
+		struct ldiskfs_group_desc	*desc;
+		ldiskfs_fsblk_t			 blk;
+		__u32				 used;
+		__u32				 i;
+
+		desc = ldiskfs_get_group_desc(sb, *ra_bg, NULL);
+		if (desc == NULL)
+			return;
+
+		/* It is readahead, the race with inode allocation is
+		 * harmless, so the group lock is unnecessary. */
+		if (desc->bg_flags & cpu_to_le16(LDISKFS_BG_INODE_UNINIT) ||
+		    osd_bg_free_inodes(sb, desc) >= ipg)
+			continue;
+
+		used = ipg - ldiskfs_itable_unused_count(sb, desc);
+		sb_breadahead(sb, osd_bg_inode_bitmap(sb, desc));
+		blk = osd_bg_inode_table(sb, desc);
+		for (i = 0; i < (used + ipb - 1) / ipb; i++)
+			sb_breadahead(sb, blk + i);
+	}
+}
+
 static int osd_inode_iteration(struct osd_thread_info *info,
 			       struct osd_device *dev, __u32 max, bool preload)
 {
@@ -1244,6 +1341,7 @@ static int osd_inode_iteration(struct osd_thread_info *info,
 	__u32		     *count;
 	struct osd_iit_param  param  = { NULL };
 	struct l_wait_info    lwi    = { 0 };
+	__u32		     *ra_bg;
 	__u32		      limit;
 	int		      rc;
 	bool		      noslot = true;
@@ -1344,6 +1442,7 @@ full:
 		exec = osd_scrub_exec;
 		pos = &scrub->os_pos_current;
 		count = &scrub->os_new_checked;
+		ra_bg = &scrub->os_ra_bg;
 	} else {
 		struct osd_otable_cache *ooc = &dev->od_otable_it->ooi_cache;
 
@@ -1351,6 +1450,7 @@ full:
 		exec = osd_preload_exec;
 		pos = &ooc->ooc_pos_preload;
 		count = &ooc->ooc_cached_items;
+		ra_bg = &ooc->ooc_ra_bg;
 	}
 	limit = le32_to_cpu(LDISKFS_SB(param.sb)->s_es->s_inodes_count);
 
@@ -1363,8 +1463,11 @@ full:
 		if (desc == NULL)
 			RETURN(-EIO);
 
+		osd_iit_readahead(param.sb, param.bg, ra_bg);
 		ldiskfs_lock_group(param.sb, param.bg);
-		if (desc->bg_flags & cpu_to_le16(LDISKFS_BG_INODE_UNINIT)) {
+		if (desc->bg_flags & cpu_to_le16(LDISKFS_BG_INODE_UNINIT) ||
+		    osd_bg_free_inodes(param.sb, desc) >=
+		    LDISKFS_INODES_PER_GROUP(param.sb)) {
 			ldiskfs_unlock_group(param.sb, param.bg);
 			*pos = 1 + (param.bg + 1) *
 				LDISKFS_INODES_PER_GROUP(param.sb);
@@ -1479,6 +1582,7 @@ static int osd_scrub_main(void *args)
 			GOTO(post, rc = 0);
 
 		scrub->os_pos_current = ooc->ooc_pos_preload;
+		scrub->os_ra_bg = 0;
 	}
 
 	CDEBUG(D_LFSCK, "%.16s: OI scrub start, flags = 0x%x, pos = %u\n",
@@ -2568,6 +2672,7 @@ static struct dt_it *osd_otable_it_init(const struct lu_env *env,
 	}
 
 	it->ooi_cache.ooc_pos_preload = scrub->os_pos_current;
+	it->ooi_cache.ooc_ra_bg = 0;
 
 	GOTO(out, it);
 
@@ -2735,6 +2840,7 @@ static int osd_otable_it_load(const struct lu_env *env,
 	ooc->ooc_pos_preload = hash;
 	if (ooc->ooc_pos_preload <= LDISKFS_FIRST_INO(osd_sb(dev)))
 		ooc->ooc_pos_preload = LDISKFS_FIRST_INO(osd_sb(dev)) + 1;
+	ooc->ooc_ra_bg = 0;
 
 	it->ooi_user_ready = 1;
 	if (!scrub->os_full_speed)
@@ -225,6 +225,9 @@ struct osd_scrub {
 	/* How many objects have been checked since last checkpoint. */
 	__u32			os_new_checked;
 	__u32			os_pos_current;
+	/* First block group not read ahead yet by the scrub, kept across
+	 * osd_inode_iteration() calls, 0 when the iteration restarts. */
+	__u32			os_ra_bg;
 	__u32			os_start_flags;
 	unsigned int		os_in_prior:1, /* process inconsistent item
 						* found by RPC prior */
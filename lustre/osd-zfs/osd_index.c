@@ -735,6 +735,66 @@ static int osd_dir_delete(const struct lu_env *env, struct dt_object *dt,
 	RETURN(rc);
 }
 
+/* entries consumed between two leaf prefetch windows */
+#define OSD_DIR_PREFETCH	128
+/* ZAP blocks read ahead per window */
+#define OSD_DIR_PREFETCH_BLOCKS	16
+
+static void osd_dir_it_prefetch_reset(struct osd_zap_it *it)
+{
+	it->ozi_pf_blk = 0;
+	it->ozi_prefetched = 0;
+}
+
+/*
+ * Issue asynchronous reads for the directory's ZAP blocks and for the
+ * dnode of the entry @za the iterator has just moved to, so neither
+ * ->rec() nor the getattr which usually follows readdir waits for them.
+ *
+ * The cursor visits the leaves in hash order, which is unrelated to
+ * their block order, so the leaves are read ahead sequentially instead:
+ * a window of OSD_DIR_PREFETCH_BLOCKS blocks every OSD_DIR_PREFETCH
+ * entries. A leaf holds well over OSD_DIR_PREFETCH / OSD_DIR_PREFETCH_BLOCKS
+ * entries, so the reads run ahead of the iteration and cover the whole
+ * directory long before it is listed, without flooding ARC up front.
+ */
+static void osd_dir_it_prefetch(const struct lu_env *env,
+				struct osd_zap_it *it, zap_attribute_t *za)
+{
+	struct osd_object	*obj = it->ozi_obj;
+	struct osd_device	*dev = osd_obj2dev(obj);
+	dmu_object_info_t	*doi = &osd_oti_get(env)->oti_doi;
+	struct zpl_direntry	*zde;
+	uint64_t		 nblks;
+	uint64_t		 count;
+
+	if (za->za_integer_length == 8 && za->za_num_integers >= 1) {
+		zde = (struct zpl_direntry *)&za->za_first_integer;
+		dmu_prefetch(dev->od_os, zde->zde_dnode, 0, 0);
+	}
+
+	if (it->ozi_prefetched-- > 0)
+		return;
+	it->ozi_prefetched = OSD_DIR_PREFETCH;
+
+	dmu_object_info_from_db(obj->oo_db, doi);
+	nblks = doi->doi_max_offset / doi->doi_data_block_size;
+
+	/* block 0 is the ZAP header (or the whole micro ZAP), the cursor
+	 * has read it already */
+	if (it->ozi_pf_blk == 0)
+		it->ozi_pf_blk = 1;
+	if (it->ozi_pf_blk >= nblks)
+		return;
+
+	count = min_t(uint64_t, OSD_DIR_PREFETCH_BLOCKS,
+		      nblks - it->ozi_pf_blk);
+	dmu_prefetch(dev->od_os, obj->oo_db->db_object,
+		     it->ozi_pf_blk * doi->doi_data_block_size,
+		     count * doi->doi_data_block_size);
+	it->ozi_pf_blk += count;
+}
+
 static struct dt_it *osd_dir_it_init(const struct lu_env *env,
 				     struct dt_object *dt,
 				     __u32 unused,
@@ -774,6 +834,7 @@ static int osd_dir_it_get(const struct lu_env *env,
 	/* reset the cursor */
 	zap_cursor_fini(it->ozi_zc);
 	osd_obj_cursor_init_serialized(it->ozi_zc, obj, 0);
+	osd_dir_it_prefetch_reset(it);
 
 	/* XXX: implementation of the API is broken at the moment */
 	LASSERT(((const char *)key)[0] == 0);
@@ -882,6 +943,9 @@ static int osd_dir_it_next(const struct lu_env *env, struct dt_it *di)
 	if (rc == -ENOENT) /* end of dir */
 		RETURN(+1);
 
+	if (rc == 0)
+		osd_dir_it_prefetch(env, it, za);
+
 	RETURN(rc);
 }
 
@@ -1075,6 +1139,7 @@ static int osd_dir_it_load(const struct lu_env *env,
 	/* reset the cursor */
 	zap_cursor_fini(it->ozi_zc);
 	osd_obj_cursor_init_serialized(it->ozi_zc, obj, hash);
+	osd_dir_it_prefetch_reset(it);
 
 	if (hash <= 2) {
 		it->ozi_pos = hash;
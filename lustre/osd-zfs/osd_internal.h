@@ -113,6 +113,10 @@ struct osd_zap_it {
 	 * 2 - ".."
 	 * 3 - real records */
 	unsigned		 ozi_pos:3;
+	/* next ZAP block to read ahead, and the number of entries left
+	 * before the next read-ahead window is issued */
+	uint64_t		 ozi_pf_blk;
+	int			 ozi_prefetched;
 	union {
 		char		 ozi_name[MAXNAMELEN]; /* file name for dir */
 		__u64		 ozi_key; /* binary key for index files */
@@ -782,8 +782,7 @@ static int osd_read_prep(const struct lu_env *env, struct dt_object *dt,
 {
 	struct osd_object *obj  = osd_dt_obj(dt);
 	struct osd_device  *osd = osd_obj2dev(obj);
-	struct lu_buf      buf;
-	loff_t             offset;
+	uint64_t	   eof;
 	int                i;
 	unsigned long	   start;
 	unsigned long	   size = 0;
@@ -793,27 +792,31 @@ static int osd_read_prep(const struct lu_env *env, struct dt_object *dt,
 
 	start = cfs_time_current();
 
+	read_lock(&obj->oo_attr_lock);
+	eof = obj->oo_attr.la_size;
+	read_unlock(&obj->oo_attr_lock);
+
 	record_start_io(osd, READ, npages, 0);
 
+	/* the pages were mapped straight into the dbufs held (and read) by
+	 * osd_bufs_get_read(), so the data is in place already and copying
+	 * it with dmu_read() again would be a memcpy onto itself. just
+	 * report how much valid data every page contains */
 	for (i = 0; i < npages; i++) {
-		buf.lb_buf = kmap(lnb[i].lnb_page);
-		buf.lb_len = lnb[i].lnb_len;
-		offset = lnb[i].lnb_file_offset;
-
 		CDEBUG(D_OTHER, "read %u bytes at %u\n",
 			(unsigned) lnb[i].lnb_len,
 			(unsigned) lnb[i].lnb_file_offset);
-		lnb[i].lnb_rc = osd_read(env, dt, &buf, &offset, NULL);
-		kunmap(lnb[i].lnb_page);
 
-		size += lnb[i].lnb_rc;
-
-		if (lnb[i].lnb_rc < buf.lb_len) {
+		if (lnb[i].lnb_file_offset >= eof) {
 			/* all subsequent rc should be 0 */
-			while (++i < npages)
-				lnb[i].lnb_rc = 0;
+			while (i < npages)
+				lnb[i++].lnb_rc = 0;
 			break;
 		}
+
+		lnb[i].lnb_rc = min_t(uint64_t, lnb[i].lnb_len,
+				      eof - lnb[i].lnb_file_offset);
+		size += lnb[i].lnb_rc;
 	}
 
 	record_end_io(osd, READ, cfs_time_current() - start, size);
@@ -420,6 +420,134 @@ osp_max_create_count_seq_write(struct file *file, const char *buffer,
 }
 LPROC_SEQ_FOPS(osp_max_create_count);
 
+/**
+ * Show number of seconds of creates to keep precreated
+ *
+ * \param[in] m		seq_file handle
+ * \param[in] data	unused for single entry
+ * \retval		0 on success
+ * \retval		negative number on error
+ */
+static int osp_create_window_seq_show(struct seq_file *m, void *data)
+{
+	struct obd_device *obd = m->private;
+	struct osp_device *osp = lu2osp_dev(obd->obd_lu_dev);
+
+	if (osp == NULL || osp->opd_pre == NULL)
+		return 0;
+
+	return seq_printf(m, "%d\n", osp->opd_pre_window);
+}
+
+/**
+ * Change number of seconds of creates to keep precreated
+ *
+ * The precreate thread sizes its requests so that the pool covers the
+ * recent create rate for this many seconds, 0 disables rate-based sizing.
+ *
+ * \param[in] file	proc file
+ * \param[in] buffer	string which represents the window (in seconds)
+ * \param[in] count	\a buffer length
+ * \param[in] off	unused for single entry
+ * \retval		\a count on success
+ * \retval		negative number on error
+ */
+static ssize_t
+osp_create_window_seq_write(struct file *file, const char *buffer,
+			    size_t count, loff_t *off)
+{
+	struct seq_file		*m = file->private_data;
+	struct obd_device	*obd = m->private;
+	struct osp_device	*osp = lu2osp_dev(obd->obd_lu_dev);
+	int			 val, rc;
+
+	if (osp == NULL || osp->opd_pre == NULL)
+		return 0;
+
+	rc = lprocfs_write_helper(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	if (val < 0 || val > obd_timeout)
+		return -ERANGE;
+
+	osp->opd_pre_window = val;
+
+	return count;
+}
+LPROC_SEQ_FOPS(osp_create_window);
+
+#define pct(a, b) (b ? a * 100 / b : 0)
+
+/**
+ * Show precreate statistics
+ *
+ * Prints the recent create rate and the histogram of time the creators
+ * had to wait for the precreated objects, the number of such stalls is
+ * the total of the histogram.
+ *
+ * \param[in] m		seq_file handle
+ * \param[in] data	unused for single entry
+ * \retval		0 on success
+ * \retval		negative number on error
+ */
+static int osp_prealloc_stats_seq_show(struct seq_file *m, void *data)
+{
+	struct obd_device	*obd = m->private;
+	struct osp_device	*osp = lu2osp_dev(obd->obd_lu_dev);
+	struct obd_histogram	*h;
+	unsigned long		 tot, cum = 0;
+	int			 i;
+
+	if (osp == NULL || osp->opd_pre == NULL)
+		return 0;
+
+	h = &osp->opd_pre_wait_hist;
+	tot = lprocfs_oh_sum(h);
+
+	seq_printf(m, "create_rate:           %d objs/s\n", osp->opd_pre_rate);
+	seq_printf(m, "create_window:         %d s\n", osp->opd_pre_window);
+	seq_printf(m, "create_count:          %d\n", osp->opd_pre_grow_count);
+	seq_printf(m, "stalls:                %lu\n", tot);
+	seq_printf(m, "\nstall time (ms)      stalls   %% cum %%\n");
+
+	for (i = 0; i < OBD_HIST_MAX && cum < tot; i++) {
+		unsigned long w = h->oh_buckets[i];
+
+		cum += w;
+		seq_printf(m, "%u:\t\t%10lu %3lu %3lu\n",
+			   1U << i, w, pct(w, tot), pct(cum, tot));
+	}
+
+	return 0;
+}
+
+/**
+ * Reset precreate statistics
+ *
+ * \param[in] file	proc file
+ * \param[in] buffer	unused
+ * \param[in] count	\a buffer length
+ * \param[in] off	unused for single entry
+ * \retval		\a count
+ */
+static ssize_t
+osp_prealloc_stats_seq_write(struct file *file, const char *buffer,
+			     size_t count, loff_t *off)
+{
+	struct seq_file		*m = file->private_data;
+	struct obd_device	*obd = m->private;
+	struct osp_device	*osp = lu2osp_dev(obd->obd_lu_dev);
+
+	if (osp == NULL || osp->opd_pre == NULL)
+		return 0;
+
+	lprocfs_oh_clear(&osp->opd_pre_wait_hist);
+
+	return count;
+}
+LPROC_SEQ_FOPS(osp_prealloc_stats);
+
 /**
  * Show last id to assign in creation
  *
@@ -739,6 +867,8 @@ static struct lprocfs_vars lprocfs_osp_obd_vars[] = {
 	  .fops =	&osp_create_count_fops		},
 	{ .name =	"max_create_count",
 	  .fops =	&osp_max_create_count_fops	},
+	{ .name =	"create_window",
+	  .fops =	&osp_create_window_fops		},
 	{ .name =	"prealloc_next_id",
 	  .fops =	&osp_prealloc_next_id_fops	},
 	{ .name =	"prealloc_next_seq",
@@ -749,6 +879,8 @@ static struct lprocfs_vars lprocfs_osp_obd_vars[] = {
 	  .fops =	&osp_prealloc_last_seq_fops	},
 	{ .name =	"prealloc_reserved",
 	  .fops =	&osp_prealloc_reserved_fops	},
+	{ .name =	"prealloc_stats",
+	  .fops =	&osp_prealloc_stats_fops	},
 	{ .name =	"timeouts",
 	  .fops =	&osp_timeouts_fops		},
 	{ .name =	"import",
@@ -91,8 +91,20 @@ struct osp_precreate {
 	int				 osp_pre_grow_slow;
 	/* cleaning up orphans or recreating missing objects */
 	int				 osp_pre_recovering;
+	/* objects consumed from the pool since osp_pre_rate_start and
+	 * the decaying average of the consumption rate (objects/sec) */
+	time_t				 osp_pre_rate_start;
+	int				 osp_pre_rate_count;
+	int				 osp_pre_rate;
+	/* seconds of creates at the current rate the pool should cover */
+	int				 osp_pre_window;
+	/* how long the creators waited for the pool to refill, msec */
+	struct obd_histogram		 osp_pre_wait_hist;
 };
 
+/* default number of seconds of creates to keep precreated */
+#define OSP_PRE_WINDOW_DEFAULT		2
+
 struct osp_device {
 	struct dt_device		 opd_dt_dev;
 	/* corresponded OST index */
@@ -214,6 +226,11 @@ struct osp_device {
 #define opd_pre_max_grow_count		opd_pre->osp_pre_max_grow_count
 #define opd_pre_grow_slow		opd_pre->osp_pre_grow_slow
 #define opd_pre_recovering		opd_pre->osp_pre_recovering
+#define opd_pre_rate_start		opd_pre->osp_pre_rate_start
+#define opd_pre_rate_count		opd_pre->osp_pre_rate_count
+#define opd_pre_rate			opd_pre->osp_pre_rate
+#define opd_pre_window			opd_pre->osp_pre_window
+#define opd_pre_wait_hist		opd_pre->osp_pre_wait_hist
 
 extern struct kmem_cache *osp_object_kmem;
 
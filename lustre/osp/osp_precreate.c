@@ -255,6 +255,51 @@ static inline int osp_objs_precreated(const struct lu_env *env,
 			    &osp->opd_pre_used_fid);
 }
 
+/**
+ * Return number of objects the pool should hold to cover the create rate
+ *
+ * The demand is the recent create rate multiplied by the configured
+ * window (in seconds). It is limited by the largest single precreate
+ * request, so the precreate thread doesn't spin on a target which can
+ * never be reached. Notice this function relies on an external locking.
+ *
+ * \param[in] d		OSP device
+ *
+ * \retval		the number of objects to keep precreated
+ */
+static inline int osp_precreate_demand_nolock(struct osp_device *d)
+{
+	return min(d->opd_pre_rate * d->opd_pre_window,
+		   d->opd_pre_max_grow_count / 2);
+}
+
+/**
+ * Account an object consumed from the pool in the create rate
+ *
+ * Creates are counted per second and every completed interval is folded
+ * into a decaying average, so the rate follows create bursts in a couple
+ * of seconds and decays quickly once they are over. Notice this function
+ * relies on an external locking.
+ *
+ * \param[in] d		OSP device
+ */
+static void osp_precreate_rate_update_nolock(struct osp_device *d)
+{
+	time_t	now = cfs_time_current_sec();
+	time_t	elapsed = now - d->opd_pre_rate_start;
+
+	if (elapsed > 0) {
+		d->opd_pre_rate = (d->opd_pre_rate +
+				   d->opd_pre_rate_count) / 2;
+		/* halve the rate for every idle second on top */
+		if (elapsed > 1)
+			d->opd_pre_rate >>= min_t(time_t, elapsed - 1, 31);
+		d->opd_pre_rate_count = 0;
+		d->opd_pre_rate_start = now;
+	}
+	d->opd_pre_rate_count++;
+}
+
 /**
  * Check pool of precreated objects is nearly empty
  *
@@ -272,11 +317,12 @@ static inline int osp_objs_precreated(const struct lu_env *env,
 static inline int osp_precreate_near_empty_nolock(const struct lu_env *env,
 						  struct osp_device *d)
 {
-	int window = osp_objs_precreated(env, d);
+	int window = osp_objs_precreated(env, d) - d->opd_pre_reserved;
 
 	/* don't consider new precreation till OST is healty and
 	 * has free space */
-	return ((window - d->opd_pre_reserved < d->opd_pre_grow_count / 2) &&
+	return ((window < d->opd_pre_grow_count / 2 ||
+		 window < osp_precreate_demand_nolock(d)) &&
 		(d->opd_pre_status == 0));
 }
 
@@ -575,6 +621,11 @@ static int osp_precreate_send(const struct lu_env *env, struct osp_device *d)
 	}
 
 	spin_lock(&d->opd_pre_lock);
+	/* ask for enough objects to cover the recent create rate unless
+	 * the OST has been unable to keep up with the previous requests */
+	if (d->opd_pre_grow_slow == 0 &&
+	    d->opd_pre_grow_count < osp_precreate_demand_nolock(d))
+		d->opd_pre_grow_count = osp_precreate_demand_nolock(d);
 	if (d->opd_pre_grow_count > d->opd_pre_max_grow_count / 2)
 		d->opd_pre_grow_count = d->opd_pre_max_grow_count / 2;
 	grow = d->opd_pre_grow_count;
@@ -1290,6 +1341,7 @@ int osp_precreate_reserve(const struct lu_env *env, struct osp_device *d)
 {
 	struct l_wait_info	 lwi;
 	cfs_time_t		 expire = cfs_time_shift(obd_timeout);
+	cfs_time_t		 stall = 0;
 	int			 precreated, rc;
 
 	ENTRY;
@@ -1370,10 +1422,17 @@ int osp_precreate_reserve(const struct lu_env *env, struct osp_device *d)
 			break;
 		}
 
+		if (stall == 0)
+			stall = cfs_time_current();
+
 		l_wait_event(d->opd_pre_user_waitq,
 			     osp_precreate_ready_condition(env, d), &lwi);
 	}
 
+	if (stall != 0)
+		lprocfs_oh_tally_log2(&d->opd_pre_wait_hist,
+			jiffies_to_msecs(cfs_time_current() - stall));
+
 	RETURN(rc);
 }
 
@@ -1414,6 +1473,7 @@ int osp_precreate_get_fid(const struct lu_env *env, struct osp_device *d,
 	d->opd_pre_used_fid.f_oid++;
 	memcpy(fid, &d->opd_pre_used_fid, sizeof(*fid));
 	d->opd_pre_reserved--;
+	osp_precreate_rate_update_nolock(d);
 	/*
 	 * last_used_id must be changed along with getting new id otherwise
 	 * we might miscalculate gap causing object loss or leak
@@ -1548,8 +1608,11 @@ int osp_init_precreate(struct osp_device *d)
 	d->opd_pre_grow_count = OST_MIN_PRECREATE;
 	d->opd_pre_min_grow_count = OST_MIN_PRECREATE;
 	d->opd_pre_max_grow_count = OST_MAX_PRECREATE;
+	d->opd_pre_rate_start = cfs_time_current_sec();
+	d->opd_pre_window = OSP_PRE_WINDOW_DEFAULT;
 
 	spin_lock_init(&d->opd_pre_lock);
+	spin_lock_init(&d->opd_pre_wait_hist.oh_lock);
 	init_waitqueue_head(&d->opd_pre_waitq);
 	init_waitqueue_head(&d->opd_pre_user_waitq);
 	init_waitqueue_head(&d->opd_pre_thread.t_ctl_waitq);
@@ -71,6 +71,22 @@
 
 static spinlock_t krb5_seq_lock;
 
+/* Split the bulk pages among threads only if each one gets at least so many */
+#define KRB5_BULK_CHUNK_PAGES	16
+
+static int krb5_bulk_threads = 4;
+CFS_MODULE_PARM(krb5_bulk_threads, "i", int, 0444,
+		"threads per CPU partition to decrypt and checksum large krb5 "
+		"bulk in parallel, 0 to disable");
+
+/* per-CPT schedulers, a bulk is only handed to threads of its CPT */
+static struct cfs_wi_sched **krb5_bulk_scheds;
+
+static int krb5_bulk_nthreads(int cpt)
+{
+	return min(krb5_bulk_threads, cfs_cpt_weight(cfs_cpt_table, cpt));
+}
+
 struct krb5_enctype {
         char           *ke_dispname;
         char           *ke_enc_name;            /* linux tfm name */
@@ -931,6 +947,124 @@ int krb5_encrypt_rawobjs(struct crypto_blkcipher *tfm,
         RETURN(0);
 }
 
+/*
+ * checksum of the clear bulk computed by a krb5_bulk_scheds thread while
+ * the caller encrypts the pages.
+ */
+struct krb5_cksum_work {
+	cfs_workitem_t		 kcw_wi;
+	struct cfs_wi_sched	*kcw_sched;
+	/* set by whoever computes the checksum, the thread or the caller */
+	atomic_t		 kcw_taken;
+	struct krb5_ctx		*kcw_kctx;
+	struct krb5_header	*kcw_khdr;
+	rawobj_t		*kcw_msgs;
+	struct ptlrpc_bulk_desc	*kcw_desc;
+	rawobj_t		 kcw_cksum;
+	__u32			 kcw_major;
+	struct completion	 kcw_done;
+};
+
+static int krb5_cksum_action(cfs_workitem_t *wi)
+{
+	struct krb5_cksum_work	*kcw = wi->wi_data;
+
+	if (atomic_xchg(&kcw->kcw_taken, 1) == 0)
+		kcw->kcw_major = krb5_make_checksum(kcw->kcw_kctx->kc_enctype,
+						    &kcw->kcw_kctx->kc_keyi,
+						    kcw->kcw_khdr, 1,
+						    kcw->kcw_msgs,
+						    kcw->kcw_desc->bd_iov_count,
+						    kcw->kcw_desc->bd_iov,
+						    &kcw->kcw_cksum);
+
+	/* @kcw is on the stack of the waiter. No cfs_wi_exit(), the waiter
+	 * may still cfs_wi_deschedule() it and nothing schedules it again */
+	complete(&kcw->kcw_done);
+
+	return 1;
+}
+
+/*
+ * a run of bulk pages decrypted by one thread, starting from the cipher
+ * block which precedes it.
+ */
+struct krb5_bulk_chunk {
+	cfs_workitem_t		 kbc_wi;
+	struct crypto_blkcipher	*kbc_tfm;
+	struct ptlrpc_bulk_desc	*kbc_desc;
+	int			 kbc_start;
+	int			 kbc_count;
+	/* chained iv, the last cipher block of the chunk once decrypted */
+	__u8			 kbc_iv[16];
+	int			 kbc_rc;
+	struct cfs_wi_sched	*kbc_sched;
+	/* set by whoever decrypts the chunk, a thread or the caller */
+	atomic_t		 kbc_taken;
+	atomic_t		*kbc_pending;
+	struct completion	*kbc_done;
+};
+
+static int krb5_decrypt_bulk_chunk(struct krb5_bulk_chunk *kbc)
+{
+	struct ptlrpc_bulk_desc	*desc = kbc->kbc_desc;
+	struct blkcipher_desc	 ciph_desc;
+	struct scatterlist	 src, dst;
+	int			 blocksize, i, rc;
+
+	blocksize = crypto_blkcipher_blocksize(kbc->kbc_tfm);
+
+	ciph_desc.tfm  = kbc->kbc_tfm;
+	ciph_desc.info = kbc->kbc_iv;
+	ciph_desc.flags = 0;
+
+	for (i = kbc->kbc_start; i < kbc->kbc_start + kbc->kbc_count; i++) {
+		if (desc->bd_enc_iov[i].kiov_len == 0)
+			continue;
+
+		sg_set_page(&src, desc->bd_enc_iov[i].kiov_page,
+			    desc->bd_enc_iov[i].kiov_len,
+			    desc->bd_enc_iov[i].kiov_offset);
+		dst = src;
+		if (desc->bd_iov[i].kiov_len % blocksize == 0)
+			sg_assign_page(&dst, desc->bd_iov[i].kiov_page);
+
+		rc = crypto_blkcipher_decrypt_iv(&ciph_desc, &dst, &src,
+						 src.length);
+		if (rc) {
+			CERROR("error to decrypt page: %d\n", rc);
+			return rc;
+		}
+
+		if (desc->bd_iov[i].kiov_len % blocksize != 0) {
+			memcpy(page_address(desc->bd_iov[i].kiov_page) +
+			       desc->bd_iov[i].kiov_offset,
+			       page_address(desc->bd_enc_iov[i].kiov_page) +
+			       desc->bd_iov[i].kiov_offset,
+			       desc->bd_iov[i].kiov_len);
+		}
+	}
+
+	return 0;
+}
+
+static int krb5_bulk_chunk_action(cfs_workitem_t *wi)
+{
+	struct krb5_bulk_chunk	*kbc	 = wi->wi_data;
+	atomic_t		*pending = kbc->kbc_pending;
+	struct completion	*done	 = kbc->kbc_done;
+
+	if (atomic_xchg(&kbc->kbc_taken, 1) == 0)
+		kbc->kbc_rc = krb5_decrypt_bulk_chunk(kbc);
+
+	/* @kbc may be freed once @pending drops to zero, no cfs_wi_exit()
+	 * as for krb5_cksum_action() */
+	if (atomic_dec_and_test(pending))
+		complete(done);
+
+	return 1;
+}
+
 /*
  * if adj_nob != 0, we adjust desc->bd_nob to the actual cipher text size.
  */
@@ -1034,7 +1168,15 @@ int krb5_decrypt_bulk(struct crypto_blkcipher *tfm,
         struct blkcipher_desc   ciph_desc;
         __u8                    local_iv[16] = {0};
         struct scatterlist      src, dst;
+	struct krb5_bulk_chunk	chunk0;
+	struct krb5_bulk_chunk	*chunks = &chunk0;
+	struct krb5_bulk_chunk	*kbc;
+	struct cfs_wi_sched	*sched = NULL;
+	struct completion	done;
+	atomic_t		pending;
+	__u8			*prev_ct;
         int                     ct_nob = 0, pt_nob = 0;
+	int			npages, nchunks = 1, per, c, cpt;
         int                     blocksize, i, rc;
 
         LASSERT(desc->bd_iov_count);
@@ -1042,7 +1184,7 @@ int krb5_decrypt_bulk(struct crypto_blkcipher *tfm,
         LASSERT(desc->bd_nob_transferred);
 
 	blocksize = crypto_blkcipher_blocksize(tfm);
-        LASSERT(blocksize > 1);
+        LASSERT(blocksize > 1 && blocksize <= sizeof(local_iv));
         LASSERT(cipher->len == blocksize + sizeof(*khdr));
 
         ciph_desc.tfm  = tfm;
@@ -1064,6 +1206,7 @@ int krb5_decrypt_bulk(struct crypto_blkcipher *tfm,
                 return rc;
         }
 
+        /* check and adjust the size of the pages to decrypt */
         for (i = 0; i < desc->bd_iov_count && ct_nob < desc->bd_nob_transferred;
              i++) {
                 if (desc->bd_enc_iov[i].kiov_offset % blocksize != 0 ||
@@ -1091,34 +1234,10 @@ int krb5_decrypt_bulk(struct crypto_blkcipher *tfm,
                                 desc->bd_enc_iov[i].kiov_len);
                 }
 
-                if (desc->bd_enc_iov[i].kiov_len == 0)
-                        continue;
-
-		sg_set_page(&src, desc->bd_enc_iov[i].kiov_page,
-			    desc->bd_enc_iov[i].kiov_len,
-			    desc->bd_enc_iov[i].kiov_offset);
-		dst = src;
-		if (desc->bd_iov[i].kiov_len % blocksize == 0)
-			sg_assign_page(&dst, desc->bd_iov[i].kiov_page);
-
-		rc = crypto_blkcipher_decrypt_iv(&ciph_desc, &dst, &src,
-						 src.length);
-                if (rc) {
-                        CERROR("error to decrypt page: %d\n", rc);
-                        return rc;
-                }
-
-                if (desc->bd_iov[i].kiov_len % blocksize != 0) {
-			memcpy(page_address(desc->bd_iov[i].kiov_page) +
-                               desc->bd_iov[i].kiov_offset,
-			       page_address(desc->bd_enc_iov[i].kiov_page) +
-                               desc->bd_iov[i].kiov_offset,
-                               desc->bd_iov[i].kiov_len);
-                }
-
                 ct_nob += desc->bd_enc_iov[i].kiov_len;
                 pt_nob += desc->bd_iov[i].kiov_len;
         }
+	npages = i;
 
         if (unlikely(ct_nob != desc->bd_nob_transferred)) {
                 CERROR("%d cipher text transferred but only %d decrypted\n",
@@ -1137,6 +1256,83 @@ int krb5_decrypt_bulk(struct crypto_blkcipher *tfm,
                 while (i < desc->bd_iov_count)
                         desc->bd_iov[i++].kiov_len = 0;
 
+	/*
+	 * CBC decryption of a block only depends on the cipher text, so large
+	 * bulk is split into chunks decrypted in parallel by the threads of
+	 * the caller's CPT and the caller, each chunk starting from the last
+	 * cipher block before it. Those are copied first as pages are
+	 * decrypted in place.
+	 */
+	if (krb5_bulk_scheds != NULL) {
+		cpt = cfs_cpt_current(cfs_cpt_table, 1);
+		sched = krb5_bulk_scheds[cpt];
+		nchunks = min(krb5_bulk_nthreads(cpt) + 1,
+			      npages / KRB5_BULK_CHUNK_PAGES);
+	}
+	if (nchunks > 1) {
+		OBD_ALLOC(chunks, nchunks * sizeof(*chunks));
+		if (chunks == NULL)
+			chunks = &chunk0;
+	}
+	if (chunks == &chunk0)
+		nchunks = 1;
+
+	per = npages / nchunks;
+	prev_ct = local_iv;
+	for (c = 0, i = 0; c < nchunks; c++) {
+		kbc = &chunks[c];
+		kbc->kbc_tfm = tfm;
+		kbc->kbc_desc = desc;
+		kbc->kbc_start = c * per;
+		kbc->kbc_count = c == nchunks - 1 ? npages - c * per : per;
+		for (; i < kbc->kbc_start; i++) {
+			if (desc->bd_enc_iov[i].kiov_len == 0)
+				continue;
+			prev_ct = page_address(desc->bd_enc_iov[i].kiov_page) +
+				  desc->bd_enc_iov[i].kiov_offset +
+				  desc->bd_enc_iov[i].kiov_len - blocksize;
+		}
+		memcpy(kbc->kbc_iv, prev_ct, blocksize);
+	}
+
+	init_completion(&done);
+	/* one for each queued chunk and one for the caller */
+	atomic_set(&pending, nchunks);
+	for (c = 1; c < nchunks; c++) {
+		kbc = &chunks[c];
+		kbc->kbc_sched = sched;
+		atomic_set(&kbc->kbc_taken, 0);
+		kbc->kbc_pending = &pending;
+		kbc->kbc_done = &done;
+		cfs_wi_init(&kbc->kbc_wi, kbc, krb5_bulk_chunk_action);
+		cfs_wi_schedule(sched, &kbc->kbc_wi);
+	}
+
+	/* decrypt the first chunk, then take back the chunks no thread has
+	 * started, the last ones first since threads start them in order */
+	rc = krb5_decrypt_bulk_chunk(&chunks[0]);
+	for (c = nchunks - 1; c > 0; c--) {
+		kbc = &chunks[c];
+		if (atomic_xchg(&kbc->kbc_taken, 1) != 0)
+			continue;
+
+		/* a chunk still queued won't run and count itself done */
+		if (cfs_wi_deschedule(kbc->kbc_sched, &kbc->kbc_wi))
+			atomic_dec(&pending);
+		kbc->kbc_rc = krb5_decrypt_bulk_chunk(kbc);
+	}
+	if (!atomic_dec_and_test(&pending))
+		wait_for_completion(&done);
+	for (c = 1; c < nchunks && rc == 0; c++)
+		rc = chunks[c].kbc_rc;
+
+	/* the tail is chained after the last cipher block of the pages */
+	memcpy(local_iv, chunks[nchunks - 1].kbc_iv, blocksize);
+	if (chunks != &chunk0)
+		OBD_FREE(chunks, nchunks * sizeof(*chunks));
+	if (rc)
+		return rc;
+
         /* decrypt tail (krb5 header) */
         buf_to_sg(&src, cipher->data + blocksize, sizeof(*khdr));
         buf_to_sg(&dst, cipher->data + blocksize, sizeof(*khdr));
@@ -1343,6 +1539,9 @@ __u32 gss_wrap_bulk_kerberos(struct gss_ctx *gctx,
         rawobj_t             cksum = RAWOBJ_EMPTY;
         rawobj_t             data_desc[1], cipher;
         __u8                 conf[GSS_MAX_CIPHER_BLOCK];
+	struct krb5_cksum_work kcw;
+	bool		     cksum_async = false;
+	__u32		     major = GSS_S_COMPLETE;
         int                  rc = 0;
 
         LASSERT(ke);
@@ -1391,13 +1590,33 @@ __u32 gss_wrap_bulk_kerberos(struct gss_ctx *gctx,
         data_desc[0].data = conf;
         data_desc[0].len = ke->ke_conf_size;
 
-        /* compute checksum */
-        if (krb5_make_checksum(kctx->kc_enctype, &kctx->kc_keyi,
-                               khdr, 1, data_desc,
-                               desc->bd_iov_count, desc->bd_iov,
-                               &cksum))
-                return GSS_S_FAILURE;
-        LASSERT(cksum.len >= ke->ke_hash_size);
+	/* compute checksum. For large bulk, it is done by a thread of the
+	 * caller's CPT while the pages are encrypted, both only read the
+	 * clear text. The CBC chain itself can't be split. */
+	if (krb5_bulk_scheds != NULL &&
+	    desc->bd_iov_count >= KRB5_BULK_CHUNK_PAGES) {
+		kcw.kcw_sched =
+			krb5_bulk_scheds[cfs_cpt_current(cfs_cpt_table, 1)];
+		atomic_set(&kcw.kcw_taken, 0);
+		kcw.kcw_kctx = kctx;
+		kcw.kcw_khdr = khdr;
+		kcw.kcw_msgs = data_desc;
+		kcw.kcw_desc = desc;
+		kcw.kcw_cksum = RAWOBJ_EMPTY;
+		init_completion(&kcw.kcw_done);
+		cfs_wi_init(&kcw.kcw_wi, &kcw, krb5_cksum_action);
+		cfs_wi_schedule(kcw.kcw_sched, &kcw.kcw_wi);
+		cksum_async = true;
+	} else {
+		major = krb5_make_checksum(kctx->kc_enctype, &kctx->kc_keyi,
+					   khdr, 1, data_desc,
+					   desc->bd_iov_count, desc->bd_iov,
+					   &cksum);
+		if (major != GSS_S_COMPLETE) {
+			rawobj_free(&cksum);
+			return GSS_S_FAILURE;
+		}
+	}
 
         /*
          * clear text layout for encryption:
@@ -1425,10 +1644,28 @@ __u32 gss_wrap_bulk_kerberos(struct gss_ctx *gctx,
                                        conf, desc, &cipher, adj_nob);
         }
 
-        if (rc != 0) {
+	if (cksum_async && atomic_xchg(&kcw.kcw_taken, 1) == 0) {
+		/* no thread got to it while encrypting, don't wait for one.
+		 * If it is running it has lost the race and just completes */
+		if (!cfs_wi_deschedule(kcw.kcw_sched, &kcw.kcw_wi))
+			wait_for_completion(&kcw.kcw_done);
+		data_desc[0].data = conf;
+		data_desc[0].len = ke->ke_conf_size;
+		major = krb5_make_checksum(kctx->kc_enctype, &kctx->kc_keyi,
+					   khdr, 1, data_desc,
+					   desc->bd_iov_count, desc->bd_iov,
+					   &cksum);
+	} else if (cksum_async) {
+		wait_for_completion(&kcw.kcw_done);
+		major = kcw.kcw_major;
+		cksum = kcw.kcw_cksum;
+	}
+
+        if (rc != 0 || major != GSS_S_COMPLETE) {
                 rawobj_free(&cksum);
                 return GSS_S_FAILURE;
         }
+        LASSERT(cksum.len >= ke->ke_hash_size);
 
         /* fill in checksum */
         LASSERT(token->len >= sizeof(*khdr) + cipher.len + ke->ke_hash_size);
@@ -1767,6 +2004,48 @@ static struct gss_api_mech gss_kerberos_mech = {
         .gm_sfs         = gss_kerberos_sfs,
 };
 
+static void krb5_bulk_scheds_destroy(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int i;
+
+	if (krb5_bulk_scheds == NULL)
+		return;
+
+	for (i = 0; i < ncpts; i++) {
+		if (krb5_bulk_scheds[i] != NULL)
+			cfs_wi_sched_destroy(krb5_bulk_scheds[i]);
+	}
+
+	OBD_FREE(krb5_bulk_scheds, ncpts * sizeof(krb5_bulk_scheds[0]));
+	krb5_bulk_scheds = NULL;
+}
+
+static void krb5_bulk_scheds_create(void)
+{
+	int ncpts = cfs_cpt_number(cfs_cpt_table);
+	int rc = -ENOMEM;
+	int i;
+
+	OBD_ALLOC(krb5_bulk_scheds, ncpts * sizeof(krb5_bulk_scheds[0]));
+	if (krb5_bulk_scheds == NULL)
+		goto failed;
+
+	for (i = 0; i < ncpts; i++) {
+		rc = cfs_wi_sched_create("krb5_bulk", cfs_cpt_table, i,
+					 krb5_bulk_nthreads(i),
+					 &krb5_bulk_scheds[i]);
+		if (rc != 0)
+			goto failed;
+	}
+
+	return;
+failed:
+	CWARN("Failed to start krb5 bulk threads, bulk will not be decrypted "
+	      "in parallel: rc = %d\n", rc);
+	krb5_bulk_scheds_destroy();
+}
+
 int __init init_kerberos_module(void)
 {
 	int status;
@@ -1774,12 +2053,20 @@ int __init init_kerberos_module(void)
 	spin_lock_init(&krb5_seq_lock);
 
 	status = lgss_mech_register(&gss_kerberos_mech);
-	if (status)
+	if (status) {
 		CERROR("Failed to register kerberos gss mechanism!\n");
-	return status;
+		return status;
+	}
+
+	if (krb5_bulk_threads > 0)
+		krb5_bulk_scheds_create();
+
+	return 0;
 }
 
 void cleanup_kerberos_module(void)
 {
+	krb5_bulk_scheds_destroy();
+
         lgss_mech_unregister(&gss_kerberos_mech);
 }
@@ -594,7 +594,8 @@ static const struct req_msg_field *ost_brw_client[] = {
         &RMF_OST_BODY,
         &RMF_OBD_IOOBJ,
         &RMF_NIOBUF_REMOTE,
-        &RMF_CAPA1
+	&RMF_CAPA1,
+	&RMF_T10_GUARDS
 };
 
 static const struct req_msg_field *ost_brw_read_server[] = {
@@ -925,7 +926,7 @@ struct req_msg_field RMF_OBD_QUOTACTL =
 EXPORT_SYMBOL(RMF_OBD_QUOTACTL);
 
 struct req_msg_field RMF_QUOTA_BODY =
-	DEFINE_MSGF("quota_body", 0,
+	DEFINE_MSGF("quota_body", RMF_F_STRUCT_ARRAY,
 		    sizeof(struct quota_body), lustre_swab_quota_body, NULL);
 EXPORT_SYMBOL(RMF_QUOTA_BODY);
 
@@ -1112,6 +1113,12 @@ struct req_msg_field RMF_RCS =
                     lustre_swab_generic_32s, dump_rcs);
 EXPORT_SYMBOL(RMF_RCS);
 
+/* T10-DIF guard tags are big-endian on the wire, no swabbing needed */
+struct req_msg_field RMF_T10_GUARDS =
+	DEFINE_MSGF("t10_guards", RMF_F_STRUCT_ARRAY, sizeof(__u16),
+		    NULL, NULL);
+EXPORT_SYMBOL(RMF_T10_GUARDS);
+
 struct req_msg_field RMF_EAVALS_LENS =
 	DEFINE_MSGF("eavals_lens", RMF_F_STRUCT_ARRAY, sizeof(__u32),
 		lustre_swab_generic_32s, NULL);
@@ -49,8 +49,8 @@
  */
 static int ptl_send_buf (lnet_handle_md_t *mdh, void *base, int len,
                          lnet_ack_req_t ack, struct ptlrpc_cb_id *cbid,
-                         struct ptlrpc_connection *conn, int portal, __u64 xid,
-                         unsigned int offset)
+			 lnet_nid_t self, struct ptlrpc_connection *conn,
+			 int portal, __u64 xid, unsigned int offset)
 {
         int              rc;
         lnet_md_t         md;
@@ -82,8 +82,8 @@ static int ptl_send_buf (lnet_handle_md_t *mdh, void *base, int len,
         CDEBUG(D_NET, "Sending %d bytes to portal %d, xid "LPD64", offset %u\n",
                len, portal, xid, offset);
 
-        rc = LNetPut (conn->c_self, *mdh, ack,
-                      conn->c_peer, portal, xid, offset, 0);
+	rc = LNetPut(self, *mdh, ack,
+		     conn->c_peer, portal, xid, offset, 0);
         if (unlikely(rc != 0)) {
                 int rc2;
                 /* We're going to get an UNLINK event when I unlink below,
@@ -202,13 +202,17 @@ int ptlrpc_start_bulk_transfer(struct ptlrpc_bulk_desc *desc)
 			}
 			break;
 		}
-		/* Network is about to get at the memory */
+		/* Network is about to get at the memory.  Bulk belongs to
+		 * the request, so it goes out on the NI the request came in
+		 * on, like the reply */
 		if (desc->bd_type == BULK_PUT_SOURCE)
-			rc = LNetPut(conn->c_self, desc->bd_mds[posted_md],
+			rc = LNetPut(desc->bd_req->rq_self,
+				     desc->bd_mds[posted_md],
 				     LNET_ACK_REQ, conn->c_peer,
 				     desc->bd_portal, xid, 0, 0);
 		else
-			rc = LNetGet(conn->c_self, desc->bd_mds[posted_md],
+			rc = LNetGet(desc->bd_req->rq_self,
+				     desc->bd_mds[posted_md],
 				     conn->c_peer, desc->bd_portal, xid, 0);
 
 		posted_md++;
@@ -601,7 +605,7 @@ int ptlrpc_send_reply(struct ptlrpc_request *req, int flags)
         rc = ptl_send_buf (&rs->rs_md_h, rs->rs_repbuf, rs->rs_repdata_len,
                            (rs->rs_difficult && !rs->rs_no_ack) ?
                            LNET_ACK_REQ : LNET_NOACK_REQ,
-			   &rs->rs_cb_id, conn,
+			   &rs->rs_cb_id, req->rq_self, conn,
 			   ptlrpc_req2svc(req)->srv_rep_portal,
                            req->rq_xid, req->rq_reply_off);
 out:
@@ -825,10 +829,14 @@ int ptl_send_rpc(struct ptlrpc_request *request, int noreply)
 
         DEBUG_REQ(D_INFO, request, "send flg=%x",
                   lustre_msg_get_flags(request->rq_reqmsg));
+	/* A new request to a multi-rail server names no source NI, so LNet
+	 * is free to pick the rail; its reply and bulk follow it back.  All
+	 * other peers keep the NID the connection is bound to. */
         rc = ptl_send_buf(&request->rq_req_md_h,
                           request->rq_reqbuf, request->rq_reqdata_len,
                           LNET_NOACK_REQ, &request->rq_req_cbid,
-                          connection,
+			  LNetIsMultiRail(connection->c_peer.nid) ?
+			  LNET_NID_ANY : connection->c_self, connection,
                           request->rq_request_portal,
                           request->rq_xid, 0);
 	if (likely(rc == 0))
@@ -68,12 +68,44 @@ rwlock_t nm_range_tree_lock;
  */
 static cfs_hash_t *nodemap_hash;
 
+static void nm_snapshot_free_work(struct work_struct *work)
+{
+	struct nm_snapshot *snap = container_of(work, struct nm_snapshot,
+						ns_work);
+
+	OBD_FREE_LARGE(snap, snap->ns_size);
+}
+
+static void nm_snapshot_free_rcu(struct rcu_head *head)
+{
+	struct nm_snapshot *snap = container_of(head, struct nm_snapshot,
+						ns_rcu);
+
+	/* vfree() can't be called from softirq context */
+	INIT_WORK(&snap->ns_work, nm_snapshot_free_work);
+	schedule_work(&snap->ns_work);
+}
+
 /**
- * Nodemap destructor
+ * Free a range or idmap snapshot once the readers which may still see it
+ * are done. Doesn't sleep.
  *
- * \param	nodemap		nodemap to destroy
+ * \param	snap		header of the snapshot to free
  */
-static void nodemap_destroy(struct lu_nodemap *nodemap)
+void nm_snapshot_free(struct nm_snapshot *snap)
+{
+	call_rcu(&snap->ns_rcu, nm_snapshot_free_rcu);
+}
+
+/**
+ * Remove the ranges of a nodemap from the range tree
+ *
+ * \param	nodemap		nodemap being deleted
+ *
+ * The caller has to publish the range tree and wait for an RCU grace period
+ * before the nodemap can be destroyed, see nodemap_del().
+ */
+static void nodemap_ranges_delete(struct lu_nodemap *nodemap)
 {
 	struct lu_nid_range *range;
 	struct lu_nid_range *range_temp;
@@ -84,7 +116,21 @@ static void nodemap_destroy(struct lu_nodemap *nodemap)
 		range_delete(range);
 	}
 	write_unlock(&nm_range_tree_lock);
+}
+
+/**
+ * Nodemap destructor
+ *
+ * \param	nodemap		nodemap to destroy
+ *
+ * The last reference can be dropped with the nodemap hash locks held, so
+ * this must not sleep. The ranges are already gone, see nodemap_del().
+ */
+static void nodemap_destroy(struct lu_nodemap *nodemap)
+{
+	LASSERT(list_empty(&nodemap->nm_ranges));
 
+	idmap_unpublish(nodemap);
 	write_lock(&nodemap->nm_idmap_lock);
 	idmap_delete_tree(nodemap);
 	write_unlock(&nodemap->nm_idmap_lock);
@@ -173,7 +219,8 @@ static cfs_hash_ops_t nodemap_hash_operations = {
 /* end of cfs_hash functions */
 
 /**
- * Helper iterator to clean up nodemap on module exit.
+ * Helper iterator to clean up nodemap on module exit, the nodemaps are
+ * destroyed by the final cfs_hash_putref().
  *
  * \param	hs		hash structure
  * \param	bd		bucket descriptor
@@ -186,6 +233,7 @@ static int nodemap_cleanup_iter_cb(cfs_hash_t *hs, cfs_hash_bd_t *bd,
 	struct lu_nodemap *nodemap;
 
 	nodemap = hlist_entry(hnode, struct lu_nodemap, nm_hash);
+	nodemap_ranges_delete(nodemap);
 	nodemap_putref(nodemap);
 
 	return 0;
@@ -197,6 +245,9 @@ static int nodemap_cleanup_iter_cb(cfs_hash_t *hs, cfs_hash_bd_t *bd,
 void nodemap_cleanup_all(void)
 {
 	cfs_hash_for_each_safe(nodemap_hash, nodemap_cleanup_iter_cb, NULL);
+	/* no classifier may still see the nodemaps when they are destroyed */
+	range_publish();
+	synchronize_rcu();
 	cfs_hash_putref(nodemap_hash);
 }
 
@@ -278,14 +329,19 @@ out:
  * \param	nid			nid to classify
  * \retval	nodemap			nodemap containing the nid
  * \retval	default_nodemap		default nodemap
+ *
+ * The range snapshot is searched under rcu_read_lock(), callers which
+ * keep using the returned nodemap should hold it themselves.
  */
 struct lu_nodemap *nodemap_classify_nid(lnet_nid_t nid)
 {
-	struct lu_nid_range	*range;
+	struct lu_nodemap	*nodemap;
 
-	range = range_search(nid);
-	if (range != NULL)
-		return range->rn_nodemap;
+	rcu_read_lock();
+	nodemap = range_classify(nid);
+	rcu_read_unlock();
+	if (nodemap != NULL)
+		return nodemap;
 
 	return default_nodemap;
 }
@@ -384,10 +440,10 @@ int nodemap_add_member(lnet_nid_t nid, struct obd_export *exp)
 	struct lu_nodemap	*nodemap;
 	int rc;
 
-	read_lock(&nm_range_tree_lock);
+	rcu_read_lock();
 	nodemap = nodemap_classify_nid(nid);
 	rc = nm_member_add(nodemap, exp);
-	read_unlock(&nm_range_tree_lock);
+	rcu_read_unlock();
 	return rc;
 }
 EXPORT_SYMBOL(nodemap_add_member);
@@ -435,6 +491,7 @@ int nodemap_add_idmap(const char *name, enum nodemap_id_type id_type,
 	write_lock(&nodemap->nm_idmap_lock);
 	idmap_insert(id_type, idmap, nodemap);
 	write_unlock(&nodemap->nm_idmap_lock);
+	idmap_publish(nodemap, id_type);
 	nm_member_revoke_locks(nodemap);
 
 out_putref:
@@ -476,6 +533,7 @@ int nodemap_del_idmap(const char *name, enum nodemap_id_type id_type,
 
 	idmap_delete(id_type, idmap, nodemap);
 	write_unlock(&nodemap->nm_idmap_lock);
+	idmap_publish(nodemap, id_type);
 	nm_member_revoke_locks(nodemap);
 
 out_putref:
@@ -514,7 +572,6 @@ __u32 nodemap_map_id(struct lu_nodemap *nodemap,
 		     enum nodemap_id_type id_type,
 		     enum nodemap_tree_type tree_type, __u32 id)
 {
-	struct lu_idmap		*idmap = NULL;
 	__u32			 found_id;
 
 	if (!nodemap_active)
@@ -536,18 +593,9 @@ __u32 nodemap_map_id(struct lu_nodemap *nodemap,
 	if (is_default_nodemap(nodemap))
 		goto squash;
 
-	read_lock(&nodemap->nm_idmap_lock);
-	idmap = idmap_search(nodemap, tree_type, id_type, id);
-	if (idmap == NULL) {
-		read_unlock(&nodemap->nm_idmap_lock);
+	if (!idmap_lookup(nodemap, tree_type, id_type, id, &found_id))
 		goto squash;
-	}
 
-	if (tree_type == NODEMAP_FS_TO_CLIENT)
-		found_id = idmap->id_client;
-	else
-		found_id = idmap->id_fs;
-	read_unlock(&nodemap->nm_idmap_lock);
 	return found_id;
 
 squash:
@@ -648,6 +696,15 @@ int nodemap_add_range(const char *name, const lnet_nid_t nid[2])
 		GOTO(out_putref, rc = -ENOMEM);
 
 	write_lock(&nm_range_tree_lock);
+	if (hlist_unhashed(&nodemap->nm_hash)) {
+		/* raced with nodemap_del(), which removes the ranges of the
+		 * nodemap under nm_range_tree_lock once it is unhashed */
+		write_unlock(&nm_range_tree_lock);
+		list_del(&range->rn_list);
+		range_destroy(range);
+		GOTO(out_putref, rc = -ENOENT);
+	}
+
 	rc = range_insert(range);
 	if (rc != 0) {
 		CERROR("cannot insert nodemap range into '%s': rc = %d\n",
@@ -660,6 +717,7 @@ int nodemap_add_range(const char *name, const lnet_nid_t nid[2])
 
 	list_add(&range->rn_list, &nodemap->nm_ranges);
 	write_unlock(&nm_range_tree_lock);
+	range_publish();
 
 	nm_member_reclassify_nodemap(default_nodemap);
 	nm_member_revoke_locks(default_nodemap);
@@ -700,6 +758,7 @@ int nodemap_del_range(const char *name, const lnet_nid_t nid[2])
 
 	range_delete(range);
 	write_unlock(&nm_range_tree_lock);
+	range_publish();
 	nm_member_reclassify_nodemap(nodemap);
 	nm_member_revoke_locks(default_nodemap);
 	nm_member_revoke_locks(nodemap);
@@ -970,6 +1029,14 @@ int nodemap_del(const char *nodemap_name)
 	 * before nodemap_destory is run.
 	 */
 	lprocfs_remove(&nodemap->nm_proc_entry);
+
+	/* the final putref may run with the nodemap hash locks held, so drop
+	 * the ranges now and wait until no classifier can find the nodemap
+	 * through the old range snapshot */
+	nodemap_ranges_delete(nodemap);
+	range_publish();
+	synchronize_rcu();
+
 	nodemap_putref(nodemap);
 out:
 	return rc;
@@ -995,6 +1062,10 @@ void nodemap_mod_exit(void)
 {
 	nodemap_cleanup_all();
 	lprocfs_remove(&proc_lustre_nodemap_root);
+
+	/* wait for the snapshots freed with nm_snapshot_free() */
+	rcu_barrier();
+	flush_scheduled_work();
 }
 
 /**
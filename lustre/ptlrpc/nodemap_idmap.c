@@ -28,6 +28,9 @@
 #include <lustre_net.h>
 #include "nodemap_internal.h"
 
+/* serializes publishing of the nm_idmaps snapshots */
+static DEFINE_MUTEX(idmap_publish_lock);
+
 /**
  * Allocate the lu_idmap structure
  *
@@ -181,6 +184,20 @@ void idmap_delete(enum nodemap_id_type id_type, struct lu_idmap *idmap,
 	idmap_destroy(idmap);
 }
 
+static struct rb_root *idmap_tree_root(struct lu_nodemap *nodemap,
+				       enum nodemap_tree_type tree_type,
+				       enum nodemap_id_type id_type)
+{
+	if (id_type == NODEMAP_UID && tree_type == NODEMAP_FS_TO_CLIENT)
+		return &nodemap->nm_fs_to_client_uidmap;
+	else if (id_type == NODEMAP_UID && tree_type == NODEMAP_CLIENT_TO_FS)
+		return &nodemap->nm_client_to_fs_uidmap;
+	else if (id_type == NODEMAP_GID && tree_type == NODEMAP_FS_TO_CLIENT)
+		return &nodemap->nm_fs_to_client_gidmap;
+	else
+		return &nodemap->nm_client_to_fs_gidmap;
+}
+
 /**
  * Search for an existing id in the nodemap trees.
  *
@@ -199,19 +216,9 @@ struct lu_idmap *idmap_search(struct lu_nodemap *nodemap,
 			      const __u32 id)
 {
 	struct rb_node	*node;
-	struct rb_root	*root = NULL;
 	struct lu_idmap	*idmap;
 
-	if (id_type == NODEMAP_UID && tree_type == NODEMAP_FS_TO_CLIENT)
-		root = &nodemap->nm_fs_to_client_uidmap;
-	else if (id_type == NODEMAP_UID && tree_type == NODEMAP_CLIENT_TO_FS)
-		root = &nodemap->nm_client_to_fs_uidmap;
-	else if (id_type == NODEMAP_GID && tree_type == NODEMAP_FS_TO_CLIENT)
-		root = &nodemap->nm_fs_to_client_gidmap;
-	else if (id_type == NODEMAP_GID && tree_type == NODEMAP_CLIENT_TO_FS)
-		root = &nodemap->nm_client_to_fs_gidmap;
-
-	node = root->rb_node;
+	node = idmap_tree_root(nodemap, tree_type, id_type)->rb_node;
 
 	if (tree_type == NODEMAP_FS_TO_CLIENT) {
 		while (node) {
@@ -266,3 +273,200 @@ void idmap_delete_tree(struct lu_nodemap *nodemap)
 		idmap_destroy(idmap);
 	}
 }
+
+static inline size_t idmap_array_size(unsigned int count)
+{
+	return offsetof(struct nm_idmap_array, nia_ents[count]);
+}
+
+static void idmap_array_free(struct nm_idmap_array *array)
+{
+	if (!IS_ERR_OR_NULL(array))
+		nm_snapshot_free(&array->nia_snap);
+}
+
+static unsigned int idmap_tree_count(struct rb_root *root)
+{
+	struct rb_node	*node;
+	unsigned int	 count = 0;
+
+	for (node = rb_first(root); node != NULL; node = rb_next(node))
+		count++;
+
+	return count;
+}
+
+/*
+ * build a sorted snapshot of one idmap tree
+ *
+ * \retval	NULL if the tree is empty, ERR_PTR(-ENOMEM) on failure
+ */
+static struct nm_idmap_array *idmap_array_build(struct lu_nodemap *nodemap,
+					enum nodemap_tree_type tree_type,
+					enum nodemap_id_type id_type)
+{
+	struct rb_root		*root = idmap_tree_root(nodemap, tree_type,
+							id_type);
+	struct nm_idmap_array	*array;
+	struct nm_idmap_ent	*ent;
+	struct rb_node		*node;
+	struct lu_idmap		*idmap;
+	unsigned int		 count;
+
+again:
+	read_lock(&nodemap->nm_idmap_lock);
+	count = idmap_tree_count(root);
+	read_unlock(&nodemap->nm_idmap_lock);
+	if (count == 0)
+		return NULL;
+
+	OBD_ALLOC_LARGE(array, idmap_array_size(count));
+	if (array == NULL) {
+		CERROR("%s: cannot allocate idmap snapshot of %u ids, using "
+		       "the idmap tree\n", nodemap->nm_name, count);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	read_lock(&nodemap->nm_idmap_lock);
+	if (idmap_tree_count(root) != count) {
+		read_unlock(&nodemap->nm_idmap_lock);
+		OBD_FREE_LARGE(array, idmap_array_size(count));
+		goto again;
+	}
+
+	ent = array->nia_ents;
+	for (node = rb_first(root); node != NULL; node = rb_next(node)) {
+		if (tree_type == NODEMAP_FS_TO_CLIENT) {
+			idmap = rb_entry(node, struct lu_idmap,
+					 id_fs_to_client);
+			ent->nie_from = idmap->id_fs;
+			ent->nie_to = idmap->id_client;
+		} else {
+			idmap = rb_entry(node, struct lu_idmap,
+					 id_client_to_fs);
+			ent->nie_from = idmap->id_client;
+			ent->nie_to = idmap->id_fs;
+		}
+		ent++;
+	}
+	read_unlock(&nodemap->nm_idmap_lock);
+	array->nia_snap.ns_size = idmap_array_size(count);
+	array->nia_count = count;
+
+	return array;
+}
+
+/*
+ * publish sorted snapshots of the idmap trees of one id type
+ *
+ * \param	nodemap		nodemap whose trees were changed
+ * \param	id_type		NODEMAP_UID or NODEMAP_GID
+ *
+ * Must be called after every idmap_insert() or idmap_delete(), once
+ * nm_idmap_lock has been dropped. Old snapshots are freed after an RCU
+ * grace period without waiting for it, so that replaying a configuration
+ * log with many idmaps stays fast.
+ */
+void idmap_publish(struct lu_nodemap *nodemap, enum nodemap_id_type id_type)
+{
+	struct nm_idmap_array	*old[2];
+	struct nm_idmap_array	*array;
+	int			 tree_type;
+
+	mutex_lock(&idmap_publish_lock);
+	for (tree_type = NODEMAP_FS_TO_CLIENT;
+	     tree_type <= NODEMAP_CLIENT_TO_FS; tree_type++) {
+		array = idmap_array_build(nodemap, tree_type, id_type);
+		old[tree_type] = nodemap->nm_idmaps[id_type][tree_type];
+		rcu_assign_pointer(nodemap->nm_idmaps[id_type][tree_type],
+				   array);
+	}
+	mutex_unlock(&idmap_publish_lock);
+
+	idmap_array_free(old[NODEMAP_FS_TO_CLIENT]);
+	idmap_array_free(old[NODEMAP_CLIENT_TO_FS]);
+}
+
+/*
+ * drop all idmap snapshots of a nodemap before its trees are deleted
+ *
+ * Called by the nodemap destructor, possibly with the nodemap hash locks
+ * held, so it must not sleep. Nobody can publish new snapshots for the
+ * nodemap since the last reference is gone.
+ */
+void idmap_unpublish(struct lu_nodemap *nodemap)
+{
+	struct nm_idmap_array	*old;
+	int			 id_type;
+	int			 tree_type;
+
+	for (id_type = NODEMAP_UID; id_type <= NODEMAP_GID; id_type++) {
+		for (tree_type = NODEMAP_FS_TO_CLIENT;
+		     tree_type <= NODEMAP_CLIENT_TO_FS; tree_type++) {
+			old = nodemap->nm_idmaps[id_type][tree_type];
+			rcu_assign_pointer(
+				nodemap->nm_idmaps[id_type][tree_type], NULL);
+			idmap_array_free(old);
+		}
+	}
+}
+
+/**
+ * Map an id through the published idmap snapshot.
+ *
+ * \param	nodemap		nodemap to search
+ * \param	tree_type	NODEMAP_FS_TO_CLIENT or NODEMAP_CLIENT_TO_FS
+ * \param	id_type		NODEMAP_UID or NODEMAP_GID
+ * \param	id		id to map
+ * \param	found_id	mapped id on success
+ *
+ * \retval	true if a mapping for \a id exists
+ */
+bool idmap_lookup(struct lu_nodemap *nodemap,
+		  enum nodemap_tree_type tree_type,
+		  enum nodemap_id_type id_type, __u32 id, __u32 *found_id)
+{
+	struct nm_idmap_array	*array;
+	struct lu_idmap		*idmap;
+	unsigned int		 lo;
+	unsigned int		 hi;
+	unsigned int		 mid;
+	bool			 found = false;
+
+	rcu_read_lock();
+	array = rcu_dereference(nodemap->nm_idmaps[id_type][tree_type]);
+	if (array == NULL)
+		goto out;
+
+	if (unlikely(IS_ERR(array))) {
+		read_lock(&nodemap->nm_idmap_lock);
+		idmap = idmap_search(nodemap, tree_type, id_type, id);
+		if (idmap != NULL) {
+			found = true;
+			if (tree_type == NODEMAP_FS_TO_CLIENT)
+				*found_id = idmap->id_client;
+			else
+				*found_id = idmap->id_fs;
+		}
+		read_unlock(&nodemap->nm_idmap_lock);
+		goto out;
+	}
+
+	lo = 0;
+	hi = array->nia_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (id < array->nia_ents[mid].nie_from) {
+			hi = mid;
+		} else if (id > array->nia_ents[mid].nie_from) {
+			lo = mid + 1;
+		} else {
+			*found_id = array->nia_ents[mid].nie_to;
+			found = true;
+			break;
+		}
+	}
+out:
+	rcu_read_unlock();
+	return found;
+}
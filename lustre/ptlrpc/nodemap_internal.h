@@ -71,6 +71,50 @@ struct lu_idmap {
 	struct rb_node	id_fs_to_client;
 };
 
+/*
+ * Header of the snapshots below. Old snapshots are released with
+ * nm_snapshot_free() once replaced, they may be vmalloc()ed so they are
+ * freed from a work item after the RCU grace period.
+ */
+struct nm_snapshot {
+	union {
+		struct rcu_head		 ns_rcu;
+		struct work_struct	 ns_work;
+	};
+	size_t				 ns_size;
+};
+
+/*
+ * Read-only snapshot of the range tree, sorted by starting nid, which is
+ * searched under rcu_read_lock() to classify nids. A new snapshot is
+ * published by range_publish() after every change of the range tree.
+ */
+struct nm_range_array {
+	struct nm_snapshot	 nra_snap;
+	unsigned int		 nra_count;
+	struct nm_range_ent {
+		lnet_nid_t		 nre_start;
+		lnet_nid_t		 nre_end;
+		struct lu_nodemap	*nre_nodemap;
+	}			 nra_ents[0];
+};
+
+/*
+ * Read-only snapshot of one idmap tree, sorted by the id being mapped, which
+ * is searched under rcu_read_lock() by nodemap_map_id(). ERR_PTR(-ENOMEM)
+ * is published when a snapshot could not be built, in which case lookups
+ * fall back to the tree under nm_idmap_lock.
+ */
+struct nm_idmap_array {
+	struct nm_snapshot	 nia_snap;
+	unsigned int		 nia_count;
+	struct nm_idmap_ent {
+		__u32			 nie_from;
+		__u32			 nie_to;
+	}			 nia_ents[0];
+};
+
+void nm_snapshot_free(struct nm_snapshot *snap);
 int nodemap_procfs_init(void);
 int lprocfs_nodemap_register(const char *name, bool is_default_nodemap,
 			     struct lu_nodemap *nodemap);
@@ -80,6 +124,8 @@ void range_destroy(struct lu_nid_range *range);
 int range_insert(struct lu_nid_range *data);
 void range_delete(struct lu_nid_range *data);
 struct lu_nid_range *range_search(lnet_nid_t nid);
+struct lu_nodemap *range_classify(lnet_nid_t nid);
+void range_publish(void);
 struct lu_nid_range *range_find(lnet_nid_t start_nid, lnet_nid_t end_nid);
 int range_parse_nidstring(char *range_string, lnet_nid_t *start_nid,
 			  lnet_nid_t *end_nid);
@@ -90,6 +136,11 @@ void idmap_insert(enum nodemap_id_type id_type, struct lu_idmap *idmap,
 void idmap_delete(enum nodemap_id_type id_type,  struct lu_idmap *idmap,
 		  struct lu_nodemap *nodemap);
 void idmap_delete_tree(struct lu_nodemap *nodemap);
+void idmap_publish(struct lu_nodemap *nodemap, enum nodemap_id_type id_type);
+void idmap_unpublish(struct lu_nodemap *nodemap);
+bool idmap_lookup(struct lu_nodemap *nodemap,
+		  enum nodemap_tree_type tree_type,
+		  enum nodemap_id_type id_type, __u32 id, __u32 *found_id);
 struct lu_idmap *idmap_search(struct lu_nodemap *nodemap,
 			      enum nodemap_tree_type,
 			      enum nodemap_id_type id_type,
@@ -38,14 +38,25 @@
  * the lu_nid_range nodes will be added to linked links within the
  * lu_nodemap structure for reporting purposes. Access to range tree should be
  * controlled to prevent read access during update operations.
+ *
+ * Clients are not classified from the tree itself: after each update, a
+ * sorted copy of the ranges is published with RCU and binary searched
+ * without taking nm_range_tree_lock, so connecting clients never contend
+ * with each other or with the lprocfs readers of the tree.
  */
 
 static struct interval_node *range_interval_root;
 static atomic_t range_highest_id;
+static unsigned int range_count;
+static struct nm_range_array *range_array;
+/* serializes publishing of range_array */
+static DEFINE_MUTEX(range_publish_lock);
 
 void range_init_tree(void)
 {
 	range_interval_root = NULL;
+	range_count = 0;
+	range_array = NULL;
 }
 
 /*
@@ -156,6 +167,7 @@ int range_insert(struct lu_nid_range *range)
 		return -EEXIST;
 
 	interval_insert(&range->rn_node, &range_interval_root);
+	range_count++;
 
 	return 0;
 }
@@ -172,6 +184,7 @@ void range_delete(struct lu_nid_range *range)
 		return;
 	list_del(&range->rn_list);
 	interval_erase(&range->rn_node, &range_interval_root);
+	range_count--;
 	range_destroy(range);
 }
 
@@ -192,3 +205,129 @@ struct lu_nid_range *range_search(lnet_nid_t nid)
 
 	return ret;
 }
+
+static inline size_t range_array_size(unsigned int count)
+{
+	return offsetof(struct nm_range_array, nra_ents[count]);
+}
+
+static enum interval_iter range_fill_cb(struct interval_node *n, void *data)
+{
+	struct lu_nid_range	*range = container_of(n, struct lu_nid_range,
+						      rn_node);
+	struct nm_range_array	*array = data;
+	struct nm_range_ent	*ent = &array->nra_ents[array->nra_count++];
+
+	ent->nre_start = interval_low(n);
+	ent->nre_end = interval_high(n);
+	ent->nre_nodemap = range->rn_nodemap;
+
+	return INTERVAL_ITER_CONT;
+}
+
+/*
+ * publish a sorted snapshot of the range tree for range_classify()
+ *
+ * Must be called after every range_insert() or range_delete(), once
+ * nm_range_tree_lock has been dropped, and may sleep. The old snapshot is
+ * freed after an RCU grace period, callers which removed the last ranges
+ * of a nodemap have to wait for it with synchronize_rcu() before the
+ * nodemap can go away. If the snapshot cannot be allocated, readers are
+ * sent back to the tree until the next successful publish.
+ */
+void range_publish(void)
+{
+	struct nm_range_array	*array;
+	struct nm_range_array	*old;
+	unsigned int		 count;
+
+	mutex_lock(&range_publish_lock);
+again:
+	read_lock(&nm_range_tree_lock);
+	count = range_count;
+	read_unlock(&nm_range_tree_lock);
+
+	array = NULL;
+	if (count > 0) {
+		OBD_ALLOC_LARGE(array, range_array_size(count));
+		if (array == NULL) {
+			CERROR("cannot allocate nodemap range snapshot of "
+			       "%u ranges, using the range tree\n", count);
+			array = ERR_PTR(-ENOMEM);
+		}
+	}
+
+	if (!IS_ERR_OR_NULL(array)) {
+		read_lock(&nm_range_tree_lock);
+		if (range_count != count) {
+			read_unlock(&nm_range_tree_lock);
+			OBD_FREE_LARGE(array, range_array_size(count));
+			goto again;
+		}
+		array->nra_snap.ns_size = range_array_size(count);
+		array->nra_count = 0;
+		interval_iterate(range_interval_root, range_fill_cb, array);
+		read_unlock(&nm_range_tree_lock);
+		LASSERT(array->nra_count == count);
+	}
+
+	old = range_array;
+	rcu_assign_pointer(range_array, array);
+	mutex_unlock(&range_publish_lock);
+
+	if (!IS_ERR_OR_NULL(old))
+		nm_snapshot_free(&old->nra_snap);
+}
+
+/*
+ * find the nodemap whose range contains an nid
+ *
+ * \param	nid		nid to classify
+ * \retval	nodemap of the matching range, NULL if no range matches
+ *
+ * The caller must hold rcu_read_lock() for as long as it uses the
+ * returned nodemap.
+ */
+struct lu_nodemap *range_classify(lnet_nid_t nid)
+{
+	struct nm_range_array	*array;
+	struct nm_range_ent	*ent;
+	struct lu_nid_range	*range;
+	struct lu_nodemap	*nodemap = NULL;
+	unsigned int		 lo;
+	unsigned int		 hi;
+	unsigned int		 mid;
+
+	array = rcu_dereference(range_array);
+	if (array == NULL)
+		return NULL;
+
+	if (unlikely(IS_ERR(array))) {
+		read_lock(&nm_range_tree_lock);
+		range = range_search(nid);
+		if (range != NULL)
+			nodemap = range->rn_nodemap;
+		read_unlock(&nm_range_tree_lock);
+		return nodemap;
+	}
+
+	/* ranges do not overlap, so the only candidate is the last range
+	 * starting at or below nid */
+	lo = 0;
+	hi = array->nra_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (array->nra_ents[mid].nre_start <= nid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+
+	ent = &array->nra_ents[lo - 1];
+	if (nid > ent->nre_end)
+		return NULL;
+
+	return ent->nre_nodemap;
+}
@@ -66,6 +66,9 @@
 
 #define CACHE_QUIESCENT_PERIOD  (20)
 
+/* pages kept in each per-CPT cache in front of the pools */
+#define ENC_POOL_CACHE_PAGES	(2 * (ONE_MB_BRW_SIZE >> PAGE_CACHE_SHIFT))
+
 static struct ptlrpc_enc_page_pool {
         /*
          * constants
@@ -101,6 +104,16 @@ static struct ptlrpc_enc_page_pool {
         unsigned long    epp_total_pages; /* total pages in pools */
         unsigned long    epp_free_pages;  /* current pages available */
 
+	/*
+	 * demand bookkeeping, the peak number of pages handed out during
+	 * the current and the last CACHE_QUIESCENT_PERIOD. It sizes the
+	 * grows and the number of free pages kept by the shrinker.
+	 */
+	atomic_long_t	 epp_out_pages;	  /* pages handed out to bulk */
+	unsigned long	 epp_demand;	  /* peak of this period */
+	unsigned long	 epp_demand_last; /* peak of the last period */
+	long		 epp_demand_start;
+
         /*
          * statistics
          */
@@ -119,6 +132,27 @@ static struct ptlrpc_enc_page_pool {
 	struct page    ***epp_pools;
 } page_pools;
 
+/*
+ * per-CPT caches of free pages, filled by sptlrpc_enc_pool_put_pages()
+ * and used by sptlrpc_enc_pool_get_pages() without taking epp_lock.
+ * Cached pages are counted in epp_total_pages but not in epp_free_pages,
+ * they are drained back into the pools under epp_lock whenever the pools
+ * run short or are shrunk. Lock order is epp_lock, then epc_lock.
+ * Hits are folded into epp_st_access and epp_idle_idx the next time
+ * epp_lock is taken, see enc_pools_fold_hits().
+ */
+struct enc_pool_cache {
+	spinlock_t	 epc_lock;
+	unsigned int	 epc_count;
+	unsigned long	 epc_hits;
+	unsigned long	 epc_unfolded;	/* hits not yet in the pool stats */
+	struct page	*epc_pages[ENC_POOL_CACHE_PAGES];
+};
+
+static struct enc_pool_cache **enc_pool_caches;
+
+static void enc_pools_fold_hits(void);
+
 /*
  * memory shrinker
  */
@@ -131,10 +165,24 @@ static struct shrinker *pools_shrinker;
  */
 int sptlrpc_proc_enc_pool_seq_show(struct seq_file *m, void *v)
 {
+	struct enc_pool_cache	*epc;
+	unsigned long		 cached = 0;
+	unsigned long		 hits = 0;
+	int			 i;
         int     rc;
 
 	spin_lock(&page_pools.epp_lock);
 
+	enc_pools_fold_hits();
+	if (enc_pool_caches != NULL) {
+		cfs_percpt_for_each(epc, i, enc_pool_caches) {
+			spin_lock(&epc->epc_lock);
+			cached += epc->epc_count;
+			hits += epc->epc_hits;
+			spin_unlock(&epc->epc_lock);
+		}
+	}
+
 	rc = seq_printf(m,
                       "physical pages:          %lu\n"
                       "pages per pool:          %lu\n"
@@ -142,6 +190,9 @@ int sptlrpc_proc_enc_pool_seq_show(struct seq_file *m, void *v)
                       "max pools:               %u\n"
                       "total pages:             %lu\n"
                       "total free:              %lu\n"
+		      "cached free:             %lu\n"
+		      "pages in use:            %lu\n"
+		      "demand:                  %lu\n"
                       "idle index:              %lu/100\n"
                       "last shrink:             %lds\n"
                       "last access:             %lds\n"
@@ -151,6 +202,7 @@ int sptlrpc_proc_enc_pool_seq_show(struct seq_file *m, void *v)
                       "shrinks:                 %u\n"
                       "cache access:            %lu\n"
                       "cache missing:           %lu\n"
+		      "cpt cache hits:          %lu\n"
                       "low free mark:           %lu\n"
                       "max waitqueue depth:     %u\n"
 		      "max wait time:           "CFS_TIME_T"/%lu\n"
@@ -161,6 +213,9 @@ int sptlrpc_proc_enc_pool_seq_show(struct seq_file *m, void *v)
                       page_pools.epp_max_pools,
                       page_pools.epp_total_pages,
                       page_pools.epp_free_pages,
+		      cached,
+		      atomic_long_read(&page_pools.epp_out_pages),
+		      max(page_pools.epp_demand, page_pools.epp_demand_last),
                       page_pools.epp_idle_idx,
                       cfs_time_current_sec() - page_pools.epp_last_shrink,
                       cfs_time_current_sec() - page_pools.epp_last_access,
@@ -170,6 +225,7 @@ int sptlrpc_proc_enc_pool_seq_show(struct seq_file *m, void *v)
                       page_pools.epp_st_shrinks,
                       page_pools.epp_st_access,
 		      page_pools.epp_st_missings,
+		      hits,
 		      page_pools.epp_st_lowfree,
 		      page_pools.epp_st_max_wqlen,
 		      page_pools.epp_st_max_wait,
@@ -226,11 +282,137 @@ static void enc_pools_release_free_pages(long npages)
 }
 
 /*
- * we try to keep at least PTLRPC_MAX_BRW_PAGES pages in the pool.
+ * put a free page back at the end of the free pages of the pools.
+ */
+static inline void enc_pools_put_page(struct page *page)
+{
+	int	p_idx, g_idx;
+
+	assert_spin_locked(&page_pools.epp_lock);
+	LASSERT(page_pools.epp_free_pages < page_pools.epp_total_pages);
+
+	p_idx = page_pools.epp_free_pages / PAGES_PER_POOL;
+	g_idx = page_pools.epp_free_pages % PAGES_PER_POOL;
+
+	LASSERT(page_pools.epp_pools[p_idx]);
+	LASSERT(page_pools.epp_pools[p_idx][g_idx] == NULL);
+
+	page_pools.epp_pools[p_idx][g_idx] = page;
+	page_pools.epp_free_pages++;
+}
+
+/*
+ * return the pages of all the per-CPT caches to the pools.
+ */
+static void enc_pools_drain_caches(void)
+{
+	struct enc_pool_cache	*epc;
+	int			 i;
+
+	assert_spin_locked(&page_pools.epp_lock);
+
+	if (enc_pool_caches == NULL)
+		return;
+
+	cfs_percpt_for_each(epc, i, enc_pool_caches) {
+		spin_lock(&epc->epc_lock);
+		while (epc->epc_count > 0)
+			enc_pools_put_page(epc->epc_pages[--epc->epc_count]);
+		spin_unlock(&epc->epc_lock);
+	}
+}
+
+/*
+ * account the per-CPT cache hits since the last call as pool accesses,
+ * each of them sampling the idle index like a get from the pools does.
+ * a hit leaves epp_free_pages alone, so the cached pages count as idle.
+ * caller must hold epp_lock.
+ */
+static void enc_pools_fold_hits(void)
+{
+	struct enc_pool_cache	*epc;
+	unsigned long		 cached = 0;
+	unsigned long		 hits = 0;
+	unsigned long		 this_idle;
+	int			 i;
+
+	assert_spin_locked(&page_pools.epp_lock);
+
+	if (enc_pool_caches == NULL)
+		return;
+
+	cfs_percpt_for_each(epc, i, enc_pool_caches) {
+		spin_lock(&epc->epc_lock);
+		cached += epc->epc_count;
+		hits += epc->epc_unfolded;
+		epc->epc_unfolded = 0;
+		spin_unlock(&epc->epc_lock);
+	}
+
+	if (hits == 0 || page_pools.epp_total_pages == 0)
+		return;
+
+	page_pools.epp_st_access += hits;
+
+	/* the weighted average has converged long before IDLE_IDX_MAX */
+	this_idle = (page_pools.epp_free_pages + cached) * IDLE_IDX_MAX /
+		    page_pools.epp_total_pages;
+	for (i = 0; i < min_t(unsigned long, hits, IDLE_IDX_MAX); i++)
+		page_pools.epp_idle_idx = (page_pools.epp_idle_idx *
+					   IDLE_IDX_WEIGHT + this_idle) /
+					  (IDLE_IDX_WEIGHT + 1);
+}
+
+/*
+ * record the number of pages handed out after a get.
+ * a little race here is fine.
+ */
+static void enc_pools_note_demand(unsigned long out)
+{
+	long	now = cfs_time_current_sec();
+
+	if (now - page_pools.epp_demand_start > CACHE_QUIESCENT_PERIOD) {
+		page_pools.epp_demand_last = page_pools.epp_demand;
+		page_pools.epp_demand = 0;
+		page_pools.epp_demand_start = now;
+	}
+
+	if (out > page_pools.epp_demand)
+		page_pools.epp_demand = out;
+
+	page_pools.epp_last_access = now;
+}
+
+/*
+ * number of free pages the shrinker should leave in the pools: what the
+ * recent demand may hand out on top of the pages already in use, and at
+ * least PTLRPC_MAX_BRW_PAGES. No demand is assumed once the pools have
+ * been idle for CACHE_QUIESCENT_PERIOD.
+ */
+static unsigned long enc_pools_keep_free(void)
+{
+	unsigned long	demand = 0;
+	unsigned long	out = atomic_long_read(&page_pools.epp_out_pages);
+
+	if (cfs_time_current_sec() - page_pools.epp_last_access <=
+	    CACHE_QUIESCENT_PERIOD)
+		demand = max(page_pools.epp_demand,
+			     page_pools.epp_demand_last);
+
+	return max_t(unsigned long, PTLRPC_MAX_BRW_PAGES,
+		     demand > out ? demand - out : 0);
+}
+
+/*
+ * we try to keep enough free pages for the recent demand in the pool.
  */
 static unsigned long enc_pools_shrink_count(struct shrinker *s,
 					    struct shrink_control *sc)
 {
+	spin_lock(&page_pools.epp_lock);
+	enc_pools_fold_hits();
+	spin_unlock(&page_pools.epp_lock);
+
 	/*
 	 * if no pool access for a long time, we consider it's fully idle.
 	 * a little race here is fine.
@@ -243,19 +425,26 @@ static unsigned long enc_pools_shrink_count(struct shrinker *s,
 	}
 
 	LASSERT(page_pools.epp_idle_idx <= IDLE_IDX_MAX);
-	return max((int)page_pools.epp_free_pages - PTLRPC_MAX_BRW_PAGES, 0) *
+	return max((long)page_pools.epp_free_pages -
+		   (long)enc_pools_keep_free(), 0L) *
 		(IDLE_IDX_MAX - page_pools.epp_idle_idx) / IDLE_IDX_MAX;
 }
 
 /*
- * we try to keep at least PTLRPC_MAX_BRW_PAGES pages in the pool.
+ * we try to keep enough free pages for the recent demand in the pool.
  */
 static unsigned long enc_pools_shrink_scan(struct shrinker *s,
 					   struct shrink_control *sc)
 {
+	unsigned long	keep = enc_pools_keep_free();
+
 	spin_lock(&page_pools.epp_lock);
+	enc_pools_fold_hits();
+	if (sc->nr_to_scan > 0)
+		enc_pools_drain_caches();
 	sc->nr_to_scan = min_t(unsigned long, sc->nr_to_scan,
-			      page_pools.epp_free_pages - PTLRPC_MAX_BRW_PAGES);
+			       page_pools.epp_free_pages > keep ?
+			       page_pools.epp_free_pages - keep : 0);
 	if (sc->nr_to_scan > 0) {
 		enc_pools_release_free_pages(sc->nr_to_scan);
 		CDEBUG(D_SEC, "released %ld pages, %ld left\n",
@@ -427,12 +616,17 @@ static int enc_pools_add_pages(int npages)
 	struct page   ***pools;
 	int             npools, alloced = 0;
 	int             i, j, rc = -ENOMEM;
+	int		node;
 
 	if (npages < PTLRPC_MAX_BRW_PAGES)
 		npages = PTLRPC_MAX_BRW_PAGES;
 
 	mutex_lock(&add_pages_mutex);
 
+	/* the new pages will be mostly used by the CPT growing the pools */
+	node = cfs_cpt_spread_node(cfs_cpt_table,
+				   cfs_cpt_current(cfs_cpt_table, 1));
+
         if (npages + page_pools.epp_total_pages > page_pools.epp_max_pages)
                 npages = page_pools.epp_max_pages - page_pools.epp_total_pages;
         LASSERT(npages > 0);
@@ -450,8 +644,8 @@ static int enc_pools_add_pages(int npages)
 			goto out_pools;
 
 		for (j = 0; j < PAGES_PER_POOL && alloced < npages; j++) {
-			pools[i][j] = alloc_page(GFP_NOFS |
-						 __GFP_HIGHMEM);
+			pools[i][j] = alloc_pages_node(node, GFP_NOFS |
+						       __GFP_HIGHMEM, 0);
 			if (pools[i][j] == NULL)
 				goto out_pools;
 
@@ -487,36 +681,85 @@ static inline void enc_pools_wakeup(void)
 	}
 }
 
-static int enc_pools_should_grow(int page_needed, long now)
+static int enc_pools_should_grow(void)
 {
-        /* don't grow if someone else is growing the pools right now,
-         * or the pools has reached its full capacity
-         */
-        if (page_pools.epp_growing ||
-            page_pools.epp_total_pages == page_pools.epp_max_pages)
-                return 0;
+	/* don't grow if someone else is growing the pools right now,
+	 * or the pools has reached its full capacity
+	 */
+	return !page_pools.epp_growing &&
+	       page_pools.epp_total_pages < page_pools.epp_max_pages;
+}
 
-        /* if total pages is not enough, we need to grow */
-        if (page_pools.epp_total_pages < page_needed)
-                return 1;
+/*
+ * grow the pools up to the measured demand, plus what the waiting users
+ * are short of beyond the pages currently in use.
+ */
+static int enc_pools_grow_size(void)
+{
+	unsigned long	out = atomic_long_read(&page_pools.epp_out_pages);
+	unsigned long	target;
 
-        /*
-         * we wanted to return 0 here if there was a shrink just happened
-         * moment ago, but this may cause deadlock if both client and ost
-         * live on single node.
-         */
-#if 0
-        if (now - page_pools.epp_last_shrink < 2)
-                return 0;
-#endif
+	target = max(max(page_pools.epp_demand, page_pools.epp_demand_last),
+		     out) + page_pools.epp_pages_short;
+	if (target <= page_pools.epp_total_pages)
+		return page_pools.epp_pages_short;
 
-        /*
-         * here we perhaps need consider other factors like wait queue
-         * length, idle index, etc. ?
-         */
+	return min_t(unsigned long, target - page_pools.epp_total_pages,
+		     page_pools.epp_max_pages);
+}
+
+static int enc_pools_cache_get(struct ptlrpc_bulk_desc *desc)
+{
+	struct enc_pool_cache	*epc;
+	int			 i;
+
+	if (enc_pool_caches == NULL)
+		return 0;
 
-        /* grow the pools in any other cases */
-        return 1;
+	epc = cfs_percpt_current(enc_pool_caches);
+	spin_lock(&epc->epc_lock);
+	if (epc->epc_count < desc->bd_iov_count) {
+		spin_unlock(&epc->epc_lock);
+		return 0;
+	}
+
+	for (i = 0; i < desc->bd_iov_count; i++)
+		desc->bd_enc_iov[i].kiov_page =
+				epc->epc_pages[--epc->epc_count];
+	epc->epc_hits++;
+	epc->epc_unfolded++;
+	spin_unlock(&epc->epc_lock);
+
+	enc_pools_note_demand(atomic_long_add_return(desc->bd_iov_count,
+					&page_pools.epp_out_pages));
+	return 1;
+}
+
+static int enc_pools_cache_put(struct ptlrpc_bulk_desc *desc)
+{
+	struct enc_pool_cache	*epc;
+	int			 i;
+
+	if (enc_pool_caches == NULL)
+		return 0;
+
+	epc = cfs_percpt_current(enc_pool_caches);
+	spin_lock(&epc->epc_lock);
+	/* waiters on the pools drain the caches after they are queued */
+	if (page_pools.epp_waitqlen != 0 ||
+	    epc->epc_count + desc->bd_iov_count > ENC_POOL_CACHE_PAGES) {
+		spin_unlock(&epc->epc_lock);
+		return 0;
+	}
+
+	for (i = 0; i < desc->bd_iov_count; i++) {
+		LASSERT(desc->bd_enc_iov[i].kiov_page != NULL);
+		epc->epc_pages[epc->epc_count++] =
+				desc->bd_enc_iov[i].kiov_page;
+	}
+	spin_unlock(&epc->epc_lock);
+
+	return 1;
 }
 
 /*
@@ -527,7 +770,6 @@ int sptlrpc_enc_pool_get_pages(struct ptlrpc_bulk_desc *desc)
 	wait_queue_t  waitlink;
 	unsigned long   this_idle = -1;
 	cfs_time_t      tick = 0;
-	long            now;
 	int             p_idx, g_idx;
 	int             i;
 
@@ -543,24 +785,31 @@ int sptlrpc_enc_pool_get_pages(struct ptlrpc_bulk_desc *desc)
 	if (desc->bd_enc_iov == NULL)
 		return -ENOMEM;
 
+	if (enc_pools_cache_get(desc))
+		return 0;
+
 	spin_lock(&page_pools.epp_lock);
 
+	enc_pools_fold_hits();
 	page_pools.epp_st_access++;
 again:
+	if (unlikely(page_pools.epp_free_pages < desc->bd_iov_count))
+		enc_pools_drain_caches();
+
 	if (unlikely(page_pools.epp_free_pages < desc->bd_iov_count)) {
 		if (tick == 0)
 			tick = cfs_time_current();
 
-		now = cfs_time_current_sec();
-
 		page_pools.epp_st_missings++;
 		page_pools.epp_pages_short += desc->bd_iov_count;
 
-		if (enc_pools_should_grow(desc->bd_iov_count, now)) {
+		if (enc_pools_should_grow()) {
+			int npages = enc_pools_grow_size();
+
 			page_pools.epp_growing = 1;
 
 			spin_unlock(&page_pools.epp_lock);
-			enc_pools_add_pages(page_pools.epp_pages_short / 2);
+			enc_pools_add_pages(npages);
 			spin_lock(&page_pools.epp_lock);
 
 			page_pools.epp_growing = 0;
@@ -572,6 +821,14 @@ again:
 				page_pools.epp_st_max_wqlen =
 						page_pools.epp_waitqlen;
 
+			/* pages may have been cached by users which did
+			 * not see us queued yet */
+			enc_pools_drain_caches();
+			if (page_pools.epp_free_pages >= desc->bd_iov_count) {
+				page_pools.epp_waitqlen--;
+				goto short_done;
+			}
+
 			set_current_state(TASK_UNINTERRUPTIBLE);
 			init_waitqueue_entry_current(&waitlink);
 			add_wait_queue(&page_pools.epp_waitq, &waitlink);
@@ -583,6 +840,7 @@ again:
 			spin_lock(&page_pools.epp_lock);
 			page_pools.epp_waitqlen--;
 		}
+short_done:
 
 		LASSERT(page_pools.epp_pages_short >= desc->bd_iov_count);
 		page_pools.epp_pages_short -= desc->bd_iov_count;
@@ -630,7 +888,8 @@ again:
                                    this_idle) /
                                   (IDLE_IDX_WEIGHT + 1);
 
-        page_pools.epp_last_access = cfs_time_current_sec();
+	enc_pools_note_demand(atomic_long_add_return(desc->bd_iov_count,
+					&page_pools.epp_out_pages));
 
 	spin_unlock(&page_pools.epp_lock);
 	return 0;
@@ -639,7 +898,6 @@ EXPORT_SYMBOL(sptlrpc_enc_pool_get_pages);
 
 void sptlrpc_enc_pool_put_pages(struct ptlrpc_bulk_desc *desc)
 {
-        int     p_idx, g_idx;
         int     i;
 
         if (desc->bd_enc_iov == NULL)
@@ -647,35 +905,26 @@ void sptlrpc_enc_pool_put_pages(struct ptlrpc_bulk_desc *desc)
 
         LASSERT(desc->bd_iov_count > 0);
 
-	spin_lock(&page_pools.epp_lock);
+	atomic_long_sub(desc->bd_iov_count, &page_pools.epp_out_pages);
 
-        p_idx = page_pools.epp_free_pages / PAGES_PER_POOL;
-        g_idx = page_pools.epp_free_pages % PAGES_PER_POOL;
+	if (enc_pools_cache_put(desc))
+		goto out;
+
+	spin_lock(&page_pools.epp_lock);
 
         LASSERT(page_pools.epp_free_pages + desc->bd_iov_count <=
                 page_pools.epp_total_pages);
-        LASSERT(page_pools.epp_pools[p_idx]);
 
         for (i = 0; i < desc->bd_iov_count; i++) {
                 LASSERT(desc->bd_enc_iov[i].kiov_page != NULL);
-                LASSERT(g_idx != 0 || page_pools.epp_pools[p_idx]);
-                LASSERT(page_pools.epp_pools[p_idx][g_idx] == NULL);
-
-                page_pools.epp_pools[p_idx][g_idx] =
-                                        desc->bd_enc_iov[i].kiov_page;
-
-                if (++g_idx == PAGES_PER_POOL) {
-                        p_idx++;
-                        g_idx = 0;
-                }
+		enc_pools_put_page(desc->bd_enc_iov[i].kiov_page);
         }
 
-        page_pools.epp_free_pages += desc->bd_iov_count;
-
         enc_pools_wakeup();
 
 	spin_unlock(&page_pools.epp_lock);
 
+out:
 	OBD_FREE(desc->bd_enc_iov,
 		 desc->bd_iov_count * sizeof(*desc->bd_enc_iov));
 	desc->bd_enc_iov = NULL;
@@ -759,6 +1008,11 @@ int sptlrpc_enc_pool_init(void)
         page_pools.epp_total_pages = 0;
         page_pools.epp_free_pages = 0;
 
+	atomic_long_set(&page_pools.epp_out_pages, 0);
+	page_pools.epp_demand = 0;
+	page_pools.epp_demand_last = 0;
+	page_pools.epp_demand_start = cfs_time_current_sec();
+
         page_pools.epp_st_max_pages = 0;
         page_pools.epp_st_grows = 0;
         page_pools.epp_st_grow_fails = 0;
@@ -773,8 +1027,25 @@ int sptlrpc_enc_pool_init(void)
         if (page_pools.epp_pools == NULL)
                 return -ENOMEM;
 
+	/* the pools work without the caches, only slower */
+	enc_pool_caches = cfs_percpt_alloc(cfs_cpt_table,
+					   sizeof(struct enc_pool_cache));
+	if (enc_pool_caches != NULL) {
+		struct enc_pool_cache	*epc;
+		int			 i;
+
+		cfs_percpt_for_each(epc, i, enc_pool_caches)
+			spin_lock_init(&epc->epc_lock);
+	} else {
+		CWARN("cannot allocate per-CPT encryption page caches\n");
+	}
+
 	pools_shrinker = set_shrinker(pools_shrinker_seeks, &shvar);
         if (pools_shrinker == NULL) {
+		if (enc_pool_caches != NULL) {
+			cfs_percpt_free(enc_pool_caches);
+			enc_pool_caches = NULL;
+		}
                 enc_pools_free();
                 return -ENOMEM;
         }
@@ -788,10 +1059,19 @@ void sptlrpc_enc_pool_fini(void)
 
         LASSERT(pools_shrinker);
         LASSERT(page_pools.epp_pools);
-        LASSERT(page_pools.epp_total_pages == page_pools.epp_free_pages);
 
 	remove_shrinker(pools_shrinker);
 
+	if (enc_pool_caches != NULL) {
+		spin_lock(&page_pools.epp_lock);
+		enc_pools_fold_hits();
+		enc_pools_drain_caches();
+		spin_unlock(&page_pools.epp_lock);
+		cfs_percpt_free(enc_pool_caches);
+		enc_pool_caches = NULL;
+	}
+        LASSERT(page_pools.epp_total_pages == page_pools.epp_free_pages);
+
         npools = npages_to_npools(page_pools.epp_total_pages);
         cleaned = enc_pools_cleanup(page_pools.epp_pools, npools);
         LASSERT(cleaned == page_pools.epp_total_pages);
@@ -69,6 +69,22 @@ struct lquota_entry_operations {
 			  va_list);
 };
 
+/* number of slaves for which the master tracks recent activity per ID */
+#define LQUOTA_SLV_RATE_MAX	8
+
+/* Quota space recently granted to a slave for a given ID, used by the master
+ * to rebalance quota space toward the active slaves */
+struct lquota_slv_rate {
+	/* hash of the slave uuid, 0 for an unused slot */
+	__u32			lsr_key;
+
+	/* last time space was granted to this slave, in seconds */
+	__u64			lsr_time;
+
+	/* average space granted per second, in inodes or kbytes */
+	__u64			lsr_rate;
+};
+
 /* Per-ID information specific to the quota master target */
 struct lquota_mst_entry {
 	/* global hard limit, in inodes or kbytes */
@@ -89,6 +105,10 @@ struct lquota_mst_entry {
 
 	/* quota space that may be released after glimpse */
 	__u64			lme_may_rel;
+
+	/* slaves which acquired space for this ID recently, array of
+	 * LQUOTA_SLV_RATE_MAX entries allocated on the first acquire */
+	struct lquota_slv_rate	*lme_slv_rate;
 };
 
 /* Per-ID information specific to the quota slave */
@@ -132,6 +152,37 @@ struct lquota_slv_entry {
 
 	/* when latest edquot set */
 	__u64			lse_edquot_time;
+
+	/* quota space consumed since lse_rate_time, same unit as lqe_usage */
+	__u64			lse_rate_space;
+
+	/* start of the current consumption rate sampling period */
+	__u64			lse_rate_time;
+
+	/* average quota space consumed per second */
+	__u64			lse_rate;
+
+	/* quota space handed out to the per-CPU partition slots, either not
+	 * consumed yet, used by in-flight operations or used by completed
+	 * operations not reflected in lse_usage yet, see qsd_pcpt_collect() */
+	__u64			lse_reserved;
+
+	/* per-CPU partition slots, only allocated for IDs with lqe_lock
+	 * contention, see qsd_pcpt_init() */
+	struct lquota_slv_pcpt	**lse_pcpt;
+};
+
+/* Quota space reserved by a quota slave entry for a CPU partition, which
+ * allows writes to consume quota space without taking lse_lock as long as
+ * the ID is far from its granted limit */
+struct lquota_slv_pcpt {
+	spinlock_t		lsp_lock;
+
+	/* space which can be consumed by new operations */
+	__u64			lsp_credit;
+
+	/* space consumed by operations which completed since last settle */
+	__u64			lsp_done;
 };
 
 /* In-memory entry for each enforced quota id
@@ -198,6 +249,7 @@ struct lquota_site {
 #define lqe_revoke_time		u.me.lme_revoke_time
 #define lqe_sem			u.me.lme_sem
 #define lqe_may_rel		u.me.lme_may_rel
+#define lqe_slv_rate		u.me.lme_slv_rate
 
 #define lqe_qtune		u.se.lse_qtune
 #define lqe_pending_write	u.se.lse_pending_write
@@ -212,6 +264,11 @@ struct lquota_site {
 #define lqe_acq_rc		u.se.lse_acq_rc
 #define lqe_acq_time		u.se.lse_acq_time
 #define lqe_edquot_time		u.se.lse_edquot_time
+#define lqe_rate_space		u.se.lse_rate_space
+#define lqe_rate_time		u.se.lse_rate_time
+#define lqe_rate		u.se.lse_rate
+#define lqe_reserved		u.se.lse_reserved
+#define lqe_pcpt		u.se.lse_pcpt
 
 #define LQUOTA_BUMP_VER 0x1
 #define LQUOTA_SET_VER  0x2
@@ -229,8 +286,14 @@ static inline void lqe_putref(struct lquota_entry *lqe)
 {
 	LASSERT(lqe != NULL);
 	LASSERT(atomic_read(&lqe->lqe_ref) > 0);
-	if (atomic_dec_and_test(&lqe->lqe_ref))
+	if (atomic_dec_and_test(&lqe->lqe_ref)) {
+		if (!lqe->lqe_site->lqs_is_mst && lqe->lqe_pcpt != NULL)
+			cfs_percpt_free(lqe->lqe_pcpt);
+		if (lqe->lqe_site->lqs_is_mst && lqe->lqe_slv_rate != NULL)
+			OBD_FREE(lqe->lqe_slv_rate, LQUOTA_SLV_RATE_MAX *
+				 sizeof(*lqe->lqe_slv_rate));
 		OBD_SLAB_FREE_PTR(lqe, lqe_kmem);
+	}
 }
 
 static inline int lqe_is_master(struct lquota_entry *lqe)
@@ -247,6 +310,14 @@ static inline void lqe_write_lock(struct lquota_entry *lqe)
 		write_lock(&lqe->lqe_lock);
 }
 
+static inline int lqe_write_trylock(struct lquota_entry *lqe)
+{
+	if (lqe_is_master(lqe))
+		return down_write_trylock(&lqe->lqe_sem);
+	else
+		return write_trylock(&lqe->lqe_lock);
+}
+
 static inline void lqe_write_unlock(struct lquota_entry *lqe)
 {
 	if (lqe_is_master(lqe))
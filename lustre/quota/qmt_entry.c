@@ -44,6 +44,7 @@ static void qmt_lqe_init(struct lquota_entry *lqe, void *arg)
 
 	lqe->lqe_revoke_time = 0;
 	init_rwsem(&lqe->lqe_sem);
+	lqe->lqe_slv_rate = NULL;
 }
 
 /*
@@ -690,3 +691,111 @@ void qmt_revalidate(const struct lu_env *env, struct lquota_entry *lqe)
 			qmt_adjust_edquot(lqe, cfs_time_current_sec());
 	}
 }
+
+/*
+ * Key identifying a slave in the lqe_slv_rate table.
+ *
+ * \param uuid - is the uuid of the slave
+ */
+__u32 qmt_slv_key(struct obd_uuid *uuid)
+{
+	__u32	key;
+
+	key = cfs_hash_djb2_hash(uuid->uuid,
+				 strnlen(uuid->uuid, sizeof(uuid->uuid)), ~0U);
+	/* 0 is reserved for unused slots */
+	return key ? : 1;
+}
+
+/* unused and idle slots are recycled first, then the slowest slave */
+static inline bool qmt_slv_evict_first(struct lquota_slv_rate *a,
+				       struct lquota_slv_rate *b, __u64 now)
+{
+	bool	a_idle = a->lsr_time + QMT_SLV_ACTIVE_TIME < now;
+	bool	b_idle = b->lsr_time + QMT_SLV_ACTIVE_TIME < now;
+
+	if (a_idle != b_idle)
+		return a_idle;
+	return a->lsr_rate < b->lsr_rate;
+}
+
+/*
+ * Account quota space granted to a slave in order to estimate how fast each
+ * slave consumes quota space for this ID. Only the LQUOTA_SLV_RATE_MAX most
+ * active slaves are tracked, the slot of the slave with the lowest rate is
+ * recycled when a new slave shows up. The table is only allocated once the
+ * ID is granted space, so that idle IDs don't pay for it. The lquota entry
+ * must be write locked.
+ *
+ * \param lqe   - is the quota entry of the ID
+ * \param uuid  - is the uuid of the slave space was granted to
+ * \param count - is how much space was granted
+ * \param now   - is the current time in seconds
+ */
+void qmt_slv_rate_update(struct lquota_entry *lqe, struct obd_uuid *uuid,
+			 __u64 count, __u64 now)
+{
+	struct lquota_slv_rate	*lsr, *victim = NULL;
+	__u32			 key = qmt_slv_key(uuid);
+	__u64			 elapsed, rate;
+	int			 i;
+
+	if (lqe->lqe_slv_rate == NULL) {
+		OBD_ALLOC(lqe->lqe_slv_rate, LQUOTA_SLV_RATE_MAX *
+			  sizeof(*lqe->lqe_slv_rate));
+		/* not fatal, the rebalance just treats all slaves alike */
+		if (lqe->lqe_slv_rate == NULL)
+			return;
+	}
+
+	for (i = 0; i < LQUOTA_SLV_RATE_MAX; i++) {
+		lsr = &lqe->lqe_slv_rate[i];
+		if (lsr->lsr_key == key)
+			break;
+		if (victim == NULL || qmt_slv_evict_first(lsr, victim, now))
+			victim = lsr;
+	}
+
+	if (i == LQUOTA_SLV_RATE_MAX) {
+		victim->lsr_key  = key;
+		victim->lsr_time = now;
+		victim->lsr_rate = count;
+		return;
+	}
+
+	elapsed = now - lsr->lsr_time;
+	rate = count;
+	if (elapsed > 1)
+		do_div(rate, elapsed);
+	/* exponentially weighted moving average, idle periods decay it */
+	lsr->lsr_rate = (lsr->lsr_rate * 3 + rate) >> 2;
+	lsr->lsr_time = now;
+}
+
+/*
+ * Collect the keys of the slaves which acquired quota space for this ID
+ * within the last QMT_SLV_ACTIVE_TIME seconds. The lquota entry must be
+ * locked.
+ *
+ * \param lqe  - is the quota entry of the ID
+ * \param now  - is the current time in seconds
+ * \param keys - is an array of LQUOTA_SLV_RATE_MAX entries to fill
+ *
+ * \retval the number of active slaves stored in \a keys
+ */
+int qmt_slv_active(struct lquota_entry *lqe, __u64 now, __u32 *keys)
+{
+	struct lquota_slv_rate	*lsr;
+	int			 i, nr = 0;
+
+	if (lqe->lqe_slv_rate == NULL)
+		return 0;
+
+	for (i = 0; i < LQUOTA_SLV_RATE_MAX; i++) {
+		lsr = &lqe->lqe_slv_rate[i];
+		if (lsr->lsr_key != 0 && lsr->lsr_rate != 0 &&
+		    lsr->lsr_time + QMT_SLV_ACTIVE_TIME >= now)
+			keys[nr++] = lsr->lsr_key;
+	}
+	return nr;
+}
@@ -549,6 +549,11 @@ out_write:
 		GOTO(out_locked, rc);
 	}
 
+	/* keep track of the slaves consuming space for this ID, the rebalance
+	 * thread favors them when the qunit shrinks */
+	if (!req_is_rel(qb_flags))
+		qmt_slv_rate_update(lqe, uuid, repbody->qb_count, now);
+
 	/* Total granted has been changed, let's try to adjust the qunit
 	 * size according to the total granted & limits. */
 	qmt_adjust_qunit(env, lqe);
@@ -578,17 +583,18 @@ out:
 }
 
 /*
- * Handle quota request from slave.
+ * Handle a single quota_body of a quota request from slave.
  *
- * \param env  - is the environment passed by the caller
- * \param ld   - is the lu device associated with the qmt
- * \param req  - is the quota acquire request
+ * \param env     - is the environment passed by the caller
+ * \param qmt     - is the quota master target
+ * \param req     - is the quota acquire request
+ * \param qbody   - is the quota body to process
+ * \param repbody - is the quota body to fill in the reply
  */
-static int qmt_dqacq(const struct lu_env *env, struct lu_device *ld,
-		     struct ptlrpc_request *req)
+static int qmt_dqacq_one(const struct lu_env *env, struct qmt_device *qmt,
+			 struct ptlrpc_request *req, struct quota_body *qbody,
+			 struct quota_body *repbody)
 {
-	struct qmt_device	*qmt = lu2qmt_dev(ld);
-	struct quota_body	*qbody, *repbody;
 	struct obd_uuid		*uuid;
 	struct ldlm_lock	*lock;
 	struct lquota_entry	*lqe;
@@ -596,14 +602,6 @@ static int qmt_dqacq(const struct lu_env *env, struct lu_device *ld,
 	int			 rc;
 	ENTRY;
 
-	qbody = req_capsule_client_get(&req->rq_pill, &RMF_QUOTA_BODY);
-	if (qbody == NULL)
-		RETURN(err_serious(-EPROTO));
-
-	repbody = req_capsule_server_get(&req->rq_pill, &RMF_QUOTA_BODY);
-	if (repbody == NULL)
-		RETURN(err_serious(-EFAULT));
-
 	/* verify if global lock is stale */
 	if (!lustre_handle_is_used(&qbody->qb_glb_lockh))
 		RETURN(-ENOLCK);
@@ -682,6 +680,57 @@ static int qmt_dqacq(const struct lu_env *env, struct lu_device *ld,
 	RETURN(rc);
 }
 
+/*
+ * Handle quota request from slave.
+ * Slaves connected with OBD_CONNECT_DQACQ_BATCH can pack several quota_body
+ * in a single request, in which case the status of each of them is returned
+ * in qb_rc of the matching reply body and the request itself succeeds.
+ *
+ * \param env  - is the environment passed by the caller
+ * \param ld   - is the lu device associated with the qmt
+ * \param req  - is the quota acquire request
+ */
+static int qmt_dqacq(const struct lu_env *env, struct lu_device *ld,
+		     struct ptlrpc_request *req)
+{
+	struct qmt_device	*qmt = lu2qmt_dev(ld);
+	struct quota_body	*qbody, *repbody;
+	int			 count, i;
+	int			 rc;
+	ENTRY;
+
+	qbody = req_capsule_client_get(&req->rq_pill, &RMF_QUOTA_BODY);
+	if (qbody == NULL)
+		RETURN(err_serious(-EPROTO));
+
+	count = req_capsule_get_size(&req->rq_pill, &RMF_QUOTA_BODY,
+				     RCL_CLIENT) / sizeof(*qbody);
+	if (count == 0)
+		RETURN(err_serious(-EPROTO));
+	if (count > 1 && !(exp_connect_flags(req->rq_export) &
+			   OBD_CONNECT_DQACQ_BATCH))
+		RETURN(err_serious(-EPROTO));
+
+	req_capsule_set_size(&req->rq_pill, &RMF_QUOTA_BODY, RCL_SERVER,
+			     count * sizeof(*repbody));
+	rc = req_capsule_server_pack(&req->rq_pill);
+	if (rc)
+		RETURN(err_serious(rc));
+
+	repbody = req_capsule_server_get(&req->rq_pill, &RMF_QUOTA_BODY);
+	if (repbody == NULL)
+		RETURN(err_serious(-EFAULT));
+
+	if (count == 1)
+		RETURN(qmt_dqacq_one(env, qmt, req, qbody, repbody));
+
+	for (i = 0; i < count; i++) {
+		rc = qmt_dqacq_one(env, qmt, req, &qbody[i], &repbody[i]);
+		repbody[i].qb_rc = ptlrpc_status_hton(rc);
+	}
+	RETURN(0);
+}
+
 /* Vector of quota request handlers. This vector is used by the MDT to forward
  * requests to the quota master. */
 struct qmt_handlers qmt_hdls = {
@@ -278,6 +278,13 @@ static inline bool qmt_space_exhausted(struct lquota_entry *lqe, __u64 now)
  * rebalancing */
 #define QMT_REBA_TIMEOUT 2
 
+/* a slave which acquired quota space for an ID within this number of seconds
+ * is considered as actively consuming space for this ID */
+#define QMT_SLV_ACTIVE_TIME 30
+
+/* maximum number of IDs the rebalance thread glimpses in one go */
+#define QMT_REBA_BATCH 32
+
 /* qmt_pool.c */
 void qmt_pool_fini(const struct lu_env *, struct qmt_device *);
 int qmt_pool_init(const struct lu_env *, struct qmt_device *);
@@ -309,6 +316,10 @@ void qmt_adjust_qunit(const struct lu_env *, struct lquota_entry *);
 void qmt_adjust_edquot(struct lquota_entry *, __u64);
 void qmt_revalidate(const struct lu_env *, struct lquota_entry *);
 __u64 qmt_alloc_expand(struct lquota_entry *, __u64, __u64);
+__u32 qmt_slv_key(struct obd_uuid *);
+void qmt_slv_rate_update(struct lquota_entry *, struct obd_uuid *, __u64,
+			 __u64);
+int qmt_slv_active(struct lquota_entry *, __u64, __u32 *);
 
 /* qmt_handler.c */
 int qmt_dqacq0(const struct lu_env *, struct lquota_entry *,
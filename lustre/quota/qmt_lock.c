@@ -440,44 +440,65 @@ int qmt_lvbo_free(struct lu_device *ld, struct ldlm_resource *res)
 typedef int (*qmt_glimpse_cb_t)(const struct lu_env *, struct qmt_device *,
 				struct obd_uuid *, union ldlm_gl_desc *,
 				void *);
+
+/* glimpse work with its own copy of the glimpse descriptor, so that the
+ * descriptor can be tailored to each slave */
+struct qmt_gl_work {
+	struct ldlm_glimpse_work	qgw_work;
+	/* linkage to the list of works to be freed by qmt_glimpse_send() */
+	struct list_head		qgw_link;
+	union ldlm_gl_desc		qgw_desc;
+};
+
 /*
- * Send glimpse callback to slaves holding a lock on resource \res.
- * This is used to notify slaves of new quota settings or to claim quota space
- * back.
+ * Prepare glimpse callbacks to slaves holding a lock on resource \res.
  *
- * \param env  - is the environment passed by the caller
- * \param qmt  - is the quota master target
- * \param res  - is the dlm resource associated with the quota object
- * \param desc - is the glimpse descriptor to pack in glimpse callback
- * \param cb   - is the callback function called on every lock and determine
- *               whether a glimpse should be issued
- * \param arg  - is an opaq parameter passed to the callback function
+ * \param env     - is the environment passed by the caller
+ * \param qmt     - is the quota master target
+ * \param res     - is the dlm resource associated with the quota object
+ * \param desc    - is the glimpse descriptor to pack in glimpse callback
+ * \param cb      - is the callback function called on every lock and
+ *                  determine whether a glimpse should be issued. It can also
+ *                  modify the copy of the descriptor sent to this slave
+ * \param arg     - is an opaq parameter passed to the callback function
+ * \param gl_list - is the list of glimpse works to add to
+ * \param works   - is the list of qmt_gl_work to be freed once sent
  */
-static int qmt_glimpse_lock(const struct lu_env *env, struct qmt_device *qmt,
-			    struct ldlm_resource *res, union ldlm_gl_desc *desc,
-			    qmt_glimpse_cb_t cb, void *arg)
+static void qmt_glimpse_prep(const struct lu_env *env, struct qmt_device *qmt,
+			     struct ldlm_resource *res,
+			     union ldlm_gl_desc *desc, qmt_glimpse_cb_t cb,
+			     void *arg, struct list_head *gl_list,
+			     struct list_head *works)
 {
-	struct list_head *tmp, *pos;
-	struct list_head gl_list = LIST_HEAD_INIT(gl_list);
-	int		 rc = 0;
-	ENTRY;
+	struct list_head	*pos;
+	int			 rc;
 
 	lock_res(res);
 	/* scan list of granted locks */
 	list_for_each(pos, &res->lr_granted) {
-		struct ldlm_glimpse_work	*work;
-		struct ldlm_lock		*lock;
-		struct obd_uuid			*uuid;
+		struct qmt_gl_work	*work;
+		struct ldlm_lock	*lock;
+		struct obd_uuid		*uuid;
 
 		lock = list_entry(pos, struct ldlm_lock, l_res_link);
 		LASSERT(lock->l_export);
 		uuid = &lock->l_export->exp_client_uuid;
 
+		OBD_ALLOC_PTR(work);
+		if (work == NULL) {
+			CERROR("%s: failed to notify %s\n", qmt->qmt_svname,
+			       obd_uuid2str(uuid));
+			continue;
+		}
+		work->qgw_desc = *desc;
+
 		if (cb != NULL) {
-			rc = cb(env, qmt, uuid, desc, arg);
-			if (rc == 0)
+			rc = cb(env, qmt, uuid, &work->qgw_desc, arg);
+			if (rc == 0) {
 				/* slave should not be notified */
+				OBD_FREE_PTR(work);
 				continue;
+			}
 			if (rc < 0)
 				/* something wrong happened, we still notify */
 				CERROR("%s: callback function failed to "
@@ -486,45 +507,81 @@ static int qmt_glimpse_lock(const struct lu_env *env, struct qmt_device *qmt,
 				       obd_uuid2str(uuid), rc);
 		}
 
-		OBD_ALLOC_PTR(work);
-		if (work == NULL) {
-			CERROR("%s: failed to notify %s\n", qmt->qmt_svname,
-			       obd_uuid2str(uuid));
-			continue;
-		}
-
-		list_add_tail(&work->gl_list, &gl_list);
-		work->gl_lock  = LDLM_LOCK_GET(lock);
-		work->gl_flags = 0;
-		work->gl_desc  = desc;
-
+		list_add_tail(&work->qgw_link, works);
+		list_add_tail(&work->qgw_work.gl_list, gl_list);
+		work->qgw_work.gl_lock  = LDLM_LOCK_GET(lock);
+		work->qgw_work.gl_flags = LDLM_GL_WORK_NOFREE;
+		work->qgw_work.gl_desc  = &work->qgw_desc;
 	}
 	unlock_res(res);
+}
 
-	if (list_empty(&gl_list)) {
-		CDEBUG(D_QUOTA, "%s: nobody to notify\n", qmt->qmt_svname);
-		RETURN(0);
-	}
-
-	/* issue glimpse callbacks to all connected slaves */
-	rc = ldlm_glimpse_locks(res, &gl_list);
-
-	list_for_each_safe(pos, tmp, &gl_list) {
-		struct ldlm_glimpse_work *work;
-
-		work = list_entry(pos, struct ldlm_glimpse_work, gl_list);
+/*
+ * Issue glimpse callbacks prepared with qmt_glimpse_prep(), possibly on
+ * several resources of the QMT namespace. All the glimpse RPCs are sent as
+ * a single set, up to ns_max_parallel_ast of them being in flight.
+ *
+ * \param env     - is the environment passed by the caller
+ * \param qmt     - is the quota master target
+ * \param res     - is one of the dlm resources the locks belong to
+ * \param gl_list - is the list of glimpse works
+ * \param works   - is the list of qmt_gl_work to free
+ */
+static int qmt_glimpse_send(const struct lu_env *env, struct qmt_device *qmt,
+			    struct ldlm_resource *res,
+			    struct list_head *gl_list, struct list_head *works)
+{
+	struct qmt_gl_work	*work, *tmp;
+	int			 rc = 0;
+	ENTRY;
 
-		list_del(&work->gl_list);
-		CERROR("%s: failed to notify %s of new quota settings\n",
-		       qmt->qmt_svname,
-		       obd_uuid2str(&work->gl_lock->l_export->exp_client_uuid));
-		LDLM_LOCK_RELEASE(work->gl_lock);
+	if (list_empty(gl_list))
+		CDEBUG(D_QUOTA, "%s: nobody to notify\n", qmt->qmt_svname);
+	else
+		/* issue glimpse callbacks to all connected slaves */
+		rc = ldlm_glimpse_locks(res, gl_list);
+
+	list_for_each_entry_safe(work, tmp, works, qgw_link) {
+		list_del(&work->qgw_link);
+		/* works processed by ldlm were unlinked from gl_list */
+		if (!list_empty(&work->qgw_work.gl_list)) {
+			list_del(&work->qgw_work.gl_list);
+			CERROR("%s: failed to notify %s of new quota "
+			       "settings\n", qmt->qmt_svname,
+			       obd_uuid2str(&work->qgw_work.gl_lock->l_export->
+					    exp_client_uuid));
+			LDLM_LOCK_RELEASE(work->qgw_work.gl_lock);
+		}
 		OBD_FREE_PTR(work);
 	}
 
 	RETURN(rc);
 }
 
+/*
+ * Send glimpse callback to slaves holding a lock on resource \res.
+ * This is used to notify slaves of new quota settings or to claim quota space
+ * back.
+ *
+ * \param env  - is the environment passed by the caller
+ * \param qmt  - is the quota master target
+ * \param res  - is the dlm resource associated with the quota object
+ * \param desc - is the glimpse descriptor to pack in glimpse callback
+ * \param cb   - is the callback function called on every lock and determine
+ *               whether a glimpse should be issued
+ * \param arg  - is an opaq parameter passed to the callback function
+ */
+static int qmt_glimpse_lock(const struct lu_env *env, struct qmt_device *qmt,
+			    struct ldlm_resource *res, union ldlm_gl_desc *desc,
+			    qmt_glimpse_cb_t cb, void *arg)
+{
+	struct list_head	gl_list = LIST_HEAD_INIT(gl_list);
+	struct list_head	works = LIST_HEAD_INIT(works);
+
+	qmt_glimpse_prep(env, qmt, res, desc, cb, arg, &gl_list, &works);
+	return qmt_glimpse_send(env, qmt, res, &gl_list, &works);
+}
+
 /*
  * Send glimpse request to all global quota locks to push new quota setting to
  * slaves.
@@ -571,39 +628,73 @@ void qmt_glb_lock_notify(const struct lu_env *env, struct lquota_entry *lqe,
 	EXIT;
 }
 
-/* Callback function used to select locks that should be glimpsed when
- * broadcasting the new qunit value */
+/* slaves which acquired quota space recently for the ID being glimpsed */
+struct qmt_id_lock_arg {
+	__u64	qia_least_qunit;
+	int	qia_nr_active;
+	__u32	qia_active[LQUOTA_SLV_RATE_MAX];
+};
+
+/* Callback function used to tailor the qunit broadcast to each slave. Quota
+ * space is rebalanced toward the slaves which consume it: when some slaves
+ * are known to be active, the other ones are sent the least qunit and thus
+ * release all their spare quota space in the glimpse reply */
 static int qmt_id_lock_cb(const struct lu_env *env, struct qmt_device *qmt,
 			  struct obd_uuid *uuid, union ldlm_gl_desc *desc,
 			  void *arg)
 {
-	struct obd_uuid *slv_uuid = arg;
+	struct qmt_id_lock_arg	*qia = arg;
+	__u32			 key;
+	int			 i;
 
-	if (slv_uuid != NULL && obd_uuid_equals(uuid, slv_uuid))
-		RETURN(0);
+	if (qia->qia_nr_active == 0 ||
+	    desc->lquota_desc.gl_qunit <= qia->qia_least_qunit)
+		RETURN(+1);
+
+	key = qmt_slv_key(uuid);
+	for (i = 0; i < qia->qia_nr_active; i++)
+		if (qia->qia_active[i] == key)
+			RETURN(+1);
+
+	desc->lquota_desc.gl_qunit = qia->qia_least_qunit;
 	RETURN(+1);
 }
 
+/* ID being glimpsed by the rebalance thread */
+struct qmt_reba_entry {
+	struct lquota_entry	*qre_lqe;
+	struct ldlm_resource	*qre_res;
+	/* qunit value broadcast to the active slaves */
+	__u64			 qre_qunit;
+};
+
 /*
- * Send glimpse request on per-ID lock to push new qunit value to slave.
+ * Prepare glimpse requests on per-ID lock to push new qunit value to slaves.
  *
- * \param env  - is the environment passed by the caller
- * \param qmt  - is the quota master target device
- * \param lqe  - is the lquota entry with the new qunit value
- * \param uuid - is the uuid of the slave acquiring space, if any
+ * \param env     - is the environment passed by the caller
+ * \param qmt     - is the quota master target device
+ * \param qre     - is filled with what qmt_id_lock_glimpse_fini() needs
+ * \param lqe     - is the lquota entry with the new qunit value
+ * \param gl_list - is the list of glimpse works to add to
+ * \param works   - is the list of qmt_gl_work to be freed once sent
+ *
+ * \retval 0 if glimpse requests were prepared, appropriate error otherwise
  */
-static void qmt_id_lock_glimpse(const struct lu_env *env,
-				struct qmt_device *qmt,
-				struct lquota_entry *lqe, struct obd_uuid *uuid)
+static int qmt_id_lock_glimpse_prep(const struct lu_env *env,
+				    struct qmt_device *qmt,
+				    struct qmt_reba_entry *qre,
+				    struct lquota_entry *lqe,
+				    struct list_head *gl_list,
+				    struct list_head *works)
 {
 	struct qmt_thread_info	*qti = qmt_info(env);
 	struct qmt_pool_info	*pool = lqe2qpi(lqe);
 	struct ldlm_resource	*res = NULL;
-	int			 rc;
+	struct qmt_id_lock_arg	 qia;
 	ENTRY;
 
 	if (!lqe->lqe_enforced)
-		RETURN_EXIT;
+		RETURN(-ESRCH);
 
 	lquota_generate_fid(&qti->qti_fid, pool->qpi_key & 0x0000ffff,
 			    pool->qpi_key >> 16, lqe->lqe_site->lqs_qtype);
@@ -620,7 +711,7 @@ static void qmt_id_lock_glimpse(const struct lu_env *env,
 		    lqe->lqe_qunit == pool->qpi_least_qunit)
 			lqe->lqe_revoke_time = cfs_time_current_64();
 		lqe_write_unlock(lqe);
-		RETURN_EXIT;
+		RETURN(PTR_ERR(res));
 	}
 
 	lqe_write_lock(lqe);
@@ -643,18 +734,37 @@ static void qmt_id_lock_glimpse(const struct lu_env *env,
 		 * replies if needed */
 		lqe->lqe_may_rel = 0;
 
+	qia.qia_least_qunit = pool->qpi_least_qunit;
+	qia.qia_nr_active = qmt_slv_active(lqe, cfs_time_current_sec(),
+					   qia.qia_active);
+
 	/* The rebalance thread is the only thread which can issue glimpses */
 	LASSERT(!lqe->lqe_gl);
 	lqe->lqe_gl = true;
 	lqe_write_unlock(lqe);
 
-	/* issue glimpse callback to slaves */
-	rc = qmt_glimpse_lock(env, qmt, res, &qti->qti_gl_desc,
-			      uuid ? qmt_id_lock_cb : NULL, (void *)uuid);
+	qmt_glimpse_prep(env, qmt, res, &qti->qti_gl_desc, qmt_id_lock_cb,
+			 &qia, gl_list, works);
+
+	qre->qre_lqe   = lqe;
+	qre->qre_res   = res;
+	qre->qre_qunit = qti->qti_gl_desc.lquota_desc.gl_qunit;
+	RETURN(0);
+}
+
+/*
+ * Complete glimpse requests prepared with qmt_id_lock_glimpse_prep().
+ *
+ * \param qre - is the ID which was glimpsed
+ */
+static void qmt_id_lock_glimpse_fini(struct qmt_reba_entry *qre)
+{
+	struct lquota_entry	*lqe = qre->qre_lqe;
+	struct qmt_pool_info	*pool = lqe2qpi(lqe);
 
 	lqe_write_lock(lqe);
 	if (lqe->lqe_revoke_time == 0 &&
-	    qti->qti_gl_desc.lquota_desc.gl_qunit == pool->qpi_least_qunit &&
+	    qre->qre_qunit == pool->qpi_least_qunit &&
 	    lqe->lqe_qunit == pool->qpi_least_qunit) {
 		lqe->lqe_revoke_time = cfs_time_current_64();
 		qmt_adjust_edquot(lqe, cfs_time_current_sec());
@@ -663,7 +773,45 @@ static void qmt_id_lock_glimpse(const struct lu_env *env,
 	lqe->lqe_gl = false;
 	lqe_write_unlock(lqe);
 
-	ldlm_resource_putref(res);
+	ldlm_resource_putref(qre->qre_res);
+}
+
+/*
+ * Send glimpse requests on per-ID locks of a batch of IDs to push new qunit
+ * values to slaves. All the glimpses are issued as a single set of RPCs, so
+ * that a slave holding locks for several of these IDs is notified of all of
+ * them in parallel instead of one ID after the other.
+ *
+ * This saves round trips, not RPCs: there is still one glimpse RPC per
+ * (ID, slave) pair, since each per-ID lock is a separate LDLM resource and
+ * the glimpse descriptor only carries one qunit. Packing several IDs in one
+ * RPC would require a new descriptor negotiated with a connect flag.
+ *
+ * \param env   - is the environment passed by the caller
+ * \param qmt   - is the quota master target device
+ * \param qre   - is the array of IDs to glimpse
+ * \param count - is the number of entries in \a qre
+ * \param gl_list - is the list of glimpse works of all the IDs
+ * \param works   - is the list of qmt_gl_work to free
+ */
+static void qmt_id_lock_glimpse(const struct lu_env *env,
+				struct qmt_device *qmt,
+				struct qmt_reba_entry *qre, int count,
+				struct list_head *gl_list,
+				struct list_head *works)
+{
+	int	rc, i;
+	ENTRY;
+
+	/* issue glimpse callback to slaves */
+	rc = qmt_glimpse_send(env, qmt, qre[0].qre_res, gl_list, works);
+	/* ldlm_glimpse_locks() only reprocessed the first resource */
+	if (rc == -ERESTART)
+		for (i = 1; i < count; i++)
+			ldlm_reprocess_all(qre[i].qre_res);
+
+	for (i = 0; i < count; i++)
+		qmt_id_lock_glimpse_fini(&qre[i]);
 	EXIT;
 }
 
@@ -710,17 +858,27 @@ static int qmt_reba_thread(void *arg)
 	struct ptlrpc_thread	*thread = &qmt->qmt_reba_thread;
 	struct l_wait_info	 lwi = { 0 };
 	struct lu_env		*env;
-	struct lquota_entry	*lqe, *tmp;
-	int			 rc;
+	struct lquota_entry	*lqe;
+	struct qmt_reba_entry	*qre;
+	struct list_head	 gl_list;
+	struct list_head	 works;
+	int			 rc, count, i;
 	ENTRY;
 
 	OBD_ALLOC_PTR(env);
 	if (env == NULL)
 		RETURN(-ENOMEM);
 
+	OBD_ALLOC(qre, QMT_REBA_BATCH * sizeof(*qre));
+	if (qre == NULL) {
+		OBD_FREE_PTR(env);
+		RETURN(-ENOMEM);
+	}
+
 	rc = lu_env_init(env, LCT_MD_THREAD);
 	if (rc) {
 		CERROR("%s: failed to init env.", qmt->qmt_svname);
+		OBD_FREE(qre, QMT_REBA_BATCH * sizeof(*qre));
 		OBD_FREE_PTR(env);
 		RETURN(rc);
 	}
@@ -734,15 +892,44 @@ static int qmt_reba_thread(void *arg)
 			     !thread_is_running(thread), &lwi);
 
 		spin_lock(&qmt->qmt_reba_lock);
-		list_for_each_entry_safe(lqe, tmp, &qmt->qmt_reba_list,
-					 lqe_link) {
-			list_del_init(&lqe->lqe_link);
+		while (!list_empty(&qmt->qmt_reba_list)) {
+			INIT_LIST_HEAD(&gl_list);
+			INIT_LIST_HEAD(&works);
+			count = 0;
+
+			/* collect glimpses for a batch of IDs */
+			while (count < QMT_REBA_BATCH &&
+			       !list_empty(&qmt->qmt_reba_list)) {
+				lqe = list_entry(qmt->qmt_reba_list.next,
+						 struct lquota_entry, lqe_link);
+				/* ID notified again while being glimpsed, wait
+				 * for the current batch to complete */
+				if (lqe->lqe_gl)
+					break;
+				list_del_init(&lqe->lqe_link);
+				spin_unlock(&qmt->qmt_reba_lock);
+
+				/* lqe reference is dropped once glimpsed */
+				if (thread_is_running(thread) &&
+				    qmt_id_lock_glimpse_prep(env, qmt,
+							     &qre[count], lqe,
+							     &gl_list,
+							     &works) == 0)
+					count++;
+				else
+					lqe_putref(lqe);
+
+				spin_lock(&qmt->qmt_reba_lock);
+			}
 			spin_unlock(&qmt->qmt_reba_lock);
 
-			if (thread_is_running(thread))
-				qmt_id_lock_glimpse(env, qmt, lqe, NULL);
+			if (count > 0) {
+				qmt_id_lock_glimpse(env, qmt, qre, count,
+						    &gl_list, &works);
+				for (i = 0; i < count; i++)
+					lqe_putref(qre[i].qre_lqe);
+			}
 
-			lqe_putref(lqe);
 			spin_lock(&qmt->qmt_reba_lock);
 		}
 		spin_unlock(&qmt->qmt_reba_lock);
@@ -751,6 +938,7 @@ static int qmt_reba_thread(void *arg)
 			break;
 	}
 	lu_env_fini(env);
+	OBD_FREE(qre, QMT_REBA_BATCH * sizeof(*qre));
 	OBD_FREE_PTR(env);
 	thread_set_flags(thread, SVC_STOPPED);
 	wake_up(&thread->t_ctl_waitq);
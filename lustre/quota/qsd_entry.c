@@ -50,6 +50,9 @@ static void qsd_lqe_init(struct lquota_entry *lqe, void *arg)
 	init_waitqueue_head(&lqe->lqe_waiters);
 	lqe->lqe_usage    = 0;
 	lqe->lqe_nopreacq = false;
+	lqe->lqe_reserved = 0;
+	/* allocated on lock contention, see qsd_pcpt_init() */
+	lqe->lqe_pcpt     = NULL;
 }
 
 /*
@@ -139,12 +142,14 @@ static void qsd_lqe_debug(struct lquota_entry *lqe, void *arg,
 
 	libcfs_debug_vmsg2(msgdata, fmt, args,
 			   "qsd:%s qtype:%s id:"LPU64" enforced:%d granted:"
-			   LPU64" pending:"LPU64" waiting:"LPU64" req:%d usage:"
-			   LPU64" qunit:"LPU64" qtune:"LPU64" edquot:%d\n",
+			   LPU64" pending:"LPU64" waiting:"LPU64" reserved:"
+			   LPU64" req:%d usage:"LPU64" qunit:"LPU64" qtune:"
+			   LPU64" edquot:%d\n",
 			   qqi->qqi_qsd->qsd_svname, QTYPE_NAME(qqi->qqi_qtype),
 			   lqe->lqe_id.qid_uid, lqe->lqe_enforced,
 			   lqe->lqe_granted, lqe->lqe_pending_write,
-			   lqe->lqe_waiting_write, lqe->lqe_pending_req,
+			   lqe->lqe_waiting_write, lqe->lqe_reserved,
+			   lqe->lqe_pending_req,
 			   lqe->lqe_usage, lqe->lqe_qunit, lqe->lqe_qtune,
 			   lqe->lqe_edquot);
 }
@@ -188,11 +193,16 @@ int qsd_refresh_usage(const struct lu_env *env, struct lquota_entry *lqe)
 	struct qsd_thread_info	*qti = qsd_info(env);
 	struct lquota_acct_rec	*rec = &qti->qti_acct_rec;
 	struct qsd_qtype_info	*qqi = lqe2qqi(lqe);
+	__u64			 done;
 	int			 rc = 0;
 	ENTRY;
 
 	LASSERT(qqi->qqi_acct_obj);
 
+	/* space of the operations completed on the CPU partitions so far is
+	 * part of the disk usage read below */
+	done = qsd_pcpt_collect(lqe);
+
 	/* read disk usage */
 	rc = lquota_disk_read(env, qqi->qqi_acct_obj, &lqe->lqe_id,
 			      (struct dt_rec *)rec);
@@ -209,8 +219,12 @@ int qsd_refresh_usage(const struct lu_env *env, struct lquota_entry *lqe)
 		break;
 	default:
 		LQUOTA_ERROR(lqe, "failed to read disk usage, rc:%d", rc);
+		/* still not reflected in lqe_usage */
+		if (done != 0)
+			qsd_pcpt_release(lqe, done);
 		RETURN(rc);
 	}
+	qsd_pcpt_done(lqe, done);
 
 	LQUOTA_DEBUG(lqe, "disk usage: "LPU64, lqe->lqe_usage);
 	RETURN(0);
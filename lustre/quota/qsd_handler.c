@@ -32,6 +32,237 @@
 
 #include "qsd_internal.h"
 
+/* number of seconds of recent quota consumption an ID should be able to
+ * consume from local grant before having to ask the master again, quota space
+ * is prefetched accordingly, 0 disables prefetching */
+static unsigned int qsd_prefetch_interval = 2;
+CFS_MODULE_PARM(qsd_prefetch_interval, "i", uint, 0644,
+		"seconds of quota consumption to prefetch from the master");
+
+/**
+ * Account \a space consumed by a write for \a lqe and refresh the average
+ * consumption rate of this ID about once per second.
+ * Should be called with lqe write lock held.
+ */
+static void qsd_update_rate(struct lquota_entry *lqe, __u64 space)
+{
+	__u64	now = cfs_time_current_64();
+	__u64	elapsed;
+	__u64	rate;
+
+	lqe->lqe_rate_space += space;
+	if (lqe->lqe_rate_time == 0) {
+		lqe->lqe_rate_time = now;
+		return;
+	}
+
+	elapsed = now - lqe->lqe_rate_time;
+	if (elapsed < cfs_time_seconds(1))
+		return;
+
+	rate = lqe->lqe_rate_space * cfs_time_seconds(1);
+	do_div(rate, elapsed);
+	/* exponentially weighted moving average, idle periods decay it */
+	lqe->lqe_rate = (lqe->lqe_rate * 3 + rate) >> 2;
+	lqe->lqe_rate_space = 0;
+	lqe->lqe_rate_time = now;
+}
+
+/**
+ * How much spare quota space should be owned by this slave for \a lqe, based
+ * on its recent consumption rate. Never more than one qunit, which is the
+ * most the master grants to a slave anyway.
+ */
+static inline __u64 qsd_prefetch_space(struct lquota_entry *lqe)
+{
+	return min_t(__u64, lqe->lqe_rate * qsd_prefetch_interval,
+		     lqe->lqe_qunit);
+}
+
+/* a CPU partition gets at most this fraction of the quota space available
+ * locally each time its reservation is refilled */
+#define QSD_PCPT_SHARES	4
+
+/**
+ * Allocate the per-CPU partition slots of \a lqe. They cost a slot per CPU
+ * partition for each ID, so this is only done for IDs whose lqe lock is
+ * contended. Slots are useless with a single partition since all the threads
+ * would then share the same slot lock. Failure to allocate them isn't fatal,
+ * lqe lock is then always used.
+ */
+static void qsd_pcpt_init(struct lquota_entry *lqe)
+{
+	struct lquota_slv_pcpt	**slots;
+	struct lquota_slv_pcpt	 *pcpt;
+	int			  i;
+
+	if (lqe->lqe_pcpt != NULL || cfs_cpt_number(cfs_cpt_table) <= 1)
+		return;
+
+	slots = cfs_percpt_alloc(cfs_cpt_table, sizeof(*pcpt));
+	if (slots == NULL)
+		return;
+
+	cfs_percpt_for_each(pcpt, i, slots)
+		spin_lock_init(&pcpt->lsp_lock);
+
+	/* the fast path reads lqe_pcpt without lqe lock */
+	if (cmpxchg(&lqe->lqe_pcpt, NULL, slots) != NULL)
+		cfs_percpt_free(slots);
+	else
+		LQUOTA_DEBUG(lqe, "per-CPU partition reservations enabled");
+}
+
+/**
+ * Give back to \a lqe the quota space reserved by the CPU partitions which
+ * hasn't been consumed. Space used by in-flight or completed operations
+ * remains accounted in lqe_reserved, the latter until lqe_usage is refreshed,
+ * see qsd_pcpt_collect().
+ * Should be called with lqe write lock held.
+ */
+void qsd_pcpt_settle(struct lquota_entry *lqe)
+{
+	struct lquota_slv_pcpt	*pcpt;
+	int			 i;
+
+	if (lqe->lqe_pcpt == NULL || lqe->lqe_reserved == 0)
+		return;
+
+	cfs_percpt_for_each(pcpt, i, lqe->lqe_pcpt) {
+		spin_lock(&pcpt->lsp_lock);
+		LASSERT(lqe->lqe_reserved >= pcpt->lsp_credit);
+		lqe->lqe_reserved -= pcpt->lsp_credit;
+		pcpt->lsp_credit = 0;
+		spin_unlock(&pcpt->lsp_lock);
+	}
+}
+
+/**
+ * Collect the space consumed by operations which completed on the CPU
+ * partitions since the last call. This space remains accounted in
+ * lqe_reserved until qsd_pcpt_done() is called with the returned value, which
+ * must only be done once lqe_usage has been read after this call.
+ */
+__u64 qsd_pcpt_collect(struct lquota_entry *lqe)
+{
+	struct lquota_slv_pcpt	*pcpt;
+	__u64			 done = 0;
+	int			 i;
+
+	if (lqe->lqe_pcpt == NULL)
+		return 0;
+
+	cfs_percpt_for_each(pcpt, i, lqe->lqe_pcpt) {
+		spin_lock(&pcpt->lsp_lock);
+		done += pcpt->lsp_done;
+		pcpt->lsp_done = 0;
+		spin_unlock(&pcpt->lsp_lock);
+	}
+	return done;
+}
+
+/**
+ * Drop from lqe_reserved the space \a done returned by qsd_pcpt_collect(),
+ * which is now part of lqe_usage.
+ */
+void qsd_pcpt_done(struct lquota_entry *lqe, __u64 done)
+{
+	if (done == 0)
+		return;
+
+	lqe_write_lock(lqe);
+	LASSERT(lqe->lqe_reserved >= done);
+	lqe->lqe_reserved -= done;
+	/* operations served by the CPU partitions don't go through
+	 * qsd_acquire_local() */
+	qsd_update_rate(lqe, done);
+	lqe_write_unlock(lqe);
+}
+
+/**
+ * Reserve some quota space for the current CPU partition so that next
+ * operations can consume it without taking lqe lock. This is only done when
+ * the ID is far enough from its granted limit, a partition never gets more
+ * than 1/QSD_PCPT_SHARES of the space available locally.
+ * Should be called with lqe write lock held.
+ */
+static void qsd_pcpt_refill(struct lquota_entry *lqe)
+{
+	struct qsd_instance	*qsd = lqe2qqi(lqe)->qqi_qsd;
+	struct lquota_slv_pcpt	*pcpt;
+	__u64			 used, avail;
+
+	if (lqe->lqe_pcpt == NULL || lqe->lqe_edquot || lqe->lqe_qunit == 0 ||
+	    !lustre_handle_is_used(&lqe->lqe_lockh))
+		return;
+
+	used  = lqe->lqe_usage + lqe->lqe_pending_rel;
+	used += lqe->lqe_pending_write + lqe->lqe_waiting_write;
+	used += lqe->lqe_reserved + qsd->qsd_sync_threshold;
+	if (used >= lqe->lqe_granted)
+		return;
+
+	avail = lqe->lqe_granted - used;
+	do_div(avail, QSD_PCPT_SHARES * cfs_percpt_number(lqe->lqe_pcpt));
+	if (avail == 0)
+		return;
+
+	pcpt = cfs_percpt_current(lqe->lqe_pcpt);
+	spin_lock(&pcpt->lsp_lock);
+	if (pcpt->lsp_credit == 0) {
+		pcpt->lsp_credit = avail;
+		lqe->lqe_reserved += avail;
+	}
+	spin_unlock(&pcpt->lsp_lock);
+}
+
+/**
+ * Try to consume \a space from the reservation of the current CPU partition.
+ *
+ * \retval true  - space consumed, \a lqe lock wasn't needed
+ * \retval false - not enough space reserved, go through qsd_acquire()
+ */
+static bool qsd_pcpt_acquire(struct lquota_entry *lqe, __u64 space)
+{
+	struct lquota_slv_pcpt	*pcpt;
+	bool			 rc = false;
+
+	if (lqe->lqe_pcpt == NULL)
+		return false;
+
+	pcpt = cfs_percpt_current(lqe->lqe_pcpt);
+	spin_lock(&pcpt->lsp_lock);
+	if (pcpt->lsp_credit >= space) {
+		pcpt->lsp_credit -= space;
+		rc = true;
+	}
+	spin_unlock(&pcpt->lsp_lock);
+
+	return rc;
+}
+
+/**
+ * Record completion of an operation which consumed \a space with
+ * qsd_pcpt_acquire(). The space remains accounted in lqe_reserved until the
+ * next usage refresh, see qsd_pcpt_collect().
+ *
+ * \retval true  - the current CPU partition still has space reserved
+ * \retval false - the reservation is exhausted
+ */
+bool qsd_pcpt_release(struct lquota_entry *lqe, __u64 space)
+{
+	struct lquota_slv_pcpt	*pcpt;
+	bool			 rc;
+
+	pcpt = cfs_percpt_current(lqe->lqe_pcpt);
+	spin_lock(&pcpt->lsp_lock);
+	pcpt->lsp_done += space;
+	rc = pcpt->lsp_credit != 0;
+	spin_unlock(&pcpt->lsp_lock);
+
+	return rc;
+}
+
 /**
  * helper function bumping lqe_pending_req if there is no quota request in
  * flight for the lquota entry \a lqe. Otherwise, EBUSY is returned.
@@ -163,6 +394,7 @@ static bool qsd_calc_adjust(struct lquota_entry *lqe, struct quota_body *qbody)
 
 	usage   = lqe->lqe_usage;
 	usage  += lqe->lqe_pending_write + lqe->lqe_waiting_write;
+	usage  += lqe->lqe_reserved;
 	granted = lqe->lqe_granted;
 
 	if (qbody != NULL)
@@ -263,9 +495,11 @@ static bool qsd_calc_adjust(struct lquota_entry *lqe, struct quota_body *qbody)
 		qbody->qb_flags = QUOTA_DQACQ_FL_REPORT;
 	}
 
-	/* 3. Time to pre-acquire? */
+	/* 3. Time to pre-acquire? Do it early enough for the spare space to
+	 * last qsd_prefetch_interval at the current consumption rate */
 	if (!lqe->lqe_edquot && !lqe->lqe_nopreacq && usage > 0 &&
-	    lqe->lqe_qunit != 0 && granted < usage + lqe->lqe_qtune) {
+	    lqe->lqe_qunit != 0 &&
+	    granted < usage + max(lqe->lqe_qtune, qsd_prefetch_space(lqe))) {
 		/* To pre-acquire quota space, we report how much spare quota
 		 * space the slave currently owns, then the master will grant us
 		 * back how much we can pretend given the current state of
@@ -451,12 +685,24 @@ static int qsd_acquire_local(struct lquota_entry *lqe, __u64 space)
 	/* use latest usage */
 	usage = lqe->lqe_usage;
 	/* take pending write into account */
-	usage += lqe->lqe_pending_write;
+	usage += lqe->lqe_pending_write + lqe->lqe_reserved;
+
+	if (space + usage > lqe->lqe_granted - lqe->lqe_pending_rel &&
+	    lqe->lqe_reserved != 0) {
+		/* close to the limit, reclaim space reserved by the CPU
+		 * partitions before giving up */
+		qsd_pcpt_settle(lqe);
+		usage  = lqe->lqe_usage;
+		usage += lqe->lqe_pending_write + lqe->lqe_reserved;
+	}
 
 	if (space + usage <= lqe->lqe_granted - lqe->lqe_pending_rel) {
 		/* Yay! we got enough space */
 		lqe->lqe_pending_write += space;
 		lqe->lqe_waiting_write -= space;
+		qsd_update_rate(lqe, space);
+		/* let next operations on this CPU partition go lockless */
+		qsd_pcpt_refill(lqe);
 		rc = 0;
 	/* lqe_edquot flag is used to avoid flooding dqacq requests when
 	 * the user is over quota, however, the lqe_edquot could be stale
@@ -493,6 +739,7 @@ static inline bool qsd_calc_acquire(struct lquota_entry *lqe,
 
 	usage   = lqe->lqe_usage;
 	usage  += lqe->lqe_pending_write + lqe->lqe_waiting_write;
+	usage  += lqe->lqe_reserved;
 	granted = lqe->lqe_granted;
 
 	qbody->qb_flags = 0;
@@ -505,9 +752,13 @@ static inline bool qsd_calc_acquire(struct lquota_entry *lqe,
 		granted = lqe->lqe_usage;
 	}
 
-	/* acquire as much as needed, but not more */
+	/* acquire as much as needed, plus what this ID is expected to
+	 * consume shortly so that writes don't have to wait for the master
+	 * again. The master never grants more than the hard limit. */
 	if (usage > granted) {
 		qbody->qb_count  = usage - granted;
+		if (!lqe->lqe_edquot)
+			qbody->qb_count += qsd_prefetch_space(lqe);
 		qbody->qb_flags |= QUOTA_DQACQ_FL_ACQ;
 	}
 
@@ -554,6 +805,9 @@ static int qsd_acquire_remote(const struct lu_env *env,
 		RETURN(0);
 	}
 
+	/* don't acquire space which is already reserved locally */
+	qsd_pcpt_settle(lqe);
+
 	/* fill qb_count & qb_flags */
 	if (!qsd_calc_acquire(lqe, qbody)) {
 		lqe_write_unlock(lqe);
@@ -722,9 +976,27 @@ static int qsd_op_begin0(const struct lu_env *env, struct qsd_qtype_info *qqi,
 		RETURN(0);
 	}
 
+	/* fast path, use space reserved for the current CPU partition */
+	if (qsd_pcpt_acquire(lqe, space)) {
+		qid->lqi_space += space;
+		qid->lqi_pcpt_space += space;
+		if (flags != NULL) {
+			LASSERT(qid->lqi_is_blk);
+			/* space is only reserved when far enough from the
+			 * limit, see qsd_pcpt_refill() */
+			*flags &= ~LQUOTA_OVER_FL(qqi->qqi_qtype);
+		}
+		RETURN(0);
+	}
+
 	LQUOTA_DEBUG(lqe, "op_begin space:"LPD64, space);
 
-	lqe_write_lock(lqe);
+	if (!lqe_write_trylock(lqe)) {
+		/* several threads are writing for this ID, let the next
+		 * operations use per-CPU partition reservations */
+		qsd_pcpt_init(lqe);
+		lqe_write_lock(lqe);
+	}
 	lqe->lqe_waiting_write += space;
 	lqe_write_unlock(lqe);
 
@@ -780,6 +1052,7 @@ out_flags:
 			usage  = lqe->lqe_usage;
 			usage += lqe->lqe_pending_write;
 			usage += lqe->lqe_waiting_write;
+			usage += lqe->lqe_reserved;
 			usage += qqi->qqi_qsd->qsd_sync_threshold;
 
 			/* if we should notify client to start sync write */
@@ -888,25 +1161,25 @@ int qsd_op_begin(const struct lu_env *env, struct qsd_instance *qsd,
 EXPORT_SYMBOL(qsd_op_begin);
 
 /**
- * Adjust quota space (by acquiring or releasing) hold by the quota slave.
- * This function is called after each quota request completion and during
- * reintegration in order to report usage or re-acquire quota locks.
- * Space adjustment is aborted if there is already a quota request in flight
- * for this ID.
+ * Prepare quota space adjustment for \a lqe, see qsd_adjust().
  *
  * \param env    - the environment passed by the caller
  * \param lqe    - is the qid entry to be processed
+ * \param qbody  - is the quota body to fill
+ * \param lockh  - is filled with the per-ID lock handle, if any
+ * \param intent - set to true if an intent lock request must be sent
  *
- * \retval 0 on success, appropriate errors on failure
+ * \retval 1     - \a qbody must be sent to the master, the caller owns a
+ *                 reference on \a lqe and the in-flight request slot until
+ *                 qsd_req_completion() is called
+ * \retval other - nothing to send, the value to be returned by qsd_adjust()
  */
-int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
+static int qsd_adjust_prep(const struct lu_env *env, struct lquota_entry *lqe,
+			   struct quota_body *qbody,
+			   struct lustre_handle *lockh, bool *intent)
 {
-	struct qsd_thread_info	*qti = qsd_info(env);
-	struct quota_body	*qbody = &qti->qti_body;
-	struct qsd_instance	*qsd;
 	struct qsd_qtype_info	*qqi;
 	int			 rc;
-	bool			 intent = false;
 	ENTRY;
 
 	memset(qbody, 0, sizeof(*qbody));
@@ -920,10 +1193,13 @@ int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
 	}
 
 	qqi = lqe2qqi(lqe);
-	qsd = qqi->qqi_qsd;
 
 	lqe_write_lock(lqe);
 
+	/* don't pre-acquire nor keep space reserved by CPU partitions but
+	 * not used */
+	qsd_pcpt_settle(lqe);
+
 	/* fill qb_count & qb_flags */
 	if (!qsd_calc_adjust(lqe, qbody)) {
 		lqe_write_unlock(lqe);
@@ -942,7 +1218,7 @@ int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
 
 	if (req_is_rel(qbody->qb_flags))
 		lqe->lqe_pending_rel = qbody->qb_count;
-	lustre_handle_copy(&qti->qti_lockh, &lqe->lqe_lockh);
+	lustre_handle_copy(lockh, &lqe->lqe_lockh);
 	lqe_write_unlock(lqe);
 
 	/* hold a refcount until completion */
@@ -954,9 +1230,9 @@ int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
 
 	if (req_is_acq(qbody->qb_flags) || req_is_preacq(qbody->qb_flags)) {
 		/* check whether we own a valid lock for this ID */
-		rc = qsd_id_lock_match(&qti->qti_lockh, &qbody->qb_lockh);
+		rc = qsd_id_lock_match(lockh, &qbody->qb_lockh);
 		if (rc) {
-			memset(&qti->qti_lockh, 0, sizeof(qti->qti_lockh));
+			memset(lockh, 0, sizeof(*lockh));
 			if (req_is_preacq(qbody->qb_flags)) {
 				if (req_has_rep(qbody->qb_flags))
 					/* still want to report usage */
@@ -966,7 +1242,7 @@ int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
 					GOTO(out, rc = -ENOLCK);
 			} else {
 				/* no lock found, should use intent */
-				intent = true;
+				*intent = true;
 			}
 		} else if (req_is_acq(qbody->qb_flags) &&
 			   qbody->qb_count == 0) {
@@ -975,31 +1251,160 @@ int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
 		}
 	} else {
 		/* release and report don't need a per-ID lock */
-		memset(&qti->qti_lockh, 0, sizeof(qti->qti_lockh));
+		memset(lockh, 0, sizeof(*lockh));
 	}
+	RETURN(1);
+out:
+	qsd_req_completion(env, qqi, qbody, NULL, lockh, NULL, lqe, rc);
+	return rc;
+}
 
-	if (!intent) {
-		rc = qsd_send_dqacq(env, qsd->qsd_exp, qbody, false,
-				    qsd_req_completion, qqi, &qti->qti_lockh,
-				    lqe);
-	} else {
-		struct lquota_lvb *lvb;
+/**
+ * Send the quota request prepared by qsd_adjust_prep() on its own.
+ */
+static int qsd_adjust_send(const struct lu_env *env, struct lquota_entry *lqe,
+			   struct quota_body *qbody,
+			   struct lustre_handle *lockh, bool intent)
+{
+	struct qsd_qtype_info	*qqi = lqe2qqi(lqe);
+	struct qsd_instance	*qsd = qqi->qqi_qsd;
+	struct lquota_lvb	*lvb;
+	int			 rc;
 
-		OBD_ALLOC_PTR(lvb);
-		if (lvb == NULL)
-			GOTO(out, rc = -ENOMEM);
+	if (!intent)
+		return qsd_send_dqacq(env, qsd->qsd_exp, qbody, false,
+				      qsd_req_completion, qqi, lockh, lqe);
 
-		rc = qsd_intent_lock(env, qsd->qsd_exp, qbody, false,
-				     IT_QUOTA_DQACQ, qsd_req_completion,
-				     qqi, lvb, (void *)lqe);
+	OBD_ALLOC_PTR(lvb);
+	if (lvb == NULL) {
+		rc = -ENOMEM;
+		qsd_req_completion(env, qqi, qbody, NULL, lockh, NULL, lqe,
+				   rc);
+		return rc;
 	}
+
+	return qsd_intent_lock(env, qsd->qsd_exp, qbody, false,
+			       IT_QUOTA_DQACQ, qsd_req_completion, qqi, lvb,
+			       (void *)lqe);
+}
+
+/**
+ * Adjust quota space (by acquiring or releasing) hold by the quota slave.
+ * This function is called after each quota request completion and during
+ * reintegration in order to report usage or re-acquire quota locks.
+ * Space adjustment is aborted if there is already a quota request in flight
+ * for this ID.
+ *
+ * \param env    - the environment passed by the caller
+ * \param lqe    - is the qid entry to be processed
+ *
+ * \retval 0 on success, appropriate errors on failure
+ */
+int qsd_adjust(const struct lu_env *env, struct lquota_entry *lqe)
+{
+	struct qsd_thread_info	*qti = qsd_info(env);
+	bool			 intent = false;
+	int			 rc;
+	ENTRY;
+
+	rc = qsd_adjust_prep(env, lqe, &qti->qti_body, &qti->qti_lockh,
+			     &intent);
+	if (rc != 1)
+		RETURN(rc);
+
 	/* the completion function will be called by qsd_send_dqacq or
 	 * qsd_intent_lock */
+	rc = qsd_adjust_send(env, lqe, &qti->qti_body, &qti->qti_lockh,
+			     intent);
 	RETURN(rc);
-out:
-	qsd_req_completion(env, qqi, qbody, NULL, &qti->qti_lockh, NULL, lqe,
-			   rc);
-	return rc;
+}
+
+/**
+ * Same as qsd_adjust(), but the DQACQ request is added to \a batchp instead
+ * of being sent right away, so that the space of many IDs can be adjusted
+ * with a single RPC once qsd_adjust_batch_flush() is called. Intent requests
+ * are still sent on their own since they enqueue a per-ID lock.
+ * The batch is allocated on demand and flushed when full.
+ *
+ * \param env    - the environment passed by the caller
+ * \param lqe    - is the qid entry to be processed
+ * \param batchp - is the batch of pending requests
+ *
+ * \retval 0 on success, appropriate errors on failure
+ */
+int qsd_adjust_batch(const struct lu_env *env, struct lquota_entry *lqe,
+		     struct qsd_dqacq_batch **batchp)
+{
+	struct qsd_thread_info	*qti = qsd_info(env);
+	struct qsd_instance	*qsd = lqe2qqi(lqe)->qqi_qsd;
+	struct qsd_dqacq_batch	*batch = *batchp;
+	bool			 intent = false;
+	int			 rc, i;
+	ENTRY;
+
+	if (!qsd_dqacq_batch_supported(qsd))
+		RETURN(qsd_adjust(env, lqe));
+
+	if (batch == NULL) {
+		OBD_ALLOC_LARGE(batch, sizeof(*batch));
+		if (batch == NULL)
+			RETURN(qsd_adjust(env, lqe));
+		*batchp = batch;
+	}
+
+	rc = qsd_adjust_prep(env, lqe, &qti->qti_body, &qti->qti_lockh,
+			     &intent);
+	if (rc != 1)
+		RETURN(rc);
+
+	if (intent)
+		RETURN(qsd_adjust_send(env, lqe, &qti->qti_body,
+				       &qti->qti_lockh, intent));
+
+	i = batch->qdb_count++;
+	batch->qdb_lqes[i] = lqe;
+	batch->qdb_bodies[i] = qti->qti_body;
+	lustre_handle_copy(&batch->qdb_lockh[i], &qti->qti_lockh);
+	LQUOTA_DEBUG(lqe, "DQACQ batched, flags:0x%x, %d pending",
+		     qti->qti_body.qb_flags, batch->qdb_count);
+
+	if (batch->qdb_count == QSD_DQACQ_BATCH_MAX)
+		qsd_adjust_batch_flush(env, qsd, batchp);
+	RETURN(0);
+}
+
+/**
+ * Send the quota requests collected by qsd_adjust_batch() to the master.
+ *
+ * \param env    - the environment passed by the caller
+ * \param qsd    - is the qsd instance the requests belong to
+ * \param batchp - is the batch of pending requests, reset on return
+ */
+void qsd_adjust_batch_flush(const struct lu_env *env, struct qsd_instance *qsd,
+			    struct qsd_dqacq_batch **batchp)
+{
+	struct qsd_dqacq_batch	*batch = *batchp;
+	struct lquota_entry	*lqe;
+	ENTRY;
+
+	if (batch == NULL || batch->qdb_count == 0)
+		RETURN_EXIT;
+
+	if (batch->qdb_count > 1) {
+		/* the request takes over the batch */
+		*batchp = NULL;
+		qsd_send_dqacq_batch(env, qsd->qsd_exp, batch,
+				     qsd_req_completion);
+		RETURN_EXIT;
+	}
+
+	/* no need for a batched request to adjust a single ID */
+	lqe = batch->qdb_lqes[0];
+	batch->qdb_count = 0;
+	qsd_send_dqacq(env, qsd->qsd_exp, &batch->qdb_bodies[0], false,
+		       qsd_req_completion, lqe2qqi(lqe), &batch->qdb_lockh[0],
+		       lqe);
+	EXIT;
 }
 
 /**
@@ -1028,6 +1433,24 @@ static void qsd_op_end0(const struct lu_env *env, struct qsd_qtype_info *qqi,
 		RETURN_EXIT;
 	qid->lqi_qentry = NULL;
 
+	if (qid->lqi_pcpt_space > 0) {
+		bool	reserved;
+
+		reserved = qsd_pcpt_release(lqe, qid->lqi_pcpt_space);
+		qid->lqi_space -= qid->lqi_pcpt_space;
+		qid->lqi_pcpt_space = 0;
+
+		if (reserved && qid->lqi_space == 0 && env != NULL) {
+			/* still far from the limit, leave usage refresh and
+			 * space adjustment to the writeback thread. Racy
+			 * check to avoid taking qsd_adjust_lock each time */
+			if (list_empty(&lqe->lqe_link))
+				qsd_adjust_schedule(lqe, true, false);
+			lqe_putref(lqe);
+			RETURN_EXIT;
+		}
+	}
+
 	/* refresh cached usage if a suitable environment is passed */
 	if (env != NULL)
 		qsd_refresh_usage(env, lqe);
@@ -1043,11 +1466,12 @@ static void qsd_op_end0(const struct lu_env *env, struct qsd_qtype_info *qqi,
 
 	if (adjust) {
 		/* pre-acquire/release quota space is needed */
-		if (env != NULL)
+		if (env != NULL && !qsd_dqacq_batch_supported(qqi->qqi_qsd))
 			qsd_adjust(env, lqe);
 		else
-			/* no suitable environment, handle adjustment in
-			 * separate thread context */
+			/* no suitable environment, or the master can process
+			 * several IDs at once: handle adjustment in the
+			 * writeback thread which batches DQACQ requests */
 			qsd_adjust_schedule(lqe, false, false);
 	}
 	lqe_putref(lqe);
@@ -356,6 +356,31 @@ int qsd_id_lock_cancel(const struct lu_env *, struct lquota_entry *);
 int qsd_start_reint_thread(struct qsd_qtype_info *);
 void qsd_stop_reint_thread(struct qsd_qtype_info *);
 
+/* maximum number of quota_body packed in a single QUOTA_DQACQ RPC */
+#define QSD_DQACQ_BATCH_MAX	64
+
+/* quota space adjustments collected by the writeback thread and sent to the
+ * master with a single QUOTA_DQACQ RPC, see qsd_adjust_batch() */
+struct qsd_dqacq_batch {
+	int			 qdb_count;
+	struct lquota_entry	*qdb_lqes[QSD_DQACQ_BATCH_MAX];
+	struct lustre_handle	 qdb_lockh[QSD_DQACQ_BATCH_MAX];
+	struct quota_body	 qdb_bodies[QSD_DQACQ_BATCH_MAX];
+};
+
+/* whether the master accepts several quota_body per QUOTA_DQACQ RPC */
+static inline bool qsd_dqacq_batch_supported(struct qsd_instance *qsd)
+{
+	bool	supported;
+
+	read_lock(&qsd->qsd_lock);
+	supported = qsd->qsd_exp_valid &&
+		    (exp_connect_flags(qsd->qsd_exp) & OBD_CONNECT_DQACQ_BATCH);
+	read_unlock(&qsd->qsd_lock);
+
+	return supported;
+}
+
 /* qsd_request.c */
 typedef void (*qsd_req_completion_t) (const struct lu_env *,
 				      struct qsd_qtype_info *,
@@ -366,6 +391,8 @@ int qsd_send_dqacq(const struct lu_env *, struct obd_export *,
 		   struct quota_body *, bool, qsd_req_completion_t,
 		   struct qsd_qtype_info *, struct lustre_handle *,
 		   struct lquota_entry *);
+int qsd_send_dqacq_batch(const struct lu_env *, struct obd_export *,
+			 struct qsd_dqacq_batch *, qsd_req_completion_t);
 int qsd_intent_lock(const struct lu_env *, struct obd_export *,
 		    struct quota_body *, bool, int, qsd_req_completion_t,
 		    struct qsd_qtype_info *, struct lquota_lvb *, void *);
@@ -382,7 +409,15 @@ void qsd_put_fsinfo(struct qsd_fsinfo *);
 int qsd_process_config(struct lustre_cfg *);
 
 /* qsd_handler.c */
+void qsd_pcpt_settle(struct lquota_entry *);
+__u64 qsd_pcpt_collect(struct lquota_entry *);
+void qsd_pcpt_done(struct lquota_entry *, __u64);
+bool qsd_pcpt_release(struct lquota_entry *, __u64);
 int qsd_adjust(const struct lu_env *, struct lquota_entry *);
+int qsd_adjust_batch(const struct lu_env *, struct lquota_entry *,
+		     struct qsd_dqacq_batch **);
+void qsd_adjust_batch_flush(const struct lu_env *, struct qsd_instance *,
+			    struct qsd_dqacq_batch **);
 
 /* qsd_writeback.c */
 void qsd_upd_schedule(struct qsd_qtype_info *, struct lquota_entry *,
@@ -408,9 +408,15 @@ static int qsd_id_glimpse_ast(struct ldlm_lock *lock, void *data)
 		/* extract new qunit from glimpse request */
 		qsd_set_qunit(lqe, desc->gl_qunit);
 
+		/* reclaim space reserved by CPU partitions and not used, the
+		 * master is asking for it. Space of completed operations
+		 * stays reserved since lqe_usage isn't refreshed here */
+		qsd_pcpt_settle(lqe);
+
 		space  = lqe->lqe_granted - lqe->lqe_pending_rel;
 		space -= lqe->lqe_usage;
 		space -= lqe->lqe_pending_write + lqe->lqe_waiting_write;
+		space -= lqe->lqe_reserved;
 		space -= lqe->lqe_qunit;
 
 		if (space > 0) {
@@ -498,8 +504,9 @@ int qsd_id_lock_cancel(const struct lu_env *env, struct lquota_entry *lqe)
 	ENTRY;
 
 	lqe_write_lock(lqe);
+	qsd_pcpt_settle(lqe);
 	if (lqe->lqe_pending_write || lqe->lqe_waiting_write ||
-	    lqe->lqe_usage || lqe->lqe_granted) {
+	    lqe->lqe_reserved || lqe->lqe_usage || lqe->lqe_granted) {
 		lqe_write_unlock(lqe);
 		RETURN(0);
 	}
@@ -141,6 +141,128 @@ out:
 	return rc;
 }
 
+struct qsd_batch_async_args {
+	struct qsd_dqacq_batch	*ba_batch;
+	qsd_req_completion_t	 ba_completion;
+};
+
+/*
+ * Batched quota request interpret callback, the completion callback is
+ * called for each quota_body of the request with its own status.
+ *
+ * \param env    - the environment passed by the caller
+ * \param req    - the batched quota request
+ * \param arg    - qsd_batch_async_args
+ * \param rc     - request status
+ *
+ * \retval 0     - success
+ * \retval -ve   - appropriate errors
+ */
+static int qsd_dqacq_batch_interpret(const struct lu_env *env,
+				     struct ptlrpc_request *req, void *arg,
+				     int rc)
+{
+	struct qsd_batch_async_args	*aa = arg;
+	struct qsd_dqacq_batch		*batch = aa->ba_batch;
+	struct quota_body		*req_qbody, *rep_qbody = NULL;
+	int				 i;
+	ENTRY;
+
+	req_qbody = req_capsule_client_get(&req->rq_pill, &RMF_QUOTA_BODY);
+	if (rc == 0) {
+		rep_qbody = req_capsule_server_get(&req->rq_pill,
+						   &RMF_QUOTA_BODY);
+		if (rep_qbody == NULL ||
+		    req_capsule_get_size(&req->rq_pill, &RMF_QUOTA_BODY,
+					 RCL_SERVER) !=
+		    batch->qdb_count * sizeof(*rep_qbody))
+			rc = -EPROTO;
+	}
+
+	for (i = 0; i < batch->qdb_count; i++) {
+		struct lquota_entry	*lqe = batch->qdb_lqes[i];
+		struct quota_body	*repbody = NULL;
+		int			 ret = rc;
+
+		if (rc == 0) {
+			ret = ptlrpc_status_ntoh(rep_qbody[i].qb_rc);
+			if (ret == 0 || ret == -EDQUOT || ret == -EINPROGRESS)
+				repbody = &rep_qbody[i];
+		}
+		aa->ba_completion(env, lqe2qqi(lqe), &req_qbody[i], repbody,
+				  &batch->qdb_lockh[i], NULL, lqe, ret);
+	}
+	OBD_FREE_LARGE(batch, sizeof(*batch));
+	RETURN(rc);
+}
+
+/*
+ * Send the quota requests collected in \a batch to the master with a single
+ * asynchronous RPC. The master must support OBD_CONNECT_DQACQ_BATCH.
+ * The request takes over \a batch which is freed once all the completion
+ * callbacks have been called.
+ *
+ * \param env    - the environment passed by the caller
+ * \param exp    - is the export to use to send the acquire RPC
+ * \param batch  - quota bodies and entries to be packed in request
+ * \param completion - completion callback, called for each entry
+ *
+ * \retval 0     - success
+ * \retval -ve   - appropriate errors
+ */
+int qsd_send_dqacq_batch(const struct lu_env *env, struct obd_export *exp,
+			 struct qsd_dqacq_batch *batch,
+			 qsd_req_completion_t completion)
+{
+	struct ptlrpc_request		*req;
+	struct quota_body		*req_qbody;
+	struct qsd_batch_async_args	*aa;
+	int				 size;
+	int				 i;
+	int				 rc;
+	ENTRY;
+
+	LASSERT(exp);
+	LASSERT(batch->qdb_count > 0);
+
+	req = ptlrpc_request_alloc(class_exp2cliimp(exp), &RQF_QUOTA_DQACQ);
+	if (req == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	size = batch->qdb_count * sizeof(*req_qbody);
+	req_capsule_set_size(&req->rq_pill, &RMF_QUOTA_BODY, RCL_CLIENT, size);
+	req->rq_no_resend = req->rq_no_delay = 1;
+	req->rq_no_retry_einprogress = 1;
+	rc = ptlrpc_request_pack(req, LUSTRE_MDS_VERSION, QUOTA_DQACQ);
+	if (rc) {
+		ptlrpc_request_free(req);
+		GOTO(out, rc);
+	}
+
+	req_qbody = req_capsule_client_get(&req->rq_pill, &RMF_QUOTA_BODY);
+	memcpy(req_qbody, batch->qdb_bodies, size);
+
+	req_capsule_set_size(&req->rq_pill, &RMF_QUOTA_BODY, RCL_SERVER, size);
+	ptlrpc_request_set_replen(req);
+
+	CLASSERT(sizeof(*aa) <= sizeof(req->rq_async_args));
+	aa = ptlrpc_req_async_args(req);
+	aa->ba_batch = batch;
+	aa->ba_completion = completion;
+
+	req->rq_interpret_reply = qsd_dqacq_batch_interpret;
+	ptlrpcd_add_req(req, PDL_POLICY_LOCAL, -1);
+
+	RETURN(0);
+out:
+	for (i = 0; i < batch->qdb_count; i++)
+		completion(env, lqe2qqi(batch->qdb_lqes[i]),
+			   &batch->qdb_bodies[i], NULL, &batch->qdb_lockh[i],
+			   NULL, batch->qdb_lqes[i], rc);
+	OBD_FREE_LARGE(batch, sizeof(*batch));
+	return rc;
+}
+
 /*
  * intent quota request interpret callback.
  *
@@ -417,6 +417,7 @@ static int qsd_upd_thread(void *arg)
 	int			 qtype, rc = 0;
 	bool			 uptodate;
 	struct lquota_entry	*lqe;
+	struct qsd_dqacq_batch	*batch = NULL;
 	__u64			 cur_time;
 	ENTRY;
 
@@ -447,6 +448,9 @@ static int qsd_upd_thread(void *arg)
 			qsd_upd_free(upd);
 		}
 
+		/* let adjustments pile up so that they are batched */
+		OBD_FAIL_TIMEOUT(OBD_FAIL_QUOTA_DELAY_ADJUST, 5);
+
 		spin_lock(&qsd->qsd_adjust_lock);
 		cur_time = cfs_time_current_64();
 		while (!list_empty(&qsd->qsd_adjust_list)) {
@@ -465,7 +469,7 @@ static int qsd_upd_thread(void *arg)
 				if (lqe->lqe_adjust_time == 0)
 					qsd_id_lock_cancel(env, lqe);
 				else
-					qsd_adjust(env, lqe);
+					qsd_adjust_batch(env, lqe, &batch);
 			}
 
 			lqe_putref(lqe);
@@ -473,6 +477,10 @@ static int qsd_upd_thread(void *arg)
 		}
 		spin_unlock(&qsd->qsd_adjust_lock);
 
+		/* send adjustments collected above in as few RPCs as
+		 * possible, the batch holds its own lqe references */
+		qsd_adjust_batch_flush(env, qsd, &batch);
+
 		if (!thread_is_running(thread))
 			break;
 
@@ -482,6 +490,8 @@ static int qsd_upd_thread(void *arg)
 		for (qtype = USRQUOTA; qtype < MAXQUOTAS; qtype++)
 			qsd_start_reint_thread(qsd->qsd_type_array[qtype]);
 	}
+	if (batch != NULL)
+		OBD_FREE_LARGE(batch, sizeof(*batch));
 	lu_env_fini(env);
 	OBD_FREE_PTR(env);
 	thread_set_flags(thread, SVC_STOPPED);
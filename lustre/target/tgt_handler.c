@@ -1589,75 +1589,120 @@ void tgt_brw_unlock(struct obd_ioobj *obj, struct niobuf_remote *niob,
 	EXIT;
 }
 
+static void tgt_checksum_page_get(void *data, unsigned int idx,
+				  struct page **page, unsigned int *offset,
+				  unsigned int *len)
+{
+	struct ptlrpc_bulk_desc *desc = data;
+
+	*page = desc->bd_iov[idx].kiov_page;
+	*offset = desc->bd_iov[idx].kiov_offset & ~CFS_PAGE_MASK;
+	*len = desc->bd_iov[idx].kiov_len;
+}
+
+/* Number of T10-DIF guard tags needed to cover the pages of \a desc. */
+static unsigned int tgt_t10_guard_count(struct ptlrpc_bulk_desc *desc)
+{
+	unsigned int	count = 0;
+	int		i;
+
+	for (i = 0; i < desc->bd_iov_count; i++)
+		count += obd_t10_guard_count(desc->bd_iov[i].kiov_len);
+
+	return count;
+}
+
+/* Compute the T10CRC checksum of the pages in \a desc, storing the guard
+ * tags into \a guards if it is given. */
+static int tgt_checksum_t10(struct ptlrpc_bulk_desc *desc, __be16 *guards,
+			    __u32 *cksum)
+{
+	unsigned int	nguards = tgt_t10_guard_count(desc);
+	__be16		*buf = guards;
+	int		rc;
+
+	if (guards == NULL) {
+		OBD_ALLOC_LARGE(buf, nguards * sizeof(*buf));
+		if (buf == NULL)
+			return -ENOMEM;
+	}
+
+	rc = obd_t10_guards_cksum(tgt_checksum_page_get, desc,
+				  desc->bd_iov_count, buf, nguards, cksum);
+
+	if (guards == NULL)
+		OBD_FREE_LARGE(buf, nguards * sizeof(*buf));
+
+	return rc;
+}
+
 static __u32 tgt_checksum_bulk(struct lu_target *tgt,
 			       struct ptlrpc_bulk_desc *desc, int opc,
-			       cksum_type_t cksum_type)
+			       cksum_type_t cksum_type, __be16 *guards)
 {
-	struct cfs_crypto_hash_desc	*hdesc;
 	unsigned int			bufsize;
-	int				i, err;
+	int				err;
 	unsigned char			cfs_alg = cksum_obd2cfs(cksum_type);
 	__u32				cksum;
 
-	hdesc = cfs_crypto_hash_init(cfs_alg, NULL, 0);
-	if (IS_ERR(hdesc)) {
-		CERROR("%s: unable to initialize checksum hash %s\n",
-		       tgt_name(tgt), cfs_crypto_hash_name(cfs_alg));
-		return PTR_ERR(hdesc);
-	}
-
 	CDEBUG(D_INFO, "Checksum for algo %s\n", cfs_crypto_hash_name(cfs_alg));
-	for (i = 0; i < desc->bd_iov_count; i++) {
-		/* corrupt the data before we compute the checksum, to
-		 * simulate a client->OST data error */
-		if (i == 0 && opc == OST_WRITE &&
-		    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_RECEIVE)) {
-			int off = desc->bd_iov[i].kiov_offset & ~CFS_PAGE_MASK;
-			int len = desc->bd_iov[i].kiov_len;
-			struct page *np = tgt_page_to_corrupt;
-			char *ptr = kmap(desc->bd_iov[i].kiov_page) + off;
-
-			if (np) {
-				char *ptr2 = kmap(np) + off;
-
-				memcpy(ptr2, ptr, len);
-				memcpy(ptr2, "bad3", min(4, len));
-				kunmap(np);
-				desc->bd_iov[i].kiov_page = np;
-			} else {
-				CERROR("%s: can't alloc page for corruption\n",
-				       tgt_name(tgt));
-			}
-		}
-		cfs_crypto_hash_update_page(hdesc, desc->bd_iov[i].kiov_page,
-				  desc->bd_iov[i].kiov_offset & ~CFS_PAGE_MASK,
-				  desc->bd_iov[i].kiov_len);
-
-		 /* corrupt the data after we compute the checksum, to
-		 * simulate an OST->client data error */
-		if (i == 0 && opc == OST_READ &&
-		    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_SEND)) {
-			int off = desc->bd_iov[i].kiov_offset & ~CFS_PAGE_MASK;
-			int len = desc->bd_iov[i].kiov_len;
-			struct page *np = tgt_page_to_corrupt;
-			char *ptr = kmap(desc->bd_iov[i].kiov_page) + off;
-
-			if (np) {
-				char *ptr2 = kmap(np) + off;
-
-				memcpy(ptr2, ptr, len);
-				memcpy(ptr2, "bad4", min(4, len));
-				kunmap(np);
-				desc->bd_iov[i].kiov_page = np;
-			} else {
-				CERROR("%s: can't alloc page for corruption\n",
-				       tgt_name(tgt));
-			}
+
+	/* corrupt the data before we compute the checksum, to
+	 * simulate a client->OST data error */
+	if (desc->bd_iov_count > 0 && opc == OST_WRITE &&
+	    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_RECEIVE)) {
+		int off = desc->bd_iov[0].kiov_offset & ~CFS_PAGE_MASK;
+		int len = desc->bd_iov[0].kiov_len;
+		struct page *np = tgt_page_to_corrupt;
+		char *ptr = kmap(desc->bd_iov[0].kiov_page) + off;
+
+		if (np) {
+			char *ptr2 = kmap(np) + off;
+
+			memcpy(ptr2, ptr, len);
+			memcpy(ptr2, "bad3", min(4, len));
+			kunmap(np);
+			desc->bd_iov[0].kiov_page = np;
+		} else {
+			CERROR("%s: can't alloc page for corruption\n",
+			       tgt_name(tgt));
 		}
 	}
 
 	bufsize = sizeof(cksum);
-	err = cfs_crypto_hash_final(hdesc, (unsigned char *)&cksum, &bufsize);
+	if (cksum_type == OBD_CKSUM_T10CRC)
+		err = tgt_checksum_t10(desc, guards, &cksum);
+	else
+		err = cfs_crypto_hash_pages(cfs_alg, tgt_checksum_page_get,
+					    desc, desc->bd_iov_count,
+					    (unsigned char *)&cksum, &bufsize);
+	if (err != 0) {
+		CERROR("%s: unable to compute checksum hash %s: rc = %d\n",
+		       tgt_name(tgt), cfs_crypto_hash_name(cfs_alg), err);
+		return err;
+	}
+
+	/* corrupt the data after we compute the checksum, to
+	 * simulate an OST->client data error */
+	if (desc->bd_iov_count > 0 && opc == OST_READ &&
+	    OBD_FAIL_CHECK(OBD_FAIL_OST_CHECKSUM_SEND)) {
+		int off = desc->bd_iov[0].kiov_offset & ~CFS_PAGE_MASK;
+		int len = desc->bd_iov[0].kiov_len;
+		struct page *np = tgt_page_to_corrupt;
+		char *ptr = kmap(desc->bd_iov[0].kiov_page) + off;
+
+		if (np) {
+			char *ptr2 = kmap(np) + off;
+
+			memcpy(ptr2, ptr, len);
+			memcpy(ptr2, "bad4", min(4, len));
+			kunmap(np);
+			desc->bd_iov[0].kiov_page = np;
+		} else {
+			CERROR("%s: can't alloc page for corruption\n",
+			       tgt_name(tgt));
+		}
+	}
 
 	return cksum;
 }
@@ -1787,7 +1832,8 @@ int tgt_brw_read(struct tgt_session_info *tsi)
 		repbody->oa.o_flags = cksum_type_pack(cksum_type);
 		repbody->oa.o_valid = OBD_MD_FLCKSUM | OBD_MD_FLFLAGS;
 		repbody->oa.o_cksum = tgt_checksum_bulk(tsi->tsi_tgt, desc,
-							OST_READ, cksum_type);
+							OST_READ, cksum_type,
+							NULL);
 		CDEBUG(D_PAGE, "checksum at read origin: %x\n",
 		       repbody->oa.o_cksum);
 	} else {
@@ -1894,6 +1940,53 @@ static void tgt_warn_on_cksum(struct ptlrpc_request *req,
 			   client_cksum, server_cksum);
 }
 
+/*
+ * Compare the T10-DIF guard tags sent by the client with the ones computed
+ * from the received pages. If they all match, hand the tags over to the OSD
+ * via lnb_guards so that they can be passed down to integrity capable
+ * storage instead of being generated again by the block layer.
+ */
+static void tgt_t10_guards_check(struct ptlrpc_request *req,
+				 struct niobuf_local *local_nb, int npages,
+				 __be16 *guards, unsigned int nguards)
+{
+	__be16		*client_guards;
+	unsigned int	 size;
+	unsigned int	 i;
+	int		 j;
+
+	if (!req_capsule_field_present(&req->rq_pill, &RMF_T10_GUARDS,
+				       RCL_CLIENT))
+		return;
+
+	size = req_capsule_get_size(&req->rq_pill, &RMF_T10_GUARDS,
+				    RCL_CLIENT);
+	if (size != nguards * sizeof(*guards)) {
+		DEBUG_REQ(D_ERROR, req, "bad T10 guard buffer size %u, "
+			  "expected %u", size,
+			  (unsigned int)(nguards * sizeof(*guards)));
+		return;
+	}
+
+	client_guards = req_capsule_client_get(&req->rq_pill,
+					       &RMF_T10_GUARDS);
+	for (i = 0; i < nguards; i++) {
+		if (client_guards[i] != guards[i]) {
+			DEBUG_REQ(D_ERROR, req, "T10 guard mismatch at sector "
+				  "%u of the bulk: client %04x, server %04x",
+				  i, be16_to_cpu(client_guards[i]),
+				  be16_to_cpu(guards[i]));
+			return;
+		}
+	}
+
+	for (i = 0, j = 0; j < npages; j++) {
+		local_nb[j].lnb_guards = guards + i;
+		i += obd_t10_guard_count(local_nb[j].lnb_len);
+	}
+	LASSERT(i == nguards);
+}
+
 int tgt_brw_write(struct tgt_session_info *tsi)
 {
 	struct ptlrpc_request	*req = tgt_ses_req(tsi);
@@ -1911,6 +2004,8 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 	cksum_type_t		 cksum_type = OBD_CKSUM_CRC32;
 	bool			 no_reply = false, mmap;
 	struct tgt_thread_big_cache *tbc = req->rq_svc_thread->t_data;
+	__be16			*guards = NULL;
+	unsigned int		 nguards = 0;
 
 	ENTRY;
 
@@ -2047,9 +2142,19 @@ skip_transfer:
 		repbody->oa.o_valid |= OBD_MD_FLCKSUM | OBD_MD_FLFLAGS;
 		repbody->oa.o_flags &= ~OBD_FL_CKSUM_ALL;
 		repbody->oa.o_flags |= cksum_type_pack(cksum_type);
+		if (cksum_type == OBD_CKSUM_T10CRC) {
+			/* on allocation failure the tags are computed in a
+			 * temporary buffer and not passed to the OSD */
+			nguards = tgt_t10_guard_count(desc);
+			OBD_ALLOC_LARGE(guards, nguards * sizeof(*guards));
+		}
 		repbody->oa.o_cksum = tgt_checksum_bulk(tsi->tsi_tgt, desc,
-							OST_WRITE, cksum_type);
+							OST_WRITE, cksum_type,
+							guards);
 		cksum_counter++;
+		if (guards != NULL)
+			tgt_t10_guards_check(req, local_nb, npages, guards,
+					     nguards);
 
 		if (unlikely(body->oa.o_cksum != repbody->oa.o_cksum)) {
 			mmap = (body->oa.o_valid & OBD_MD_FLFLAGS &&
@@ -2071,6 +2176,11 @@ skip_transfer:
 	rc = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp, &repbody->oa,
 			  objcount, ioo, remote_nb, npages, local_nb, NULL,
 			  rc);
+	if (guards != NULL) {
+		for (i = 0; i < npages; i++)
+			local_nb[i].lnb_guards = NULL;
+		OBD_FREE_LARGE(guards, nguards * sizeof(*guards));
+	}
 	if (rc == -ENOTCONN)
 		/* quota acquire process has been given up because
 		 * either the client has been evicted or the client
@@ -163,6 +163,123 @@ test_smoke () {
 }
 run_test smoke "lst regression test"
 
+test_latency () {
+	lst_prepare
+
+	local log=$TMP/$tfile.log
+	local feats
+
+	export LST_SESSION=$$
+
+	# old nodes reject sessions with features they don't know, so a
+	# default session mustn't ask for latency
+	$LST new_session --timeo 100 lat || error "new_session failed"
+	feats=$($LST show_session | awk '{ print $7 }')
+	(( (0x$feats & 0x2) == 0 )) ||
+		error "default session has latency feature: $feats"
+	$LST add_group s $(nids_list $lst_SERVERS) ||
+		error "add_group failed"
+	$LST stat --latency --count 1 s &&
+		error "latency stat without --latency succeeded"
+	$LST end_session
+
+	$LST new_session --timeo 100 --latency lat ||
+		error "new_session --latency failed"
+	feats=$($LST show_session | awk '{ print $7 }')
+	(( (0x$feats & 0x2) != 0 )) ||
+		error "latency session lacks latency feature: $feats"
+	$LST add_group c $(nids_list $lst_CLIENTS) || error "add_group failed"
+	$LST add_group s $(nids_list $lst_SERVERS) || error "add_group failed"
+	$LST add_batch b
+	$LST add_test --batch b --loop -1 --concurrency 4 --from c --to s \
+		ping || error "add_test failed"
+	$LST run b || error "run failed"
+	sleep 5
+	$LST stat --latency --count 1 --delay 5 c | tee $log
+	$LST stop b
+	$LST end_session
+
+	grep -q "^RPCs: [1-9][0-9]* p50: " $log ||
+		error "no latency percentiles reported"
+
+	lst_cleanup_all
+}
+run_test latency "lst RPC latency is opt-in per session"
+
+# NIDs of one multi-rail server, primary first, e.g.
+# "192.168.0.2@tcp,192.168.1.2@tcp1"; the local node must list them in the
+# lnet mr_peers module parameter
+lst_MR_NIDS=${lst_MR_NIDS:-}
+# interface of the second rail on that server, taken down for failover
+lst_MR_IFACE=${lst_MR_IFACE:-}
+
+mr_brw () {
+	local duration=$1
+
+	export LST_SESSION=$$
+	$LST new_session --timeo 100000 mr || return 1
+	$LST add_group c $($LCTL list_nids | head -1) || return 1
+	$LST add_group s ${lst_MR_NIDS%%,*} || return 1
+	$LST add_batch b || return 1
+	$LST add_test --batch b --loop -1 --concurrency 8 --from c --to s \
+		brw write size=1M || return 1
+	$LST run b || return 1
+	sleep $duration
+	$LST show_error c s
+	$LST stop b
+	$LST end_session
+}
+
+# number of sends to the multi-rail peer that were moved to rail NID $2,
+# LNet only logs those that don't use the primary NID
+mr_sends () {
+	grep "Multi-rail ${lst_MR_NIDS%%,*} via $2 " $1 | wc -l
+}
+
+test_mr () {
+	[ -z "$lst_MR_NIDS" ] &&
+		skip_env "lst_MR_NIDS not set" && return
+	grep -q ${lst_MR_NIDS%%,*} /sys/module/lnet/parameters/mr_peers ||
+		{ skip_env "${lst_MR_NIDS%%,*} not in mr_peers" && return; }
+
+	local log=$TMP/$tfile.log
+	local dbg=$TMP/$tfile.dbg
+	local server=$(facet_active_host ost1)
+	local nid
+
+	lst_prepare
+	$LCTL set_param debug=+net
+
+	# new sends are spread over the secondary rails too
+	$LCTL clear
+	mr_brw 30 2>&1 | tee $log
+	check_lst_err $log
+	$LCTL dk > $dbg
+	for nid in $(echo ${lst_MR_NIDS//,/ } | cut -d' ' -f2-); do
+		[ $(mr_sends $dbg $nid) -gt 0 ] ||
+			error "no sends via rail $nid"
+	done
+
+	if [ -n "$lst_MR_IFACE" ]; then
+		# with the second rail down new sends avoid it
+		nid=$(echo ${lst_MR_NIDS//,/ } | awk '{ print $2 }')
+		do_node $server ip link set dev $lst_MR_IFACE down
+		# let LNet find out the rail is gone
+		mr_brw 60 > /dev/null 2>&1
+		$LCTL clear
+		mr_brw 30 2>&1 | tee $log
+		do_node $server ip link set dev $lst_MR_IFACE up
+		check_lst_err $log
+		$LCTL dk > $dbg
+		[ $(mr_sends $dbg $nid) -eq 0 ] ||
+			error "$(mr_sends $dbg $nid) sends via failed rail $nid"
+	fi
+
+	$LCTL set_param debug=-net
+	lst_cleanup_all
+}
+run_test mr "multi-rail rail selection and failover"
+
 complete $SECONDS
 if [ "$RESTORE_MOUNT" = yes ]; then
     setupall
@@ -4212,6 +4212,90 @@ test_31h() {
 }
 run_test 31h "Repair the corrupted shard's name entry"
 
+test_32() {
+	local param=/sys/module/lfsck/parameters/lfsck_oit_threads
+	local threads=$(do_facet $SINGLEMDS "cat $param 2>/dev/null")
+
+	[ -z "$threads" ] && skip "no OIT worker threads support" && return
+
+	lfsck_prep 10 10
+
+	echo "#####"
+	echo "The OIT worker threads handle the objects out of order. When"
+	echo "the LFSCK fails, the checkpoint must not pass any object that"
+	echo "is still in processing, and resuming from it must repair all"
+	echo "the crashed linkEA entries exactly once."
+	echo "#####"
+
+	#define OBD_FAIL_LFSCK_LINKEA_CRASH	0x1603
+	do_facet $SINGLEMDS $LCTL set_param fail_loc=0x1603
+	for ((i = 0; i < 8; i++)); do
+		touch $DIR/$tdir/crashed_$i || error "(1) touch crashed_$i"
+	done
+	do_facet $SINGLEMDS $LCTL set_param fail_loc=0
+
+	do_facet $SINGLEMDS "echo 4 > $param"
+
+	#define OBD_FAIL_LFSCK_DELAY1		0x1600
+	do_facet $SINGLEMDS $LCTL set_param fail_val=1 fail_loc=0x1600
+	$START_NAMESPACE -r || error "(2) Fail to start LFSCK for namespace!"
+
+	# Sleep 3 sec to guarantee at least one object processed by LFSCK
+	sleep 3
+	#define OBD_FAIL_LFSCK_FATAL1		0x1608
+	do_facet $SINGLEMDS $LCTL set_param fail_loc=0x80001608
+	wait_update_facet $SINGLEMDS "$LCTL get_param -n \
+		mdd.${MDT_DEV}.lfsck_namespace |
+		awk '/^status/ { print \\\$2 }'" "failed" 32 || {
+		$SHOW_NAMESPACE
+		do_facet $SINGLEMDS "echo $threads > $param"
+		error "(3) unexpected status"
+	}
+
+	local POS0=$($SHOW_NAMESPACE |
+		     awk '/^last_checkpoint_position/ { print $2 }' |
+		     tr -d ',')
+
+	do_facet $SINGLEMDS $LCTL set_param fail_loc=0 fail_val=0
+	$START_NAMESPACE || error "(4) Fail to start LFSCK for namespace!"
+
+	local POS1=$($SHOW_NAMESPACE |
+		     awk '/^latest_start_position/ { print $2 }' |
+		     tr -d ',')
+	[[ $POS0 -lt $POS1 ]] ||
+		error "(5) Expect larger than: $POS0, but got $POS1"
+
+	wait_update_facet $SINGLEMDS "$LCTL get_param -n \
+		mdd.${MDT_DEV}.lfsck_namespace |
+		awk '/^status/ { print \\\$2 }'" "completed" 32 || {
+		$SHOW_NAMESPACE
+		do_facet $SINGLEMDS "echo $threads > $param"
+		error "(6) unexpected status"
+	}
+
+	local repaired=$($SHOW_NAMESPACE |
+			 awk '/^linkea_repaired/ { print $2 }')
+	[ $repaired -eq 8 ] ||
+		error "(7) Expect 8 crashed linkEA repaired, got $repaired"
+
+	$START_LAYOUT -r || error "(8) Fail to start LFSCK for layout!"
+	wait_update_facet $SINGLEMDS "$LCTL get_param -n \
+		mdd.${MDT_DEV}.lfsck_layout |
+		awk '/^status/ { print \\\$2 }'" "completed" 32 || {
+		$SHOW_LAYOUT
+		do_facet $SINGLEMDS "echo $threads > $param"
+		error "(9) unexpected status"
+	}
+
+	do_facet $SINGLEMDS "echo $threads > $param"
+
+	local failed=$($SHOW_LAYOUT |
+		       awk '/^failed_phase1/ { print $2 }')
+	[ $failed -eq 0 ] ||
+		error "(10) layout LFSCK failed on $failed objects"
+}
+run_test 32 "LFSCK with OIT worker threads resumes from oldest outstanding"
+
 # restore MDS/OST size
 MDSSIZE=${SAVED_MDSSIZE}
 OSTSIZE=${SAVED_OSTSIZE}
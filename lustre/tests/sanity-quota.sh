@@ -2379,6 +2379,87 @@ test_37() {
 }
 run_test 37 "Quota accounted properly for file created by 'lfs setstripe'"
 
+# pre-acquire requests of several IDs are packed in one batched DQACQ
+test_38() {
+	local TESTFILE=$DIR/$tdir/$tfile
+	local LIMIT=200 # 200M
+	local count
+
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+
+	setup_quota_test
+	trap cleanup_quota_test EXIT
+
+	# only ost1 talks to the master during the test
+	set_mdt_qtype "none" || error "disable mdt quota failed"
+	set_ost_qtype "ug" || error "enable ost quota failed"
+	$LFS setquota -u $TSTUSR -b 0 -B ${LIMIT}M -i 0 -I 0 $DIR ||
+		error "set user quota failed"
+	$LFS setquota -g $TSTUSR -b 0 -B ${LIMIT}M -i 0 -I 0 $DIR ||
+		error "set group quota failed"
+	$LFS setquota -u $TSTUSR2 -b 0 -B ${LIMIT}M -i 0 -I 0 $DIR ||
+		error "set user quota failed"
+	$LFS setquota -g $TSTUSR2 -b 0 -B ${LIMIT}M -i 0 -I 0 $DIR ||
+		error "set group quota failed"
+	$LFS setstripe $DIR/$tdir -c 1 -i 0 || error "setstripe failed"
+
+	# hold the writeback thread on ost1 so that the adjustments
+	# scheduled by the writes of all IDs are sent together
+	do_facet ost1 $LCTL clear
+	#define OBD_FAIL_QUOTA_DELAY_ADJUST 0xa05
+	do_facet ost1 $LCTL set_param fail_loc=0xa05
+	$RUNAS $DD of=$TESTFILE-1 count=20 oflag=sync ||
+		quota_error u $TSTUSR "write failed"
+	$RUNAS2 $DD of=$TESTFILE-2 count=20 oflag=sync ||
+		quota_error u $TSTUSR2 "write failed"
+
+	# the first quota_body handled by the master fails, the status
+	# must be returned for this ID only
+	#define OBD_FAIL_QUOTA_RECOVERABLE_ERR 0xa04
+	#define ENOLCK  37
+	lustre_fail mds 0x80000a04 37
+	do_facet ost1 $LCTL set_param fail_loc=0
+
+	# deferred adjustments are processed after QSD_WB_INTERVAL
+	local wait=0
+	rm -f $TMP/$tfile.log
+	while [ $wait -lt 90 ]; do
+		sleep 5
+		wait=$((wait + 5))
+		do_facet ost1 $LCTL dk >> $TMP/$tfile.log
+		grep -q "DQACQ returned -37" $TMP/$tfile.log && break
+	done
+	lustre_fail mds 0 0
+
+	count=$(grep -o "DQACQ batched.* [0-9]* pending" $TMP/$tfile.log |
+		awk '{ print $(NF - 1) }' | sort -n | tail -n 1)
+	[ -n "$count" ] && [ $count -ge 2 ] ||
+		error "no batched DQACQ sent by ost1"
+	grep -q "DQACQ returned -37" $TMP/$tfile.log ||
+		error "per-ID error not returned to ost1"
+	grep -q "DQACQ returned 0" $TMP/$tfile.log ||
+		error "other IDs of the batch failed as well"
+	rm -f $TMP/$tfile.log
+
+	# the failed adjustment is retried, usage stays consistent
+	$RUNAS $DD of=$TESTFILE-1 count=1 seek=20 oflag=sync ||
+		quota_error u $TSTUSR "write after batch failed"
+	sync_all_data || true
+	local used=$(getquota -u $TSTUSR global curspace)
+	[ $used -ge $((21 * 1024)) ] || quota_error u $TSTUSR \
+		"Used space(${used}K) is less than 21M"
+	used=$(getquota -u $TSTUSR2 global curspace)
+	[ $used -ge $((20 * 1024)) ] || quota_error u $TSTUSR2 \
+		"Used space(${used}K) is less than 20M"
+
+	cleanup_quota_test
+	resetquota -u $TSTUSR
+	resetquota -g $TSTUSR
+	resetquota -u $TSTUSR2
+	resetquota -g $TSTUSR2
+}
+run_test 38 "Batched DQACQ returns per-ID status"
+
 quota_fini()
 {
         do_nodes $(comma_list $(nodes_list)) "lctl set_param debug=-quota"
@@ -1141,6 +1141,52 @@ test_15() {
 }
 run_test 15 "Dryrun mode OI scrub"
 
+test_16() {
+	local param=/sys/module/osd_ldiskfs/parameters/osd_scrub_ra_groups
+	local saved=$(do_facet $SINGLEMDS "cat $param 2>/dev/null")
+	local mdts=$(comma_list $(mdts_nodes))
+	local ra
+
+	[ -z "$saved" ] && skip "no inode table readahead support" && return
+
+	scrub_prep 20
+	scrub_backup_restore 1
+	echo "starting MDTs with OI scrub disabled"
+	scrub_start_mds 2 "$MOUNT_OPTS_NOSCRUB"
+	scrub_check_status 3 init
+	scrub_check_flags 4 inconsistent
+
+	# the readahead window must not change what the scan finds, from
+	# disabled over one group to more groups than the device has
+	for ra in 0 1 1024; do
+		do_nodes $mdts "echo $ra > $param"
+		scrub_start 5 --dryrun
+		scrub_check_status 6 completed
+		scrub_check_flags 7 inconsistent
+		scrub_check_repaired 8 20
+	done
+
+	do_nodes $mdts "echo 2 > $param"
+	scrub_start 9
+	scrub_check_status 10 completed
+	scrub_check_flags 11 ""
+	scrub_check_repaired 12 20
+
+	# LFSCK reads the inode tables through the otable iterator, which
+	# refills its cache many times during one pass
+	do_facet $SINGLEMDS $LCTL lfsck_start -M ${MDT_DEV} -t namespace -r ||
+		error "(13) Fail to start LFSCK for namespace"
+	wait_update_facet $SINGLEMDS "$LCTL get_param -n \
+		mdd.${MDT_DEV}.lfsck_namespace |
+		awk '/^status/ { print \\\$2 }'" "completed" 32 ||
+		error "(14) LFSCK for namespace did not complete"
+	do_nodes $mdts "echo $saved > $param"
+
+	mount_client $MOUNT || error "(15) Fail to start client!"
+	scrub_check_data 16
+}
+run_test 16 "OI scrub with inode table readahead"
+
 # restore MDS/OST size
 MDSSIZE=${SAVED_MDSSIZE}
 OSTSIZE=${SAVED_OSTSIZE}
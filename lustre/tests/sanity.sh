@@ -5935,6 +5935,97 @@ test_77j() { # bug 13805
 }
 run_test 77j "client only supporting ADLER32"
 
+t10crc_supported() {
+	$LCTL get_param -n osc.*osc-[^mM]*.checksum_type | head -n1 |
+		grep -qw t10crc
+}
+
+test_77k() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$GSS && skip "could not run with gss" && return
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+	t10crc_supported || { skip "t10crc checksum not supported"; return; }
+
+	[ ! -f $F77_TMP ] && setup_f77
+	$SETSTRIPE -c 1 -i 0 $DIR/$tfile
+	set_checksums 1
+	set_checksum_type t10crc
+	local algo=$($LCTL get_param -n osc.*osc-[^mM]*.checksum_type |
+		     sed 's/.*\[\(.*\)\].*/\1/g' | head -n1)
+	[ "$algo" = "t10crc" ] || error "algo set to $algo instead of t10crc"
+
+	dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ || error "dd error"
+	cancel_lru_locks osc
+	cmp $F77_TMP $DIR/$tfile || error "file compare failed"
+
+	# corrupted bulk on the client must be resent
+	#define OBD_FAIL_OSC_CHECKSUM_SEND       0x409
+	$LCTL set_param fail_loc=0x80000409
+	dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ conv=sync ||
+		error "dd error on client corruption: $?"
+	$LCTL set_param fail_loc=0
+	cancel_lru_locks osc
+	cmp $F77_TMP $DIR/$tfile || error "file compare failed after resend"
+
+	# bulk corrupted on the OST must be caught by the guard tags
+	do_facet ost1 $LCTL clear
+	#define OBD_FAIL_OST_CHECKSUM_RECEIVE       0x21a
+	do_facet ost1 $LCTL set_param fail_loc=0x8000021a
+	dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ conv=sync ||
+		error "dd error on OST corruption: $?"
+	do_facet ost1 $LCTL set_param fail_loc=0
+	do_facet ost1 $LCTL dk | grep -q "T10 guard mismatch" ||
+		error "guard mismatch not reported by ost1"
+	cancel_lru_locks osc
+	cmp $F77_TMP $DIR/$tfile || error "file compare failed after OST resend"
+
+	set_checksum_type $ORIG_CSUM_TYPE
+	set_checksums 0
+	rm -f $DIR/$tfile
+}
+run_test 77k "t10crc checksum read/write and error detection"
+
+test_77l() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	$GSS && skip "could not run with gss" && return
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+	[ $(facet_fstype ost1) != ldiskfs ] &&
+		skip "ldiskfs only test" && return
+	t10crc_supported || { skip "t10crc checksum not supported"; return; }
+
+	# ost1 has to sit on a device with T10-DIF Type 1 integrity and
+	# 512-byte sectors, e.g. scsi_debug with dif=1 dix=1 sector_size=512
+	local dev=$(do_facet ost1 "readlink -f \
+		\$($LCTL get_param -n osd-ldiskfs.$FSNAME-OST0000.mntdev)")
+	local fmt=$(do_facet ost1 \
+		"cat /sys/block/${dev##*/}/integrity/format 2>/dev/null")
+	[ "$fmt" = "T10-DIF-TYPE1-CRC" ] ||
+		{ skip_env "$dev has no T10-DIF-TYPE1-CRC integrity"; return; }
+
+	[ ! -f $F77_TMP ] && setup_f77
+	$SETSTRIPE -c 1 -i 0 $DIR/$tfile
+	set_checksums 1
+	set_checksum_type t10crc
+
+	local old_debug=$(do_facet ost1 $LCTL get_param -n debug)
+	do_facet ost1 $LCTL set_param debug=+inode
+	do_facet ost1 $LCTL clear
+	dd if=$F77_TMP of=$DIR/$tfile bs=1M count=$F77SZ oflag=sync ||
+		error "dd error"
+	local passed=$(do_facet ost1 $LCTL dk |
+		       grep -c "passing T10 guards of")
+	do_facet ost1 $LCTL set_param debug="\"$old_debug\""
+	[ $passed -gt 0 ] || error "no T10 guards passed to $dev"
+
+	cancel_lru_locks osc
+	cmp $F77_TMP $DIR/$tfile || error "file compare failed"
+
+	set_checksum_type $ORIG_CSUM_TYPE
+	set_checksums 0
+	rm -f $DIR/$tfile
+}
+run_test 77l "t10crc guard tags passed to an integrity capable OST"
+
 [ "$ORIG_CSUM" ] && set_checksums $ORIG_CSUM || true
 rm -f $F77_TMP
 unset F77_TMP
@@ -12949,6 +13040,37 @@ test_243()
 }
 run_test 243 "various group lock tests"
 
+test_244() {
+	[ $(lustre_version_code $SINGLEMDS) -lt $(version_code 2.7.50) ] &&
+		skip "Need MDS version at least 2.7.50" && return
+	local mdtosc=$(get_mdtosc_proc_path $SINGLEMDS $FSNAME-OST0000)
+	local window=$(do_facet $SINGLEMDS \
+		lctl get_param -n osc.$mdtosc.create_window)
+
+	do_facet $SINGLEMDS lctl set_param osc.$mdtosc.create_window=-1 &&
+		error "negative create_window accepted"
+	do_facet $SINGLEMDS lctl set_param osc.$mdtosc.create_window=4 ||
+		error "cannot set create_window"
+	do_facet $SINGLEMDS lctl set_param osc.$mdtosc.prealloc_stats=clear
+
+	test_mkdir -p $DIR/$tdir
+	$SETSTRIPE -i 0 -c 1 $DIR/$tdir
+	createmany -o $DIR/$tdir/f- 2000 || error "createmany failed"
+	sleep 1
+	# the rate is folded in on the next create after a second boundary
+	touch $DIR/$tdir/f-last
+
+	local rate=$(do_facet $SINGLEMDS lctl get_param -n \
+		osc.$mdtosc.prealloc_stats | awk '/create_rate/ { print $2 }')
+	do_facet $SINGLEMDS lctl set_param osc.$mdtosc.create_window=$window
+	[ -n "$rate" ] || error "no create_rate in prealloc_stats"
+	[ $rate -gt 0 ] || error "create_rate $rate after 2000 creates"
+
+	rm -f $DIR/$tdir/f-last
+	unlinkmany $DIR/$tdir/f- 2000
+}
+run_test 244 "OSP precreate tracks the create rate"
+
 test_250() {
 	[ "$(facet_fstype ost$(($($GETSTRIPE -i $DIR/$tfile) + 1)))" = "zfs" ] \
 	 && skip "no 16TB file size limit on ZFS" && return
@@ -525,12 +525,14 @@ check_obd_connect_data(void)
 	CHECK_DEFINE_64X(OBD_CONNECT_FLOCK_DEAD);
 	CHECK_DEFINE_64X(OBD_CONNECT_OPEN_BY_FID);
 	CHECK_DEFINE_64X(OBD_CONNECT_LFSCK);
+	CHECK_DEFINE_64X(OBD_CONNECT_DQACQ_BATCH);
 	CHECK_DEFINE_64X(OBD_CONNECT_UNLINK_CLOSE);
 	CHECK_DEFINE_64X(OBD_CONNECT_DIR_STRIPE);
 
 	CHECK_VALUE_X(OBD_CKSUM_CRC32);
 	CHECK_VALUE_X(OBD_CKSUM_ADLER);
 	CHECK_VALUE_X(OBD_CKSUM_CRC32C);
+	CHECK_VALUE_X(OBD_CKSUM_T10CRC);
 }
 
 static void
@@ -630,7 +632,7 @@ check_obdo(void)
 	CHECK_CVALUE_X(OBD_FL_CKSUM_CRC32);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_ADLER);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_CRC32C);
-	CHECK_CVALUE_X(OBD_FL_CKSUM_RSVD2);
+	CHECK_CVALUE_X(OBD_FL_CKSUM_T10CRC);
 	CHECK_CVALUE_X(OBD_FL_CKSUM_RSVD3);
 	CHECK_CVALUE_X(OBD_FL_SHRINK_GRANT);
 	CHECK_CVALUE_X(OBD_FL_MMAP);